@@ -1,5 +1,6 @@
 import 'dart:async';
 import 'dart:io';
+import 'dart:typed_data';
 
 import 'package:flutter/foundation.dart';
 import 'package:flutter/services.dart';
@@ -45,9 +46,161 @@ class MidiPlaybackInfo {
   }
 }
 
+/// 离线渲染结果信息
+class MidiRenderInfo {
+  /// 渲染出的音频时长（毫秒）
+  final int durationMs;
+
+  /// 渲染耗时（毫秒）
+  final int renderTimeMs;
+
+  /// 渲染速度相对实时播放的倍数
+  final double realtimeFactor;
+
+  const MidiRenderInfo({
+    required this.durationMs,
+    required this.renderTimeMs,
+    required this.realtimeFactor,
+  });
+
+  factory MidiRenderInfo.fromMap(Map<String, dynamic> map) {
+    return MidiRenderInfo(
+      durationMs: map['durationMs'] ?? 0,
+      renderTimeMs: map['renderTimeMs'] ?? 0,
+      realtimeFactor: (map['realtimeFactor'] ?? 0.0).toDouble(),
+    );
+  }
+}
+
+/// 已解析MIDI文件缓存的统计信息
+class MidiCacheStats {
+  /// 命中次数
+  final int hits;
+
+  /// 未命中次数
+  final int misses;
+
+  /// 因超出内存预算而淘汰的条目数
+  final int evictions;
+
+  /// 当前缓存的文件数
+  final int entries;
+
+  /// 当前占用的内存（字节）
+  final int bytes;
+
+  /// 内存预算（字节）
+  final int budgetBytes;
+
+  const MidiCacheStats({
+    required this.hits,
+    required this.misses,
+    required this.evictions,
+    required this.entries,
+    required this.bytes,
+    required this.budgetBytes,
+  });
+
+  factory MidiCacheStats.fromMap(Map<String, dynamic> map) {
+    return MidiCacheStats(
+      hits: map['hits'] ?? 0,
+      misses: map['misses'] ?? 0,
+      evictions: map['evictions'] ?? 0,
+      entries: map['entries'] ?? 0,
+      bytes: map['bytes'] ?? 0,
+      budgetBytes: map['budgetBytes'] ?? 0,
+    );
+  }
+}
+
+/// 一项计时指标的分布摘要（分位数按2的幂分桶估算，偏大不超过一倍）
+class MidiStatsHistogram {
+  /// 样本数
+  final int count;
+
+  /// 平均值
+  final double mean;
+
+  /// 中位数
+  final int p50;
+
+  /// 90分位
+  final int p90;
+
+  /// 99分位
+  final int p99;
+
+  /// 最大值
+  final int max;
+
+  const MidiStatsHistogram({
+    required this.count,
+    required this.mean,
+    required this.p50,
+    required this.p90,
+    required this.p99,
+    required this.max,
+  });
+
+  factory MidiStatsHistogram.fromMap(Map<dynamic, dynamic>? map) {
+    return MidiStatsHistogram(
+      count: map?['count'] ?? 0,
+      mean: (map?['mean'] ?? 0.0).toDouble(),
+      p50: map?['p50'] ?? 0,
+      p90: map?['p90'] ?? 0,
+      p99: map?['p99'] ?? 0,
+      max: map?['max'] ?? 0,
+    );
+  }
+}
+
+/// 播放引擎的计时统计
+class MidiPlaybackStats {
+  /// 事件实际发出时间晚于计划时间的微秒数
+  final MidiStatsHistogram dispatchLatenessUs;
+
+  /// 引擎线程每次调度播放器的耗时（微秒）
+  final MidiStatsHistogram serviceDurationUs;
+
+  /// 每次生成一段音频的耗时（微秒），仅软件合成输出时记录
+  final MidiStatsHistogram audioCallbackUs;
+
+  /// 引擎线程每次取命令时排队的命令数
+  final MidiStatsHistogram commandQueueDepth;
+
+  /// 执行跳转命令的耗时（微秒）
+  final MidiStatsHistogram seekLatencyUs;
+
+  /// 音频输出缓冲欠载次数
+  final int underruns;
+
+  const MidiPlaybackStats({
+    required this.dispatchLatenessUs,
+    required this.serviceDurationUs,
+    required this.audioCallbackUs,
+    required this.commandQueueDepth,
+    required this.seekLatencyUs,
+    required this.underruns,
+  });
+
+  factory MidiPlaybackStats.fromMap(Map<String, dynamic> map) {
+    return MidiPlaybackStats(
+      dispatchLatenessUs: MidiStatsHistogram.fromMap(map['dispatchLatenessUs']),
+      serviceDurationUs: MidiStatsHistogram.fromMap(map['serviceDurationUs']),
+      audioCallbackUs: MidiStatsHistogram.fromMap(map['audioCallbackUs']),
+      commandQueueDepth: MidiStatsHistogram.fromMap(map['commandQueueDepth']),
+      seekLatencyUs: MidiStatsHistogram.fromMap(map['seekLatencyUs']),
+      underruns: map['underruns'] ?? 0,
+    );
+  }
+}
+
 /// MIDI播放器类
 class PlayMidifile {
   static const MethodChannel _channel = MethodChannel('playmidifile');
+  static const EventChannel _eventChannel = EventChannel('playmidifile/events');
+
+  Stream<Map<String, dynamic>>? _events;
 
   static PlayMidifile? _instance;
   static PlayMidifile get instance => _instance ??= PlayMidifile._();
@@ -55,9 +208,44 @@ class PlayMidifile {
   PlayMidifile._();
 
   /// 初始化插件
-  Future<void> initialize() async {
+  /// 默认通过系统MIDI设备（Microsoft GS Wavetable Synth）播放。
+  /// 指定 [soundFontPath] 时改用内置软件合成器，经 WASAPI 输出（仅Windows）：
+  /// [sampleRate] 采样率
+  /// [periodFrames] 声卡每次取走的帧数（32 - 8192）
+  /// [bufferCount] 预先渲染的周期数（2 - 16）
+  /// 输出延迟约为 periodFrames * bufferCount / sampleRate 秒；
+  /// 数值越小延迟越低，但越容易欠载，欠载次数见 [getStats]
+  /// [leadInMs] 每次加载和跳转后在后台预先渲染的时长（0 - 2000毫秒），
+  /// 使 [play] 在声卡的下一个周期即可出声；为0时不预渲染，
+  /// 短于输出延迟加一个周期时也不生效
+  Future<void> initialize({
+    String? soundFontPath,
+    int sampleRate = 48000,
+    int periodFrames = 480,
+    int bufferCount = 3,
+    int leadInMs = 300,
+  }) async {
     try {
-      await _channel.invokeMethod('initialize');
+      if (soundFontPath == null) {
+        await _channel.invokeMethod('initialize');
+        return;
+      }
+      if (periodFrames < 32 || periodFrames > 8192) {
+        throw Exception('周期帧数必须在32到8192之间');
+      }
+      if (bufferCount < 2 || bufferCount > 16) {
+        throw Exception('缓冲周期数必须在2到16之间');
+      }
+      if (leadInMs < 0 || leadInMs > 2000) {
+        throw Exception('预渲染时长必须在0到2000毫秒之间');
+      }
+      await _channel.invokeMethod('initialize', {
+        'soundFontPath': soundFontPath,
+        'sampleRate': sampleRate,
+        'periodFrames': periodFrames,
+        'bufferCount': bufferCount,
+        'leadInMs': leadInMs,
+      });
     } catch (e) {
       if (kDebugMode) {
         print('初始化MIDI播放器失败: $e');
@@ -68,6 +256,8 @@ class PlayMidifile {
 
   /// 加载MIDI文件
   /// [filePath] MIDI文件路径
+  /// Windows上在后台线程解析；上一次加载尚未完成时再次加载会取消上一次，
+  /// 上一次的调用以`LOAD_CANCELLED`错误结束
   Future<bool> loadFile(String filePath) async {
     try {
       // 在测试环境中跳过文件存在检查
@@ -89,8 +279,26 @@ class PlayMidifile {
     }
   }
 
+  /// 从内存加载MIDI文件（仅Windows）
+  /// 适用于下载或程序生成的数据，无需先写入临时文件
+  /// [bytes] 完整的标准MIDI文件内容
+  Future<bool> loadBytes(Uint8List bytes) async {
+    try {
+      final result = await _channel.invokeMethod('loadBytes', {
+        'bytes': bytes,
+      });
+      return result == true;
+    } catch (e) {
+      if (kDebugMode) {
+        print('从内存加载MIDI文件失败: $e');
+      }
+      rethrow;
+    }
+  }
+
   /// 从assets加载MIDI文件
   /// [assetPath] assets中的MIDI文件路径
+  /// 与 [loadFile] 一样，较新的加载会取消尚未完成的加载
   Future<bool> loadAsset(String assetPath) async {
     try {
       final result = await _channel.invokeMethod('loadAsset', {
@@ -105,6 +313,51 @@ class PlayMidifile {
     }
   }
 
+  /// 把MIDI文件加入播放队列末尾（仅Windows）
+  /// 当前文件播放时，原生端会在后台预先解析队列中的下一个文件，
+  /// 并在当前文件结束的同一时刻无缝开始播放它
+  /// [filePath] MIDI文件路径
+  Future<void> enqueue(String filePath) async {
+    try {
+      await _channel.invokeMethod('enqueue', {
+        'filePath': filePath,
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        print('加入播放队列失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 用 [filePaths] 替换整个播放队列（仅Windows），传入空列表即清空队列
+  Future<void> setQueue(List<String> filePaths) async {
+    try {
+      await _channel.invokeMethod('setQueue', {
+        'filePaths': filePaths,
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        print('设置播放队列失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 立即切换到队列中的下一个文件（仅Windows）
+  /// 正在播放时切换后继续播放；队列为空时以`QUEUE_EMPTY`错误结束
+  Future<bool> next() async {
+    try {
+      final result = await _channel.invokeMethod('next');
+      return result == true;
+    } catch (e) {
+      if (kDebugMode) {
+        print('切换到下一首失败: $e');
+      }
+      rethrow;
+    }
+  }
+
   /// 开始播放
   Future<void> play() async {
     try {
@@ -211,6 +464,181 @@ class PlayMidifile {
     }
   }
 
+  /// 将MIDI文件离线渲染为16位立体声WAV文件（仅Windows）
+  /// 不依赖播放状态和MIDI设备，无需先调用 [initialize]
+  /// [filePath] MIDI文件路径
+  /// [outputPath] 输出的WAV文件路径
+  /// [soundFontPath] SF2音色库路径
+  /// [sampleRate] 采样率
+  /// [threads] 并行渲染的线程数，按通道分组（1 - 16）
+  Future<MidiRenderInfo> renderToFile(
+    String filePath,
+    String outputPath, {
+    required String soundFontPath,
+    int sampleRate = 44100,
+    int threads = 1,
+  }) async {
+    try {
+      if (threads < 1 || threads > 16) {
+        throw Exception('线程数必须在1到16之间');
+      }
+
+      final result = await _channel.invokeMethod('renderToFile', {
+        'filePath': filePath,
+        'outputPath': outputPath,
+        'soundFontPath': soundFontPath,
+        'sampleRate': sampleRate,
+        'threads': threads,
+      });
+      final Map<String, dynamic> map = {};
+      (result as Map).forEach((key, value) {
+        map[key.toString()] = value;
+      });
+      return MidiRenderInfo.fromMap(map);
+    } catch (e) {
+      if (kDebugMode) {
+        print('渲染到文件失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 将MIDI文件离线渲染到内存（仅Windows）
+  /// 返回交错的立体声PCM浮点采样（左、右、左、右……）
+  /// 参数同 [renderToFile]
+  Future<Float32List> renderToBuffer(
+    String filePath, {
+    required String soundFontPath,
+    int sampleRate = 44100,
+    int threads = 1,
+  }) async {
+    try {
+      if (threads < 1 || threads > 16) {
+        throw Exception('线程数必须在1到16之间');
+      }
+
+      final result = await _channel.invokeMethod('renderToBuffer', {
+        'filePath': filePath,
+        'soundFontPath': soundFontPath,
+        'sampleRate': sampleRate,
+        'threads': threads,
+      });
+      return result as Float32List;
+    } catch (e) {
+      if (kDebugMode) {
+        print('渲染到内存失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 获取已解析MIDI文件缓存的统计信息（仅Windows）
+  /// 重复加载同一文件（路径、大小和修改时间均未变化）时直接使用缓存
+  Future<MidiCacheStats?> getCacheStats() async {
+    try {
+      final result = await _channel.invokeMethod('getCacheStats');
+      if (result is Map) {
+        final Map<String, dynamic> convertedMap = {};
+        result.forEach((key, value) {
+          convertedMap[key.toString()] = value;
+        });
+        return MidiCacheStats.fromMap(convertedMap);
+      }
+      return null;
+    } catch (e) {
+      if (kDebugMode) {
+        print('获取缓存统计失败: $e');
+      }
+      return null;
+    }
+  }
+
+  /// 设置已解析MIDI文件缓存的内存预算（仅Windows）
+  /// [bytes] 预算字节数，超出时淘汰最久未使用的文件；0表示禁用缓存
+  Future<void> setCacheBudget(int bytes) async {
+    try {
+      if (bytes < 0) {
+        throw Exception('缓存预算不能为负数');
+      }
+
+      await _channel.invokeMethod('setCacheBudget', {'bytes': bytes});
+    } catch (e) {
+      if (kDebugMode) {
+        print('设置缓存预算失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 获取播放计时统计（仅Windows）
+  /// 自初始化或上次 [resetStats] 以来所有播放器的事件延迟、调度耗时、
+  /// 跳转耗时等；统计始终开启，开销可以忽略
+  Future<MidiPlaybackStats?> getStats() async {
+    try {
+      final result = await _channel.invokeMethod('getStats');
+      if (result is Map) {
+        final Map<String, dynamic> convertedMap = {};
+        result.forEach((key, value) {
+          convertedMap[key.toString()] = value;
+        });
+        return MidiPlaybackStats.fromMap(convertedMap);
+      }
+      return null;
+    } catch (e) {
+      if (kDebugMode) {
+        print('获取播放统计失败: $e');
+      }
+      return null;
+    }
+  }
+
+  /// 清零播放计时统计（仅Windows）
+  Future<void> resetStats() async {
+    try {
+      await _channel.invokeMethod('resetStats');
+    } catch (e) {
+      if (kDebugMode) {
+        print('清零播放统计失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 设置流式加载的文件大小阈值（仅Windows）
+  /// [bytes] 不小于该大小的文件边播放边从磁盘解码，内存占用与文件长度无关；
+  /// 默认8MB，0表示总是完整解析后再播放。从下一次加载起生效
+  Future<void> setStreamingThreshold(int bytes) async {
+    try {
+      if (bytes < 0) {
+        throw Exception('流式加载阈值不能为负数');
+      }
+
+      await _channel.invokeMethod('setStreamingThreshold', {'bytes': bytes});
+    } catch (e) {
+      if (kDebugMode) {
+        print('设置流式加载阈值失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 创建一个独立的播放器（仅Windows）
+  /// 每个播放器有自己的文件、播放状态、速度和音量，可与默认播放器同时播放，
+  /// 例如伴奏加节拍器；所有播放器共用一个MIDI输出和一个播放线程
+  /// 播放器共享MIDI设备的16个通道，同时播放的文件应使用不同的通道
+  /// 不再使用时调用 [MidiPlayer.dispose]
+  Future<MidiPlayer> createPlayer() async {
+    try {
+      final result = await _channel.invokeMethod('createPlayer');
+      return MidiPlayer._(this, result as int);
+    } catch (e) {
+      if (kDebugMode) {
+        print('创建播放器失败: $e');
+      }
+      rethrow;
+    }
+  }
+
   /// 释放资源（简化版本）
   Future<void> dispose() async {
     try {
@@ -222,7 +650,172 @@ class PlayMidifile {
     }
   }
 
-  // 添加一些 getter 方法用于兼容
-  Stream<MidiPlaybackInfo> get onProgressChanged => Stream.empty();
-  Stream<MidiPlayerState> get onStateChanged => Stream.empty();
+  /// 设置进度事件的推送间隔（仅Windows）
+  /// 播放中按此间隔推送进度；状态变化（包括播放结束）会立即推送
+  /// [intervalMs] 间隔毫秒数，默认200
+  Future<void> setProgressInterval(int intervalMs) async {
+    try {
+      if (intervalMs < 1) {
+        throw Exception('推送间隔必须大于0');
+      }
+
+      await _channel.invokeMethod('setProgressInterval', {
+        'intervalMs': intervalMs,
+      });
+    } catch (e) {
+      if (kDebugMode) {
+        print('设置进度推送间隔失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 原生端推送的进度与状态事件，目前仅Windows提供
+  /// 原生端在界面线程繁忙时会合并事件，只保留最新的一条
+  Stream<Map<String, dynamic>> get _eventStream {
+    if (defaultTargetPlatform != TargetPlatform.windows) {
+      return const Stream.empty();
+    }
+    return _events ??= _eventChannel.receiveBroadcastStream().map((event) {
+      final Map<String, dynamic> convertedMap = {};
+      (event as Map).forEach((key, value) {
+        convertedMap[key.toString()] = value;
+      });
+      return convertedMap;
+    });
+  }
+
+  /// 某个播放器的事件；默认播放器的编号为0
+  Stream<Map<String, dynamic>> _playerEvents(int playerId) =>
+      _eventStream.where((event) => (event['playerId'] ?? 0) == playerId);
+
+  /// 播放进度变化流（仅Windows推送，其他平台为空流）
+  Stream<MidiPlaybackInfo> get onProgressChanged =>
+      _playerEvents(0).map(MidiPlaybackInfo.fromMap);
+
+  /// 播放状态变化流（仅Windows推送，其他平台为空流）
+  Stream<MidiPlayerState> get onStateChanged => _playerEvents(0)
+      .map((event) => _parseState(event['state']))
+      .distinct();
+
+  static MidiPlayerState _parseState(Object? state) {
+    switch (state) {
+      case 'playing':
+        return MidiPlayerState.playing;
+      case 'paused':
+        return MidiPlayerState.paused;
+      case 'stopped':
+        return MidiPlayerState.stopped;
+      default:
+        return MidiPlayerState.error;
+    }
+  }
+}
+
+/// 由 [PlayMidifile.createPlayer] 创建的独立播放器（仅Windows）
+/// 方法与 [PlayMidifile] 中的同名方法相同，只作用于这个播放器
+class MidiPlayer {
+  final PlayMidifile _owner;
+
+  /// 播放器编号
+  final int id;
+
+  MidiPlayer._(this._owner, this.id);
+
+  Future<dynamic> _invoke(String method, String action,
+      [Map<String, dynamic> arguments = const {}]) async {
+    try {
+      return await PlayMidifile._channel
+          .invokeMethod(method, {...arguments, 'playerId': id});
+    } catch (e) {
+      if (kDebugMode) {
+        print('播放器$id$action失败: $e');
+      }
+      rethrow;
+    }
+  }
+
+  /// 加载MIDI文件
+  Future<bool> loadFile(String filePath) async =>
+      await _invoke('loadFile', '加载MIDI文件', {'filePath': filePath}) == true;
+
+  /// 从内存加载MIDI文件
+  Future<bool> loadBytes(Uint8List bytes) async =>
+      await _invoke('loadBytes', '从内存加载MIDI文件', {'bytes': bytes}) == true;
+
+  /// 从assets加载MIDI文件
+  Future<bool> loadAsset(String assetPath) async =>
+      await _invoke('loadAsset', '从assets加载MIDI文件',
+          {'assetPath': assetPath}) ==
+      true;
+
+  /// 把MIDI文件加入这个播放器的播放队列末尾
+  Future<void> enqueue(String filePath) =>
+      _invoke('enqueue', '加入播放队列', {'filePath': filePath});
+
+  /// 替换这个播放器的播放队列
+  Future<void> setQueue(List<String> filePaths) =>
+      _invoke('setQueue', '设置播放队列', {'filePaths': filePaths});
+
+  /// 立即切换到队列中的下一个文件
+  Future<bool> next() async => await _invoke('next', '切换到下一首') == true;
+
+  /// 开始播放
+  Future<void> play() => _invoke('play', '播放');
+
+  /// 暂停播放
+  Future<void> pause() => _invoke('pause', '暂停');
+
+  /// 停止播放
+  Future<void> stop() => _invoke('stop', '停止');
+
+  /// 跳转到指定位置
+  Future<void> seekTo(int positionMs) =>
+      _invoke('seekTo', '跳转', {'positionMs': positionMs});
+
+  /// 设置播放速度 (0.5 - 2.0)
+  Future<void> setSpeed(double speed) async {
+    if (speed < 0.5 || speed > 2.0) {
+      throw Exception('播放速度必须在0.5到2.0之间');
+    }
+    await _invoke('setSpeed', '设置播放速度', {'speed': speed});
+  }
+
+  /// 设置这个播放器的音量 (0.0 - 1.0)，不影响其他播放器
+  Future<void> setVolume(double volume) async {
+    if (volume < 0.0 || volume > 1.0) {
+      throw Exception('音量必须在0.0到1.0之间');
+    }
+    await _invoke('setVolume', '设置音量', {'volume': volume});
+  }
+
+  /// 获取当前播放信息
+  Future<MidiPlaybackInfo?> getCurrentInfo() async {
+    try {
+      final result = await _invoke('getCurrentInfo', '获取播放信息');
+      if (result is Map) {
+        final Map<String, dynamic> convertedMap = {};
+        result.forEach((key, value) {
+          convertedMap[key.toString()] = value;
+        });
+        return MidiPlaybackInfo.fromMap(convertedMap);
+      }
+      return null;
+    } catch (e) {
+      return null;
+    }
+  }
+
+  /// 播放进度变化流
+  Stream<MidiPlaybackInfo> get onProgressChanged =>
+      _owner._playerEvents(id).map(MidiPlaybackInfo.fromMap);
+
+  /// 播放状态变化流
+  Stream<MidiPlayerState> get onStateChanged => _owner
+      ._playerEvents(id)
+      .map((event) => PlayMidifile._parseState(event['state']))
+      .distinct();
+
+  /// 停止并释放这个播放器，之后不能再使用
+  Future<void> dispose() => _invoke('disposePlayer', '释放');
 }
@@ -1,3 +1,6 @@
+import 'dart:typed_data';
+
+import 'package:flutter/foundation.dart';
 import 'package:flutter_test/flutter_test.dart';
 import 'package:flutter/services.dart';
 import 'package:playmidifile/playmidifile.dart';
@@ -18,6 +21,8 @@ void main() {
           return true;
         case 'loadAsset':
           return true;
+        case 'loadBytes':
+          return methodCall.arguments['bytes'] is Uint8List;
         case 'play':
           return null;
         case 'pause':
@@ -38,6 +43,54 @@ void main() {
             'durationMs': 60000,
             'progress': 0.0,
           };
+        case 'renderToFile':
+          return {
+            'durationMs': 60000,
+            'renderTimeMs': 500,
+            'realtimeFactor': 120.0,
+          };
+        case 'renderToBuffer':
+          return Float32List.fromList([0.0, 0.0, 0.5, -0.5]);
+        case 'getCacheStats':
+          return {
+            'hits': 3,
+            'misses': 1,
+            'evictions': 0,
+            'entries': 1,
+            'bytes': 4096,
+            'budgetBytes': 67108864,
+          };
+        case 'setCacheBudget':
+          return null;
+        case 'getStats':
+          return {
+            'dispatchLatenessUs': {
+              'count': 120,
+              'mean': 85.5,
+              'p50': 63,
+              'p90': 255,
+              'p99': 511,
+              'max': 900,
+            },
+            'seekLatencyUs': {'count': 2, 'mean': 300.0, 'max': 400},
+            'underruns': 1,
+          };
+        case 'resetStats':
+          return null;
+        case 'setStreamingThreshold':
+          return null;
+        case 'setProgressInterval':
+          return null;
+        case 'createPlayer':
+          return 1;
+        case 'disposePlayer':
+          return null;
+        case 'enqueue':
+          return null;
+        case 'setQueue':
+          return null;
+        case 'next':
+          return true;
         case 'dispose':
           return null;
         default:
@@ -57,6 +110,31 @@ void main() {
       await expectLater(player.initialize(), completes);
     });
 
+    test('使用软件合成器初始化', () async {
+      MethodCall? call;
+      TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+          .setMockMethodCallHandler(channel, (MethodCall methodCall) async {
+        call = methodCall;
+        return null;
+      });
+      final player = PlayMidifile.instance;
+      await player.initialize(
+          soundFontPath: '/path/to/gm.sf2', periodFrames: 256, bufferCount: 2);
+      expect(call?.method, 'initialize');
+      expect(call?.arguments['soundFontPath'], '/path/to/gm.sf2');
+      expect(call?.arguments['sampleRate'], 48000);
+      expect(call?.arguments['periodFrames'], 256);
+      expect(call?.arguments['bufferCount'], 2);
+      expect(call?.arguments['leadInMs'], 300);
+
+      expect(
+          player.initialize(soundFontPath: '/path/to/gm.sf2', bufferCount: 1),
+          throwsException);
+      expect(
+          player.initialize(soundFontPath: '/path/to/gm.sf2', leadInMs: -1),
+          throwsException);
+    });
+
     test('加载MIDI文件 - Mock成功', () async {
       final player = PlayMidifile.instance;
       await player.initialize();
@@ -74,6 +152,15 @@ void main() {
       expect(result, true);
     });
 
+    test('从内存加载MIDI数据', () async {
+      final player = PlayMidifile.instance;
+      await player.initialize();
+
+      final result = await player.loadBytes(
+          Uint8List.fromList([0x4D, 0x54, 0x68, 0x64]));
+      expect(result, true);
+    });
+
     test('播放控制功能 - Mock环境', () async {
       final player = PlayMidifile.instance;
       await player.initialize();
@@ -140,6 +227,127 @@ void main() {
       expect(info.progress, 0.0);
     });
 
+    test('渲染到WAV文件', () async {
+      final player = PlayMidifile.instance;
+
+      final info = await player.renderToFile(
+        '/path/to/test.mid',
+        '/path/to/test.wav',
+        soundFontPath: '/path/to/font.sf2',
+        threads: 4,
+      );
+      expect(info.durationMs, 60000);
+      expect(info.renderTimeMs, 500);
+      expect(info.realtimeFactor, 120.0);
+
+      expect(
+        () => player.renderToFile('/a.mid', '/a.wav',
+            soundFontPath: '/font.sf2', threads: 0),
+        throwsException,
+      );
+    });
+
+    test('渲染到内存', () async {
+      final player = PlayMidifile.instance;
+
+      final audio = await player.renderToBuffer(
+        '/path/to/test.mid',
+        soundFontPath: '/path/to/font.sf2',
+      );
+      expect(audio.length, 4);
+      expect(audio[2], 0.5);
+    });
+
+    test('缓存统计与预算', () async {
+      final player = PlayMidifile.instance;
+
+      final stats = await player.getCacheStats();
+      expect(stats, isNotNull);
+      expect(stats!.hits, 3);
+      expect(stats.misses, 1);
+      expect(stats.budgetBytes, 67108864);
+
+      await expectLater(player.setCacheBudget(1 << 20), completes);
+      expect(() => player.setCacheBudget(-1), throwsException);
+    });
+
+    test('播放计时统计', () async {
+      final player = PlayMidifile.instance;
+
+      final stats = await player.getStats();
+      expect(stats, isNotNull);
+      expect(stats!.dispatchLatenessUs.count, 120);
+      expect(stats.dispatchLatenessUs.mean, 85.5);
+      expect(stats.dispatchLatenessUs.p99, 511);
+      expect(stats.seekLatencyUs.max, 400);
+      // 缺少的指标按空分布处理
+      expect(stats.audioCallbackUs.count, 0);
+      expect(stats.underruns, 1);
+
+      await expectLater(player.resetStats(), completes);
+    });
+
+    test('流式加载阈值', () async {
+      final player = PlayMidifile.instance;
+
+      await expectLater(player.setStreamingThreshold(1 << 20), completes);
+      await expectLater(player.setStreamingThreshold(0), completes);
+      expect(() => player.setStreamingThreshold(-1), throwsException);
+    });
+
+    test('播放队列', () async {
+      final calls = <MethodCall>[];
+      TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+          .setMockMethodCallHandler(channel, (MethodCall methodCall) async {
+        calls.add(methodCall);
+        return methodCall.method == 'next' ? true : null;
+      });
+
+      final player = PlayMidifile.instance;
+      await player.setQueue(['a.mid', 'b.mid']);
+      await player.enqueue('c.mid');
+      expect(await player.next(), true);
+
+      expect(calls.map((call) => call.method), ['setQueue', 'enqueue', 'next']);
+      expect(calls[0].arguments['filePaths'], ['a.mid', 'b.mid']);
+      expect(calls[1].arguments['filePath'], 'c.mid');
+    });
+
+    test('创建独立播放器', () async {
+      final calls = <MethodCall>[];
+      TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+          .setMockMethodCallHandler(channel, (MethodCall methodCall) async {
+        calls.add(methodCall);
+        switch (methodCall.method) {
+          case 'createPlayer':
+            return 1;
+          case 'loadFile':
+            return true;
+          default:
+            return null;
+        }
+      });
+
+      final player = await PlayMidifile.instance.createPlayer();
+      expect(player.id, 1);
+      expect(await player.loadFile('backing.mid'), true);
+      await player.setVolume(0.5);
+      await player.play();
+      await player.dispose();
+
+      expect(calls.map((call) => call.method), [
+        'createPlayer',
+        'loadFile',
+        'setVolume',
+        'play',
+        'disposePlayer',
+      ]);
+      for (final call in calls.skip(1)) {
+        expect(call.arguments['playerId'], 1);
+      }
+      expect(() => player.setVolume(1.5), throwsException);
+    });
+
     test('释放资源', () async {
       final player = PlayMidifile.instance;
       await player.initialize();
@@ -149,6 +357,79 @@ void main() {
     });
   });
 
+  group('进度事件', () {
+    const EventChannel eventChannel = EventChannel('playmidifile/events');
+
+    setUp(() {
+      debugDefaultTargetPlatformOverride = TargetPlatform.windows;
+      TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+          .setMockStreamHandler(
+        eventChannel,
+        MockStreamHandler.inline(onListen: (arguments, events) {
+          // 另一个播放器的事件不会出现在默认播放器的流中
+          events.success({
+            'playerId': 1,
+            'currentPositionMs': 15000,
+            'durationMs': 20000,
+            'progress': 0.75,
+            'state': 'paused',
+          });
+          events.success({
+            'currentPositionMs': 0,
+            'durationMs': 60000,
+            'progress': 0.0,
+            'state': 'playing',
+          });
+          events.success({
+            'currentPositionMs': 30000,
+            'durationMs': 60000,
+            'progress': 0.5,
+            'state': 'playing',
+          });
+          events.success({
+            'currentPositionMs': 0,
+            'durationMs': 60000,
+            'progress': 0.0,
+            'state': 'stopped',
+          });
+        }),
+      );
+    });
+
+    tearDown(() {
+      debugDefaultTargetPlatformOverride = null;
+      TestDefaultBinaryMessengerBinding.instance.defaultBinaryMessenger
+          .setMockStreamHandler(eventChannel, null);
+    });
+
+    test('推送播放进度', () async {
+      final updates =
+          await PlayMidifile.instance.onProgressChanged.take(3).toList();
+      expect(updates.length, 3);
+      expect(updates[1].currentPositionMs, 30000);
+      expect(updates[1].progress, 0.5);
+    });
+
+    test('推送状态变化并去重', () async {
+      final states =
+          await PlayMidifile.instance.onStateChanged.take(2).toList();
+      expect(states, [MidiPlayerState.playing, MidiPlayerState.stopped]);
+    });
+
+    test('按播放器区分事件', () async {
+      final player = await PlayMidifile.instance.createPlayer();
+      final info = await player.onProgressChanged.first;
+      expect(info.currentPositionMs, 15000);
+      expect(await player.onStateChanged.first, MidiPlayerState.paused);
+    });
+
+    test('设置推送间隔', () async {
+      final player = PlayMidifile.instance;
+      await expectLater(player.setProgressInterval(50), completes);
+      expect(() => player.setProgressInterval(0), throwsException);
+    });
+  });
+
   group('MidiPlaybackInfo Tests', () {
     test('从Map创建播放信息', () {
       final map = {
@@ -0,0 +1,42 @@
+// Compile time of a 32-track, 30-minute orchestral file with the tracks
+// decoded on 1, 2, 4 and 8 threads before the k-way merge.
+
+#include <benchmark/benchmark.h>
+
+#include <memory>
+
+#include "corpus.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/thread_pool.h"
+
+namespace playmidifile {
+namespace {
+
+const MidiFile& ManyTrackFile() {
+  static const std::unique_ptr<MidiFile> file = corpus::OpenBytes(
+      corpus::Orchestral(30, 32), "compile_benchmark.mid");
+  return *file;
+}
+
+void BM_CompileThreads(benchmark::State& state) {
+  const MidiFile& file = ManyTrackFile();
+  ThreadPool pool(static_cast<int>(state.range(0)));
+  size_t events = 0;
+  for (auto _ : state) {
+    std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+        file, Sequence::kDefaultCheckpointInterval, &pool);
+    events = sequence->event_count();
+    benchmark::DoNotOptimize(sequence);
+  }
+  state.SetItemsProcessed(state.iterations() * events);
+}
+BENCHMARK(BM_CompileThreads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace playmidifile
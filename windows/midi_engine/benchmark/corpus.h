@@ -0,0 +1,124 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_CORPUS_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_CORPUS_H_
+
+#include <cstdint>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "midi_engine/midi_file.h"
+#include "midi_engine/soundfont.h"
+#include "sf2_builder.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace corpus {
+
+// A dense orchestral arrangement: |tracks| parts (sharing the 16 channels
+// round-robin) at 120 BPM, each playing eighth notes with expression (CC11)
+// rides every sixteenth and the occasional pitch bend. About 8 events per
+// track per beat, so 30 minutes of 16 tracks is roughly 460k events. Seeded, so every run gets the
+// same bytes.
+inline std::vector<uint8_t> Orchestral(int minutes, int tracks = 16) {
+  constexpr uint16_t kDivision = 480;
+  constexpr uint32_t kSixteenth = kDivision / 4;
+  const int beats = minutes * 120;
+  std::mt19937 random(2024);
+  testing::SmfBuilder builder(1, kDivision);
+  builder.BeginTrack().Tempo(0, 500000).EndTrack();
+  for (int track = 0; track < tracks; ++track) {
+    const uint8_t channel = static_cast<uint8_t>(track % 16);
+    builder.BeginTrack();
+    builder.ControlChange(0, channel, 0, 0)
+        .ProgramChange(0, channel, static_cast<uint8_t>(channel * 3))
+        .ControlChange(0, channel, 7, 100);
+    for (int beat = 0; beat < beats; ++beat) {
+      for (int eighth = 0; eighth < 2; ++eighth) {
+        uint8_t note = static_cast<uint8_t>(36 + random() % 48);
+        builder.NoteOn(0, channel, note, static_cast<uint8_t>(64 + beat % 40))
+            .ControlChange(kSixteenth, channel, 11,
+                           static_cast<uint8_t>(random() % 128))
+            .NoteOff(0, channel, note)
+            .ControlChange(kSixteenth, channel, 11,
+                           static_cast<uint8_t>(random() % 128));
+      }
+      if (beat % 8 == 0) {
+        builder.PitchBend(0, channel,
+                          static_cast<uint16_t>(random() % 0x4000));
+      }
+    }
+    builder.EndTrack();
+  }
+  return builder.Build();
+}
+
+// A SoundFont with one looped sine cycle behind every GM program (bank 0)
+// and a drum kit (bank 128), with a short attack, a decay to -12 dB and a
+// 200 ms release: cheap to build, but voices behave like real instruments.
+inline std::shared_ptr<const SoundFont> SineFont() {
+  constexpr int kCycle = 100;
+  testing::Sf2Builder builder;
+  testing::Sf2Builder::Sample sample;
+  sample.sample_rate = 44100;
+  // 441 Hz at the root key, 69 (A4), close enough for timing work.
+  sample.root_key = 69;
+  for (int i = 0; i < kCycle; ++i) {
+    sample.data.push_back(static_cast<int16_t>(
+        16000 * std::sin(2 * 3.14159265358979 * i / kCycle)));
+  }
+  sample.loop_end = kCycle;
+  int id = builder.AddSample(sample);
+  namespace sf2 = testing::sf2;
+  const testing::Sf2Builder::Generators generators = {
+      {sf2::kAttackVolEnv, static_cast<uint16_t>(-7973)},   // ~10 ms.
+      {sf2::kDecayVolEnv, static_cast<uint16_t>(-1200)},    // 500 ms.
+      {sf2::kSustainVolEnv, 120},
+      {sf2::kReleaseVolEnv, static_cast<uint16_t>(-2786)},  // ~200 ms.
+      {sf2::kSampleModes, 1}};
+  for (uint16_t program = 0; program < 128; ++program) {
+    builder.SimplePreset(0, program, id, generators);
+  }
+  builder.SimplePreset(128, 0, id, generators);
+  std::vector<uint8_t> bytes = builder.Build();
+  std::string error;
+  return SoundFont::Parse(bytes.data(), bytes.size(), &error);
+}
+
+// A General MIDI-sized SoundFont: every program of bank 0 and a drum kit,
+// each with its own looped sample of |frames| frames (a sine at a
+// per-program pitch), so 128 programs of 256k frames make a 64 MB bank.
+inline std::vector<uint8_t> GmFont(size_t frames) {
+  testing::Sf2Builder builder;
+  for (uint16_t program = 0; program <= 128; ++program) {
+    testing::Sf2Builder::Sample sample;
+    sample.data.resize(frames);
+    double cycle = 50.0 + program;
+    for (size_t i = 0; i < frames; ++i) {
+      sample.data[i] = static_cast<int16_t>(
+          12000 * std::sin(2 * 3.14159265358979 * i / cycle));
+    }
+    sample.loop_end = static_cast<uint32_t>(frames);
+    int id = builder.AddSample(sample);
+    builder.SimplePreset(program < 128 ? 0 : 128, program % 128, id,
+                         {{testing::sf2::kSampleModes, 1}});
+  }
+  return builder.Build();
+}
+
+// Opens |bytes| through a temporary file, as the player would.
+inline std::unique_ptr<MidiFile> OpenBytes(const std::vector<uint8_t>& bytes,
+                                           const std::string& name) {
+  std::string path = testing::WriteTempFile(name, bytes);
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  std::remove(path.c_str());
+  return file;
+}
+
+}  // namespace corpus
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_CORPUS_H_
@@ -0,0 +1,100 @@
+// The sequencer's scheduling path. BM_DispatchCost is the CPU cost of
+// Dispatch() per event with a synthetic clock. BM_DispatchJitter plays a
+// note every millisecond against the real clock, sleeping until each
+// deadline as the engine thread does, and reports how late the events went
+// out (OS wake-up included).
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequencer.h"
+
+namespace playmidifile {
+namespace {
+
+using Clock = Sequencer::Clock;
+
+class NullOutput : public MidiOutput {
+ public:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override {
+    ++messages;
+  }
+  void SendSysEx(const uint8_t* data, size_t size) override { ++messages; }
+  void SetVolume(double volume) override {}
+
+  size_t messages = 0;
+};
+
+void BM_DispatchCost(benchmark::State& state) {
+  static const std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+      *corpus::OpenBytes(corpus::Orchestral(5), "dispatch_benchmark.mid"));
+  NullOutput output;
+  Sequencer sequencer(&output);
+  for (auto _ : state) {
+    sequencer.Load(sequence);
+    Clock::time_point now = Clock::time_point();
+    sequencer.Play(now);
+    // Jump straight to each deadline instead of waiting for it.
+    while (true) {
+      Clock::time_point next = sequencer.Dispatch(now);
+      if (next == Clock::time_point::max()) {
+        break;
+      }
+      now = next;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * sequence->event_count());
+}
+BENCHMARK(BM_DispatchCost)->Unit(benchmark::kMillisecond);
+
+void BM_DispatchJitter(benchmark::State& state) {
+  constexpr int kNotes = 500;
+  // With 500 ticks per quarter at the default 120 BPM one tick is 1 ms.
+  testing::SmfBuilder builder(0, 500);
+  builder.BeginTrack();
+  for (int i = 0; i < kNotes; ++i) {
+    builder.NoteOn(i == 0 ? 0 : 1, 0, 60, 100);
+  }
+  std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+      *corpus::OpenBytes(builder.EndTrack().Build(), "jitter_benchmark.mid"));
+  NullOutput output;
+  Sequencer sequencer(&output);
+  std::vector<double> lateness_us;
+  lateness_us.reserve(kNotes * 4);
+  for (auto _ : state) {
+    sequencer.Load(sequence);
+    sequencer.Play(Clock::now());
+    Clock::time_point deadline = sequencer.Dispatch(Clock::now());
+    while (deadline != Clock::time_point::max()) {
+      std::this_thread::sleep_until(deadline);
+      Clock::time_point now = Clock::now();
+      lateness_us.push_back(
+          std::chrono::duration<double, std::micro>(now - deadline).count());
+      deadline = sequencer.Dispatch(now);
+    }
+  }
+  std::sort(lateness_us.begin(), lateness_us.end());
+  if (!lateness_us.empty()) {
+    state.counters["late_p50_us"] = lateness_us[lateness_us.size() / 2];
+    state.counters["late_p99_us"] = lateness_us[lateness_us.size() * 99 / 100];
+    state.counters["late_max_us"] = lateness_us.back();
+  }
+}
+BENCHMARK(BM_DispatchJitter)
+    ->Iterations(2)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,86 @@
+// The compiled event store (two parallel 4-byte arrays plus a sysex side
+// table) versus a naive vector of per-event structs that own their
+// payloads, on a 30-minute orchestral file: bytes per event, and the
+// throughput of the in-order scan the scheduler does.
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+namespace {
+
+// What a straightforward port would store per event.
+struct NaiveEvent {
+  uint32_t tick;
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+  std::vector<uint8_t> payload;
+};
+
+// Without checkpoints, so the memory is the event storage alone.
+std::shared_ptr<const Sequence> OrchestralSequence() {
+  static const std::shared_ptr<const Sequence> sequence = [] {
+    std::unique_ptr<MidiFile> file = corpus::OpenBytes(
+        corpus::Orchestral(30), "event_store_benchmark.mid");
+    return Sequence::Compile(*file, 0);
+  }();
+  return sequence;
+}
+
+void BM_EventStorePacked(benchmark::State& state) {
+  std::shared_ptr<const Sequence> sequence = OrchestralSequence();
+  const size_t count = sequence->event_count();
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < count; ++i) {
+      SequenceEvent event = sequence->event(i);
+      sum += event.tick + event.data1;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["bytes_per_event"] =
+      static_cast<double>(sequence->memory_bytes() -
+                          sequence->tempo_map().memory_bytes()) /
+      count;
+}
+BENCHMARK(BM_EventStorePacked)->Unit(benchmark::kMillisecond);
+
+void BM_EventStoreNaive(benchmark::State& state) {
+  std::shared_ptr<const Sequence> sequence = OrchestralSequence();
+  const size_t count = sequence->event_count();
+  std::vector<NaiveEvent> events;
+  size_t payload_bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    SequenceEvent event = sequence->event(i);
+    const uint8_t* payload = sequence->payload(event);
+    events.push_back(NaiveEvent{
+        event.tick, event.status, event.data1, event.data2,
+        std::vector<uint8_t>(payload, payload + event.payload_size)});
+    payload_bytes += events.back().payload.capacity();
+  }
+  for (auto _ : state) {
+    uint64_t sum = 0;
+    for (const NaiveEvent& event : events) {
+      sum += event.tick + event.data1;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["bytes_per_event"] =
+      static_cast<double>(events.capacity() * sizeof(NaiveEvent) +
+                          payload_bytes) /
+      count;
+}
+BENCHMARK(BM_EventStoreNaive)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
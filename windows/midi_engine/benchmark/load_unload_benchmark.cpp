@@ -0,0 +1,53 @@
+// Load/unload churn, as in a long practice session that keeps reopening
+// pieces: parse and compile an orchestral file from memory, then drop it.
+// Reports heap allocations per cycle, split into the load and the unload,
+// and how many heap blocks the compiled sequence holds (its arena chunks).
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "corpus.h"
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+namespace {
+
+// range(0) is the length in minutes, range(1) the number of tracks.
+void BM_LoadUnload(benchmark::State& state) {
+  const std::vector<uint8_t> bytes = corpus::Orchestral(
+      static_cast<int>(state.range(0)), static_cast<int>(state.range(1)));
+  uint64_t load_allocations = 0;
+  uint64_t unload_frees = 0;
+  size_t heap_blocks = 0;
+  std::string error;
+  for (auto _ : state) {
+    testing::AllocationScope load;
+    std::unique_ptr<MidiFile> file =
+        MidiFile::Parse(bytes.data(), bytes.size(), &error);
+    std::shared_ptr<const Sequence> sequence = Sequence::Compile(*file);
+    file.reset();
+    load_allocations += load.counts().allocations;
+    heap_blocks = sequence->heap_blocks();
+
+    testing::AllocationScope unload;
+    sequence.reset();
+    unload_frees += unload.counts().frees;
+  }
+  const double cycles = static_cast<double>(state.iterations());
+  state.counters["load_allocs"] = load_allocations / cycles;
+  state.counters["unload_frees"] = unload_frees / cycles;
+  state.counters["heap_blocks"] = static_cast<double>(heap_blocks);
+}
+BENCHMARK(BM_LoadUnload)
+    ->Args({1, 16})
+    ->Args({10, 16})
+    ->Args({10, 32})
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
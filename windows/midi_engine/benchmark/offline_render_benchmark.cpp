@@ -0,0 +1,56 @@
+// Offline rendering speed of a 2-minute, 16-channel orchestral file through
+// the synthesizer, with channel groups spread over 1, 2 and 4 threads. The
+// x_realtime counter is audio duration divided by wall time.
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/offline_renderer.h"
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+namespace {
+
+std::shared_ptr<const Sequence> OrchestralSequence() {
+  static const std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+      *corpus::OpenBytes(corpus::Orchestral(2), "render_benchmark.mid"));
+  return sequence;
+}
+
+// range(0) is the number of render threads.
+void BM_RenderToBuffer(benchmark::State& state) {
+  std::shared_ptr<const Sequence> sequence = OrchestralSequence();
+  std::shared_ptr<const SoundFont> font = corpus::SineFont();
+  RenderOptions options;
+  options.threads = static_cast<int>(state.range(0));
+  std::vector<float> audio;
+  std::string error;
+  double audio_seconds = 0.0;
+  double wall_seconds = 0.0;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    RenderToBuffer(sequence, font, options, &audio, &error);
+    wall_seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+    audio_seconds +=
+        static_cast<double>(audio.size() / 2) / options.sample_rate;
+  }
+  state.counters["x_realtime"] = audio_seconds / wall_seconds;
+  state.counters["events"] =
+      static_cast<double>(sequence->event_count());
+}
+BENCHMARK(BM_RenderToBuffer)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,117 @@
+// CPU cost of many concurrent players: N players on one engine, sharing one
+// engine thread and one output through PlayerOutputs, versus N engines with
+// a thread each. Every player plays the dense orchestral corpus (16
+// channels, ~130 events per second). The benchmark thread only sleeps, so
+// process CPU time is the engine threads' time.
+
+#include <benchmark/benchmark.h>
+
+#include <time.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/playback_engine.h"
+#include "midi_engine/player_output.h"
+#include "midi_engine/sequence_cache.h"
+#include "midi_engine/sequencer_backend.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr std::chrono::seconds kPlayback(2);
+
+class NullOutput : public MidiOutput {
+ public:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override {}
+  void SendSysEx(const uint8_t* data, size_t size) override {}
+};
+
+double ProcessCpuSeconds() {
+  timespec now;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void ReportCpu(benchmark::State& state, double cpu_seconds, int players) {
+  double played = static_cast<double>(state.iterations()) *
+                  std::chrono::duration<double>(kPlayback).count();
+  state.counters["cpu_us_per_s"] = cpu_seconds * 1e6 / played;
+  state.counters["cpu_us_per_s_per_player"] =
+      cpu_seconds * 1e6 / played / players;
+}
+
+// range(0) players on one engine.
+void BM_PlayersSharedEngine(benchmark::State& state) {
+  const int players = static_cast<int>(state.range(0));
+  const std::vector<uint8_t> bytes = corpus::Orchestral(1);
+  NullOutput device;
+  PlaybackEngine engine([&device] {
+    return std::make_unique<SequencerBackend>(
+        std::make_unique<PlayerOutput>(&device));
+  });
+  std::vector<int> handles = {PlaybackEngine::kDefaultPlayer};
+  while (static_cast<int>(handles.size()) < players) {
+    handles.push_back(engine.CreatePlayer(nullptr));
+  }
+  for (int handle : handles) {
+    engine.LoadBytes(bytes, nullptr, handle);
+    engine.Play(nullptr, handle);
+  }
+
+  double cpu_seconds = 0.0;
+  for (auto _ : state) {
+    double cpu_start = ProcessCpuSeconds();
+    std::this_thread::sleep_for(kPlayback);
+    cpu_seconds += ProcessCpuSeconds() - cpu_start;
+  }
+  ReportCpu(state, cpu_seconds, players);
+}
+BENCHMARK(BM_PlayersSharedEngine)
+    ->Arg(1)
+    ->Arg(8)
+    ->Arg(32)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+// range(0) engines with one player each. They all write to |device| from
+// their own threads, which only a do-nothing output tolerates.
+void BM_PlayersEnginePerPlayer(benchmark::State& state) {
+  const int players = static_cast<int>(state.range(0));
+  const std::vector<uint8_t> bytes = corpus::Orchestral(1);
+  NullOutput device;
+  auto cache = std::make_shared<SequenceCache>();
+  std::vector<std::unique_ptr<PlaybackEngine>> engines;
+  for (int i = 0; i < players; ++i) {
+    engines.push_back(std::make_unique<PlaybackEngine>(
+        std::make_unique<SequencerBackend>(
+            std::make_unique<PlayerOutput>(&device)),
+        cache));
+    engines.back()->LoadBytes(bytes, nullptr);
+    engines.back()->Play(nullptr);
+  }
+
+  double cpu_seconds = 0.0;
+  for (auto _ : state) {
+    double cpu_start = ProcessCpuSeconds();
+    std::this_thread::sleep_for(kPlayback);
+    cpu_seconds += ProcessCpuSeconds() - cpu_start;
+  }
+  ReportCpu(state, cpu_seconds, players);
+}
+BENCHMARK(BM_PlayersEnginePerPlayer)
+    ->Arg(1)
+    ->Arg(8)
+    ->Arg(32)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,75 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_PROCESS_MEMORY_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_PROCESS_MEMORY_H_
+
+// Resident memory measurements for the benchmarks that report them. Linux
+// only.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+namespace playmidifile {
+namespace corpus {
+
+// A field of /proc/self/status in kB, e.g. "VmRSS" or "VmHWM".
+inline long StatusKb(const char* field) {
+  std::FILE* status = std::fopen("/proc/self/status", "r");
+  if (!status) {
+    return -1;
+  }
+  char line[256];
+  long value = -1;
+  size_t length = std::strlen(field);
+  while (std::fgets(line, sizeof(line), status)) {
+    if (std::strncmp(line, field, length) == 0 && line[length] == ':') {
+      value = std::strtol(line + length + 1, nullptr, 10);
+      break;
+    }
+  }
+  std::fclose(status);
+  return value;
+}
+
+// Runs |work| in a child process and returns how far its resident set
+// rose above where it started, in kB; -1 on failure. With |peak| the
+// growth is to the high-water mark, otherwise to the resident set when
+// |work| returns.
+inline long RssGrowthKb(const std::function<void()>& work, bool peak = true) {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return -1;
+  }
+  pid_t child = fork();
+  if (child == 0) {
+    close(fds[0]);
+    // Resets VmHWM to the current resident set.
+    if (std::FILE* clear = std::fopen("/proc/self/clear_refs", "w")) {
+      std::fputs("5", clear);
+      std::fclose(clear);
+    }
+    long before = StatusKb("VmRSS");
+    work();
+    long growth = StatusKb(peak ? "VmHWM" : "VmRSS") - before;
+    ssize_t written = write(fds[1], &growth, sizeof(growth));
+    _exit(written == sizeof(growth) ? 0 : 1);
+  }
+  close(fds[1]);
+  long growth = -1;
+  if (child < 0 || read(fds[0], &growth, sizeof(growth)) != sizeof(growth)) {
+    growth = -1;
+  }
+  close(fds[0]);
+  if (child > 0) {
+    waitpid(child, nullptr, 0);
+  }
+  return growth;
+}
+
+}  // namespace corpus
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_BENCHMARK_PROCESS_MEMORY_H_
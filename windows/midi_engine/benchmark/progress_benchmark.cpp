@@ -0,0 +1,168 @@
+// CPU time the UI ("platform") thread spends per second of playback to keep
+// a progress display current: polling GetInfo() on a timer versus receiving
+// coalesced pushes from the engine. The benchmark thread plays the platform
+// thread; replies and pushes reach it through a mutex-guarded mailbox, as
+// window messages do in the plugin.
+
+#include <benchmark/benchmark.h>
+
+#include <time.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "corpus.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/playback_engine.h"
+#include "midi_engine/sequencer_backend.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr std::chrono::seconds kPlayback(2);
+
+class NullOutput : public MidiOutput {
+ public:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override {}
+  void SendSysEx(const uint8_t* data, size_t size) override {}
+};
+
+double ThreadCpuSeconds() {
+  timespec now;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+  return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+// Latest PlaybackInfo plus a "message posted" flag, like the plugin's
+// event mailbox.
+struct Mailbox {
+  std::mutex mutex;
+  std::condition_variable posted;
+  PlaybackInfo info;
+  bool pending = false;
+
+  // Returns false if a message was already pending (the update coalesced).
+  bool Put(const PlaybackInfo& update) {
+    std::lock_guard<std::mutex> lock(mutex);
+    info = update;
+    bool was_pending = pending;
+    pending = true;
+    posted.notify_one();
+    return !was_pending;
+  }
+
+  bool Take(std::chrono::steady_clock::time_point deadline,
+            PlaybackInfo* update) {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (!posted.wait_until(lock, deadline, [this] { return pending; })) {
+      return false;
+    }
+    pending = false;
+    *update = info;
+    return true;
+  }
+};
+
+void RunWithEngine(benchmark::State& state, bool push) {
+  const auto interval =
+      std::chrono::milliseconds(static_cast<int>(state.range(0)));
+  NullOutput output;
+  PlaybackEngine engine(std::make_unique<SequencerBackend>(&output));
+  Mailbox mailbox;
+  engine.LoadBytes(corpus::Orchestral(30), nullptr);
+  if (push) {
+    engine.SetProgressListener(
+        [&mailbox](int player, const PlaybackInfo& info) {
+          mailbox.Put(info);
+        },
+        static_cast<uint32_t>(interval.count()), nullptr);
+  }
+  engine.Play(nullptr);
+
+  double cpu_seconds = 0.0;
+  uint64_t updates = 0;
+  uint32_t shown_position = 0;
+  for (auto _ : state) {
+    double cpu_start = ThreadCpuSeconds();
+    auto end = std::chrono::steady_clock::now() + kPlayback;
+    auto next_poll = std::chrono::steady_clock::now();
+    PlaybackInfo info;
+    while (std::chrono::steady_clock::now() < end) {
+      if (push) {
+        if (mailbox.Take(end, &info)) {
+          shown_position = info.position_ms;
+          ++updates;
+        }
+        continue;
+      }
+      std::this_thread::sleep_until(next_poll);
+      next_poll += interval;
+      engine.GetInfo([&mailbox](const CommandResult& result) {
+        mailbox.Put(result.info);
+      });
+      if (mailbox.Take(end, &info)) {
+        shown_position = info.position_ms;
+        ++updates;
+      }
+    }
+    cpu_seconds += ThreadCpuSeconds() - cpu_start;
+  }
+  double played = static_cast<double>(state.iterations()) *
+                  std::chrono::duration<double>(kPlayback).count();
+  state.counters["platform_cpu_us_per_s"] = cpu_seconds * 1e6 / played;
+  state.counters["updates_per_s"] = updates / played;
+  benchmark::DoNotOptimize(shown_position);
+}
+
+// Reading the info once: the seqlock snapshot versus a GetInfo() command
+// answered by the engine thread.
+void BM_InfoSnapshot(benchmark::State& state) {
+  NullOutput output;
+  PlaybackEngine engine(std::make_unique<SequencerBackend>(&output));
+  engine.LoadBytes(corpus::Orchestral(1), nullptr);
+  engine.Play(nullptr);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(engine.Snapshot());
+  }
+}
+BENCHMARK(BM_InfoSnapshot);
+
+void BM_InfoRoundTrip(benchmark::State& state) {
+  NullOutput output;
+  PlaybackEngine engine(std::make_unique<SequencerBackend>(&output));
+  engine.LoadBytes(corpus::Orchestral(1), nullptr);
+  engine.Play(nullptr);
+  Mailbox mailbox;
+  PlaybackInfo info;
+  for (auto _ : state) {
+    engine.GetInfo([&mailbox](const CommandResult& result) {
+      mailbox.Put(result.info);
+    });
+    mailbox.Take(std::chrono::steady_clock::time_point::max(), &info);
+  }
+  benchmark::DoNotOptimize(info);
+}
+BENCHMARK(BM_InfoRoundTrip);
+
+// range(0) is the update interval in ms.
+void BM_ProgressPolled(benchmark::State& state) { RunWithEngine(state, false); }
+void BM_ProgressPushed(benchmark::State& state) { RunWithEngine(state, true); }
+BENCHMARK(BM_ProgressPolled)
+    ->Arg(16)
+    ->Arg(200)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ProgressPushed)
+    ->Arg(16)
+    ->Arg(200)
+    ->Iterations(1)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,94 @@
+// Seek latency on a 30-minute orchestral file: restoring channel state from
+// the start of the file on every seek versus from the nearest checkpoint.
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequencer.h"
+
+namespace playmidifile {
+namespace {
+
+// Counts messages instead of sending them, so the benchmark measures the
+// engine rather than a device.
+class CountingOutput : public MidiOutput {
+ public:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override {
+    ++messages_;
+  }
+  void SendSysEx(const uint8_t* data, size_t size) override { ++messages_; }
+
+  size_t messages() const { return messages_; }
+
+ private:
+  size_t messages_ = 0;
+};
+
+const MidiFile& OrchestralFile() {
+  static const std::unique_ptr<MidiFile> file =
+      corpus::OpenBytes(corpus::Orchestral(30), "seek_benchmark.mid");
+  return *file;
+}
+
+// range(0) is the checkpoint interval in events; 0 replays from the start.
+void BM_SeekRandom(benchmark::State& state) {
+  std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+      OrchestralFile(), static_cast<size_t>(state.range(0)));
+  CountingOutput output;
+  Sequencer sequencer(&output);
+  sequencer.Load(sequence);
+  std::mt19937_64 random(99);
+  Sequencer::Clock::time_point now = Sequencer::Clock::now();
+  for (auto _ : state) {
+    sequencer.Seek(random() % sequence->duration_us(), now);
+  }
+  state.counters["events"] =
+      static_cast<double>(sequence->event_count());
+  state.counters["checkpoint_bytes"] = static_cast<double>(
+      sequence->checkpoint_count() * sizeof(ChannelStateSet));
+  benchmark::DoNotOptimize(output.messages());
+}
+BENCHMARK(BM_SeekRandom)
+    ->Arg(0)
+    ->Arg(256)
+    ->Arg(1024)
+    ->Arg(4096)
+    ->Unit(benchmark::kMicrosecond);
+
+// Worst case without checkpoints: the very end of the file.
+void BM_SeekToEnd(benchmark::State& state) {
+  std::shared_ptr<const Sequence> sequence = Sequence::Compile(
+      OrchestralFile(), static_cast<size_t>(state.range(0)));
+  CountingOutput output;
+  Sequencer sequencer(&output);
+  sequencer.Load(sequence);
+  Sequencer::Clock::time_point now = Sequencer::Clock::now();
+  for (auto _ : state) {
+    sequencer.Seek(sequence->duration_us() - 1, now);
+  }
+}
+BENCHMARK(BM_SeekToEnd)->Arg(0)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+// What the checkpoints add to load time.
+void BM_CompileOrchestral(benchmark::State& state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Sequence::Compile(
+        OrchestralFile(), static_cast<size_t>(state.range(0))));
+  }
+}
+BENCHMARK(BM_CompileOrchestral)
+    ->Arg(0)
+    ->Arg(1024)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,36 @@
+// Repeated loads of the same 30-minute orchestral file: parsing and
+// compiling every time (budget 0) versus hitting the sequence cache.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "corpus.h"
+#include "midi_engine/sequence_cache.h"
+
+namespace playmidifile {
+namespace {
+
+const std::string& OrchestralPath() {
+  static const std::string path = testing::WriteTempFile(
+      "sequence_cache_benchmark.mid", corpus::Orchestral(30));
+  return path;
+}
+
+// range(0) is the cache budget in MiB.
+void BM_RepeatLoad(benchmark::State& state) {
+  SequenceCache cache(static_cast<size_t>(state.range(0)) << 20);
+  std::string error;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(cache.Load(OrchestralPath(), &error));
+  }
+  SequenceCacheStats stats = cache.stats();
+  state.counters["hits"] = static_cast<double>(stats.hits);
+  state.counters["cached_bytes"] = static_cast<double>(stats.bytes);
+}
+BENCHMARK(BM_RepeatLoad)->Arg(0)->Arg(64)->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,44 @@
+// Raw SMF parsing speed: locating the track chunks of a 30-minute
+// orchestral file held in memory and decoding every event, without
+// building a sequence.
+
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/smf_parser.h"
+
+namespace playmidifile {
+namespace {
+
+void BM_ParseAndDecode(benchmark::State& state) {
+  static const std::vector<uint8_t> bytes = corpus::Orchestral(30);
+  size_t events = 0;
+  for (auto _ : state) {
+    SmfFile file;
+    std::string error;
+    if (!ParseSmf(bytes.data(), bytes.size(), &file, &error)) {
+      state.SkipWithError(error.c_str());
+      return;
+    }
+    events = 0;
+    for (const SmfTrack& track : file.tracks) {
+      TrackReader reader(track);
+      MidiEvent event;
+      while (reader.Next(&event)) {
+        ++events;
+      }
+    }
+    benchmark::DoNotOptimize(events);
+  }
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+  state.SetItemsProcessed(state.iterations() * events);
+}
+BENCHMARK(BM_ParseAndDecode)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
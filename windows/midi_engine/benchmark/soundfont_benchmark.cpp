@@ -0,0 +1,88 @@
+// Opening a General MIDI-sized (64 MB) SoundFont, as the player's startup
+// does before the first render: range(0) 0 reads and copies every sample
+// up front, the way banks were loaded before they were mapped; 1 maps the
+// file and reads only the preset tables (SoundFont::Open()).
+//
+// open_rss_kb is the resident memory the open bank holds; first_program_kb
+// adds playing one note, which pages in that program's samples only. Both
+// are measured in a forked child (see process_memory.h). The file is in
+// the page cache throughout, so times exclude disk reads, which only the
+// copying open would pay for in full. Linux only.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/mapped_file.h"
+#include "midi_engine/soundfont.h"
+#include "midi_engine/synthesizer.h"
+#include "process_memory.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr size_t kFramesPerProgram = 256 * 1024;
+
+std::unique_ptr<SoundFont> OpenFont(const std::string& path, bool mapped) {
+  std::string error;
+  if (mapped) {
+    return SoundFont::Open(path, &error);
+  }
+  MappedFile file;
+  if (!file.Open(path, &error)) {
+    return nullptr;
+  }
+  return SoundFont::Parse(file.data(), file.size(), &error);
+}
+
+void BM_OpenSoundFont(benchmark::State& state) {
+  const bool mapped = state.range(0) != 0;
+  const std::string path = testing::WriteTempFile(
+      "soundfont_benchmark.sf2", corpus::GmFont(kFramesPerProgram));
+  for (auto _ : state) {
+    std::unique_ptr<SoundFont> font = OpenFont(path, mapped);
+    if (!font) {
+      state.SkipWithError("Failed to open the SoundFont");
+      break;
+    }
+    benchmark::DoNotOptimize(font->presets().data());
+  }
+  state.SetLabel(mapped ? "mapped" : "copied");
+  state.counters["open_rss_kb"] =
+      static_cast<double>(corpus::RssGrowthKb(
+          [&path, mapped] {
+            // Leaked so it is still open when measured; the child exits
+            // right after.
+            benchmark::DoNotOptimize(OpenFont(path, mapped).release());
+          },
+          false));
+  state.counters["first_program_kb"] =
+      static_cast<double>(corpus::RssGrowthKb(
+          [&path, mapped] {
+            std::shared_ptr<const SoundFont> font = OpenFont(path, mapped);
+            // As the mixer does before the program plays.
+            font->PrepareSamples(*font->FindPreset(0, 40));
+            Synthesizer synth(font, 48000);
+            synth.SendChannelMessage(0xC0, 40, 0);
+            synth.SendChannelMessage(0x90, 60, 100);
+            std::vector<float> block(256 * 2);
+            synth.Render(block.data(), 256);
+            // Leaked, as above.
+            benchmark::DoNotOptimize(new std::shared_ptr<const SoundFont>(font));
+          },
+          false));
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_OpenSoundFont)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,104 @@
+// Streaming a file from disk (SequenceStream) versus compiling it first
+// (MidiFile + Sequence), against file length: the time until the first
+// note can be dispatched, and the peak resident memory of opening the file
+// and walking every event. Memory is measured in a forked child, from its
+// resident set before the work to its high-water mark after, so each
+// measurement starts clean. Linux only.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/midi_file.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequence_stream.h"
+#include "process_memory.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+// Writes the orchestral corpus of |minutes| once per process.
+std::string CorpusPath(int minutes) {
+  std::string path = testing::WriteTempFile(
+      "streaming_benchmark_" + std::to_string(minutes) + ".mid",
+      corpus::Orchestral(minutes));
+  return path;
+}
+
+// Plays nothing, but touches every event the way the sequencer would.
+void WalkEvents(EventCursor* events) {
+  uint64_t micros = 0;
+  while (const SequenceEvent* event = events->Peek(&micros)) {
+    benchmark::DoNotOptimize(event->status);
+    events->Advance();
+  }
+}
+
+void ReportFile(benchmark::State& state, const std::string& path,
+                const std::function<void()>& walk) {
+  std::FILE* file = std::fopen(path.c_str(), "rb");
+  std::fseek(file, 0, SEEK_END);
+  state.counters["file_kb"] = static_cast<double>(std::ftell(file)) / 1024;
+  std::fclose(file);
+  state.counters["peak_rss_kb"] =
+      static_cast<double>(corpus::RssGrowthKb(walk));
+}
+
+// range(0) minutes of music, compiled before the first note.
+void BM_FirstNoteCompiled(benchmark::State& state) {
+  const std::string path = CorpusPath(static_cast<int>(state.range(0)));
+  std::string error;
+  for (auto _ : state) {
+    std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+    SequenceCursor events(Sequence::Compile(*file));
+    uint64_t micros = 0;
+    benchmark::DoNotOptimize(events.Peek(&micros));
+  }
+  ReportFile(state, path, [&path, &error] {
+    std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+    SequenceCursor events(Sequence::Compile(*file));
+    WalkEvents(&events);
+  });
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_FirstNoteCompiled)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(60)
+    ->Arg(240)
+    ->Unit(benchmark::kMillisecond);
+
+// range(0) minutes of music, streamed.
+void BM_FirstNoteStreamed(benchmark::State& state) {
+  const std::string path = CorpusPath(static_cast<int>(state.range(0)));
+  std::string error;
+  for (auto _ : state) {
+    std::unique_ptr<SequenceStream> stream =
+        SequenceStream::Open(path, &error);
+    uint64_t micros = 0;
+    benchmark::DoNotOptimize(stream->Peek(&micros));
+  }
+  ReportFile(state, path, [&path, &error] {
+    std::unique_ptr<SequenceStream> stream =
+        SequenceStream::Open(path, &error);
+    WalkEvents(stream.get());
+  });
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_FirstNoteStreamed)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(60)
+    ->Arg(240)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,115 @@
+// The synthesizer's per-voice block kernels in isolation, for each
+// SimdLevel |range(0)| (0 scalar, 1 SSE2, 2 AVX2), on 128-frame blocks as
+// Render() calls them. voices_per_core is how many voices at 48 kHz that
+// kernel alone could keep up with on one core; BM_SynthVoices measures the
+// whole render path.
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <random>
+#include <vector>
+
+#include "midi_engine/synth_kernels.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr size_t kBlock = 128;
+constexpr double kSampleRate = 48000;
+
+struct Inputs {
+  Inputs() : s0(kBlock), s1(kBlock), fraction(kBlock), envelope(kBlock),
+             mono(kBlock), stereo(kBlock * 2) {
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> sample(-32768, 32767);
+    std::uniform_real_distribution<float> unit(0, 1);
+    for (size_t i = 0; i < kBlock; ++i) {
+      s0[i] = sample(random);
+      s1[i] = sample(random);
+      fraction[i] = unit(random);
+      envelope[i] = unit(random);
+      mono[i] = unit(random);
+    }
+  }
+
+  std::vector<float> s0;
+  std::vector<float> s1;
+  std::vector<float> fraction;
+  std::vector<float> envelope;
+  std::vector<float> mono;
+  std::vector<float> stereo;
+};
+
+// Returns the kernels for the benchmark's level, or null (and skips) when
+// this CPU lacks them.
+const SynthKernels* KernelsFor(benchmark::State& state) {
+  SimdLevel level = static_cast<SimdLevel>(state.range(0));
+  if (!IsSimdLevelSupported(level)) {
+    state.SkipWithError("Instruction set not supported by this CPU");
+    return nullptr;
+  }
+  state.SetLabel(GetSynthKernels(level).name);
+  return &GetSynthKernels(level);
+}
+
+void SetCounters(benchmark::State& state) {
+  double frames = static_cast<double>(state.iterations()) * kBlock;
+  state.SetItemsProcessed(static_cast<int64_t>(frames));
+  state.counters["voices_per_core"] =
+      benchmark::Counter(frames / kSampleRate, benchmark::Counter::kIsRate);
+}
+
+void BM_Interpolate(benchmark::State& state) {
+  const SynthKernels* kernels = KernelsFor(state);
+  if (!kernels) {
+    return;
+  }
+  Inputs in;
+  for (auto _ : state) {
+    kernels->interpolate(in.s0.data(), in.s1.data(), in.fraction.data(),
+                         1.0f / 32768.0f, in.mono.data(), kBlock);
+    benchmark::DoNotOptimize(in.mono.data());
+    benchmark::ClobberMemory();
+  }
+  SetCounters(state);
+}
+BENCHMARK(BM_Interpolate)->DenseRange(0, 2);
+
+void BM_ApplyEnvelope(benchmark::State& state) {
+  const SynthKernels* kernels = KernelsFor(state);
+  if (!kernels) {
+    return;
+  }
+  Inputs in;
+  // At unity the samples stay put from one iteration to the next instead
+  // of decaying into denormals, which would time the FPU's slow path.
+  std::fill(in.envelope.begin(), in.envelope.end(), 1.0f);
+  for (auto _ : state) {
+    kernels->apply_envelope(in.mono.data(), in.envelope.data(), kBlock);
+    benchmark::DoNotOptimize(in.mono.data());
+    benchmark::ClobberMemory();
+  }
+  SetCounters(state);
+}
+BENCHMARK(BM_ApplyEnvelope)->DenseRange(0, 2);
+
+void BM_MixStereo(benchmark::State& state) {
+  const SynthKernels* kernels = KernelsFor(state);
+  if (!kernels) {
+    return;
+  }
+  Inputs in;
+  for (auto _ : state) {
+    kernels->mix_stereo(in.mono.data(), 0.5f, 0.5f, in.stereo.data(),
+                        kBlock);
+    benchmark::DoNotOptimize(in.stereo.data());
+    benchmark::ClobberMemory();
+  }
+  SetCounters(state);
+}
+BENCHMARK(BM_MixStereo)->DenseRange(0, 2);
+
+}  // namespace
+}  // namespace playmidifile
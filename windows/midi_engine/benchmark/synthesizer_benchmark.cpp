@@ -0,0 +1,60 @@
+// Synthesizer throughput: |range(1)| held notes rendered at 48 kHz in
+// 256-frame blocks with the kernels for SimdLevel |range(0)| (0 scalar,
+// 1 SSE2, 2 AVX2). voices_realtime is how many such voices one core keeps
+// up with in real time (voices x audio seconds / wall seconds).
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/synth_kernels.h"
+#include "midi_engine/synthesizer.h"
+
+namespace playmidifile {
+namespace {
+
+void BM_SynthVoices(benchmark::State& state) {
+  constexpr uint32_t kSampleRate = 48000;
+  constexpr size_t kBlock = 256;
+  const SimdLevel level = static_cast<SimdLevel>(state.range(0));
+  const int voices = static_cast<int>(state.range(1));
+  if (!IsSimdLevelSupported(level)) {
+    state.SkipWithError("Instruction set not supported by this CPU");
+    return;
+  }
+  Synthesizer synth(corpus::SineFont(), kSampleRate, voices);
+  synth.SetSimdLevel(level);
+  for (int i = 0; i < voices; ++i) {
+    synth.SendChannelMessage(static_cast<uint8_t>(0x90 | (i % 9)),
+                             static_cast<uint8_t>(30 + i % 64), 100);
+  }
+  std::vector<float> block(kBlock * 2);
+  size_t frames = 0;
+  double wall_seconds = 0.0;
+  for (auto _ : state) {
+    auto start = std::chrono::steady_clock::now();
+    // 100 ms of audio per iteration.
+    for (size_t i = 0; i < kSampleRate / 10 / kBlock; ++i) {
+      synth.Render(block.data(), kBlock);
+      frames += kBlock;
+    }
+    wall_seconds += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start)
+                        .count();
+  }
+  state.SetLabel(GetSynthKernels(level).name);
+  state.counters["active_voices"] = synth.active_voices();
+  state.counters["voices_realtime"] =
+      synth.active_voices() * (static_cast<double>(frames) / kSampleRate) /
+      wall_seconds;
+}
+BENCHMARK(BM_SynthVoices)
+    ->ArgsProduct({{0, 1, 2}, {16, 64, 256}})
+    ->Unit(benchmark::kMicrosecond);
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,110 @@
+// Tap-to-sound latency of the synthesizer: from PlaybackEngine::Play() on
+// the calling thread to the first audible frame leaving the device, with
+// the file sink standing in for the device (48 kHz, 10 ms periods, three of
+// them in the ring). range(0) is the lead-in in milliseconds; 0 plays the
+// live part alone, which has to get through the ring first.
+//
+// Before each tap the player is stopped, rewound and given time to go
+// quiet and to render its lead-in, none of which is timed.
+
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "corpus.h"
+#include "midi_engine/audio_output.h"
+#include "midi_engine/audio_sink.h"
+#include "midi_engine/playback_engine.h"
+#include "midi_engine/synthesizer_backend.h"
+#include "midi_engine/synthesizer_mixer.h"
+
+namespace playmidifile {
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Past the SineFont's 200 ms release, so the next onset is a new one.
+constexpr std::chrono::milliseconds kQuiet(300);
+
+template <typename Condition>
+bool WaitFor(Condition condition) {
+  auto deadline = Clock::now() + std::chrono::seconds(5);
+  while (!condition()) {
+    if (Clock::now() > deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  return true;
+}
+
+void Wait(PlaybackEngine* engine,
+          void (PlaybackEngine::*command)(CommandCallback, int)) {
+  std::promise<void> done;
+  (engine->*command)([&done](const CommandResult&) { done.set_value(); },
+                     PlaybackEngine::kDefaultPlayer);
+  done.get_future().wait();
+}
+
+void BM_TapToSound(benchmark::State& state) {
+  const uint32_t lead_in_ms = static_cast<uint32_t>(state.range(0));
+  std::string path = testing::WriteTempFile("tap_to_sound.wav", {});
+  auto sink = std::make_unique<WavFileAudioSink>(path);
+  WavFileAudioSink* device = sink.get();
+  SynthesizerMixer mixer(corpus::SineFont(), 48000);
+  AudioOutput output(std::move(sink), &mixer, AudioOutputOptions());
+  mixer.SetOutput(&output);
+  mixer.SetLeadInMs(lead_in_ms);
+  std::string error;
+  if (!output.Start(&error)) {
+    state.SkipWithError(error.c_str());
+    return;
+  }
+  {
+    PlaybackEngine engine(
+        [&mixer] { return std::make_unique<SynthesizerBackend>(&mixer); });
+    // The default player is the mixer's first part.
+    const int part = 0;
+    std::promise<void> loaded;
+    engine.LoadBytes(corpus::Orchestral(1),
+                     [&loaded](const CommandResult&) { loaded.set_value(); });
+    loaded.get_future().wait();
+
+    for (auto _ : state) {
+      Wait(&engine, &PlaybackEngine::Stop);
+      std::this_thread::sleep_for(kQuiet);
+      if (lead_in_ms > 0 &&
+          !WaitFor([&] { return mixer.lead_in_ready(part); })) {
+        state.SkipWithError("Lead-in never became ready");
+        break;
+      }
+      Clock::time_point tap = Clock::now();
+      engine.Play(nullptr);
+      if (!WaitFor([&] { return device->last_onset() > tap; })) {
+        state.SkipWithError("No sound");
+        break;
+      }
+      state.SetIterationTime(
+          std::chrono::duration<double>(device->last_onset() - tap).count());
+    }
+    state.counters["underruns"] = static_cast<double>(output.underruns());
+  }
+  output.Stop();
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_TapToSound)
+    ->Arg(0)
+    ->Arg(300)
+    ->Iterations(20)
+    ->UseManualTime()
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
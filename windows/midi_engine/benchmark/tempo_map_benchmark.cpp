@@ -0,0 +1,156 @@
+// Tick <-> time conversion on files with many tempo changes (e.g. rubato
+// performances exported from a DAW, which write a tempo event every few
+// ticks). Compares the linear scan the engine used to do per conversion
+// with the indexed TempoMap and its sequential Cursor.
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "midi_engine/midi_file.h"
+#include "midi_engine/tempo_map.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr uint16_t kDivision = 960;
+constexpr uint32_t kTicksBetweenChanges = 48;
+
+std::vector<TempoChange> MakeTempoChanges(int count) {
+  std::mt19937 random(42);
+  std::vector<TempoChange> changes;
+  changes.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    changes.push_back(TempoChange{
+        static_cast<uint32_t>(i) * kTicksBetweenChanges,
+        400000 + static_cast<uint32_t>(random() % 400000)});
+  }
+  return changes;
+}
+
+// The per-conversion walk over all tempo changes that TempoMap replaces.
+uint64_t LinearTicksToMicros(const std::vector<TempoChange>& changes,
+                             uint32_t tick) {
+  uint64_t micros = 0;
+  uint32_t last_tick = 0;
+  uint32_t tempo = kDefaultMicrosPerQuarter;
+  for (const TempoChange& change : changes) {
+    if (change.tick >= tick) {
+      break;
+    }
+    micros += static_cast<uint64_t>(change.tick - last_tick) * tempo /
+              kDivision;
+    last_tick = change.tick;
+    tempo = change.micros_per_quarter;
+  }
+  return micros + static_cast<uint64_t>(tick - last_tick) * tempo / kDivision;
+}
+
+std::vector<uint32_t> RandomTicks(uint32_t end_tick) {
+  std::mt19937 random(7);
+  std::vector<uint32_t> ticks(4096);
+  for (uint32_t& tick : ticks) {
+    tick = random() % end_tick;
+  }
+  return ticks;
+}
+
+void BM_LinearScanRandomTicks(benchmark::State& state) {
+  std::vector<TempoChange> changes =
+      MakeTempoChanges(static_cast<int>(state.range(0)));
+  std::vector<uint32_t> ticks =
+      RandomTicks(changes.back().tick + kTicksBetweenChanges);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        LinearTicksToMicros(changes, ticks[i++ & (ticks.size() - 1)]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LinearScanRandomTicks)->Arg(100)->Arg(10000)->Arg(100000);
+
+void BM_TempoMapRandomTicks(benchmark::State& state) {
+  std::vector<TempoChange> changes =
+      MakeTempoChanges(static_cast<int>(state.range(0)));
+  TempoMap map(changes, kDivision);
+  std::vector<uint32_t> ticks =
+      RandomTicks(changes.back().tick + kTicksBetweenChanges);
+  size_t i = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        map.TicksToMicros(ticks[i++ & (ticks.size() - 1)]));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TempoMapRandomTicks)->Arg(100)->Arg(10000)->Arg(100000);
+
+void BM_TempoMapMicrosToTicks(benchmark::State& state) {
+  std::vector<TempoChange> changes =
+      MakeTempoChanges(static_cast<int>(state.range(0)));
+  TempoMap map(changes, kDivision);
+  uint64_t duration =
+      map.TicksToMicros(changes.back().tick + kTicksBetweenChanges);
+  std::vector<uint32_t> ticks = RandomTicks(1u << 30);
+  size_t i = 0;
+  for (auto _ : state) {
+    uint64_t micros = ticks[i++ & (ticks.size() - 1)] % duration;
+    benchmark::DoNotOptimize(map.MicrosToTicks(micros));
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_TempoMapMicrosToTicks)->Arg(100)->Arg(10000)->Arg(100000);
+
+// Playback order: every event of the file converted once, front to back.
+void BM_TempoMapCursorSequential(benchmark::State& state) {
+  std::vector<TempoChange> changes =
+      MakeTempoChanges(static_cast<int>(state.range(0)));
+  TempoMap map(changes, kDivision);
+  uint32_t end_tick = changes.back().tick + kTicksBetweenChanges;
+  for (auto _ : state) {
+    TempoMap::Cursor cursor(&map);
+    for (uint32_t tick = 0; tick < end_tick; tick += 12) {
+      benchmark::DoNotOptimize(cursor.TicksToMicros(tick));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * (end_tick / 12));
+}
+BENCHMARK(BM_TempoMapCursorSequential)->Arg(10000);
+
+// Parse + duration + tempo map for a file with |range(0)| tempo events.
+void BM_OpenFileWithTempoEvents(benchmark::State& state) {
+  std::vector<TempoChange> changes =
+      MakeTempoChanges(static_cast<int>(state.range(0)));
+  testing::SmfBuilder builder(1, kDivision);
+  builder.BeginTrack();
+  for (const TempoChange& change : changes) {
+    builder.Tempo(change.tick == 0 ? 0 : kTicksBetweenChanges,
+                  change.micros_per_quarter);
+  }
+  builder.EndTrack();
+  builder.BeginTrack();
+  for (size_t i = 0; i < changes.size(); ++i) {
+    builder.NoteOn(0, 0, 60, 100).NoteOff(kTicksBetweenChanges, 0, 60);
+  }
+  builder.EndTrack();
+  std::string path =
+      testing::WriteTempFile("tempo_map_benchmark.mid", builder.Build());
+  for (auto _ : state) {
+    std::string error;
+    std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+    benchmark::DoNotOptimize(file->info().duration_us);
+  }
+  std::remove(path.c_str());
+}
+BENCHMARK(BM_OpenFileWithTempoEvents)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond);
+
+}  // namespace
+}  // namespace playmidifile
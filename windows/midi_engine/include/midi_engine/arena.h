@@ -0,0 +1,125 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_ARENA_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace playmidifile {
+
+// A monotonic allocator: allocations are bump-pointer carves out of large
+// chunks and are never freed one by one, only all at once when the arena is
+// released or destroyed. Everything a compiled Sequence owns lives in one,
+// so unloading or evicting a file is a single free with no per-array heap
+// traffic, and reloading it does not fragment the heap.
+//
+// Reserve() up front with the total size and the whole lot is one chunk.
+// Not thread-safe.
+class Arena {
+ public:
+  static constexpr size_t kDefaultChunkBytes = 64 * 1024;
+
+  // Chunks allocated on demand are at least |chunk_bytes| long.
+  explicit Arena(size_t chunk_bytes = kDefaultChunkBytes);
+  ~Arena();
+
+  // Disallow copy and assign.
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Returns |bytes| of storage aligned to |alignment|, a power of two no
+  // larger than alignof(std::max_align_t).
+  void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+  // Makes sure the next |bytes| (plus alignment padding) can be allocated
+  // without another chunk.
+  void Reserve(size_t bytes);
+  // Frees every chunk; earlier allocations become invalid.
+  void Release();
+
+  // Bytes handed out, including alignment padding.
+  size_t bytes_used() const { return used_; }
+  // Bytes held in chunks.
+  size_t bytes_reserved() const { return reserved_; }
+  size_t chunk_count() const { return chunk_count_; }
+
+ private:
+  struct Chunk;
+
+  void AddChunk(size_t min_bytes);
+
+  size_t chunk_bytes_;
+  Chunk* head_;
+  // Free space of the head chunk.
+  uint8_t* cursor_;
+  uint8_t* limit_;
+  size_t used_;
+  size_t reserved_;
+  size_t chunk_count_;
+};
+
+// Standard allocator over an Arena, for containers owned by the same object
+// as the arena. Deallocation is a no-op; the arena frees everything at
+// once. A default-constructed allocator uses the heap instead, so types
+// built on it still work without an arena, and copying a container always
+// copies to the heap rather than into someone else's arena.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+  using propagate_on_container_copy_assignment = std::false_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  ArenaAllocator() noexcept : arena_(nullptr) {}
+  explicit ArenaAllocator(Arena* arena) noexcept : arena_(arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) noexcept
+      : arena_(other.arena()) {}
+
+  T* allocate(size_t n) {
+    if (arena_) {
+      return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+  void deallocate(T* p, size_t n) noexcept {
+    if (!arena_) {
+      ::operator delete(p);
+    }
+  }
+
+  ArenaAllocator select_on_container_copy_construction() const {
+    return ArenaAllocator();
+  }
+
+  Arena* arena() const { return arena_; }
+
+ private:
+  Arena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// Bytes Arena::Reserve() needs for an array of |count| T, allowing for
+// alignment padding in front of it.
+template <typename T>
+constexpr size_t ArenaBytes(size_t count) {
+  return count * sizeof(T) + alignof(T) - 1;
+}
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_ARENA_H_
@@ -0,0 +1,178 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_AUDIO_OUTPUT_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_AUDIO_OUTPUT_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midi_engine/audio_ring.h"
+#include "midi_engine/audio_sink.h"
+#include "midi_engine/playback_stats.h"
+
+namespace playmidifile {
+
+// Produces the audio an AudioOutput plays, a period at a time, on the
+// output's render thread.
+class AudioSource {
+ public:
+  virtual ~AudioSource() = default;
+
+  // Writes |frames| interleaved stereo frames to |output|.
+  virtual void Render(float* output, size_t frames) = 0;
+
+  // Called on the render thread each time it wakes, even when the ring has
+  // no room to render into; for work that should not wait a period.
+  virtual void Poll() {}
+};
+
+struct AudioOutputOptions {
+  uint32_t sample_rate = 48000;
+  // Frames the device takes at a time; 480 is 10 ms at 48 kHz. The sink
+  // may round it to what the device supports.
+  size_t period_frames = 480;
+  // Periods rendered ahead of the device. Output latency is about
+  // period_frames * periods; fewer periods answer sooner but leave less
+  // slack before a slow render underruns. At least 2.
+  int periods = 3;
+};
+
+// Plays an AudioSource through an AudioSink. A render thread keeps an
+// AudioRing topped up from the source, and the sink's device thread drains
+// it a period at a time, so the device never waits for rendering and
+// rendering never runs on the device thread:
+//
+//   source --Render()--> ring --Pull()--> sink
+//
+// When the device asks for more than the ring holds it gets silence for the
+// rest, and the period counts as an underrun.
+//
+// Audio that must be heard sooner than the ring's latency allows can be
+// laid over it as an overlay: the device mixes the overlay in from its next
+// pull, on top of whatever the ring already holds.
+class AudioOutput {
+ public:
+  static constexpr int kMaxOverlays = 8;
+
+  // |source| must outlive this object, and is only called on the render
+  // thread (and on the caller of Start(), before the sink starts).
+  AudioOutput(std::unique_ptr<AudioSink> sink, AudioSource* source,
+              const AudioOutputOptions& options = AudioOutputOptions());
+  // Calls Stop().
+  ~AudioOutput();
+
+  // Disallow copy and assign.
+  AudioOutput(const AudioOutput&) = delete;
+  AudioOutput& operator=(const AudioOutput&) = delete;
+
+  // Where to record render time (audio_callback) and underruns; call
+  // before Start(). |stats| must outlive the output.
+  void SetStats(PlaybackStats* stats) { stats_ = stats; }
+
+  // Opens the sink, fills the ring, and starts both threads. On failure
+  // returns false and fills |error|.
+  bool Start(std::string* error);
+  // Stops both threads and closes the sink. The ring's contents are
+  // dropped.
+  void Stop();
+  bool running() const { return ring_ != nullptr; }
+
+  // The format the sink opened with, valid after Start().
+  const AudioFormat& format() const { return format_; }
+  // Frames between the source and the speaker when the ring is full.
+  size_t latency_frames() const { return ring_ ? ring_->capacity() : 0; }
+
+  // Wakes the render thread to Poll() the source now. Any thread.
+  void Wake();
+
+  // Render thread only (the source's Render() and Poll()):
+
+  // Frames rendered since Start(); the ring frame the next Render() call
+  // writes its first frame to.
+  uint64_t render_frame() const { return frames_rendered_; }
+  // The ring frame the device reads next.
+  uint64_t read_frame() const {
+    return ring_ ? frames_rendered_ - ring_->readable() : 0;
+  }
+  // Plays |frames| frames of |samples| on top of the ring, starting with
+  // the device's next pull. |samples| must stay valid until
+  // TryReleaseOverlay() returns true. Returns the overlay's id, or -1 if
+  // kMaxOverlays are already in use.
+  int StartOverlay(const float* samples, size_t frames);
+  // The ring frame (see render_frame()) overlay |id| started on, or -1
+  // while the device has yet to start it.
+  int64_t OverlayStartFrame(int id) const;
+  // Stops overlay |id| wherever it has got to.
+  void CancelOverlay(int id);
+  // Frees |id| and returns true once the device is done with it.
+  bool TryReleaseOverlay(int id);
+
+  // Device periods that came up short, since Start().
+  uint64_t underruns() const {
+    return underruns_.load(std::memory_order_relaxed);
+  }
+  // Frames handed to the device since Start(), silence included.
+  uint64_t frames_played() const {
+    return frames_played_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  enum OverlayState { kOverlayFree, kOverlayArmed, kOverlayPlaying,
+                      kOverlayCancelled, kOverlayDone };
+
+  struct Overlay {
+    // Armed and released by the render thread, everything else by the
+    // device thread; |samples| and |frames| are published by the release
+    // store of kOverlayArmed.
+    std::atomic<int> state{kOverlayFree};
+    const float* samples = nullptr;
+    size_t frames = 0;
+    std::atomic<int64_t> start_frame{-1};
+    // Device thread.
+    size_t played = 0;
+  };
+
+  // Device thread.
+  void Pull(float* output, size_t frames);
+  void MixOverlays(float* output, size_t frames, uint64_t first_frame);
+  // Render thread.
+  void Run();
+  // Renders periods into the ring while a whole one fits.
+  void Fill();
+
+  std::unique_ptr<AudioSink> sink_;
+  AudioSource* source_;
+  AudioOutputOptions options_;
+  AudioFormat format_;
+  PlaybackStats* stats_;
+  std::unique_ptr<AudioRing> ring_;
+  // One period, rendered before it is copied into the ring.
+  std::vector<float> period_;
+  std::atomic<uint64_t> underruns_;
+  std::atomic<uint64_t> frames_played_;
+  // Render thread.
+  uint64_t frames_rendered_;
+  // Device thread: frames taken from the ring, which underrun silence is
+  // not.
+  uint64_t frames_read_;
+  Overlay overlays_[kMaxOverlays];
+
+  // The render thread sleeps on |wake_| until the device has made room for
+  // a period. Pull() notifies without taking |mutex_|, and the wait has a
+  // timeout, so a lost notification costs at most one period of slack.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  // Set by Wake().
+  bool poll_;
+  std::thread thread_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_AUDIO_OUTPUT_H_
@@ -0,0 +1,60 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_AUDIO_RING_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_AUDIO_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace playmidifile {
+
+// Lock-free ring of interleaved float frames between one producer thread
+// (the renderer) and one consumer thread (the audio device). Like
+// SpscQueue, each side only writes its own index, but frames move in bulk:
+// a Write() or Read() is at most two memcpys and one release store.
+//
+// The capacity is exact, not rounded, because it is the output latency:
+// a ring kept full holds capacity() frames between render and speaker.
+class AudioRing {
+ public:
+  AudioRing(size_t capacity_frames, int channels);
+
+  // Disallow copy and assign.
+  AudioRing(const AudioRing&) = delete;
+  AudioRing& operator=(const AudioRing&) = delete;
+
+  // Producer side. Copies up to |frames| frames from |input| and returns
+  // how many fit.
+  size_t Write(const float* input, size_t frames);
+  // Frames Write() can take now. Exact on the producer thread; the consumer
+  // can only make it grow.
+  size_t writable() const;
+
+  // Consumer side. Copies up to |frames| frames to |output| and returns how
+  // many there were.
+  size_t Read(float* output, size_t frames);
+  // Drops up to |frames| buffered frames and returns how many.
+  size_t Skip(size_t frames);
+  // Frames Read() can return now. Exact on the consumer thread; the
+  // producer can only make it grow.
+  size_t readable() const;
+
+  size_t capacity() const { return capacity_; }
+  int channels() const { return channels_; }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  const size_t capacity_;
+  const int channels_;
+  std::unique_ptr<float[]> samples_;
+
+  // Frame counts since construction; the slot is the count modulo the
+  // capacity. Consumer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> read_;
+  // Producer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> written_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_AUDIO_RING_H_
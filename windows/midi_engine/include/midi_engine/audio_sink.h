@@ -0,0 +1,135 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_AUDIO_SINK_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_AUDIO_SINK_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midi_engine/wav_writer.h"
+
+namespace playmidifile {
+
+// What a sink plays: interleaved stereo float frames at |sample_rate|,
+// pulled |period_frames| at a time.
+struct AudioFormat {
+  uint32_t sample_rate = 48000;
+  size_t period_frames = 480;
+};
+
+// Where rendered audio ends up: a sound device, a file, or nowhere. The
+// sink owns the device thread and pulls audio from it at the device's
+// pace; it never renders itself (see AudioOutput).
+class AudioSink {
+ public:
+  // Fills |output| with |frames| frames. Called on the device thread, so it
+  // must not block.
+  using PullCallback = std::function<void(float* output, size_t frames)>;
+
+  virtual ~AudioSink() = default;
+
+  // Opens the device for |format|. A device that cannot take the requested
+  // period size rounds it to one it can and updates |format|. On failure
+  // returns false and fills |error|.
+  virtual bool Open(AudioFormat* format, std::string* error) = 0;
+  // Starts pulling from |pull| on the device thread. Pulls may be for any
+  // number of frames, though usually a period.
+  virtual void Start(PullCallback pull) = 0;
+  // Stops the device thread and closes the device. No pull is running or
+  // will run once this returns.
+  virtual void Close() = 0;
+};
+
+// A sink whose "device" is a thread woken once per period by the steady
+// clock, standing in for a sound card's interrupt. Subclasses only decide
+// what happens to each period.
+class ClockedAudioSink : public AudioSink {
+ public:
+  ClockedAudioSink();
+  // Subclasses must Close() in their own destructors, so that the device
+  // thread never calls Consume() on a half-destroyed object.
+  ~ClockedAudioSink() override;
+
+  // Disallow copy and assign.
+  ClockedAudioSink(const ClockedAudioSink&) = delete;
+  ClockedAudioSink& operator=(const ClockedAudioSink&) = delete;
+
+  // AudioSink:
+  bool Open(AudioFormat* format, std::string* error) override;
+  void Start(PullCallback pull) override;
+  void Close() override;
+
+  // Periods the device thread has pulled since Open().
+  uint64_t periods() const { return periods_.load(std::memory_order_relaxed); }
+  // When the most recent sound after silence reached the "speaker": the
+  // time its period was due plus the offset of its first non-zero frame.
+  // The epoch if there has been none since Open(). For measuring how long
+  // after a play() the first note is heard.
+  std::chrono::steady_clock::time_point last_onset() const {
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(
+        last_onset_ns_.load(std::memory_order_acquire)));
+  }
+
+ protected:
+  // Called on the device thread with each period pulled.
+  virtual void Consume(const float* samples, size_t frames) {}
+
+  const AudioFormat& format() const { return format_; }
+
+ private:
+  void Run();
+
+  AudioFormat format_;
+  PullCallback pull_;
+  std::vector<float> period_;
+  std::atomic<uint64_t> periods_;
+  std::atomic<int64_t> last_onset_ns_;
+  // Device thread: whether the last period was all zeros.
+  bool silent_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  std::thread thread_;
+};
+
+// Plays into nothing, in real time. For running the audio path without a
+// sound card, in tests and benchmarks.
+class NullAudioSink : public ClockedAudioSink {
+ public:
+  NullAudioSink() = default;
+  ~NullAudioSink() override;
+};
+
+// Plays into a 16-bit .wav file, in real time, so what a listener would
+// have heard can be checked afterwards.
+class WavFileAudioSink : public ClockedAudioSink {
+ public:
+  explicit WavFileAudioSink(std::string utf8_path);
+  ~WavFileAudioSink() override;
+
+  // AudioSink:
+  bool Open(AudioFormat* format, std::string* error) override;
+  // Also finalizes the file.
+  void Close() override;
+
+  // The first write error, if any; writing stops there. Read after Close().
+  const std::string& error() const { return error_; }
+
+ protected:
+  void Consume(const float* samples, size_t frames) override;
+
+ private:
+  std::string path_;
+  WavWriter writer_;
+  std::string error_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_AUDIO_SINK_H_
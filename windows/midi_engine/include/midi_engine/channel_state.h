@@ -0,0 +1,48 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_CHANNEL_STATE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_CHANNEL_STATE_H_
+
+#include <cstdint>
+
+#include "midi_engine/midi_output.h"
+
+namespace playmidifile {
+
+constexpr int kMidiChannelCount = 16;
+
+// The persistent (non-note) state of all 16 MIDI channels: program,
+// controllers, pitch bend and channel pressure. Used to chase state when
+// playback starts somewhere other than the beginning of a file.
+class ChannelStateSet {
+ public:
+  ChannelStateSet();
+
+  void Reset();
+
+  // Folds one channel message into the state. Notes are ignored.
+  void Apply(uint8_t status, uint8_t data1, uint8_t data2);
+
+  // Sends the recorded state to |output|, bank select before program change
+  // so the right patch is chosen.
+  void Emit(MidiOutput* output) const;
+
+ private:
+  static constexpr uint8_t kUnset = 0xFF;
+
+  struct Channel {
+    uint8_t program;
+    uint8_t pressure;
+    uint8_t bend_lsb;
+    uint8_t bend_msb;
+    // kUnset for controllers never seen.
+    uint8_t controllers[120];
+  };
+
+  Channel channels_[kMidiChannelCount];
+};
+
+// Sends "all notes off" and releases the sustain pedal on every channel.
+void SilenceAllChannels(MidiOutput* output);
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_CHANNEL_STATE_H_
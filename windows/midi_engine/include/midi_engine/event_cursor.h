@@ -0,0 +1,66 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_EVENT_CURSOR_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_EVENT_CURSOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "midi_engine/channel_state.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+// Where a Sequencer reads its events from, in playback order: a compiled
+// Sequence, or a file decoded on the fly (SequenceStream).
+class EventCursor {
+ public:
+  virtual ~EventCursor() = default;
+
+  // Length of the piece in song time, trailing silence included.
+  virtual uint64_t duration_us() const = 0;
+
+  // The event at the cursor and its song time, or null past the last
+  // event. Valid until the next Advance() or Seek().
+  virtual const SequenceEvent* Peek(uint64_t* micros) = 0;
+  // Wire bytes of a system exclusive event returned by Peek().
+  virtual const uint8_t* Payload(const SequenceEvent& event) const = 0;
+  virtual void Advance() = 0;
+
+  // Moves to the first event at or after |position_us|; events exactly
+  // there are played, not chased. Stores in |state| the channel state in
+  // effect at that point.
+  virtual void Seek(uint64_t position_us, ChannelStateSet* state) = 0;
+};
+
+// Walks a compiled Sequence. Seeking is a binary search plus a replay from
+// the nearest checkpoint.
+class SequenceCursor : public EventCursor {
+ public:
+  explicit SequenceCursor(std::shared_ptr<const Sequence> sequence);
+
+  // Disallow copy and assign.
+  SequenceCursor(const SequenceCursor&) = delete;
+  SequenceCursor& operator=(const SequenceCursor&) = delete;
+
+  // EventCursor:
+  uint64_t duration_us() const override;
+  const SequenceEvent* Peek(uint64_t* micros) override;
+  const uint8_t* Payload(const SequenceEvent& event) const override;
+  void Advance() override;
+  void Seek(uint64_t position_us, ChannelStateSet* state) override;
+
+ private:
+  std::shared_ptr<const Sequence> sequence_;
+  // Converts event ticks in playback order without searching.
+  TempoMap::Cursor tempo_cursor_;
+  size_t next_event_;
+  // |next_event_| unpacked and its song time, once computed.
+  SequenceEvent current_;
+  uint64_t next_event_us_;
+  bool current_valid_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_EVENT_CURSOR_H_
@@ -0,0 +1,53 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_MAPPED_FILE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace playmidifile {
+
+// Read-only memory mapping of a whole file. The parser decodes straight out
+// of the mapping, so nothing is copied onto the heap at load time.
+class MappedFile {
+ public:
+  // How the mapping will be read, passed on to the OS as a read-ahead hint.
+  enum class Access {
+    // Front to back, once: read ahead aggressively.
+    kSequential,
+    // Scattered reads of parts of the file: read only what is touched.
+    kRandom,
+  };
+
+  MappedFile();
+  ~MappedFile();
+
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // Disallow copy and assign.
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps |utf8_path|. On failure returns false and fills |error|.
+  bool Open(const std::string& utf8_path, std::string* error,
+            Access access = Access::kSequential);
+
+  void Close();
+
+  bool is_open() const { return data_ != nullptr; }
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_MAPPED_FILE_H_
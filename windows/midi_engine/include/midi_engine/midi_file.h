@@ -0,0 +1,72 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_MIDI_FILE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_MIDI_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/mapped_file.h"
+#include "midi_engine/smf_parser.h"
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+// Summary of a parsed file, gathered in a single pass over all tracks.
+struct MidiFileInfo {
+  uint16_t format = 0;
+  uint16_t track_count = 0;
+  // Ticks per quarter note; 0 for SMPTE-timed files.
+  uint16_t ppq = 0;
+  // Tick of the last event over all tracks.
+  uint32_t end_tick = 0;
+  uint64_t duration_us = 0;
+  // Tempo changes from all tracks in tick order. Empty for SMPTE files.
+  std::vector<TempoChange> tempo_changes;
+  TempoMap tempo_map;
+
+  uint32_t duration_ms() const {
+    return static_cast<uint32_t>(duration_us / 1000);
+  }
+  // Tempo in effect at tick 0.
+  double initial_bpm() const;
+};
+
+// A parsed Standard MIDI File, either memory-mapped from disk or borrowed
+// from a caller's buffer. Track data is decoded in place with TrackReader.
+class MidiFile {
+ public:
+  // Maps and parses |utf8_path|. Returns null and fills |error| on failure.
+  static std::unique_ptr<MidiFile> Open(const std::string& utf8_path,
+                                        std::string* error);
+  // Parses |size| bytes at |data| without copying them. |data| must outlive
+  // the returned file.
+  static std::unique_ptr<MidiFile> Parse(const uint8_t* data, size_t size,
+                                         std::string* error);
+
+  // Disallow copy and assign.
+  MidiFile(const MidiFile&) = delete;
+  MidiFile& operator=(const MidiFile&) = delete;
+
+  const SmfFile& smf() const { return smf_; }
+  const MidiFileInfo& info() const { return info_; }
+
+  // Converts an absolute tick to microseconds using the file's tempo map.
+  uint64_t TicksToMicros(uint32_t tick) const {
+    return info_.tempo_map.TicksToMicros(tick);
+  }
+
+ private:
+  MidiFile() = default;
+
+  // Parses |data| and builds |info_|.
+  bool Load(const uint8_t* data, size_t size, std::string* error);
+
+  MappedFile mapping_;
+  SmfFile smf_;
+  MidiFileInfo info_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_MIDI_FILE_H_
@@ -0,0 +1,30 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_MIDI_OUTPUT_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_MIDI_OUTPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+namespace playmidifile {
+
+// Destination for MIDI messages dispatched by the sequencer: a hardware or
+// OS port, a software synthesizer, or a recorder in tests. Called on the
+// engine thread only.
+class MidiOutput {
+ public:
+  virtual ~MidiOutput() = default;
+
+  // Sends a channel message. |data2| is 0 for one-byte messages.
+  virtual void SendChannelMessage(uint8_t status, uint8_t data1,
+                                  uint8_t data2) = 0;
+
+  // Sends a complete system exclusive message, including the leading 0xF0
+  // (or 0xF7 for escaped data) and the trailing 0xF7.
+  virtual void SendSysEx(const uint8_t* data, size_t size) = 0;
+
+  // Output level in [0, 1].
+  virtual void SetVolume(double volume) {}
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_MIDI_OUTPUT_H_
@@ -0,0 +1,109 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_OFFLINE_RENDERER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_OFFLINE_RENDERER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/sequence.h"
+#include "midi_engine/soundfont.h"
+#include "midi_engine/synthesizer.h"
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+struct RenderOptions {
+  uint32_t sample_rate = 44100;
+  // Number of channel groups rendered concurrently and mixed per block.
+  // Channel c belongs to group c % threads. 1 renders on the calling thread.
+  int threads = 1;
+  double volume = 1.0;
+  // Voices per channel group.
+  int polyphony = Synthesizer::kDefaultPolyphony;
+  // Longest time rendered after the last event while notes ring out.
+  uint32_t max_tail_ms = 3000;
+  // Polled between blocks by the Render*() helpers; rendering stops with an
+  // error once it becomes true.
+  const std::atomic<bool>* cancel = nullptr;
+};
+
+// Renders a Sequence through the synthesizer as fast as the CPU allows, with
+// no clock: event times come from the tempo map and become sample offsets,
+// so every event starts on its exact frame.
+//
+// With several threads each channel group has its own Synthesizer (and
+// voice pool), so output matches a single-threaded render except for float
+// summation order, unless a group runs out of voices.
+//
+// A playlist plays its pieces back to back the way a chained Sequencer
+// does: each starts on the frame the previous one ends, after the channels
+// are silenced, with no gap.
+class OfflineRenderer {
+ public:
+  OfflineRenderer(std::shared_ptr<const Sequence> sequence,
+                  std::shared_ptr<const SoundFont> font,
+                  const RenderOptions& options);
+  OfflineRenderer(std::vector<std::shared_ptr<const Sequence>> playlist,
+                  std::shared_ptr<const SoundFont> font,
+                  const RenderOptions& options);
+  ~OfflineRenderer();
+
+  // Disallow copy and assign.
+  OfflineRenderer(const OfflineRenderer&) = delete;
+  OfflineRenderer& operator=(const OfflineRenderer&) = delete;
+
+  // Writes up to |frames| interleaved stereo frames to |output| and returns
+  // how many were written: fewer once the end of the piece (plus its tail)
+  // is reached, then 0.
+  size_t Render(float* output, size_t frames);
+
+  // True once the last event has played and every voice has died away, or
+  // the tail limit is reached.
+  bool finished() const;
+
+  uint64_t position_frames() const { return position_; }
+  // Frames up to the last event, without the release tail.
+  uint64_t end_frame() const { return end_frame_; }
+  // Frame on which playlist piece |index| starts.
+  uint64_t start_frame(size_t index) const { return starts_[index]; }
+  uint32_t sample_rate() const { return options_.sample_rate; }
+
+ private:
+  struct Group;
+
+  uint64_t FrameAt(uint64_t micros) const;
+  // Renders every group for |frames| frames and advances the position.
+  void RenderChunk(float* output, size_t frames);
+  void RenderGroup(Group* group, float* output, size_t frames);
+
+  std::vector<std::shared_ptr<const Sequence>> playlist_;
+  // First frame of each playlist piece.
+  std::vector<uint64_t> starts_;
+  RenderOptions options_;
+  std::vector<std::unique_ptr<Group>> groups_;
+  uint64_t position_;
+  uint64_t end_frame_;
+  uint64_t tail_frames_;
+};
+
+// Renders the whole sequence into |output| (interleaved stereo). Returns
+// false only when cancelled.
+bool RenderToBuffer(std::shared_ptr<const Sequence> sequence,
+                    std::shared_ptr<const SoundFont> font,
+                    const RenderOptions& options, std::vector<float>* output,
+                    std::string* error);
+
+// Renders the whole sequence to a 16-bit stereo .wav file, streaming in
+// blocks. |frames| receives the length rendered.
+bool RenderToWavFile(std::shared_ptr<const Sequence> sequence,
+                     std::shared_ptr<const SoundFont> font,
+                     const RenderOptions& options,
+                     const std::string& utf8_path, uint64_t* frames,
+                     std::string* error);
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_OFFLINE_RENDERER_H_
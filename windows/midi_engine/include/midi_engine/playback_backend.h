@@ -0,0 +1,80 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_BACKEND_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_BACKEND_H_
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/playback_stats.h"
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+
+// The device or sequencer a PlaybackEngine drives. Every method is called on
+// the engine thread only, so implementations need no locking of their own.
+// Failures return false and describe the problem in |error|.
+class PlaybackBackend {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  virtual ~PlaybackBackend() = default;
+
+  // Prepares |sequence| for playback, replacing whatever was open before.
+  // |path| names its source: a file path, or "<memory>" for loaded bytes.
+  virtual bool Open(const std::string& path,
+                    std::shared_ptr<const Sequence> sequence,
+                    std::string* error) = 0;
+  // Prepares a file decoded on the fly by |events| instead. Only called
+  // when CanStream() is true; the default fails.
+  virtual bool OpenStream(const std::string& path,
+                          std::unique_ptr<EventCursor> events,
+                          std::string* error) {
+    *error = "Streaming is not supported";
+    return false;
+  }
+  virtual bool CanStream() const { return false; }
+  virtual void Close() = 0;
+
+  // Queues |next| to start the moment the open file ends, with no gap, and
+  // drops any file queued before; null just drops it. Opening another file
+  // drops it too. The default fails, and the engine then opens the next
+  // file itself once the current one has finished.
+  virtual bool Chain(const std::string& path,
+                     std::shared_ptr<const Sequence> next,
+                     std::string* error) {
+    *error = "Gapless playback is not supported";
+    return false;
+  }
+  // True once after Service() has moved on to the chained file.
+  virtual bool TakeTransition() { return false; }
+
+  // Starts or resumes playback from the current position.
+  virtual bool Play(std::string* error) = 0;
+  virtual bool Pause(std::string* error) = 0;
+  // Halts playback; the engine seeks back to the start afterwards.
+  virtual bool Stop(std::string* error) = 0;
+  // Moves the position. Playback, if running, may be halted; the engine
+  // calls Play() again when needed.
+  virtual bool Seek(uint32_t position_ms, std::string* error) = 0;
+
+  virtual void SetVolume(double volume) = 0;
+  // Returns false if the backend cannot change the playback rate.
+  virtual bool SetSpeed(double speed) = 0;
+
+  virtual uint32_t PositionMs() = 0;
+
+  // Where to record timing, for backends that measure any; |stats|
+  // outlives the backend. The default ignores it.
+  virtual void SetStats(PlaybackStats* stats) {}
+
+  // Gives the backend time on the engine thread while playing. Sets
+  // |*finished| once the end of the file has been reached and returns when
+  // it next wants to be called.
+  virtual Clock::time_point Service(Clock::time_point now, bool* finished) = 0;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_BACKEND_H_
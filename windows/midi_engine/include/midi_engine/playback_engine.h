@@ -0,0 +1,404 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_ENGINE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_ENGINE_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/playback_backend.h"
+#include "midi_engine/playback_stats.h"
+#include "midi_engine/seqlock.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequence_cache.h"
+#include "midi_engine/spsc_queue.h"
+#include "midi_engine/worker_thread.h"
+
+namespace playmidifile {
+
+enum class PlaybackState : uint8_t {
+  kStopped,
+  kPlaying,
+  kPaused,
+};
+
+// Name used on the method channel ("stopped", "playing", "paused").
+const char* PlaybackStateName(PlaybackState state);
+
+struct PlaybackInfo {
+  uint32_t position_ms = 0;
+  uint32_t duration_ms = 0;
+  PlaybackState state = PlaybackState::kStopped;
+};
+
+// Outcome of a command. |error_code| mirrors the method channel error codes
+// ("FILE_NOT_FOUND", "LOAD_ERROR", ...) and is empty on success.
+struct CommandResult {
+  std::string error_code;
+  std::string error_message;
+  // The player the command addressed, and its info afterwards.
+  int player = 0;
+  PlaybackInfo info;
+
+  bool ok() const { return error_code.empty(); }
+};
+
+enum class CommandType : uint8_t {
+  kLoad,
+  kLoadBytes,
+  kPlay,
+  kPause,
+  kStop,
+  kSeek,
+  kSetVolume,
+  kSetSpeed,
+  kGetInfo,
+  kSetProgressListener,
+  kCreatePlayer,
+  kDisposePlayer,
+  kEnqueue,
+  kSetQueue,
+  kNext,
+};
+
+using CommandCallback = std::function<void(const CommandResult&)>;
+// Receives pushed playback updates for |player| on the engine thread. Must
+// not block.
+using ProgressListener =
+    std::function<void(int player, const PlaybackInfo& info)>;
+
+struct Command {
+  CommandType type = CommandType::kGetInfo;
+  // The player addressed; ignored by kSetProgressListener.
+  int player = 0;
+  // kLoad and kEnqueue.
+  std::string path;
+  // kSetQueue.
+  std::vector<std::string> paths;
+  // kLoadBytes: a whole Standard MIDI File.
+  std::vector<uint8_t> bytes;
+  // kSetVolume and kSetSpeed.
+  double value = 0.0;
+  // kSeek.
+  uint32_t position_ms = 0;
+  // kSetProgressListener.
+  ProgressListener listener;
+  uint32_t interval_ms = 0;
+  // Invoked on the engine thread once the command has been executed.
+  CommandCallback done;
+};
+
+// Owns all playback state on a dedicated thread. Callers post commands
+// through a lock-free single-producer ring and get results back
+// asynchronously, so a slow driver never blocks the posting thread.
+//
+// The engine hosts several independent players, each with its own backend,
+// sequence, transport state and volume, all serviced by the one engine
+// thread: N players cost N schedulers, not N threads. Player
+// kDefaultPlayer always exists and is what commands address by default;
+// more come from CreatePlayer().
+//
+// Files are parsed on a separate loader thread, so a long load neither
+// stalls other players nor the command ring. A player's later commands wait
+// for its load to finish. A newer load for the same player cancels the one
+// in progress, which completes with "LOAD_CANCELLED" and leaves the player
+// as it was; commands queued behind it then run against that state.
+//
+// Each player also has a queue of files to play after the current one.
+// While a file plays, the loader thread parses the next queued one and, if
+// the backend can chain, hands it over so it starts on the exact tick the
+// current file ends. Otherwise the next file is opened once the current one
+// finishes, after the (then cached) parse.
+//
+// Post() and the convenience wrappers must all be called from the same
+// thread (the Flutter platform thread in the plugin).
+class PlaybackEngine {
+ public:
+  using Clock = std::chrono::steady_clock;
+  // Makes the backend of a new player; called on the engine thread except
+  // for the default player's, which is made by the constructor.
+  using BackendFactory = std::function<std::unique_ptr<PlaybackBackend>()>;
+
+  static constexpr int kDefaultPlayer = 0;
+  static constexpr int kMaxPlayers = 64;
+  // Files at least this large are streamed from disk by default.
+  static constexpr uint64_t kDefaultStreamingThreshold = 8 * 1024 * 1024;
+
+  // An engine with just the default player, playing through |backend|.
+  // Files are loaded through |cache|, which may be shared with other users;
+  // without one the engine keeps a private cache.
+  explicit PlaybackEngine(std::unique_ptr<PlaybackBackend> backend,
+                          std::shared_ptr<SequenceCache> cache = nullptr,
+                          size_t queue_capacity = 256);
+  // An engine that makes a backend with |factory| for every player.
+  explicit PlaybackEngine(BackendFactory factory,
+                          std::shared_ptr<SequenceCache> cache = nullptr,
+                          size_t queue_capacity = 256);
+  ~PlaybackEngine();
+
+  // Disallow copy and assign.
+  PlaybackEngine(const PlaybackEngine&) = delete;
+  PlaybackEngine& operator=(const PlaybackEngine&) = delete;
+
+  // Queues |command|. If the ring is full the command is completed
+  // immediately on the calling thread with a "BUSY" error, and false is
+  // returned.
+  bool Post(Command command);
+
+  // Player commands. A handle that is not a live player fails with
+  // "INVALID_ARGUMENT".
+  void Load(std::string path, CommandCallback done,
+            int player = kDefaultPlayer);
+  // Loads a file held in memory. |bytes| moves to the engine thread, where
+  // it is parsed in place.
+  void LoadBytes(std::vector<uint8_t> bytes, CommandCallback done,
+                 int player = kDefaultPlayer);
+  void Play(CommandCallback done, int player = kDefaultPlayer);
+  void Pause(CommandCallback done, int player = kDefaultPlayer);
+  void Stop(CommandCallback done, int player = kDefaultPlayer);
+  void Seek(uint32_t position_ms, CommandCallback done,
+            int player = kDefaultPlayer);
+  void SetVolume(double volume, CommandCallback done,
+                 int player = kDefaultPlayer);
+  void SetSpeed(double speed, CommandCallback done,
+                int player = kDefaultPlayer);
+  void GetInfo(CommandCallback done, int player = kDefaultPlayer);
+
+  // Adds |path| to the end of the player's queue.
+  void Enqueue(std::string path, CommandCallback done,
+               int player = kDefaultPlayer);
+  // Replaces the player's queue with |paths|; empty clears it.
+  void SetQueue(std::vector<std::string> paths, CommandCallback done,
+                int player = kDefaultPlayer);
+  // Loads the next queued file now, playing it if the player was playing,
+  // and replies like Load(). Fails with "QUEUE_EMPTY" when nothing is
+  // queued.
+  void Next(CommandCallback done, int player = kDefaultPlayer);
+
+  // Returns the handle of a new, empty player, usable at once. Returns -1
+  // and fails |done| with "PLAYER_ERROR" when kMaxPlayers are in use or
+  // the engine was built around a single backend, or with "BUSY" when the
+  // command ring is full.
+  int CreatePlayer(CommandCallback done);
+  // Stops and frees |player|; its handle may be reused afterwards. The
+  // default player cannot be disposed. A load still running for it, and
+  // the commands waiting for that load, fail with "INVALID_ARGUMENT".
+  void DisposePlayer(int player, CommandCallback done);
+
+  // Pushes each player's info to |listener| every |interval_ms| while it
+  // plays, and at once after a load, transport command, seek or the end of
+  // its file. A null listener stops the updates.
+  void SetProgressListener(ProgressListener listener, uint32_t interval_ms,
+                           CommandCallback done);
+
+  // Load() streams files of at least |bytes| from disk with a
+  // SequenceStream instead of compiling them, when the backend can play a
+  // stream; 0 never streams. Takes effect from the next load. Callable from
+  // any thread.
+  void SetStreamingThreshold(uint64_t bytes) {
+    streaming_threshold_.store(bytes, std::memory_order_relaxed);
+  }
+
+  // The playback info of |player| right now, readable from any thread
+  // without a round trip: a consistent snapshot of what the engine last
+  // published, with the position extrapolated from the engine clock while
+  // playing. Takes no lock, makes no system call and does not allocate.
+  PlaybackInfo Snapshot(int player = kDefaultPlayer) const {
+    return Snapshot(player, Clock::now());
+  }
+  PlaybackInfo Snapshot(Clock::time_point now) const {
+    return Snapshot(kDefaultPlayer, now);
+  }
+  PlaybackInfo Snapshot(int player, Clock::time_point now) const;
+
+  // Timing counters of every player since construction or the last
+  // ResetStats(). Callable from any thread; neither call waits for the
+  // engine thread.
+  PlaybackStatsSnapshot Stats() const { return stats_.Snapshot(); }
+  void ResetStats() { stats_.Reset(); }
+  // The same counters, for outputs the engine does not own (an
+  // AudioOutput's render and device threads) to record into.
+  PlaybackStats* mutable_stats() { return &stats_; }
+
+  // Number of commands executed by the engine thread so far.
+  uint64_t commands_executed() const {
+    return commands_executed_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Engine-thread state of one player.
+  struct Player {
+    std::unique_ptr<PlaybackBackend> backend;
+    // Whether a file is open, and its length.
+    bool loaded = false;
+    uint32_t duration_ms = 0;
+    PlaybackState state = PlaybackState::kStopped;
+    // Rate the backend last accepted.
+    double speed = 1.0;
+    // When the backend next wants Service(); min() after any command so
+    // the change is acted on straight away.
+    Clock::time_point deadline = Clock::time_point::min();
+    Clock::time_point next_progress;
+    // Set by commands and the end of the file to publish without waiting
+    // for the interval.
+    bool progress_dirty = false;
+    // The load in progress, if any: set to cancel it. Commands for the
+    // player wait in |deferred| until it completes.
+    std::shared_ptr<std::atomic<bool>> load_cancel;
+    CommandCallback load_done;
+    std::deque<Command> deferred;
+    // Play the load in progress as soon as it opens.
+    bool load_autoplay = false;
+    // Files to play after the current one.
+    std::deque<std::string> queue;
+    // The parse of |queue|.front() ahead of time, if running: set to
+    // cancel it.
+    std::shared_ptr<std::atomic<bool>> preload_cancel;
+    // |queue|.front() has been parsed ahead of time; if |chained| too, the
+    // backend starts it by itself, and it lasts |chained_duration_ms|.
+    bool preloaded = false;
+    bool chained = false;
+    uint32_t chained_duration_ms = 0;
+  };
+
+  // A load as handed to the loader thread.
+  struct LoadJob {
+    int player = 0;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    // The file, or the bytes when |from_bytes|.
+    std::string path;
+    std::vector<uint8_t> bytes;
+    bool from_bytes = false;
+    // Stream instead of compiling at or above this size.
+    uint64_t streaming_threshold = 0;
+    // Parsing a queued file ahead of time rather than loading it.
+    bool preload = false;
+  };
+
+  // What the loader thread hands back: a sequence, a stream, or an error.
+  struct LoadOutcome {
+    int player = 0;
+    // Identifies the load; stale when the player has moved on.
+    std::shared_ptr<std::atomic<bool>> cancel;
+    std::string source;
+    std::shared_ptr<const Sequence> sequence;
+    std::unique_ptr<EventCursor> stream;
+    uint32_t duration_ms = 0;
+    std::string error_code;
+    std::string error_message;
+    bool preload = false;
+  };
+
+  PlaybackEngine(BackendFactory factory,
+                 std::unique_ptr<PlaybackBackend> default_backend,
+                 std::shared_ptr<SequenceCache> cache, size_t queue_capacity);
+
+  void Run();
+  // Sleeps until |deadline| or until a command is posted.
+  void WaitForWork(Clock::time_point deadline);
+  // Services every playing player that is due and returns the earliest
+  // deadline among them.
+  Clock::time_point ServicePlayers(Clock::time_point now);
+  void Execute(Command* command);
+  void ExecutePlayerCommand(int id, Command* command, Player* player,
+                            CommandResult* result);
+  // Calls the progress listener for every player with an update due and
+  // returns when the next periodic one is.
+  Clock::time_point PublishProgress(Clock::time_point now);
+  // Wakes the engine thread if it is not already awake. Any thread.
+  void Wake();
+  // Cancels any load in progress for |id| and hands the new one to the
+  // loader thread.
+  void StartLoad(int id, Player* player, Command* command);
+  // Completes the load in progress for |id|, if any, with "LOAD_CANCELLED"
+  // and runs the commands that waited for it.
+  void CancelLoad(int id, Player* player);
+  // Fails the load in progress for |id|, if any, and the commands that
+  // waited for it with "INVALID_ARGUMENT", running none of them. For a
+  // player about to be disposed.
+  void AbandonLoad(int id, Player* player);
+  // Runs |job| on the loader thread and queues its outcome for the engine.
+  void PostLoadJob(LoadJob job);
+  // Loads the front of the queue of |id| in place of the current file.
+  void AdvanceQueue(int id, Player* player, bool autoplay,
+                    CommandCallback done);
+  // Starts parsing the front of the queue of |id| ahead of time, unless
+  // that is done, running or pointless.
+  void SchedulePreload(int id, Player* player);
+  // Forgets the parse ahead of time, cancelling or unchaining it.
+  void DropPreload(Player* player);
+  // Chains a file parsed ahead of time into its player's backend.
+  void FinishPreload(LoadOutcome* outcome);
+  // Loader thread: parses or opens what |job| names into |outcome|.
+  void ParseInBackground(LoadJob* job, LoadOutcome* outcome);
+  // Opens every finished load in its player, dropping stale ones.
+  void DrainLoads();
+  void FinishLoad(LoadOutcome* outcome);
+  // Replies to the load of |id| with |result| and runs the commands that
+  // waited for it.
+  void CompleteLoad(int id, Player* player, CommandResult* result);
+  // Hands a loaded sequence to the backend. |source| names it in errors.
+  void OpenSequence(Player* player, const std::string& source,
+                    std::shared_ptr<const Sequence> sequence,
+                    CommandResult* result);
+  // Records the outcome of a backend Open() or OpenStream().
+  void FinishOpen(Player* player, const std::string& source, bool opened,
+                  uint32_t duration_ms, const std::string& error,
+                  CommandResult* result);
+  PlaybackInfo CurrentInfo(Player* player);
+  // Republishes the anchor of |id| from its backend's current position.
+  void PublishAnchor(int id);
+
+  // What Snapshot() extrapolates from.
+  struct Anchor {
+    // Clock time at which |position_us| was sampled.
+    int64_t time_ns = 0;
+    uint64_t position_us = 0;
+    double speed = 1.0;
+    uint32_t duration_ms = 0;
+    PlaybackState state = PlaybackState::kStopped;
+  };
+
+  BackendFactory factory_;
+  std::shared_ptr<SequenceCache> cache_;
+  SpscQueue<Command> commands_;
+  // Handles given out by CreatePlayer(). Posting thread only; a disposed
+  // handle is reused only by commands queued behind the dispose.
+  bool handle_in_use_[kMaxPlayers];
+
+  // Wake-up handshake only; the command ring itself is lock-free.
+  std::mutex wake_mutex_;
+  std::condition_variable wake_;
+  std::atomic<bool> wake_pending_;
+  std::atomic<bool> quit_;
+  std::atomic<uint64_t> commands_executed_;
+  std::atomic<uint64_t> streaming_threshold_;
+  Seqlock<Anchor> anchors_[kMaxPlayers];
+  // Written by the engine thread and backends, read by Stats().
+  PlaybackStats stats_;
+
+  // Engine-thread state. Empty slots are players not created yet or
+  // disposed.
+  std::unique_ptr<Player> players_[kMaxPlayers];
+  ProgressListener progress_listener_;
+  Clock::duration progress_interval_;
+
+  // Finished loads; the loader thread is the only producer.
+  SpscQueue<LoadOutcome> loads_;
+
+  std::thread thread_;
+  // Last, so it stops before anything its tasks touch goes away.
+  WorkerThread loader_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_ENGINE_H_
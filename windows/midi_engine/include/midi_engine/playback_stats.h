@@ -0,0 +1,79 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_STATS_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_STATS_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace playmidifile {
+
+// Summary of a StatsHistogram. Percentiles are bucket upper bounds (capped
+// at the maximum), so they overstate by less than 2x.
+struct HistogramSummary {
+  uint64_t count = 0;
+  double mean = 0.0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t max = 0;
+};
+
+// Lock-free histogram of non-negative integer samples in power-of-two
+// buckets. Record() is a few relaxed atomic adds, cheap enough for the
+// engine thread and audio callbacks; Summary() and Reset() may run on any
+// thread at the same time. A reset racing a record may lose that sample.
+class StatsHistogram {
+ public:
+  // Bucket 0 holds 0; bucket b holds [2^(b-1), 2^b). The last one also
+  // takes everything larger.
+  static constexpr size_t kBuckets = 40;
+
+  StatsHistogram();
+
+  // Disallow copy and assign.
+  StatsHistogram(const StatsHistogram&) = delete;
+  StatsHistogram& operator=(const StatsHistogram&) = delete;
+
+  void Record(uint64_t value);
+  HistogramSummary Summary() const;
+  void Reset();
+
+ private:
+  std::atomic<uint64_t> buckets_[kBuckets];
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+};
+
+struct PlaybackStatsSnapshot {
+  HistogramSummary dispatch_lateness_us;
+  HistogramSummary service_duration_us;
+  HistogramSummary audio_callback_us;
+  HistogramSummary command_queue_depth;
+  HistogramSummary seek_latency_us;
+  uint64_t underruns = 0;
+};
+
+// Timing counters a PlaybackEngine and its backends fill in while playing.
+// Always on: recording costs a handful of uncontended atomic adds.
+struct PlaybackStats {
+  // How long after its deadline each event went out.
+  StatsHistogram dispatch_lateness;
+  // Time spent in each backend Service() call.
+  StatsHistogram service_duration;
+  // Time spent producing each buffer of audio, and buffers the device
+  // found empty. Only backends that render audio record these.
+  StatsHistogram audio_callback;
+  std::atomic<uint64_t> underruns{0};
+  // Commands waiting each time the engine thread drains its ring.
+  StatsHistogram command_queue_depth;
+  // Time to execute a seek command, state chase included.
+  StatsHistogram seek_latency;
+
+  PlaybackStatsSnapshot Snapshot() const;
+  void Reset();
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_PLAYBACK_STATS_H_
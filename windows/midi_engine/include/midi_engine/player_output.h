@@ -0,0 +1,57 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_PLAYER_OUTPUT_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_PLAYER_OUTPUT_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "midi_engine/channel_state.h"
+#include "midi_engine/midi_output.h"
+
+namespace playmidifile {
+
+// One player's view of a MidiOutput shared by several players, all driven
+// from the engine thread. Messages pass straight through, except that:
+//
+//  - "all notes off" (CC123) becomes note-offs for the notes this player
+//    has sounding, so pausing or seeking one player leaves the others
+//    playing, and
+//  - channel volume (CC7) is scaled by the player's volume, so each player
+//    has its own level without touching the device volume.
+//
+// Players still share the output's 16 channels: a program change, pedal or
+// reset from one affects any other player on the same channel.
+class PlayerOutput : public MidiOutput {
+ public:
+  // |output| must outlive this object.
+  explicit PlayerOutput(MidiOutput* output);
+
+  // Disallow copy and assign.
+  PlayerOutput(const PlayerOutput&) = delete;
+  PlayerOutput& operator=(const PlayerOutput&) = delete;
+
+  // MidiOutput:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override;
+  void SendSysEx(const uint8_t* data, size_t size) override;
+  // Re-sends the scaled channel volume on every channel this player uses.
+  void SetVolume(double volume) override;
+
+  double volume() const { return volume_; }
+
+ private:
+  void SendVolume(int channel);
+  void ReleaseNotes(int channel);
+
+  MidiOutput* output_;
+  double volume_;
+  // Bit c set: the player has sent something on channel c.
+  uint16_t used_channels_;
+  // Unscaled CC7 per channel, as the file set it.
+  uint8_t channel_volume_[kMidiChannelCount];
+  // Bit k of word k / 64: key k is sounding.
+  uint64_t sounding_[kMidiChannelCount][2];
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_PLAYER_OUTPUT_H_
@@ -0,0 +1,73 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQLOCK_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQLOCK_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace playmidifile {
+
+// Publishes a small trivially copyable value from one writer thread to any
+// number of readers. Writes never wait; reads take no lock, never allocate
+// and only retry while a write is in progress, which for a few words is a
+// handful of nanoseconds.
+//
+// The value lives in relaxed atomic words rather than plain memory, so a
+// read racing a write is well-defined: the reader notices the sequence
+// change and tries again.
+template <typename T>
+class Seqlock {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "Seqlock values are copied word by word");
+
+ public:
+  explicit Seqlock(const T& value = T()) : sequence_(0) { Store(value); }
+
+  // Disallow copy and assign.
+  Seqlock(const Seqlock&) = delete;
+  Seqlock& operator=(const Seqlock&) = delete;
+
+  // Writer side; only ever from one thread at a time.
+  void Store(const T& value) {
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &value, sizeof(T));
+    uint32_t sequence = sequence_.load(std::memory_order_relaxed);
+    // Odd while the words are being changed.
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  // Any thread.
+  T Load() const {
+    uint64_t words[kWords];
+    uint32_t before;
+    uint32_t after;
+    do {
+      before = sequence_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < kWords; ++i) {
+        words[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      after = sequence_.load(std::memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    T value;
+    std::memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+ private:
+  static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+  std::atomic<uint32_t> sequence_;
+  std::atomic<uint64_t> words_[kWords];
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQLOCK_H_
@@ -0,0 +1,158 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "midi_engine/arena.h"
+#include "midi_engine/channel_state.h"
+#include "midi_engine/midi_file.h"
+#include "midi_engine/smf_parser.h"
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+class ThreadPool;
+
+// One playable event, as handed to the scheduler.
+struct SequenceEvent {
+  uint32_t tick;
+  // Channel status byte, or 0xF0/0xF7 for system exclusive.
+  uint8_t status;
+  uint8_t data1;
+  uint8_t data2;
+  // System exclusive only: where its wire bytes are in the owner's payload
+  // storage.
+  uint32_t payload_offset;
+  uint32_t payload_size;
+};
+
+// All tracks of a file merged into a single time-ordered list of events the
+// sequencer can play. Self-contained: it does not reference the source file
+// after compilation, so it can outlive the mapping.
+//
+// Events are stored as two parallel arrays, the absolute ticks and the
+// packed messages, for 8 bytes per event. A sysex event's message word
+// holds an index into a side table of payloads instead of data bytes.
+// Scanning in order touches both arrays linearly.
+//
+// Compilation also snapshots the channel state every |checkpoint_interval|
+// events, so restoring the state at any point replays at most that many
+// events instead of the whole file.
+//
+// Everything the sequence owns (event arrays, payloads, tempo map and
+// checkpoints) is sized exactly after decoding and carved out of a single
+// arena chunk, so a sequence costs one heap block and is freed in one go.
+class Sequence {
+ public:
+  static constexpr size_t kDefaultCheckpointInterval = 1024;
+
+  // Merges the tracks of |file|. Events at the same tick keep track order,
+  // then file order. A |checkpoint_interval| of 0 disables checkpoints.
+  // With a |pool| the tracks are decoded in parallel before a k-way merge;
+  // the result is the same either way. Returns null if |cancel| is set
+  // part way through, which is checked every few thousand events.
+  static std::shared_ptr<const Sequence> Compile(
+      const MidiFile& file,
+      size_t checkpoint_interval = kDefaultCheckpointInterval,
+      ThreadPool* pool = nullptr,
+      const std::atomic<bool>* cancel = nullptr);
+
+  // Disallow copy and assign.
+  Sequence(const Sequence&) = delete;
+  Sequence& operator=(const Sequence&) = delete;
+
+  size_t event_count() const { return ticks_.size(); }
+  uint32_t tick(size_t index) const { return ticks_[index]; }
+  // Event |index| unpacked.
+  SequenceEvent event(size_t index) const {
+    uint32_t message = messages_[index];
+    SequenceEvent event = {ticks_[index], static_cast<uint8_t>(message),
+                           0, 0, 0, 0};
+    if (event.status >= 0xF0) {
+      const PayloadRef& ref = payload_refs_[message >> 8];
+      event.payload_offset = ref.offset;
+      event.payload_size = ref.size;
+    } else {
+      event.data1 = static_cast<uint8_t>(message >> 8);
+      event.data2 = static_cast<uint8_t>(message >> 16);
+    }
+    return event;
+  }
+  const uint8_t* payload(const SequenceEvent& event) const {
+    return payloads_.data() + event.payload_offset;
+  }
+
+  uint32_t end_tick() const { return end_tick_; }
+  uint64_t duration_us() const { return duration_us_; }
+  uint32_t duration_ms() const {
+    return static_cast<uint32_t>(duration_us_ / 1000);
+  }
+  const TempoMap& tempo_map() const { return tempo_map_; }
+
+  // Stores in |state| the channel state in effect just before the event at
+  // |event_index| (or after the last event if it is past the end).
+  void StateAt(size_t event_index, ChannelStateSet* state) const;
+
+  size_t checkpoint_count() const { return checkpoints_.size(); }
+
+  // Approximate bytes held by the sequence, including its heap storage.
+  size_t memory_bytes() const;
+  // Heap blocks holding the sequence's storage; 1 unless it is empty.
+  size_t heap_blocks() const { return arena_.chunk_count(); }
+
+ private:
+  struct PayloadRef {
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  // One track's events in the packed layout, before merging. A sysex
+  // message word indexes the track's own |payload_refs|.
+  struct DecodedTrack {
+    std::vector<uint32_t> ticks;
+    std::vector<uint32_t> messages;
+    std::vector<PayloadRef> payload_refs;
+    std::vector<uint8_t> payloads;
+  };
+
+  Sequence();
+
+  // Both return false if |cancel| was set.
+  static bool DecodeTrack(const SmfTrack& track,
+                          const std::atomic<bool>* cancel,
+                          DecodedTrack* decoded);
+  // Sizes the arena and every array for |tracks| and copies in
+  // |tempo_map|, so nothing allocates after it.
+  void ReserveStorage(const std::vector<DecodedTrack>& tracks,
+                      const TempoMap& tempo_map);
+  // Merges |tracks| into the event arrays, consuming their payloads.
+  bool Merge(std::vector<DecodedTrack>* tracks,
+             const std::atomic<bool>* cancel);
+
+  // Folds the channel messages of events [begin, end) into |state|.
+  void Replay(size_t begin, size_t end, ChannelStateSet* state) const;
+  void BuildCheckpoints();
+
+  // First, so it outlives everything stored in it.
+  Arena arena_;
+  ArenaVector<uint32_t> ticks_;
+  // status | data1 << 8 | data2 << 16, or for sysex
+  // status | payload_refs_ index << 8.
+  ArenaVector<uint32_t> messages_;
+  ArenaVector<PayloadRef> payload_refs_;
+  ArenaVector<uint8_t> payloads_;
+  TempoMap tempo_map_;
+  // checkpoints_[i] is the state before event i * checkpoint_interval_.
+  ArenaVector<ChannelStateSet> checkpoints_;
+  size_t checkpoint_interval_ = 0;
+  uint32_t end_tick_ = 0;
+  uint64_t duration_us_ = 0;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_H_
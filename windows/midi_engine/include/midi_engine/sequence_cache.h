@@ -0,0 +1,108 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_CACHE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_CACHE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "midi_engine/sequence.h"
+#include "midi_engine/thread_pool.h"
+
+namespace playmidifile {
+
+struct SequenceCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  // Entries dropped to stay within the budget. Entries replaced because
+  // their file changed are not counted.
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
+  size_t budget_bytes = 0;
+};
+
+// Least-recently-used cache of compiled sequences, bounded by the memory
+// they hold (Sequence::memory_bytes()). Files are keyed by canonical path,
+// and an entry is only used while the file's size and modification time
+// are unchanged, so an edited file is parsed again. In-memory data is keyed
+// by a hash of its contents.
+//
+// Thread-safe: the engine thread loads through it while the platform
+// thread reads the stats or changes the budget. Parsing happens outside
+// the lock, with the tracks of a file decoded in parallel on the cache's
+// thread pool.
+class SequenceCache {
+ public:
+  static constexpr size_t kDefaultBudgetBytes = 64 * 1024 * 1024;
+
+  static constexpr char kCancelledError[] = "Load cancelled";
+  // Up to this many threads decode a file's tracks.
+  static constexpr int kMaxCompileThreads = 8;
+
+  // |compile_threads| of 0 picks the hardware concurrency, up to
+  // kMaxCompileThreads.
+  explicit SequenceCache(size_t budget_bytes = kDefaultBudgetBytes,
+                         int compile_threads = 0);
+  ~SequenceCache();
+
+  // Disallow copy and assign.
+  SequenceCache(const SequenceCache&) = delete;
+  SequenceCache& operator=(const SequenceCache&) = delete;
+
+  // Returns the compiled sequence for |utf8_path|, parsing and caching it on
+  // a miss. Returns null and fills |error| (as MidiFile::Open() does) on
+  // failure, or with kCancelledError if |cancel| was set during parsing. A
+  // sequence larger than the whole budget is returned but not kept.
+  std::shared_ptr<const Sequence> Load(
+      const std::string& utf8_path, std::string* error,
+      const std::atomic<bool>* cancel = nullptr);
+  // As Load(), for a file held in memory. |data| is parsed in place and
+  // not referenced afterwards.
+  std::shared_ptr<const Sequence> LoadBytes(
+      const uint8_t* data, size_t size, std::string* error,
+      const std::atomic<bool>* cancel = nullptr);
+
+  // Evicts least recently used entries until the rest fit. 0 disables
+  // caching.
+  void SetBudget(size_t budget_bytes);
+  void Clear();
+
+  SequenceCacheStats stats() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    uint64_t size;
+    int64_t mtime;
+    std::shared_ptr<const Sequence> sequence;
+    size_t bytes;
+  };
+  using EntryList = std::list<Entry>;
+
+  // Returns the entry for |key| if it matches |size| and |mtime|, dropping
+  // a stale one. Counts the hit or miss.
+  std::shared_ptr<const Sequence> Find(const std::string& key, uint64_t size,
+                                       int64_t mtime);
+  void Insert(const std::string& key, uint64_t size, int64_t mtime,
+              const std::shared_ptr<const Sequence>& sequence);
+
+  // Both require |mutex_|.
+  void Remove(EntryList::iterator entry);
+  void EvictToBudget();
+
+  mutable std::mutex mutex_;
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+  SequenceCacheStats stats_;
+  ThreadPool pool_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_CACHE_H_
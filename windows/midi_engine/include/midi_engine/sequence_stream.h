@@ -0,0 +1,147 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_STREAM_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_STREAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/channel_state.h"
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/smf_parser.h"
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+// Plays a Standard MIDI File straight from disk, decoding its tracks a
+// window at a time just ahead of the playhead instead of compiling the
+// whole file first. Each track is read through a small buffer and the
+// tracks are merged on the fly, so memory stays the same whatever the
+// length of the file, apart from the tempo map and checkpoints, and
+// playback can start as soon as the first window is decoded.
+//
+// Open() still makes one decode-only pass to find the length and the tempo
+// map. Every |checkpoint_interval| events that pass also records where each
+// track is in the file and the channel state, so seeking re-decodes from
+// the nearest checkpoint rather than from the start of the file.
+//
+// Events come out in the same order as from Sequence::Compile().
+class SequenceStream : public EventCursor {
+ public:
+  static constexpr size_t kDefaultWindowEvents = 4096;
+  static constexpr size_t kDefaultTrackBufferBytes = 16 * 1024;
+  static constexpr size_t kDefaultCheckpointInterval = 4096;
+
+  // Opens and scans |utf8_path|. Returns null and fills |error| on failure.
+  // |window_events| is the number of events decoded ahead; a track buffer
+  // only grows past |track_buffer_bytes| to hold a single larger event.
+  // A |checkpoint_interval| of 0 disables checkpoints.
+  static std::unique_ptr<SequenceStream> Open(
+      const std::string& utf8_path, std::string* error,
+      size_t window_events = kDefaultWindowEvents,
+      size_t track_buffer_bytes = kDefaultTrackBufferBytes,
+      size_t checkpoint_interval = kDefaultCheckpointInterval);
+  ~SequenceStream() override;
+
+  // Disallow copy and assign.
+  SequenceStream(const SequenceStream&) = delete;
+  SequenceStream& operator=(const SequenceStream&) = delete;
+
+  // EventCursor:
+  uint64_t duration_us() const override { return duration_us_; }
+  const SequenceEvent* Peek(uint64_t* micros) override;
+  const uint8_t* Payload(const SequenceEvent& event) const override;
+  void Advance() override;
+  void Seek(uint64_t position_us, ChannelStateSet* state) override;
+
+  uint32_t end_tick() const { return end_tick_; }
+  uint32_t duration_ms() const {
+    return static_cast<uint32_t>(duration_us_ / 1000);
+  }
+  const TempoMap& tempo_map() const { return tempo_map_; }
+  size_t checkpoint_count() const { return checkpoints_.size(); }
+
+  // Approximate bytes held, including heap storage. Independent of the
+  // file length except for the tempo map and checkpoints.
+  size_t memory_bytes() const;
+
+ private:
+  struct Track;
+
+  // Where decoding of one track resumes: the body offset of its next event,
+  // with the running status and tick before it.
+  struct TrackPosition {
+    uint64_t offset = 0;
+    uint32_t tick = 0;
+    uint8_t running_status = 0;
+    bool done = false;
+  };
+
+  // The state before a playable event, which is at |tick|.
+  struct Checkpoint {
+    uint32_t tick;
+    ChannelStateSet state;
+  };
+
+  SequenceStream(size_t window_events, size_t track_buffer_bytes,
+                 size_t checkpoint_interval);
+
+  // Locates the track chunks, then decodes everything once, in playing
+  // order, for the end tick, tempo changes and checkpoints.
+  bool Scan(std::string* error);
+  // Records the state before the next event as a checkpoint.
+  void AddCheckpoint(uint32_t tick, const ChannelStateSet& state);
+  // Puts every track back at its first playable event.
+  void Rewind();
+  // Puts every track back where checkpoint |index| found it.
+  void Restore(size_t index);
+  // Restarts |track| from |position| at its next playable event.
+  void Resume(Track* track, const TrackPosition& position);
+  // Empties the window, before decoding from a new place.
+  void ResetWindow();
+  // Decodes the next event of |track|, meta events included, reading more
+  // of the file as needed. Returns false at its end.
+  bool Fetch(Track* track);
+  // Fetch() that skips meta events, which are not played.
+  void FetchPlayable(Track* track);
+  // Moves the undecoded bytes of |track| to the front of its buffer and
+  // fills the rest from the file.
+  bool ReadMore(Track* track);
+  // Removes the earliest pending event of all tracks into |event|, copying
+  // a sysex payload into |window_payloads_|. Returns false once every track
+  // is exhausted.
+  bool TakeNext(SequenceEvent* event);
+  // Decodes the next window of events.
+  void Refill();
+
+  const size_t window_capacity_;
+  const size_t track_buffer_bytes_;
+  const size_t checkpoint_interval_;
+  std::FILE* file_;
+  SmfHeader header_;
+  std::vector<std::unique_ptr<Track>> tracks_;
+  TempoMap tempo_map_;
+  TempoMap::Cursor tempo_cursor_;
+  uint32_t end_tick_;
+  uint64_t duration_us_;
+
+  // checkpoints_[i] was taken before event (i + 1) * checkpoint_interval_;
+  // its track positions are checkpoint_tracks_[i * tracks_.size()] on.
+  std::vector<Checkpoint> checkpoints_;
+  std::vector<TrackPosition> checkpoint_tracks_;
+
+  // Decoded events not played yet, from |window_position_|. Sysex payloads
+  // live in |window_payloads_| until the next refill.
+  std::vector<SequenceEvent> window_;
+  std::vector<uint8_t> window_payloads_;
+  size_t window_position_;
+  uint64_t next_event_us_;
+  bool next_event_us_valid_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQUENCE_STREAM_H_
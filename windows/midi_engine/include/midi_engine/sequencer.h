@@ -0,0 +1,95 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/playback_stats.h"
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+
+// Plays a compiled Sequence, or any other EventCursor, against a wall
+// clock. Playback is anchored to a (wall time, song time) pair and every
+// event deadline is computed from that anchor, so timing does not drift
+// however long the piece runs. The speed factor is applied when deadlines
+// are computed; changing it re-anchors at the current position and takes
+// effect from the next event.
+//
+// Not thread-safe: the owner (the engine thread) calls everything.
+class Sequencer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit Sequencer(MidiOutput* output);
+
+  // Disallow copy and assign.
+  Sequencer(const Sequencer&) = delete;
+  Sequencer& operator=(const Sequencer&) = delete;
+
+  // Replaces the sequence and rewinds to the start, stopped.
+  void Load(std::shared_ptr<const Sequence> sequence);
+  // Plays from |events| instead, which starts at its first event.
+  void Load(std::unique_ptr<EventCursor> events);
+  void Unload();
+
+  // Queues |next| to take over on the exact deadline the current events
+  // end, so back-to-back pieces play without a gap. Replaces any earlier
+  // chained piece; null drops it. Load() and Unload() drop it too.
+  void Chain(std::shared_ptr<const Sequence> next);
+  void Chain(std::unique_ptr<EventCursor> next);
+  // True once after playback moved on to a chained piece.
+  bool TakeTransition();
+  bool chained() const { return next_ != nullptr; }
+
+  // Records how late each event is sent into |stats|, which must outlive
+  // the sequencer. Null stops recording.
+  void set_stats(PlaybackStats* stats) { stats_ = stats; }
+
+  // Starts or resumes at the current position. No-op if already running.
+  void Play(Clock::time_point now);
+  // Freezes the position and silences sounding notes.
+  void Pause(Clock::time_point now);
+  // Moves to |position_us| (song time) and restores the controller state in
+  // effect there. Keeps running if it was running.
+  void Seek(uint64_t position_us, Clock::time_point now);
+  // |speed| is a playback rate multiplier (1.0 is the file's tempo).
+  void SetSpeed(double speed, Clock::time_point now);
+
+  // Sends every event due at |now| and returns the deadline of the next one,
+  // or Clock::time_point::max() when stopped or finished.
+  Clock::time_point Dispatch(Clock::time_point now);
+
+  // Song position in microseconds at |now|.
+  uint64_t PositionUs(Clock::time_point now) const;
+
+  bool running() const { return running_; }
+  // True once playback ran past the end of the sequence.
+  bool finished() const { return finished_; }
+  double speed() const { return speed_; }
+  bool loaded() const { return events_ != nullptr; }
+
+ private:
+  Clock::time_point DeadlineFor(uint64_t song_us) const;
+  void Send(const SequenceEvent& event);
+
+  MidiOutput* output_;
+  PlaybackStats* stats_;
+  std::unique_ptr<EventCursor> events_;
+  std::unique_ptr<EventCursor> next_;
+  bool running_;
+  bool transitioned_;
+  bool finished_;
+  double speed_;
+  // Song time |anchor_song_us_| plays at wall time |anchor_wall_|.
+  uint64_t anchor_song_us_;
+  Clock::time_point anchor_wall_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_H_
@@ -0,0 +1,56 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_BACKEND_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_BACKEND_H_
+
+#include <memory>
+#include <string>
+
+#include "midi_engine/midi_output.h"
+#include "midi_engine/playback_backend.h"
+#include "midi_engine/sequencer.h"
+
+namespace playmidifile {
+
+// Plays files with the in-process Sequencer into a MidiOutput. Unlike a
+// device sequencer it supports speed changes and reports exact positions.
+class SequencerBackend : public PlaybackBackend {
+ public:
+  // |output| must outlive the backend.
+  explicit SequencerBackend(MidiOutput* output);
+  // Owns |output|, e.g. a PlayerOutput in front of a shared device.
+  explicit SequencerBackend(std::unique_ptr<MidiOutput> output);
+  ~SequencerBackend() override;
+
+  // Disallow copy and assign.
+  SequencerBackend(const SequencerBackend&) = delete;
+  SequencerBackend& operator=(const SequencerBackend&) = delete;
+
+  bool Open(const std::string& path, std::shared_ptr<const Sequence> sequence,
+            std::string* error) override;
+  bool OpenStream(const std::string& path, std::unique_ptr<EventCursor> events,
+                  std::string* error) override;
+  bool CanStream() const override { return true; }
+  void Close() override;
+  bool Chain(const std::string& path, std::shared_ptr<const Sequence> next,
+             std::string* error) override;
+  bool TakeTransition() override { return sequencer_.TakeTransition(); }
+  bool Play(std::string* error) override;
+  bool Pause(std::string* error) override;
+  bool Stop(std::string* error) override;
+  bool Seek(uint32_t position_ms, std::string* error) override;
+  void SetVolume(double volume) override;
+  bool SetSpeed(double speed) override;
+  uint32_t PositionMs() override;
+  void SetStats(PlaybackStats* stats) override { sequencer_.set_stats(stats); }
+  Clock::time_point Service(Clock::time_point now, bool* finished) override;
+
+  const Sequencer& sequencer() const { return sequencer_; }
+
+ private:
+  std::unique_ptr<MidiOutput> owned_output_;
+  MidiOutput* output_;
+  Sequencer sequencer_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SEQUENCER_BACKEND_H_
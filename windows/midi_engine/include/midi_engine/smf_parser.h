@@ -0,0 +1,102 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SMF_PARSER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SMF_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace playmidifile {
+
+// Meta event types the engine interprets. Everything else is passed through.
+constexpr uint8_t kMetaEndOfTrack = 0x2F;
+constexpr uint8_t kMetaTempo = 0x51;
+constexpr uint8_t kMetaTimeSignature = 0x58;
+
+// Default tempo when a file has no tempo event (120 BPM).
+constexpr uint32_t kDefaultMicrosPerQuarter = 500000;
+
+enum class MidiEventType : uint8_t {
+  kChannel,
+  kSysEx,
+  kMeta,
+};
+
+// One decoded track event. Sysex and meta payloads point into the source
+// buffer, so an event is only valid while that buffer is alive.
+struct MidiEvent {
+  uint32_t delta_ticks;
+  MidiEventType type;
+  // Channel status (0x80-0xEF, running status already resolved), 0xF0/0xF7
+  // for sysex, or 0xFF for meta events.
+  uint8_t status;
+  // First data byte for channel events, the meta type for meta events.
+  uint8_t data1;
+  // Second data byte for channel events; 0 for one-byte messages.
+  uint8_t data2;
+  const uint8_t* payload;
+  uint32_t payload_size;
+};
+
+struct SmfHeader {
+  uint16_t format;
+  uint16_t track_count;
+  // Raw division word: ticks per quarter note, or SMPTE timing when the high
+  // bit is set.
+  uint16_t division;
+
+  bool is_smpte() const { return (division & 0x8000) != 0; }
+};
+
+// View of one MTrk chunk body inside the source buffer.
+struct SmfTrack {
+  const uint8_t* data;
+  size_t size;
+};
+
+struct SmfFile {
+  SmfHeader header;
+  std::vector<SmfTrack> tracks;
+};
+
+// Validates the header and locates every track chunk of a Standard MIDI File
+// (format 0 or 1). Nothing is copied; |file| refers into |data|. On failure
+// returns false and fills |error|.
+bool ParseSmf(const uint8_t* data, size_t size, SmfFile* file,
+              std::string* error);
+
+// Sequentially decodes the events of one track, resolving running status.
+// Decoding stops at the end-of-track meta event or at the end of the chunk.
+class TrackReader {
+ public:
+  explicit TrackReader(const SmfTrack& track);
+  // Resumes decoding part way through a track, where a previous reader
+  // left off with |running_status|.
+  TrackReader(const SmfTrack& track, uint8_t running_status);
+
+  // Decodes the next event into |event|. Returns false at the end of the
+  // track or when the data is malformed (see failed()).
+  bool Next(MidiEvent* event);
+
+  bool failed() const { return failed_; }
+  // True once the end-of-track event or the end of the data was reached.
+  bool finished() const { return finished_; }
+  uint8_t running_status() const { return running_status_; }
+
+  // Offset of the next undecoded byte from the start of the track.
+  size_t offset() const { return static_cast<size_t>(cursor_ - begin_); }
+
+ private:
+  bool ReadVarLen(uint32_t* value);
+
+  const uint8_t* begin_;
+  const uint8_t* cursor_;
+  const uint8_t* end_;
+  uint8_t running_status_;
+  bool finished_;
+  bool failed_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SMF_PARSER_H_
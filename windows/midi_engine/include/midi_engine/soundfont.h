@@ -0,0 +1,149 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/mapped_file.h"
+
+namespace playmidifile {
+
+// Sample loop behaviour (SF2 generator 54).
+enum class LoopMode : uint8_t {
+  kNone = 0,
+  kContinuous = 1,
+  // Loops while the key is held, then plays on to the end of the sample.
+  kUntilRelease = 3,
+};
+
+// Volume envelope times in timecents and sustain in centibels of
+// attenuation, as stored in the file.
+struct VolumeEnvelope {
+  int16_t delay = -12000;
+  int16_t attack = -12000;
+  int16_t hold = -12000;
+  int16_t decay = -12000;
+  int16_t sustain = 0;
+  int16_t release = -12000;
+};
+
+// One playable zone with the preset and instrument levels already combined:
+// instrument generators are absolute, preset generators add to them, and
+// key/velocity ranges are intersected.
+struct SoundFontRegion {
+  uint8_t key_low = 0;
+  uint8_t key_high = 127;
+  uint8_t velocity_low = 0;
+  uint8_t velocity_high = 127;
+
+  // Absolute frame indices into SoundFont::samples(), address offsets
+  // applied. Loop points are [loop_start, loop_end).
+  uint32_t start = 0;
+  uint32_t end = 0;
+  uint32_t loop_start = 0;
+  uint32_t loop_end = 0;
+  uint32_t sample_rate = 44100;
+  LoopMode loop_mode = LoopMode::kNone;
+
+  // Key at which the sample plays unshifted.
+  int16_t root_key = 60;
+  // Cents per key; 100 is equal temperament.
+  int16_t scale_tuning = 100;
+  // Coarse and fine tune plus the sample's pitch correction, in cents.
+  int16_t tune = 0;
+  // Centibels.
+  int16_t attenuation = 0;
+  // -500 (left) to 500 (right), in 0.1% units.
+  int16_t pan = 0;
+  // Non-zero: a new note cuts off sounding notes of the same class on the
+  // channel (e.g. open and closed hi-hat).
+  uint16_t exclusive_class = 0;
+  VolumeEnvelope envelope;
+
+  bool Matches(uint8_t key, uint8_t velocity) const {
+    return key >= key_low && key <= key_high && velocity >= velocity_low &&
+           velocity <= velocity_high;
+  }
+};
+
+struct SoundFontPreset {
+  std::string name;
+  uint16_t bank = 0;
+  uint16_t program = 0;
+  std::vector<SoundFontRegion> regions;
+};
+
+// A parsed SoundFont 2 bank. Modulators in the file are ignored; the
+// synthesizer applies the standard default modulators (velocity, volume,
+// expression and pan) itself.
+//
+// A bank opened from disk stays memory-mapped and its sample data, nearly
+// all of the file, is played in place: opening reads only the preset
+// tables, and the samples of a preset are paged in by PrepareSamples()
+// before anything plays it, off the audio thread. Safe to share between
+// threads.
+class SoundFont {
+ public:
+  // Parses the .sf2 file at |utf8_path|. Returns null and fills |error| on
+  // failure.
+  static std::unique_ptr<SoundFont> Open(const std::string& utf8_path,
+                                         std::string* error);
+  // Parses an in-memory image of an .sf2 file. The sample data is copied,
+  // so |data| is not referenced afterwards.
+  static std::unique_ptr<SoundFont> Parse(const uint8_t* data, size_t size,
+                                          std::string* error);
+
+  // Disallow copy and assign.
+  SoundFont(const SoundFont&) = delete;
+  SoundFont& operator=(const SoundFont&) = delete;
+
+  // Exact match, else the same program in bank 0 (or bank 128 for
+  // percussion), else the first preset. Null only for an empty bank.
+  const SoundFontPreset* FindPreset(uint16_t bank, uint16_t program) const;
+
+  // Pages in the sample data |preset| plays, the first time it is called
+  // for that preset, so its notes do not stall on disk reads. A no-op for
+  // presets already prepared and for banks held in memory. Blocks on the
+  // disk, so never call it on the audio thread.
+  void PrepareSamples(const SoundFontPreset& preset) const;
+  // Whether PrepareSamples() has finished for |preset|, or the bank is in
+  // memory. Does not block.
+  bool samples_prepared(const SoundFontPreset& preset) const;
+
+  const std::vector<SoundFontPreset>& presets() const { return presets_; }
+  // Mono 16-bit sample data of all samples, sample_count() frames.
+  const int16_t* samples() const { return samples_; }
+  size_t sample_count() const { return sample_count_; }
+  // True when the samples are read straight from the mapped file.
+  bool mapped() const { return mapping_.is_open(); }
+  // Presets PrepareSamples() has paged in.
+  size_t prepared_presets() const {
+    return prepared_count_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  SoundFont();
+
+  // With |borrow_samples| the sample data is used in place when its byte
+  // order and alignment allow, and |data| must outlive the font.
+  bool Load(const uint8_t* data, size_t size, bool borrow_samples,
+            std::string* error);
+
+  MappedFile mapping_;
+  std::vector<SoundFontPreset> presets_;
+  // Either into |mapping_| or |sample_copy_|.
+  const int16_t* samples_;
+  size_t sample_count_;
+  std::vector<int16_t> sample_copy_;
+  // One flag per preset.
+  std::unique_ptr<std::atomic<bool>[]> prepared_;
+  mutable std::atomic<size_t> prepared_count_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_H_
@@ -0,0 +1,56 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_CACHE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "midi_engine/soundfont.h"
+
+namespace playmidifile {
+
+// Shares opened SoundFonts between everything that plays them, so every
+// player and render using one bank maps it once and pages each preset in
+// once. Entries are weak: a bank is closed (and its mapping dropped) as
+// soon as its last user lets go, and the next Open() maps it afresh.
+// Banks are keyed like SequenceCache keys files, by canonical path, size
+// and modification time, so an edited file is opened again.
+//
+// Thread-safe. Opening happens outside the lock.
+class SoundFontCache {
+ public:
+  SoundFontCache();
+  ~SoundFontCache();
+
+  // Disallow copy and assign.
+  SoundFontCache(const SoundFontCache&) = delete;
+  SoundFontCache& operator=(const SoundFontCache&) = delete;
+
+  // Returns the open bank for |utf8_path|, opening it if no one holds it.
+  // Returns null and fills |error| (as SoundFont::Open() does) on failure.
+  std::shared_ptr<const SoundFont> Open(const std::string& utf8_path,
+                                        std::string* error);
+
+  // Banks currently held by someone.
+  size_t open_fonts() const;
+
+ private:
+  struct Entry {
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    std::weak_ptr<const SoundFont> font;
+  };
+
+  // Requires |mutex_|.
+  void DropExpired();
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SOUNDFONT_CACHE_H_
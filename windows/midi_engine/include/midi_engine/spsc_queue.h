@@ -0,0 +1,94 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SPSC_QUEUE_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace playmidifile {
+
+// Bounded lock-free ring for exactly one producer thread and one consumer
+// thread. Each side only writes its own index and keeps a cached copy of the
+// other side's, so the common path touches no shared cache line.
+template <typename T>
+class SpscQueue {
+ public:
+  // |capacity| is rounded up to a power of two.
+  explicit SpscQueue(size_t capacity)
+      : capacity_(RoundUpToPowerOfTwo(capacity < 2 ? 2 : capacity)),
+        mask_(capacity_ - 1),
+        slots_(new T[capacity_]),
+        head_(0),
+        cached_tail_(0),
+        tail_(0),
+        cached_head_(0) {}
+
+  // Disallow copy and assign.
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  // Producer side. Returns false if the queue is full; |value| is left
+  // untouched in that case.
+  bool TryPush(T&& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - cached_head_ == capacity_) {
+      cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - cached_head_ == capacity_) {
+        return false;
+      }
+    }
+    slots_[tail & mask_] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side. Returns false if the queue is empty.
+  bool TryPop(T* value) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == cached_tail_) {
+      cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == cached_tail_) {
+        return false;
+      }
+    }
+    *value = std::move(slots_[head & mask_]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Number of queued items. Exact only when called from one of the two
+  // participating threads while the other is idle.
+  size_t SizeApprox() const {
+    return tail_.load(std::memory_order_acquire) -
+           head_.load(std::memory_order_acquire);
+  }
+
+  size_t capacity() const { return capacity_; }
+
+ private:
+  static constexpr size_t kCacheLineSize = 64;
+
+  static size_t RoundUpToPowerOfTwo(size_t value) {
+    size_t result = 1;
+    while (result < value) {
+      result <<= 1;
+    }
+    return result;
+  }
+
+  const size_t capacity_;
+  const size_t mask_;
+  std::unique_ptr<T[]> slots_;
+
+  // Consumer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> head_;
+  size_t cached_tail_;
+  // Producer-owned.
+  alignas(kCacheLineSize) std::atomic<size_t> tail_;
+  size_t cached_head_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SPSC_QUEUE_H_
@@ -0,0 +1,49 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SYNTH_KERNELS_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SYNTH_KERNELS_H_
+
+#include <cstddef>
+
+namespace playmidifile {
+
+// Instruction sets the synthesizer's block kernels are built for, in order
+// of preference.
+enum class SimdLevel {
+  kScalar,
+  kSse2,
+  kAvx2,
+};
+
+// The per-voice inner loops of Synthesizer::Render(), each over a whole
+// block of one voice. Every variant does exactly the same float operations
+// per sample, in the same order and without fused multiply-adds, so all of
+// them produce bit-identical output; they only differ in how many samples
+// they do at once.
+struct SynthKernels {
+  SimdLevel level;
+  const char* name;
+
+  // out[i] = (s0[i] + fraction[i] * (s1[i] - s0[i])) * scale: linear
+  // interpolation between the two sample frames around each position.
+  void (*interpolate)(const float* s0, const float* s1, const float* fraction,
+                      float scale, float* out, size_t frames);
+  // samples[i] *= envelope[i].
+  void (*apply_envelope)(float* samples, const float* envelope,
+                         size_t frames);
+  // Pans mono |samples| and adds them to interleaved stereo |output|.
+  void (*mix_stereo)(const float* samples, float left_gain, float right_gain,
+                     float* output, size_t frames);
+};
+
+// The best level this CPU (and OS) supports; detected once.
+SimdLevel DetectSimdLevel();
+
+// Whether |level| can run here. kScalar always can; the vector levels need
+// an x86-64 build and the matching CPU features.
+bool IsSimdLevelSupported(SimdLevel level);
+
+// Kernels for |level|, which must be supported.
+const SynthKernels& GetSynthKernels(SimdLevel level);
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SYNTH_KERNELS_H_
@@ -0,0 +1,179 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "midi_engine/channel_state.h"
+#include "midi_engine/midi_output.h"
+#include "midi_engine/soundfont.h"
+#include "midi_engine/synth_kernels.h"
+
+namespace playmidifile {
+
+class Sequence;
+
+// Sample-based General MIDI synthesizer playing a SoundFont. It is a
+// MidiOutput, so the sequencer drives it like a device; Render() then mixes
+// the sounding voices into float PCM.
+//
+// Per voice: linear-interpolated sample playback with loop points, the
+// SF2 volume envelope (delay, attack, hold, decay, sustain, release), and
+// the default modulators for velocity, volume (CC7), expression (CC11) and
+// pan (CC10). Pitch bend honours RPN 0 (bend range). Filters, LFOs and the
+// modulation envelope are not implemented.
+//
+// The voice pool is allocated once, at construction, with room for
+// |polyphony| voices. When every voice is busy a note steals one: a voice
+// already in its release tail first, then the quietest, then the oldest.
+// Neither messages nor Render() allocate, lock or touch the disk, so both
+// are safe to call from an audio callback. The samples of a mapped bank are
+// paged in beforehand, by PrepareSamples() off the audio thread; a preset
+// selected without that plays still, but its notes may fault pages in.
+//
+// Render() works a block of one voice at a time: envelope levels and sample
+// frames are gathered first, then interpolation, envelope and pan/mix run
+// as vector kernels (see synth_kernels.h) chosen for the CPU at run time.
+//
+// Not thread-safe: messages and Render() must come from the same thread,
+// which is the engine thread when it renders between dispatches.
+class Synthesizer : public MidiOutput {
+ public:
+  static constexpr int kDefaultPolyphony = 128;
+
+  // Pages in the samples of every preset |sequence| can select, as the
+  // synthesizer resolves its bank selects and program changes, and those
+  // of the default programs. Blocks on the disk: call it off the audio
+  // thread before the sequence plays.
+  static void PrepareSamples(const SoundFont& font, const Sequence& sequence);
+
+  Synthesizer(std::shared_ptr<const SoundFont> font, uint32_t sample_rate,
+              int polyphony = kDefaultPolyphony);
+  ~Synthesizer() override;
+
+  // Disallow copy and assign.
+  Synthesizer(const Synthesizer&) = delete;
+  Synthesizer& operator=(const Synthesizer&) = delete;
+
+  // MidiOutput:
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override;
+  void SendSysEx(const uint8_t* data, size_t size) override;
+  void SetVolume(double volume) override;
+
+  // Writes |frames| interleaved stereo frames to |output|.
+  void Render(float* output, size_t frames);
+
+  // Silences every voice and restores all controllers and programs.
+  void Reset();
+
+  // Selects the kernels Render() uses, by default the best the CPU
+  // supports. Every level renders bit-identical output; an unsupported one
+  // is ignored.
+  void SetSimdLevel(SimdLevel level);
+  SimdLevel simd_level() const { return kernels_->level; }
+
+  uint32_t sample_rate() const { return sample_rate_; }
+  int polyphony() const { return static_cast<int>(voices_.size()); }
+  int active_voices() const;
+  // Notes that started by cutting off a sounding voice.
+  uint64_t stolen_voices() const { return stolen_voices_; }
+  // Presets selected before their samples were prepared, whose first notes
+  // may wait on page faults.
+  uint64_t unprepared_presets() const { return unprepared_presets_; }
+
+ private:
+  struct Channel {
+    const SoundFontPreset* preset;
+    uint8_t bank;
+    uint8_t program;
+    uint8_t volume;
+    uint8_t expression;
+    uint8_t pan;
+    bool sustain;
+    // 14-bit, 8192 is centre.
+    uint16_t pitch_bend;
+    int bend_range_cents;
+    // Currently selected RPN; 0x3FFF when none.
+    uint16_t rpn;
+  };
+
+  enum class Stage : uint8_t {
+    kDelay,
+    kAttack,
+    kHold,
+    kDecay,
+    kSustain,
+    kRelease,
+  };
+
+  struct Voice {
+    const SoundFontRegion* region = nullptr;
+    bool active = false;
+    uint8_t channel = 0;
+    uint8_t key = 0;
+    uint8_t velocity = 0;
+    // Key released while the sustain pedal is down.
+    bool held_by_pedal = false;
+    bool released = false;
+    uint64_t id = 0;
+    // Position in the font's sample data, in frames.
+    double position = 0.0;
+    double step = 0.0;
+    float left_gain = 0.0f;
+    float right_gain = 0.0f;
+
+    Stage stage = Stage::kDelay;
+    float level = 0.0f;
+    // Samples left in a timed stage.
+    uint32_t stage_samples = 0;
+    // Per-sample level increment (attack) or multiplier (decay, release).
+    float attack_step = 0.0f;
+    float decay_factor = 1.0f;
+    float sustain_level = 1.0f;
+    float release_factor = 1.0f;
+  };
+
+  void NoteOn(int channel, uint8_t key, uint8_t velocity);
+  void NoteOff(int channel, uint8_t key);
+  void ControlChange(int channel, uint8_t control, uint8_t value);
+  void ReleaseVoice(Voice* voice);
+  void EnterStage(Voice* voice, Stage stage) const;
+  // Returns a free voice, or the one to steal when all are busy.
+  Voice* AllocateVoice();
+  void UpdatePitch(Voice* voice) const;
+  void UpdateGain(Voice* voice) const;
+  void UpdateChannelVoices(int channel, bool pitch, bool gain);
+  void ResetChannel(int channel);
+  // Points |channel| at the preset for its bank and program. Never pages
+  // samples in; only notes one that was not prepared.
+  void SelectPreset(int channel);
+  // Writes the envelope level of up to |frames| frames to |envelope| and
+  // advances it. Returns how many frames the voice lasts, which is fewer
+  // when it falls silent.
+  size_t AdvanceEnvelope(Voice* voice, float* envelope, size_t frames) const;
+  // Reads the sample frames either side of the position, and the fraction
+  // between them, for up to |frames| frames, then advances the position.
+  // Returns fewer than |frames| when the sample runs out.
+  size_t FetchSamples(Voice* voice, float* s0, float* s1, float* fraction,
+                      size_t frames) const;
+  void RenderVoice(Voice* voice, float* output, size_t frames);
+
+  std::shared_ptr<const SoundFont> font_;
+  uint32_t sample_rate_;
+  const SynthKernels* kernels_;
+  float master_gain_;
+  Channel channels_[kMidiChannelCount];
+  // Sized at construction and never resized.
+  std::vector<Voice> voices_;
+  // Start order of the next voice; the lowest live value is the oldest.
+  uint64_t next_voice_id_;
+  uint64_t stolen_voices_;
+  uint64_t unprepared_presets_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_H_
@@ -0,0 +1,65 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_BACKEND_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_BACKEND_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "midi_engine/playback_backend.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/synthesizer_mixer.h"
+
+namespace playmidifile {
+
+// Plays files as one part of a SynthesizerMixer, sequenced on the audio
+// render thread. The engine thread only queues commands, so the position
+// is kept by a clock of its own here, restarted by every command.
+class SynthesizerBackend : public PlaybackBackend {
+ public:
+  // |mixer| must outlive the backend. When the mixer has no part free,
+  // every command that needs one fails and the rest do nothing.
+  explicit SynthesizerBackend(SynthesizerMixer* mixer);
+  ~SynthesizerBackend() override;
+
+  // Disallow copy and assign.
+  SynthesizerBackend(const SynthesizerBackend&) = delete;
+  SynthesizerBackend& operator=(const SynthesizerBackend&) = delete;
+
+  bool Open(const std::string& path, std::shared_ptr<const Sequence> sequence,
+            std::string* error) override;
+  void Close() override;
+  bool Chain(const std::string& path, std::shared_ptr<const Sequence> next,
+             std::string* error) override;
+  bool TakeTransition() override;
+  bool Play(std::string* error) override;
+  bool Pause(std::string* error) override;
+  bool Stop(std::string* error) override;
+  bool Seek(uint32_t position_ms, std::string* error) override;
+  void SetVolume(double volume) override;
+  bool SetSpeed(double speed) override;
+  uint32_t PositionMs() override;
+  Clock::time_point Service(Clock::time_point now, bool* finished) override;
+
+  // The mixer part this backend plays, or -1 if all were taken.
+  int part() const { return part_; }
+
+ private:
+  uint64_t PositionUs(Clock::time_point now) const;
+  // Restarts the position clock from wherever it is now.
+  void Rebase(Clock::time_point now);
+
+  SynthesizerMixer* mixer_;
+  const int part_;
+  uint64_t duration_us_;
+  uint64_t chained_duration_us_;
+  uint64_t transitions_;
+  // Position at |anchor_|, and moving at |speed_| while |playing_|.
+  uint64_t position_us_;
+  Clock::time_point anchor_;
+  double speed_;
+  bool playing_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_BACKEND_H_
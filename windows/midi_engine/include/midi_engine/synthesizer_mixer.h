@@ -0,0 +1,190 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_MIXER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_MIXER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "midi_engine/audio_output.h"
+#include "midi_engine/event_cursor.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequencer.h"
+#include "midi_engine/soundfont.h"
+#include "midi_engine/spsc_queue.h"
+#include "midi_engine/synthesizer.h"
+#include "midi_engine/worker_thread.h"
+
+namespace playmidifile {
+
+// Plays up to kMaxParts sequences through the synthesizer, one part per
+// player, mixed on an AudioOutput's render thread. Each part is a Sequencer
+// and a Synthesizer of its own, clocked by the frames it renders instead of
+// the wall clock, so every event starts on its exact frame and each player
+// has its own voices, channels and volume.
+//
+// The engine thread controls parts through the methods below, which queue
+// commands to the render thread and never wait for it.
+//
+// Lead-in: with SetLeadInMs() above 0, every load and seek also has a
+// worker thread render the part's next few hundred milliseconds ahead of
+// time, with a copy of the part. When play() finds that lead-in ready, the
+// copy takes over as the live part and the pre-rendered audio goes straight
+// to the device as an AudioOutput overlay, so the first note is heard on
+// the next device period instead of after the ring's latency; the live
+// part joins in on the ring frame where the lead-in ends.
+class SynthesizerMixer : public AudioSource {
+ public:
+  static constexpr int kMaxParts = 64;
+
+  SynthesizerMixer(std::shared_ptr<const SoundFont> font, uint32_t sample_rate,
+                   int polyphony = Synthesizer::kDefaultPolyphony);
+  ~SynthesizerMixer() override;
+
+  // Disallow copy and assign.
+  SynthesizerMixer(const SynthesizerMixer&) = delete;
+  SynthesizerMixer& operator=(const SynthesizerMixer&) = delete;
+
+  // The output this mixer is the source of, for overlays and waking; call
+  // before it starts, and stop it before destroying the mixer. Without one
+  // lead-ins are not used.
+  void SetOutput(AudioOutput* output) { output_ = output; }
+
+  // Length of the lead-ins rendered from now on; 0 (the default) turns
+  // them off. A lead-in shorter than the ring cannot cover the ring's
+  // latency and is not rendered. Engine thread.
+  void SetLeadInMs(uint32_t lead_in_ms);
+  uint32_t lead_in_ms() const { return lead_in_ms_; }
+
+  // Engine thread. A part plays nothing until opened.
+  int AddPart();
+  void RemovePart(int part);
+  // Open() and Chain() page in the samples the sequence's programs play
+  // first (Synthesizer::PrepareSamples()), so the render thread never
+  // waits on the disk for them.
+  void Open(int part, std::shared_ptr<const Sequence> sequence);
+  void Close(int part);
+  // Queues |next| to follow the open sequence without a gap; null drops it.
+  void Chain(int part, std::shared_ptr<const Sequence> next);
+  void Play(int part);
+  void Pause(int part);
+  void Seek(int part, uint64_t position_us);
+  void SetSpeed(int part, double speed);
+  void SetVolume(int part, double volume);
+
+  // Readable from any thread, about the last command the engine thread
+  // sent: whether the part has played past its end since,
+  bool finished(int part) const;
+  // and whether its lead-in is ready for the next Play().
+  bool lead_in_ready(int part) const;
+  // Chained sequences the part has moved on to, ever.
+  uint64_t transitions(int part) const {
+    return slots_[part].transitions.load(std::memory_order_acquire);
+  }
+
+  // AudioSource, on the render thread:
+  void Render(float* output, size_t frames) override;
+  void Poll() override;
+
+ private:
+  struct Part;
+  struct LeadIn;
+
+  static constexpr uint64_t kNever = ~0ull;
+
+  struct Command {
+    enum class Kind : uint8_t {
+      kOpen, kClose, kChain, kPlay, kPause, kSeek, kSpeed, kVolume
+    };
+    Kind kind = Kind::kOpen;
+    int part = 0;
+    uint64_t generation = 0;
+    uint64_t position_us = 0;
+    double value = 0.0;
+    // kOpen.
+    std::unique_ptr<Part> state;
+    // kChain.
+    std::unique_ptr<EventCursor> next;
+  };
+
+  // What the engine thread last told a part, to render lead-ins from.
+  struct Control {
+    bool added = false;
+    std::shared_ptr<const Sequence> sequence;
+    std::shared_ptr<const Sequence> chained;
+    // Exact only while |position_known|: after an open or a seek, until
+    // the next play.
+    uint64_t position_us = 0;
+    bool position_known = false;
+    bool playing = false;
+    double speed = 1.0;
+    double volume = 1.0;
+    // Bumped by every command, so results of older ones can be told apart.
+    // Atomic only so that finished() and lead_in_ready() work anywhere.
+    std::atomic<uint64_t> generation{0};
+  };
+
+  struct Slot {
+    // Render thread.
+    std::unique_ptr<Part> part;
+    std::unique_ptr<LeadIn> lead_in;
+    uint64_t generation = 0;
+    // While |waiting| the live part has taken over from a lead-in still
+    // playing as overlay |overlay|, and joins in on the ring frame the
+    // lead-in ends on, |lead_in_frames| after the overlay's start. The
+    // lead-in started at |lead_in_position_us|.
+    bool waiting = false;
+    int overlay = -1;
+    size_t lead_in_frames = 0;
+    uint64_t lead_in_position_us = 0;
+    // Published for the engine thread.
+    std::atomic<uint64_t> finished_generation{kNever};
+    std::atomic<uint64_t> ready_generation{kNever};
+    std::atomic<uint64_t> transitions{0};
+  };
+
+  std::unique_ptr<Part> NewPart(std::shared_ptr<const Sequence> sequence,
+                                double speed, double volume) const;
+  // Engine thread.
+  void Send(Command&& command);
+  Command NewCommand(int part, Command::Kind kind);
+  void RequestLeadIn(int part);
+  void DrainRetired();
+  // Worker thread.
+  void RenderLeadIn(std::unique_ptr<LeadIn> lead_in,
+                    std::shared_ptr<const Sequence> sequence,
+                    std::shared_ptr<const Sequence> chained,
+                    uint64_t position_us, double speed, double volume);
+  // Render thread.
+  void Execute(Command* command);
+  void StopLeadIn(Slot* slot);
+  void ReleaseOverlays();
+  void Retire(std::unique_ptr<Part> part);
+  void Retire(std::unique_ptr<LeadIn> lead_in);
+
+  std::shared_ptr<const SoundFont> font_;
+  const uint32_t sample_rate_;
+  const int polyphony_;
+  AudioOutput* output_;
+  uint32_t lead_in_ms_;
+  Control controls_[kMaxParts];
+  Slot slots_[kMaxParts];
+  // Render thread: the audio of each AudioOutput overlay in use, until the
+  // device lets go of it.
+  std::unique_ptr<LeadIn> overlays_[AudioOutput::kMaxOverlays];
+  // Engine thread to render thread.
+  SpscQueue<Command> commands_;
+  // Lead-in worker to render thread.
+  SpscQueue<std::unique_ptr<LeadIn>> lead_ins_;
+  // Render thread to engine thread: parts the render thread is done with,
+  // freed where allocation is allowed.
+  SpscQueue<std::unique_ptr<Part>> retired_parts_;
+  SpscQueue<std::unique_ptr<LeadIn>> retired_lead_ins_;
+  // Last member: destroyed first, so no lead-in is rendering while the
+  // rest goes away.
+  std::unique_ptr<WorkerThread> worker_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SYNTHESIZER_MIXER_H_
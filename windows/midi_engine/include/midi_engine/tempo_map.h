@@ -0,0 +1,95 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_TEMPO_MAP_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_TEMPO_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "midi_engine/arena.h"
+
+namespace playmidifile {
+
+struct TempoChange {
+  uint32_t tick;
+  uint32_t micros_per_quarter;
+};
+
+// Precomputed tick <-> time conversion for a file. Each tempo segment stores
+// the exact cumulative time at its first tick, so a conversion is a binary
+// search plus one multiply, whatever the number of tempo changes.
+//
+// Times are song microseconds at normal speed; the overloads taking |speed|
+// convert to and from wall-clock time at that playback rate.
+class TempoMap {
+ public:
+  // 120 BPM at 480 ticks per quarter note.
+  TempoMap();
+
+  // |changes| must be sorted by tick. |division| is the raw SMF division
+  // word; SMPTE-timed files ignore |changes|. A division that fails
+  // IsValidDivision() is taken as 480 ticks per quarter note.
+  TempoMap(const std::vector<TempoChange>& changes, uint16_t division);
+
+  // A copy of |other| whose segment table lives in |arena|, which must
+  // outlive it. Copies of the copy go back to the heap.
+  TempoMap(const TempoMap& other, Arena* arena);
+  TempoMap(const TempoMap& other) = default;
+  TempoMap(TempoMap&& other) = default;
+  TempoMap& operator=(const TempoMap& other) = default;
+  TempoMap& operator=(TempoMap&& other) = default;
+
+  // Whether |division| is a usable SMF division word: a non-zero tick
+  // count per quarter note, or SMPTE timing at 24, 25, 29 (29.97 drop
+  // frame) or 30 frames per second with a non-zero tick count per frame.
+  // Parsers reject files that fail this.
+  static bool IsValidDivision(uint16_t division);
+
+  uint64_t TicksToMicros(uint32_t tick) const;
+  // The tick playing at |micros|, rounded down.
+  uint32_t MicrosToTicks(uint64_t micros) const;
+
+  uint64_t TicksToMicros(uint32_t tick, double speed) const;
+  uint32_t MicrosToTicks(uint64_t micros, double speed) const;
+
+  // Tempo in effect at |tick|; 0 for SMPTE-timed files.
+  uint32_t MicrosPerQuarterAt(uint32_t tick) const;
+
+  size_t segment_count() const { return segments_.size(); }
+  // Heap bytes held by the map.
+  size_t memory_bytes() const { return segments_.capacity() * sizeof(Segment); }
+
+  // Converts monotonically increasing ticks in amortized O(1) by walking
+  // forward from the last segment used. Falls back to a binary search when
+  // asked for an earlier tick.
+  class Cursor {
+   public:
+    explicit Cursor(const TempoMap* map) : map_(map), segment_(0) {}
+
+    uint64_t TicksToMicros(uint32_t tick);
+
+   private:
+    const TempoMap* map_;
+    size_t segment_;
+  };
+
+ private:
+  struct Segment {
+    uint32_t tick;
+    // Microseconds per quarter for PPQ timing, or the SMPTE rate scaled so
+    // that micros = scaled / denominator_.
+    uint64_t rate;
+    // Time at |tick| multiplied by |denominator_|, kept exact.
+    uint64_t scaled_start;
+  };
+
+  size_t SegmentForTick(uint32_t tick) const;
+  uint64_t SegmentTicksToMicros(const Segment& segment, uint32_t tick) const;
+
+  ArenaVector<Segment> segments_;
+  uint64_t denominator_;
+  bool smpte_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_TEMPO_MAP_H_
@@ -0,0 +1,64 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_THREAD_POOL_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace playmidifile {
+
+// A fixed set of threads for fork-join work such as decoding the tracks of
+// a file in parallel. The thread calling ParallelFor() takes part, so a
+// pool of N threads starts N - 1 workers, and a pool of 1 runs everything
+// inline. Idle workers sleep on a condition variable.
+class ThreadPool {
+ public:
+  // Clamped to at least 1.
+  explicit ThreadPool(int threads);
+  ~ThreadPool();
+
+  // Disallow copy and assign.
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int threads() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // Runs task(i) for every i in [0, count), spread over the pool, and
+  // returns once all have finished. Callable from any thread; concurrent
+  // calls take turns.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& task);
+
+ private:
+  void Run();
+  // Claims and runs items of the current job until none are left.
+  void Work();
+
+  // Held for a whole ParallelFor() call.
+  std::mutex job_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  // Bumped for every job, so a worker can tell a new one from a spurious
+  // wake-up.
+  uint64_t generation_;
+  // Workers still inside the current job.
+  int busy_;
+  bool quit_;
+
+  // The current job.
+  const std::function<void(size_t)>* task_;
+  size_t count_;
+  std::atomic<size_t> next_;
+
+  std::vector<std::thread> workers_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_THREAD_POOL_H_
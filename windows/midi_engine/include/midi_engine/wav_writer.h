@@ -0,0 +1,44 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_WAV_WRITER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_WAV_WRITER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace playmidifile {
+
+// Streams interleaved float audio to a 16-bit PCM .wav file. Samples are
+// clipped to [-1, 1]. The header is written with placeholder sizes and
+// patched by Close().
+class WavWriter {
+ public:
+  WavWriter();
+  ~WavWriter();
+
+  // Disallow copy and assign.
+  WavWriter(const WavWriter&) = delete;
+  WavWriter& operator=(const WavWriter&) = delete;
+
+  bool Open(const std::string& utf8_path, uint32_t sample_rate,
+            uint16_t channels, std::string* error);
+  bool Write(const float* samples, size_t frames, std::string* error);
+  // Finalizes the header. Called by the destructor if needed, ignoring
+  // errors.
+  bool Close(std::string* error);
+
+  bool is_open() const { return file_ != nullptr; }
+  uint64_t frames_written() const { return frames_written_; }
+
+ private:
+  std::FILE* file_;
+  uint32_t sample_rate_;
+  uint16_t channels_;
+  uint64_t frames_written_;
+  std::vector<uint8_t> scratch_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_WAV_WRITER_H_
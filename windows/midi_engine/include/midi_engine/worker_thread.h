@@ -0,0 +1,45 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_WORKER_THREAD_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_WORKER_THREAD_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace playmidifile {
+
+// A thread that runs posted tasks one at a time, in order. For slow jobs
+// (offline rendering) that must not hold up the engine thread. Unlike the
+// engine's command ring it takes a lock, which is fine off the real-time
+// path.
+class WorkerThread {
+ public:
+  WorkerThread();
+  // Waits for the running task; tasks not yet started are dropped.
+  ~WorkerThread();
+
+  // Disallow copy and assign.
+  WorkerThread(const WorkerThread&) = delete;
+  WorkerThread& operator=(const WorkerThread&) = delete;
+
+  // May be called from any thread.
+  void Post(std::function<void()> task);
+
+  bool IsCurrentThread() const {
+    return std::this_thread::get_id() == thread_.get_id();
+  }
+
+ private:
+  void Run();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<std::function<void()>> tasks_;
+  bool quit_;
+  std::thread thread_;
+};
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_WORKER_THREAD_H_
@@ -0,0 +1,77 @@
+#include "midi_engine/arena.h"
+
+#include <algorithm>
+#include <new>
+
+namespace playmidifile {
+
+struct Arena::Chunk {
+  Chunk* next;
+  // Storage follows, starting max-aligned.
+};
+
+namespace {
+
+// The chunk header, rounded up so the storage after it stays max-aligned.
+constexpr size_t kHeaderBytes =
+    (sizeof(void*) + alignof(std::max_align_t) - 1) /
+    alignof(std::max_align_t) * alignof(std::max_align_t);
+
+}  // namespace
+
+Arena::Arena(size_t chunk_bytes)
+    : chunk_bytes_(std::max<size_t>(chunk_bytes, 1)),
+      head_(nullptr),
+      cursor_(nullptr),
+      limit_(nullptr),
+      used_(0),
+      reserved_(0),
+      chunk_count_(0) {}
+
+Arena::~Arena() { Release(); }
+
+void* Arena::Allocate(size_t bytes, size_t alignment) {
+  size_t padding = static_cast<size_t>(
+      -reinterpret_cast<uintptr_t>(cursor_) & (alignment - 1));
+  if (!cursor_ || static_cast<size_t>(limit_ - cursor_) < padding + bytes) {
+    AddChunk(std::max(bytes, chunk_bytes_));
+    padding = 0;
+  }
+  uint8_t* result = cursor_ + padding;
+  cursor_ = result + bytes;
+  used_ += padding + bytes;
+  return result;
+}
+
+void Arena::Reserve(size_t bytes) {
+  if (bytes > 0 && (!cursor_ || static_cast<size_t>(limit_ - cursor_) < bytes)) {
+    AddChunk(bytes);
+  }
+}
+
+void Arena::Release() {
+  while (head_) {
+    Chunk* next = head_->next;
+    ::operator delete(head_);
+    head_ = next;
+  }
+  cursor_ = nullptr;
+  limit_ = nullptr;
+  used_ = 0;
+  reserved_ = 0;
+  chunk_count_ = 0;
+}
+
+void Arena::AddChunk(size_t min_bytes) {
+  // Fails like any other allocation when memory runs out.
+  void* memory = ::operator new(kHeaderBytes + min_bytes);
+  Chunk* chunk = static_cast<Chunk*>(memory);
+  chunk->next = head_;
+  head_ = chunk;
+  cursor_ = static_cast<uint8_t*>(memory) + kHeaderBytes;
+  limit_ = cursor_ + min_bytes;
+  reserved_ += min_bytes;
+  ++chunk_count_;
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,212 @@
+#include "midi_engine/audio_output.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace playmidifile {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kChannels = 2;
+
+}  // namespace
+
+AudioOutput::AudioOutput(std::unique_ptr<AudioSink> sink, AudioSource* source,
+                         const AudioOutputOptions& options)
+    : sink_(std::move(sink)),
+      source_(source),
+      options_(options),
+      stats_(nullptr),
+      underruns_(0),
+      frames_played_(0),
+      frames_rendered_(0),
+      frames_read_(0),
+      stop_(false),
+      poll_(false) {
+  options_.periods = std::max(options_.periods, 2);
+}
+
+AudioOutput::~AudioOutput() {
+  Stop();
+}
+
+bool AudioOutput::Start(std::string* error) {
+  if (running()) {
+    return true;
+  }
+  format_.sample_rate = options_.sample_rate;
+  format_.period_frames = options_.period_frames;
+  if (!sink_->Open(&format_, error)) {
+    return false;
+  }
+  ring_ = std::make_unique<AudioRing>(
+      format_.period_frames * static_cast<size_t>(options_.periods),
+      kChannels);
+  period_.assign(format_.period_frames * kChannels, 0.0f);
+  underruns_.store(0, std::memory_order_relaxed);
+  frames_played_.store(0, std::memory_order_relaxed);
+  frames_rendered_ = 0;
+  frames_read_ = 0;
+  // Start with a full ring, so the first periods do not underrun while the
+  // render thread gets going.
+  source_->Poll();
+  Fill();
+  stop_ = false;
+  thread_ = std::thread(&AudioOutput::Run, this);
+  sink_->Start([this](float* output, size_t frames) { Pull(output, frames); });
+  return true;
+}
+
+void AudioOutput::Stop() {
+  if (!running()) {
+    return;
+  }
+  sink_->Close();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  ring_.reset();
+  for (Overlay& overlay : overlays_) {
+    overlay.state.store(kOverlayFree, std::memory_order_relaxed);
+  }
+}
+
+void AudioOutput::Wake() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    poll_ = true;
+  }
+  wake_.notify_one();
+}
+
+int AudioOutput::StartOverlay(const float* samples, size_t frames) {
+  for (int id = 0; id < kMaxOverlays; ++id) {
+    Overlay& overlay = overlays_[id];
+    if (overlay.state.load(std::memory_order_acquire) == kOverlayFree) {
+      overlay.samples = samples;
+      overlay.frames = frames;
+      overlay.start_frame.store(-1, std::memory_order_relaxed);
+      overlay.state.store(kOverlayArmed, std::memory_order_release);
+      return id;
+    }
+  }
+  return -1;
+}
+
+int64_t AudioOutput::OverlayStartFrame(int id) const {
+  return overlays_[id].start_frame.load(std::memory_order_acquire);
+}
+
+void AudioOutput::CancelOverlay(int id) {
+  std::atomic<int>& state = overlays_[id].state;
+  int expected = kOverlayArmed;
+  // Not started: the device will never touch it. Playing: the device may be
+  // mixing it right now, so it is the device that marks it done.
+  if (!state.compare_exchange_strong(expected, kOverlayDone,
+                                     std::memory_order_acq_rel)) {
+    expected = kOverlayPlaying;
+    state.compare_exchange_strong(expected, kOverlayCancelled,
+                                  std::memory_order_acq_rel);
+  }
+}
+
+bool AudioOutput::TryReleaseOverlay(int id) {
+  std::atomic<int>& state = overlays_[id].state;
+  int current = state.load(std::memory_order_acquire);
+  if (current == kOverlayDone) {
+    state.store(kOverlayFree, std::memory_order_release);
+    return true;
+  }
+  // Stop() frees every overlay.
+  return current == kOverlayFree;
+}
+
+void AudioOutput::Pull(float* output, size_t frames) {
+  size_t read = ring_->Read(output, frames);
+  if (read < frames) {
+    std::fill(output + read * kChannels, output + frames * kChannels, 0.0f);
+    underruns_.fetch_add(1, std::memory_order_relaxed);
+    if (stats_) {
+      stats_->underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  MixOverlays(output, frames, frames_read_);
+  frames_read_ += read;
+  frames_played_.fetch_add(frames, std::memory_order_relaxed);
+  wake_.notify_one();
+}
+
+void AudioOutput::MixOverlays(float* output, size_t frames,
+                              uint64_t first_frame) {
+  for (Overlay& overlay : overlays_) {
+    int state = overlay.state.load(std::memory_order_acquire);
+    if (state == kOverlayArmed) {
+      overlay.played = 0;
+      overlay.start_frame.store(static_cast<int64_t>(first_frame),
+                                std::memory_order_release);
+      if (!overlay.state.compare_exchange_strong(
+              state, kOverlayPlaying, std::memory_order_acq_rel)) {
+        continue;  // Cancelled before it started.
+      }
+      state = kOverlayPlaying;
+    }
+    if (state == kOverlayCancelled) {
+      overlay.state.store(kOverlayDone, std::memory_order_release);
+      continue;
+    }
+    if (state != kOverlayPlaying) {
+      continue;
+    }
+    size_t count = std::min(frames, overlay.frames - overlay.played);
+    const float* samples = overlay.samples + overlay.played * kChannels;
+    for (size_t i = 0; i < count * kChannels; ++i) {
+      output[i] += samples[i];
+    }
+    overlay.played += count;
+    if (overlay.played == overlay.frames) {
+      // Loses to a concurrent cancel, which then ends it next pull.
+      overlay.state.compare_exchange_strong(state, kOverlayDone,
+                                            std::memory_order_acq_rel);
+    }
+  }
+}
+
+void AudioOutput::Run() {
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(
+          static_cast<double>(format_.period_frames) / format_.sample_rate));
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    lock.unlock();
+    source_->Poll();
+    Fill();
+    lock.lock();
+    wake_.wait_for(lock, period, [this] {
+      return stop_ || poll_ || ring_->writable() >= format_.period_frames;
+    });
+    poll_ = false;
+  }
+}
+
+void AudioOutput::Fill() {
+  while (ring_->writable() >= format_.period_frames) {
+    Clock::time_point start = Clock::now();
+    source_->Render(period_.data(), format_.period_frames);
+    if (stats_) {
+      stats_->audio_callback.Record(static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              Clock::now() - start)
+              .count()));
+    }
+    ring_->Write(period_.data(), format_.period_frames);
+    frames_rendered_ += format_.period_frames;
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,60 @@
+#include "midi_engine/audio_ring.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace playmidifile {
+
+AudioRing::AudioRing(size_t capacity_frames, int channels)
+    : capacity_(capacity_frames < 1 ? 1 : capacity_frames),
+      channels_(channels),
+      samples_(new float[capacity_ * channels]()),
+      read_(0),
+      written_(0) {}
+
+size_t AudioRing::Write(const float* input, size_t frames) {
+  size_t written = written_.load(std::memory_order_relaxed);
+  size_t free =
+      capacity_ - (written - read_.load(std::memory_order_acquire));
+  frames = std::min(frames, free);
+  size_t slot = written % capacity_;
+  size_t first = std::min(frames, capacity_ - slot);
+  std::memcpy(samples_.get() + slot * channels_, input,
+              first * channels_ * sizeof(float));
+  std::memcpy(samples_.get(), input + first * channels_,
+              (frames - first) * channels_ * sizeof(float));
+  written_.store(written + frames, std::memory_order_release);
+  return frames;
+}
+
+size_t AudioRing::writable() const {
+  return capacity_ - (written_.load(std::memory_order_relaxed) -
+                      read_.load(std::memory_order_acquire));
+}
+
+size_t AudioRing::Read(float* output, size_t frames) {
+  size_t read = read_.load(std::memory_order_relaxed);
+  frames = std::min(frames, written_.load(std::memory_order_acquire) - read);
+  size_t slot = read % capacity_;
+  size_t first = std::min(frames, capacity_ - slot);
+  std::memcpy(output, samples_.get() + slot * channels_,
+              first * channels_ * sizeof(float));
+  std::memcpy(output + first * channels_, samples_.get(),
+              (frames - first) * channels_ * sizeof(float));
+  read_.store(read + frames, std::memory_order_release);
+  return frames;
+}
+
+size_t AudioRing::Skip(size_t frames) {
+  size_t read = read_.load(std::memory_order_relaxed);
+  frames = std::min(frames, written_.load(std::memory_order_acquire) - read);
+  read_.store(read + frames, std::memory_order_release);
+  return frames;
+}
+
+size_t AudioRing::readable() const {
+  return written_.load(std::memory_order_acquire) -
+         read_.load(std::memory_order_relaxed);
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,117 @@
+#include "midi_engine/audio_sink.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace playmidifile {
+
+ClockedAudioSink::ClockedAudioSink()
+    : periods_(0), last_onset_ns_(0), silent_(true), stop_(false) {}
+
+ClockedAudioSink::~ClockedAudioSink() {
+  ClockedAudioSink::Close();
+}
+
+NullAudioSink::~NullAudioSink() {
+  Close();
+}
+
+bool ClockedAudioSink::Open(AudioFormat* format, std::string* error) {
+  if (format->sample_rate == 0 || format->period_frames == 0) {
+    *error = "Invalid audio format";
+    return false;
+  }
+  format_ = *format;
+  period_.assign(format_.period_frames * 2, 0.0f);
+  periods_.store(0, std::memory_order_relaxed);
+  last_onset_ns_.store(0, std::memory_order_relaxed);
+  silent_ = true;
+  return true;
+}
+
+void ClockedAudioSink::Start(PullCallback pull) {
+  pull_ = std::move(pull);
+  stop_ = false;
+  thread_ = std::thread(&ClockedAudioSink::Run, this);
+}
+
+void ClockedAudioSink::Close() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_one();
+    thread_.join();
+  }
+  pull_ = nullptr;
+}
+
+void ClockedAudioSink::Run() {
+  using Clock = std::chrono::steady_clock;
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(
+          static_cast<double>(format_.period_frames) / format_.sample_rate));
+  Clock::time_point deadline = Clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stop_) {
+    lock.unlock();
+    pull_(period_.data(), format_.period_frames);
+    Consume(period_.data(), format_.period_frames);
+    periods_.fetch_add(1, std::memory_order_relaxed);
+    auto sound = std::find_if(period_.begin(), period_.end(),
+                              [](float sample) { return sample != 0.0f; });
+    if (silent_ && sound != period_.end()) {
+      size_t frame = static_cast<size_t>(sound - period_.begin()) / 2;
+      auto offset = std::chrono::nanoseconds(
+          static_cast<int64_t>(frame * 1000000000ull / format_.sample_rate));
+      last_onset_ns_.store(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              (deadline + offset).time_since_epoch())
+              .count(),
+          std::memory_order_release);
+    }
+    silent_ = sound == period_.end();
+    lock.lock();
+    // A real device does not catch up on periods it missed; neither does
+    // this one if the thread was held up.
+    deadline += period;
+    Clock::time_point now = Clock::now();
+    if (deadline + period < now) {
+      deadline = now;
+    }
+    wake_.wait_until(lock, deadline, [this] { return stop_; });
+  }
+}
+
+WavFileAudioSink::WavFileAudioSink(std::string utf8_path)
+    : path_(std::move(utf8_path)) {}
+
+WavFileAudioSink::~WavFileAudioSink() {
+  WavFileAudioSink::Close();
+}
+
+bool WavFileAudioSink::Open(AudioFormat* format, std::string* error) {
+  if (!ClockedAudioSink::Open(format, error)) {
+    return false;
+  }
+  error_.clear();
+  return writer_.Open(path_, format->sample_rate, 2, error);
+}
+
+void WavFileAudioSink::Close() {
+  ClockedAudioSink::Close();
+  std::string error;
+  if (!writer_.Close(&error) && error_.empty()) {
+    error_ = error;
+  }
+}
+
+void WavFileAudioSink::Consume(const float* samples, size_t frames) {
+  if (error_.empty()) {
+    writer_.Write(samples, frames, &error_);
+  }
+}
+
+}  // namespace playmidifile
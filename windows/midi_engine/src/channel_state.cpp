@@ -0,0 +1,88 @@
+#include "midi_engine/channel_state.h"
+
+#include <cstring>
+#include <initializer_list>
+
+namespace playmidifile {
+
+namespace {
+
+constexpr uint8_t kControlBankSelect = 0;
+constexpr uint8_t kControlBankSelectLsb = 32;
+constexpr uint8_t kControlSustain = 64;
+constexpr uint8_t kControlAllNotesOff = 123;
+
+}  // namespace
+
+ChannelStateSet::ChannelStateSet() { Reset(); }
+
+void ChannelStateSet::Reset() {
+  std::memset(channels_, kUnset, sizeof(channels_));
+}
+
+void ChannelStateSet::Apply(uint8_t status, uint8_t data1, uint8_t data2) {
+  Channel& channel = channels_[status & 0x0F];
+  switch (status & 0xF0) {
+    case 0xB0:
+      // Channel mode messages (120-127) are not state to restore.
+      if (data1 < 120) {
+        channel.controllers[data1] = data2;
+      }
+      break;
+    case 0xC0:
+      channel.program = data1;
+      break;
+    case 0xD0:
+      channel.pressure = data1;
+      break;
+    case 0xE0:
+      channel.bend_lsb = data1;
+      channel.bend_msb = data2;
+      break;
+    default:
+      break;
+  }
+}
+
+void ChannelStateSet::Emit(MidiOutput* output) const {
+  for (int i = 0; i < kMidiChannelCount; ++i) {
+    const Channel& channel = channels_[i];
+    uint8_t control_change = static_cast<uint8_t>(0xB0 | i);
+    for (uint8_t control : {kControlBankSelect, kControlBankSelectLsb}) {
+      if (channel.controllers[control] != kUnset) {
+        output->SendChannelMessage(control_change, control,
+                                   channel.controllers[control]);
+      }
+    }
+    if (channel.program != kUnset) {
+      output->SendChannelMessage(static_cast<uint8_t>(0xC0 | i),
+                                 channel.program, 0);
+    }
+    for (uint8_t control = 0; control < 120; ++control) {
+      if (control == kControlBankSelect || control == kControlBankSelectLsb ||
+          channel.controllers[control] == kUnset) {
+        continue;
+      }
+      output->SendChannelMessage(control_change, control,
+                                 channel.controllers[control]);
+    }
+    if (channel.bend_msb != kUnset) {
+      output->SendChannelMessage(static_cast<uint8_t>(0xE0 | i),
+                                 channel.bend_lsb, channel.bend_msb);
+    }
+    if (channel.pressure != kUnset) {
+      output->SendChannelMessage(static_cast<uint8_t>(0xD0 | i),
+                                 channel.pressure, 0);
+    }
+  }
+}
+
+void SilenceAllChannels(MidiOutput* output) {
+  for (int i = 0; i < kMidiChannelCount; ++i) {
+    uint8_t control_change = static_cast<uint8_t>(0xB0 | i);
+    output->SendChannelMessage(control_change, kControlSustain, 0);
+    output->SendChannelMessage(control_change, kControlAllNotesOff, 0);
+  }
+}
+
+}  // namespace playmidifile
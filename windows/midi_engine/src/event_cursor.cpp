@@ -0,0 +1,60 @@
+#include "midi_engine/event_cursor.h"
+
+#include <utility>
+
+namespace playmidifile {
+
+SequenceCursor::SequenceCursor(std::shared_ptr<const Sequence> sequence)
+    : sequence_(std::move(sequence)),
+      tempo_cursor_(&sequence_->tempo_map()),
+      next_event_(0),
+      current_(),
+      next_event_us_(0),
+      current_valid_(false) {}
+
+uint64_t SequenceCursor::duration_us() const {
+  return sequence_->duration_us();
+}
+
+const SequenceEvent* SequenceCursor::Peek(uint64_t* micros) {
+  if (next_event_ >= sequence_->event_count()) {
+    return nullptr;
+  }
+  if (!current_valid_) {
+    current_ = sequence_->event(next_event_);
+    next_event_us_ = tempo_cursor_.TicksToMicros(current_.tick);
+    current_valid_ = true;
+  }
+  *micros = next_event_us_;
+  return &current_;
+}
+
+const uint8_t* SequenceCursor::Payload(const SequenceEvent& event) const {
+  return sequence_->payload(event);
+}
+
+void SequenceCursor::Advance() {
+  ++next_event_;
+  current_valid_ = false;
+}
+
+void SequenceCursor::Seek(uint64_t position_us, ChannelStateSet* state) {
+  uint32_t target_tick = sequence_->tempo_map().MicrosToTicks(position_us);
+  // Binary search over the tick array alone.
+  size_t low = 0;
+  size_t high = sequence_->event_count();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (sequence_->tick(middle) < target_tick) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  next_event_ = low;
+  current_valid_ = false;
+  // Restore controller state from the nearest checkpoint.
+  sequence_->StateAt(next_event_, state);
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,162 @@
+#include "midi_engine/mapped_file.h"
+
+#include <utility>
+
+#include "utf8_path.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace playmidifile {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile()
+    : data_(nullptr),
+      size_(0),
+      file_handle_(INVALID_HANDLE_VALUE),
+      mapping_handle_(nullptr) {}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)),
+      file_handle_(std::exchange(other.file_handle_, INVALID_HANDLE_VALUE)),
+      mapping_handle_(std::exchange(other.mapping_handle_, nullptr)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    file_handle_ = std::exchange(other.file_handle_, INVALID_HANDLE_VALUE);
+    mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+  }
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& utf8_path, std::string* error,
+                      Access access) {
+  Close();
+  std::wstring wide_path = Utf8ToWide(utf8_path);
+  DWORD flags = access == Access::kSequential ? FILE_FLAG_SEQUENTIAL_SCAN
+                                              : FILE_FLAG_RANDOM_ACCESS;
+  // Sharing delete access lets the file be replaced on disk while mapped,
+  // as POSIX allows; the mapping keeps the old contents.
+  HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ,
+                            FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr,
+                            OPEN_EXISTING, flags, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = "File not found";
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+    CloseHandle(file);
+    *error = "File is empty";
+    return false;
+  }
+  HANDLE mapping =
+      CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    *error = "Failed to map file";
+    return false;
+  }
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (view == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    *error = "Failed to map file";
+    return false;
+  }
+  file_handle_ = file;
+  mapping_handle_ = mapping;
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(file_size.QuadPart);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_handle_ = nullptr;
+}
+
+#else  // _WIN32
+
+MappedFile::MappedFile() : data_(nullptr), size_(0) {}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    Close();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+bool MappedFile::Open(const std::string& utf8_path, std::string* error,
+                      Access access) {
+  Close();
+  int fd = open(utf8_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *error = errno == ENOENT ? "File not found" : std::strerror(errno);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    *error = "File is empty";
+    return false;
+  }
+  void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                    MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (view == MAP_FAILED) {
+    *error = "Failed to map file";
+    return false;
+  }
+  madvise(view, static_cast<size_t>(st.st_size),
+          access == Access::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  data_ = static_cast<const uint8_t*>(view);
+  size_ = static_cast<size_t>(st.st_size);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(const_cast<uint8_t*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif  // _WIN32
+
+MappedFile::~MappedFile() { Close(); }
+
+}  // namespace playmidifile
@@ -0,0 +1,86 @@
+#include "midi_engine/midi_file.h"
+
+#include <algorithm>
+
+namespace playmidifile {
+
+namespace {
+
+uint32_t ReadTempo(const MidiEvent& event) {
+  return (static_cast<uint32_t>(event.payload[0]) << 16) |
+         (static_cast<uint32_t>(event.payload[1]) << 8) |
+         static_cast<uint32_t>(event.payload[2]);
+}
+
+}  // namespace
+
+double MidiFileInfo::initial_bpm() const {
+  uint32_t micros = kDefaultMicrosPerQuarter;
+  if (!tempo_changes.empty() && tempo_changes.front().tick == 0) {
+    micros = tempo_changes.front().micros_per_quarter;
+  }
+  return 60000000.0 / micros;
+}
+
+// static
+std::unique_ptr<MidiFile> MidiFile::Open(const std::string& utf8_path,
+                                         std::string* error) {
+  std::unique_ptr<MidiFile> file(new MidiFile());
+  if (!file->mapping_.Open(utf8_path, error) ||
+      !file->Load(file->mapping_.data(), file->mapping_.size(), error)) {
+    return nullptr;
+  }
+  return file;
+}
+
+// static
+std::unique_ptr<MidiFile> MidiFile::Parse(const uint8_t* data, size_t size,
+                                          std::string* error) {
+  std::unique_ptr<MidiFile> file(new MidiFile());
+  if (!file->Load(data, size, error)) {
+    return nullptr;
+  }
+  return file;
+}
+
+bool MidiFile::Load(const uint8_t* data, size_t size, std::string* error) {
+  if (!ParseSmf(data, size, &smf_, error)) {
+    return false;
+  }
+  info_.format = smf_.header.format;
+  info_.track_count = static_cast<uint16_t>(smf_.tracks.size());
+  info_.ppq = smf_.header.is_smpte() ? 0 : smf_.header.division;
+
+  bool collect_tempo = !smf_.header.is_smpte();
+  for (const SmfTrack& track : smf_.tracks) {
+    TrackReader reader(track);
+    MidiEvent event;
+    uint32_t tick = 0;
+    while (reader.Next(&event)) {
+      tick += event.delta_ticks;
+      if (collect_tempo && event.type == MidiEventType::kMeta &&
+          event.data1 == kMetaTempo && event.payload_size >= 3) {
+        uint32_t micros = ReadTempo(event);
+        if (micros > 0) {
+          info_.tempo_changes.push_back(TempoChange{tick, micros});
+        }
+      }
+    }
+    if (reader.failed()) {
+      *error = "Malformed MIDI track data";
+      return false;
+    }
+    info_.end_tick = std::max(info_.end_tick, tick);
+  }
+  // Tempo events usually live in the first track, but format 1 files may
+  // scatter them; a stable sort keeps the file order for equal ticks.
+  std::stable_sort(info_.tempo_changes.begin(), info_.tempo_changes.end(),
+                   [](const TempoChange& a, const TempoChange& b) {
+                     return a.tick < b.tick;
+                   });
+  info_.tempo_map = TempoMap(info_.tempo_changes, smf_.header.division);
+  info_.duration_us = info_.tempo_map.TicksToMicros(info_.end_tick);
+  return true;
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,239 @@
+#include "midi_engine/offline_renderer.h"
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+#include "midi_engine/channel_state.h"
+#include "midi_engine/wav_writer.h"
+
+namespace playmidifile {
+
+namespace {
+
+// Frames per block for the Render*() helpers: large enough that the
+// per-block thread handoff is noise, small enough to cancel promptly.
+constexpr size_t kBlockFrames = 16384;
+
+// Granularity of the release tail, in frames (~6 ms at 44.1 kHz).
+constexpr uint64_t kTailChunkFrames = 256;
+
+constexpr char kCancelledError[] = "Rendering cancelled";
+
+bool Cancelled(const RenderOptions& options) {
+  return options.cancel != nullptr &&
+         options.cancel->load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+struct OfflineRenderer::Group {
+  Group(std::shared_ptr<const SoundFont> font, const RenderOptions& options,
+        const TempoMap* tempo_map)
+      : synth(std::move(font), options.sample_rate, options.polyphony),
+        tempo_cursor(tempo_map) {}
+
+  Synthesizer synth;
+  // Bit c set: channel c plays in this group.
+  uint16_t channels = 0;
+  // Playlist piece being played and its next event.
+  size_t piece = 0;
+  size_t next_event = 0;
+  TempoMap::Cursor tempo_cursor;
+  // Mix buffer for groups rendered off the calling thread.
+  std::vector<float> buffer;
+};
+
+OfflineRenderer::OfflineRenderer(std::shared_ptr<const Sequence> sequence,
+                                 std::shared_ptr<const SoundFont> font,
+                                 const RenderOptions& options)
+    : OfflineRenderer(
+          std::vector<std::shared_ptr<const Sequence>>{std::move(sequence)},
+          std::move(font), options) {}
+
+OfflineRenderer::OfflineRenderer(
+    std::vector<std::shared_ptr<const Sequence>> playlist,
+    std::shared_ptr<const SoundFont> font, const RenderOptions& options)
+    : playlist_(std::move(playlist)),
+      options_(options),
+      position_(0),
+      end_frame_(0),
+      tail_frames_(0) {
+  options_.threads =
+      std::max(1, std::min(options_.threads, kMidiChannelCount));
+  for (int i = 0; i < options_.threads; ++i) {
+    groups_.push_back(std::unique_ptr<Group>(
+        new Group(font, options_, &playlist_.front()->tempo_map())));
+    groups_.back()->synth.SetVolume(options_.volume);
+  }
+  for (int channel = 0; channel < kMidiChannelCount; ++channel) {
+    groups_[channel % options_.threads]->channels |=
+        static_cast<uint16_t>(1u << channel);
+  }
+  for (const std::shared_ptr<const Sequence>& sequence : playlist_) {
+    starts_.push_back(end_frame_);
+    end_frame_ += FrameAt(sequence->duration_us());
+  }
+  tail_frames_ =
+      static_cast<uint64_t>(options_.max_tail_ms) * options_.sample_rate / 1000;
+}
+
+OfflineRenderer::~OfflineRenderer() = default;
+
+size_t OfflineRenderer::Render(float* output, size_t frames) {
+  size_t written = 0;
+  while (written < frames && !finished()) {
+    // Up to the last event in one go; past it, in short chunks so the
+    // output ends soon after the last voice falls silent.
+    uint64_t chunk = frames - written;
+    if (position_ < end_frame_) {
+      chunk = std::min(chunk, end_frame_ - position_);
+    } else {
+      chunk = std::min<uint64_t>(
+          {chunk, kTailChunkFrames, end_frame_ + tail_frames_ - position_});
+    }
+    RenderChunk(output + written * 2, static_cast<size_t>(chunk));
+    written += static_cast<size_t>(chunk);
+  }
+  return written;
+}
+
+void OfflineRenderer::RenderChunk(float* output, size_t frames) {
+  if (groups_.size() == 1) {
+    RenderGroup(groups_.front().get(), output, frames);
+  } else {
+    std::vector<std::thread> workers;
+    workers.reserve(groups_.size() - 1);
+    for (size_t i = 1; i < groups_.size(); ++i) {
+      Group* group = groups_[i].get();
+      group->buffer.resize(frames * 2);
+      workers.emplace_back([this, group, frames] {
+        RenderGroup(group, group->buffer.data(), frames);
+      });
+    }
+    RenderGroup(groups_.front().get(), output, frames);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    for (size_t i = 1; i < groups_.size(); ++i) {
+      const float* buffer = groups_[i]->buffer.data();
+      for (size_t sample = 0; sample < frames * 2; ++sample) {
+        output[sample] += buffer[sample];
+      }
+    }
+  }
+  position_ += frames;
+}
+
+bool OfflineRenderer::finished() const {
+  if (position_ < end_frame_) {
+    return false;
+  }
+  if (position_ >= end_frame_ + tail_frames_) {
+    return true;
+  }
+  return std::all_of(groups_.begin(), groups_.end(),
+                     [](const std::unique_ptr<Group>& group) {
+                       return group->synth.active_voices() == 0;
+                     });
+}
+
+uint64_t OfflineRenderer::FrameAt(uint64_t micros) const {
+  return micros * options_.sample_rate / 1000000;
+}
+
+void OfflineRenderer::RenderGroup(Group* group, float* output,
+                                  size_t frames) {
+  uint64_t position = position_;
+  const uint64_t end = position_ + frames;
+  while (position < end) {
+    // Send everything due at |position|, then render up to the next event
+    // or the start of the next piece.
+    uint64_t next_frame = end;
+    while (true) {
+      const Sequence& sequence = *playlist_[group->piece];
+      if (group->next_event < sequence.event_count()) {
+        const SequenceEvent event = sequence.event(group->next_event);
+        uint64_t frame =
+            starts_[group->piece] +
+            FrameAt(group->tempo_cursor.TicksToMicros(event.tick));
+        if (frame > position) {
+          next_frame = std::min(next_frame, frame);
+          break;
+        }
+        if (event.status >= 0xF0) {
+          group->synth.SendSysEx(sequence.payload(event),
+                                 event.payload_size);
+        } else if (group->channels & (1u << (event.status & 0x0F))) {
+          group->synth.SendChannelMessage(event.status, event.data1,
+                                          event.data2);
+        }
+        ++group->next_event;
+        continue;
+      }
+      if (group->piece + 1 == playlist_.size()) {
+        break;
+      }
+      uint64_t start = starts_[group->piece + 1];
+      if (start > position) {
+        next_frame = std::min(next_frame, start);
+        break;
+      }
+      SilenceAllChannels(&group->synth);
+      ++group->piece;
+      group->next_event = 0;
+      group->tempo_cursor =
+          TempoMap::Cursor(&playlist_[group->piece]->tempo_map());
+    }
+    group->synth.Render(output + (position - position_) * 2,
+                        static_cast<size_t>(next_frame - position));
+    position = next_frame;
+  }
+}
+
+bool RenderToBuffer(std::shared_ptr<const Sequence> sequence,
+                    std::shared_ptr<const SoundFont> font,
+                    const RenderOptions& options, std::vector<float>* output,
+                    std::string* error) {
+  OfflineRenderer renderer(std::move(sequence), std::move(font), options);
+  output->clear();
+  output->reserve(static_cast<size_t>(renderer.end_frame()) * 2);
+  while (!renderer.finished()) {
+    if (Cancelled(options)) {
+      *error = kCancelledError;
+      return false;
+    }
+    size_t offset = output->size();
+    output->resize(offset + kBlockFrames * 2);
+    size_t rendered = renderer.Render(output->data() + offset, kBlockFrames);
+    output->resize(offset + rendered * 2);
+  }
+  return true;
+}
+
+bool RenderToWavFile(std::shared_ptr<const Sequence> sequence,
+                     std::shared_ptr<const SoundFont> font,
+                     const RenderOptions& options,
+                     const std::string& utf8_path, uint64_t* frames,
+                     std::string* error) {
+  OfflineRenderer renderer(std::move(sequence), std::move(font), options);
+  WavWriter writer;
+  if (!writer.Open(utf8_path, options.sample_rate, 2, error)) {
+    return false;
+  }
+  std::vector<float> block(kBlockFrames * 2);
+  while (!renderer.finished()) {
+    if (Cancelled(options)) {
+      *error = kCancelledError;
+      return false;
+    }
+    size_t rendered = renderer.Render(block.data(), kBlockFrames);
+    if (!writer.Write(block.data(), rendered, error)) {
+      return false;
+    }
+  }
+  *frames = writer.frames_written();
+  return writer.Close(error);
+}
+
+}  // namespace playmidifile
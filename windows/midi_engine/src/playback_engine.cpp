@@ -0,0 +1,912 @@
+#include "midi_engine/playback_engine.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "midi_engine/sequence_stream.h"
+#include "utf8_path.h"
+
+namespace playmidifile {
+
+namespace {
+
+// Condition variable timeouts are only accurate to the OS timer resolution,
+// so the last stretch before a deadline is covered by yielding instead.
+constexpr std::chrono::microseconds kSpinWindow(1000);
+
+uint64_t MicrosecondsSince(std::chrono::steady_clock::time_point start) {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+}  // namespace
+
+const char* PlaybackStateName(PlaybackState state) {
+  switch (state) {
+    case PlaybackState::kPlaying:
+      return "playing";
+    case PlaybackState::kPaused:
+      return "paused";
+    case PlaybackState::kStopped:
+    default:
+      return "stopped";
+  }
+}
+
+PlaybackEngine::PlaybackEngine(std::unique_ptr<PlaybackBackend> backend,
+                               std::shared_ptr<SequenceCache> cache,
+                               size_t queue_capacity)
+    : PlaybackEngine(BackendFactory(), std::move(backend), std::move(cache),
+                     queue_capacity) {}
+
+PlaybackEngine::PlaybackEngine(BackendFactory factory,
+                               std::shared_ptr<SequenceCache> cache,
+                               size_t queue_capacity)
+    : PlaybackEngine(factory, factory(), std::move(cache), queue_capacity) {}
+
+PlaybackEngine::PlaybackEngine(BackendFactory factory,
+                               std::unique_ptr<PlaybackBackend> default_backend,
+                               std::shared_ptr<SequenceCache> cache,
+                               size_t queue_capacity)
+    : factory_(std::move(factory)),
+      cache_(cache ? std::move(cache) : std::make_shared<SequenceCache>()),
+      commands_(queue_capacity),
+      handle_in_use_(),
+      wake_pending_(false),
+      quit_(false),
+      commands_executed_(0),
+      streaming_threshold_(kDefaultStreamingThreshold),
+      progress_interval_(0),
+      loads_(queue_capacity) {
+  handle_in_use_[kDefaultPlayer] = true;
+  players_[kDefaultPlayer] = std::make_unique<Player>();
+  players_[kDefaultPlayer]->backend = std::move(default_backend);
+  players_[kDefaultPlayer]->backend->SetStats(&stats_);
+  thread_ = std::thread(&PlaybackEngine::Run, this);
+}
+
+PlaybackEngine::~PlaybackEngine() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    quit_.store(true, std::memory_order_release);
+  }
+  wake_.notify_one();
+  thread_.join();
+  for (std::unique_ptr<Player>& player : players_) {
+    if (player) {
+      // Lets the loader thread give up early.
+      if (player->load_cancel) {
+        player->load_cancel->store(true, std::memory_order_relaxed);
+      }
+      if (player->preload_cancel) {
+        player->preload_cancel->store(true, std::memory_order_relaxed);
+      }
+      player->backend->Close();
+    }
+  }
+}
+
+bool PlaybackEngine::Post(Command command) {
+  if (!commands_.TryPush(std::move(command))) {
+    CommandResult result;
+    result.error_code = "BUSY";
+    result.error_message = "Too many pending playback commands";
+    if (command.done) {
+      command.done(result);
+    }
+    return false;
+  }
+  Wake();
+  return true;
+}
+
+void PlaybackEngine::Wake() {
+  // Only the first wake-up after the engine went to sleep pays for the
+  // notification.
+  if (!wake_pending_.exchange(true, std::memory_order_acq_rel)) {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    wake_.notify_one();
+  }
+}
+
+void PlaybackEngine::Load(std::string path, CommandCallback done,
+                          int player) {
+  Command command;
+  command.type = CommandType::kLoad;
+  command.player = player;
+  command.path = std::move(path);
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::LoadBytes(std::vector<uint8_t> bytes,
+                               CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kLoadBytes;
+  command.player = player;
+  command.bytes = std::move(bytes);
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Play(CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kPlay;
+  command.player = player;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Pause(CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kPause;
+  command.player = player;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Stop(CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kStop;
+  command.player = player;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Seek(uint32_t position_ms, CommandCallback done,
+                          int player) {
+  Command command;
+  command.type = CommandType::kSeek;
+  command.player = player;
+  command.position_ms = position_ms;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::SetVolume(double volume, CommandCallback done,
+                               int player) {
+  Command command;
+  command.type = CommandType::kSetVolume;
+  command.player = player;
+  command.value = volume;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::SetSpeed(double speed, CommandCallback done,
+                              int player) {
+  Command command;
+  command.type = CommandType::kSetSpeed;
+  command.player = player;
+  command.value = speed;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::GetInfo(CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kGetInfo;
+  command.player = player;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Enqueue(std::string path, CommandCallback done,
+                             int player) {
+  Command command;
+  command.type = CommandType::kEnqueue;
+  command.player = player;
+  command.path = std::move(path);
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::SetQueue(std::vector<std::string> paths,
+                              CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kSetQueue;
+  command.player = player;
+  command.paths = std::move(paths);
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Next(CommandCallback done, int player) {
+  Command command;
+  command.type = CommandType::kNext;
+  command.player = player;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+int PlaybackEngine::CreatePlayer(CommandCallback done) {
+  int handle = -1;
+  if (factory_) {
+    for (int i = 0; i < kMaxPlayers; ++i) {
+      if (!handle_in_use_[i]) {
+        handle = i;
+        break;
+      }
+    }
+  }
+  if (handle < 0) {
+    CommandResult result;
+    result.player = -1;
+    result.error_code = "PLAYER_ERROR";
+    result.error_message = factory_ ? "Too many players"
+                                    : "This engine has a single player";
+    if (done) {
+      done(result);
+    }
+    return -1;
+  }
+  Command command;
+  command.type = CommandType::kCreatePlayer;
+  command.player = handle;
+  command.done = std::move(done);
+  // Only a queued command takes the handle; a rejected one leaves it free.
+  if (!Post(std::move(command))) {
+    return -1;
+  }
+  handle_in_use_[handle] = true;
+  return handle;
+}
+
+void PlaybackEngine::DisposePlayer(int player, CommandCallback done) {
+  Command command;
+  command.type = CommandType::kDisposePlayer;
+  command.player = player;
+  command.done = std::move(done);
+  // A rejected dispose leaves the player alive on the engine thread, so its
+  // handle stays taken.
+  if (Post(std::move(command)) && player != kDefaultPlayer && player >= 0 &&
+      player < kMaxPlayers) {
+    handle_in_use_[player] = false;
+  }
+}
+
+void PlaybackEngine::SetProgressListener(ProgressListener listener,
+                                         uint32_t interval_ms,
+                                         CommandCallback done) {
+  Command command;
+  command.type = CommandType::kSetProgressListener;
+  command.listener = std::move(listener);
+  command.interval_ms = interval_ms;
+  command.done = std::move(done);
+  Post(std::move(command));
+}
+
+void PlaybackEngine::Run() {
+  while (!quit_.load(std::memory_order_acquire)) {
+    if (size_t pending = commands_.SizeApprox()) {
+      stats_.command_queue_depth.Record(pending);
+    }
+    Command command;
+    while (commands_.TryPop(&command)) {
+      Execute(&command);
+      commands_executed_.fetch_add(1, std::memory_order_relaxed);
+      // Publish each change before running the next command, so the
+      // listener never lags behind a reply.
+      if (progress_listener_) {
+        PublishProgress(Clock::now());
+      }
+    }
+    DrainLoads();
+
+    Clock::time_point deadline = ServicePlayers(Clock::now());
+    if (progress_listener_) {
+      deadline = std::min(deadline, PublishProgress(Clock::now()));
+    }
+    WaitForWork(deadline);
+  }
+}
+
+void PlaybackEngine::WaitForWork(Clock::time_point deadline) {
+  auto has_work = [this] {
+    return wake_pending_.load(std::memory_order_acquire) ||
+           quit_.load(std::memory_order_acquire);
+  };
+  {
+    std::unique_lock<std::mutex> lock(wake_mutex_);
+    if (deadline == Clock::time_point::max()) {
+      wake_.wait(lock, has_work);
+    } else {
+      wake_.wait_until(lock, deadline - kSpinWindow, has_work);
+    }
+  }
+  while (!has_work() && Clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+  // Acquire pairs with the producer's exchange so every command pushed
+  // before it is visible to the drain that follows.
+  wake_pending_.exchange(false, std::memory_order_acq_rel);
+}
+
+PlaybackEngine::Clock::time_point PlaybackEngine::ServicePlayers(
+    Clock::time_point now) {
+  Clock::time_point deadline = Clock::time_point::max();
+  for (int id = 0; id < kMaxPlayers; ++id) {
+    Player* player = players_[id].get();
+    if (!player || player->state != PlaybackState::kPlaying) {
+      continue;
+    }
+    if (player->deadline <= now) {
+      bool finished = false;
+      player->deadline = player->backend->Service(now, &finished);
+      stats_.service_duration.Record(MicrosecondsSince(now));
+      if (player->backend->TakeTransition()) {
+        // The chained file took over without a gap.
+        player->queue.pop_front();
+        player->preloaded = false;
+        player->chained = false;
+        player->duration_ms = player->chained_duration_ms;
+        player->progress_dirty = true;
+        PublishAnchor(id);
+        SchedulePreload(id, player);
+      }
+      if (finished && !player->queue.empty() && !player->load_cancel) {
+        // Not chained: open the next file now, after a short gap.
+        player->state = PlaybackState::kStopped;
+        player->progress_dirty = true;
+        PublishAnchor(id);
+        AdvanceQueue(id, player, true, nullptr);
+        continue;
+      }
+      if (finished) {
+        // Rewind so the next play() starts from the beginning.
+        std::string ignored;
+        player->backend->Seek(0, &ignored);
+        player->state = PlaybackState::kStopped;
+        player->progress_dirty = true;
+        PublishAnchor(id);
+        continue;
+      }
+    }
+    deadline = std::min(deadline, player->deadline);
+  }
+  return deadline;
+}
+
+void PlaybackEngine::Execute(Command* command) {
+  CommandResult result;
+  const int id = command->player;
+  result.player = id;
+  Player* player =
+      id >= 0 && id < kMaxPlayers ? players_[id].get() : nullptr;
+  switch (command->type) {
+    case CommandType::kSetProgressListener:
+      progress_listener_ = std::move(command->listener);
+      progress_interval_ = std::chrono::milliseconds(
+          std::max<uint32_t>(command->interval_ms, 1));
+      // Every player reports where it is to the new listener.
+      for (std::unique_ptr<Player>& each : players_) {
+        if (each) {
+          each->progress_dirty = true;
+        }
+      }
+      break;
+    case CommandType::kCreatePlayer: {
+      std::unique_ptr<PlaybackBackend> backend = factory_();
+      if (!backend) {
+        result.error_code = "PLAYER_ERROR";
+        result.error_message = "Failed to create a player";
+        break;
+      }
+      players_[id] = std::make_unique<Player>();
+      players_[id]->backend = std::move(backend);
+      players_[id]->backend->SetStats(&stats_);
+      player = players_[id].get();
+      player->progress_dirty = true;
+      PublishAnchor(id);
+      break;
+    }
+    case CommandType::kDisposePlayer:
+      if (!player || id == kDefaultPlayer) {
+        result.error_code = "INVALID_ARGUMENT";
+        result.error_message = "Cannot dispose player " + std::to_string(id);
+        break;
+      }
+      AbandonLoad(id, player);
+      DropPreload(player);
+      player->backend->Close();
+      players_[id].reset();
+      player = nullptr;
+      PublishAnchor(id);
+      break;
+    default:
+      if (!player) {
+        result.error_code = "INVALID_ARGUMENT";
+        result.error_message = "Unknown player " + std::to_string(id);
+        break;
+      }
+      if (command->type == CommandType::kLoad ||
+          command->type == CommandType::kLoadBytes) {
+        // Replies once the loader thread is done.
+        StartLoad(id, player, command);
+        return;
+      }
+      if (player->load_cancel) {
+        player->deferred.push_back(std::move(*command));
+        return;
+      }
+      if (command->type == CommandType::kNext && !player->queue.empty()) {
+        // Replies once the next file is open.
+        AdvanceQueue(id, player, player->state == PlaybackState::kPlaying,
+                     std::move(command->done));
+        return;
+      }
+      ExecutePlayerCommand(id, command, player, &result);
+      // Before the reply, so a caller that has its result sees the new
+      // state in Snapshot() too.
+      if (command->type != CommandType::kGetInfo) {
+        PublishAnchor(id);
+      }
+      break;
+  }
+  if (player) {
+    result.info = CurrentInfo(player);
+  }
+  if (command->done) {
+    command->done(result);
+  }
+}
+
+void PlaybackEngine::ExecutePlayerCommand(int id, Command* command,
+                                          Player* player,
+                                          CommandResult* result) {
+  PlaybackBackend* backend = player->backend.get();
+  std::string error;
+  switch (command->type) {
+    case CommandType::kPlay:
+      if (!player->loaded) {
+        result->error_code = "PLAY_ERROR";
+        result->error_message = "No MIDI file loaded";
+        break;
+      }
+      if (player->state == PlaybackState::kPlaying) {
+        break;
+      }
+      // After a stop or the end of the file, start again from the top.
+      if (player->state == PlaybackState::kStopped) {
+        backend->Seek(0, &error);
+      }
+      if (backend->Play(&error)) {
+        player->state = PlaybackState::kPlaying;
+      } else {
+        result->error_code = "PLAY_ERROR";
+        result->error_message = error;
+      }
+      break;
+    case CommandType::kPause:
+      if (player->state != PlaybackState::kPlaying) {
+        break;
+      }
+      if (backend->Pause(&error)) {
+        player->state = PlaybackState::kPaused;
+      } else {
+        result->error_code = "PAUSE_ERROR";
+        result->error_message = "Failed to pause";
+      }
+      break;
+    case CommandType::kStop:
+      if (!player->loaded) {
+        break;
+      }
+      if (backend->Stop(&error)) {
+        backend->Seek(0, &error);
+        player->state = PlaybackState::kStopped;
+      } else {
+        result->error_code = "STOP_ERROR";
+        result->error_message = "Failed to stop";
+      }
+      break;
+    case CommandType::kSeek: {
+      const Clock::time_point start = Clock::now();
+      if (!player->loaded) {
+        result->error_code = "SEEK_ERROR";
+        result->error_message = "No MIDI file loaded";
+        break;
+      }
+      uint32_t target =
+          std::min(command->position_ms, player->duration_ms);
+      if (!backend->Seek(target, &error)) {
+        result->error_code = "SEEK_ERROR";
+        result->error_message = error;
+        break;
+      }
+      // Keep playing across a seek, like a scrubbed progress bar expects.
+      if (player->state == PlaybackState::kPlaying && !backend->Play(&error)) {
+        player->state = PlaybackState::kPaused;
+      }
+      stats_.seek_latency.Record(MicrosecondsSince(start));
+      break;
+    }
+    case CommandType::kSetVolume:
+      backend->SetVolume(std::clamp(command->value, 0.0, 1.0));
+      break;
+    case CommandType::kSetSpeed:
+      // Backends that cannot change rate keep playing at normal speed.
+      if (command->value > 0.0 && backend->SetSpeed(command->value)) {
+        player->speed = command->value;
+      }
+      break;
+    case CommandType::kEnqueue:
+      player->queue.push_back(std::move(command->path));
+      SchedulePreload(id, player);
+      break;
+    case CommandType::kSetQueue:
+      DropPreload(player);
+      player->queue.assign(std::make_move_iterator(command->paths.begin()),
+                           std::make_move_iterator(command->paths.end()));
+      SchedulePreload(id, player);
+      break;
+    case CommandType::kNext:
+      // Execute() loads the next file when there is one.
+      result->error_code = "QUEUE_EMPTY";
+      result->error_message = "No queued MIDI file";
+      break;
+    default:
+      break;
+  }
+  // Everything but volume, speed, queue edits and info queries can change
+  // what a listener shows.
+  if (command->type != CommandType::kSetVolume &&
+      command->type != CommandType::kSetSpeed &&
+      command->type != CommandType::kEnqueue &&
+      command->type != CommandType::kSetQueue &&
+      command->type != CommandType::kGetInfo) {
+    player->progress_dirty = true;
+  }
+  player->deadline = Clock::time_point::min();
+}
+
+void PlaybackEngine::StartLoad(int id, Player* player, Command* command) {
+  CancelLoad(id, player);
+  // Opening a file unchains whatever was queued behind the old one.
+  DropPreload(player);
+  player->load_cancel = std::make_shared<std::atomic<bool>>(false);
+  player->load_done = std::move(command->done);
+  LoadJob job;
+  job.player = id;
+  job.cancel = player->load_cancel;
+  job.path = std::move(command->path);
+  job.bytes = std::move(command->bytes);
+  job.from_bytes = command->type == CommandType::kLoadBytes;
+  job.streaming_threshold =
+      player->backend->CanStream()
+          ? streaming_threshold_.load(std::memory_order_relaxed)
+          : 0;
+  PostLoadJob(std::move(job));
+}
+
+void PlaybackEngine::PostLoadJob(LoadJob job) {
+  loader_.Post([this, job = std::move(job)]() mutable {
+    LoadOutcome outcome;
+    ParseInBackground(&job, &outcome);
+    // The engine drains every pass, so this only waits if it is far
+    // behind.
+    while (!loads_.TryPush(std::move(outcome))) {
+      if (quit_.load(std::memory_order_acquire)) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+    Wake();
+  });
+}
+
+void PlaybackEngine::CancelLoad(int id, Player* player) {
+  if (!player->load_cancel) {
+    return;
+  }
+  player->load_cancel->store(true, std::memory_order_relaxed);
+  CommandResult result;
+  result.player = id;
+  result.error_code = "LOAD_CANCELLED";
+  result.error_message = "Superseded by a newer load";
+  CompleteLoad(id, player, &result);
+}
+
+void PlaybackEngine::AbandonLoad(int id, Player* player) {
+  if (player->load_cancel) {
+    player->load_cancel->store(true, std::memory_order_relaxed);
+    player->load_cancel.reset();
+  }
+  CommandResult result;
+  result.player = id;
+  result.error_code = "INVALID_ARGUMENT";
+  result.error_message = "Player disposed";
+  CommandCallback done = std::move(player->load_done);
+  player->load_done = nullptr;
+  if (done) {
+    done(result);
+  }
+  // Failed rather than run: a next or load among them would start another
+  // load for the player, whose reply would never come.
+  std::deque<Command> deferred;
+  deferred.swap(player->deferred);
+  for (Command& command : deferred) {
+    if (command.done) {
+      command.done(result);
+    }
+  }
+}
+
+void PlaybackEngine::AdvanceQueue(int id, Player* player, bool autoplay,
+                                  CommandCallback done) {
+  Command command;
+  command.type = CommandType::kLoad;
+  command.player = id;
+  command.path = std::move(player->queue.front());
+  command.done = std::move(done);
+  player->queue.pop_front();
+  StartLoad(id, player, &command);
+  player->load_autoplay = autoplay;
+}
+
+void PlaybackEngine::SchedulePreload(int id, Player* player) {
+  if (!player->loaded || player->load_cancel || player->queue.empty() ||
+      player->preload_cancel || player->preloaded) {
+    return;
+  }
+  player->preload_cancel = std::make_shared<std::atomic<bool>>(false);
+  LoadJob job;
+  job.player = id;
+  job.cancel = player->preload_cancel;
+  job.path = player->queue.front();
+  job.preload = true;
+  PostLoadJob(std::move(job));
+}
+
+void PlaybackEngine::DropPreload(Player* player) {
+  if (player->preload_cancel) {
+    player->preload_cancel->store(true, std::memory_order_relaxed);
+    player->preload_cancel.reset();
+  }
+  if (player->chained) {
+    std::string ignored;
+    player->backend->Chain(std::string(), nullptr, &ignored);
+  }
+  player->preloaded = false;
+  player->chained = false;
+}
+
+void PlaybackEngine::ParseInBackground(LoadJob* job, LoadOutcome* outcome) {
+  outcome->player = job->player;
+  outcome->cancel = job->cancel;
+  outcome->preload = job->preload;
+  outcome->source = job->from_bytes ? "<memory>" : job->path;
+  // Superseded while it waited behind another load.
+  if (job->cancel->load(std::memory_order_relaxed)) {
+    outcome->error_code = "LOAD_CANCELLED";
+    return;
+  }
+  std::string error;
+  if (job->from_bytes) {
+    outcome->sequence = cache_->LoadBytes(job->bytes.data(), job->bytes.size(),
+                                          &error, job->cancel.get());
+    // The sequence is self-contained; release the bytes now.
+    std::vector<uint8_t>().swap(job->bytes);
+    if (!outcome->sequence) {
+      outcome->error_code = "LOAD_ERROR";
+      outcome->error_message = error;
+    }
+  } else {
+    FileStamp stamp;
+    // Missing files are reported by the compiling path.
+    if (job->streaming_threshold > 0 &&
+        StatFileUtf8(job->path, &stamp, &error) &&
+        stamp.size >= job->streaming_threshold) {
+      std::unique_ptr<SequenceStream> stream =
+          SequenceStream::Open(job->path, &error);
+      if (!stream) {
+        outcome->error_code = "LOAD_ERROR";
+        outcome->error_message = error + " Path: " + job->path;
+        return;
+      }
+      outcome->duration_ms = stream->duration_ms();
+      outcome->stream = std::move(stream);
+      return;
+    }
+    outcome->sequence = cache_->Load(job->path, &error, job->cancel.get());
+    if (!outcome->sequence) {
+      bool missing = error == "File not found";
+      outcome->error_code = missing ? "FILE_NOT_FOUND" : "LOAD_ERROR";
+      outcome->error_message = missing ? error : error + " Path: " + job->path;
+    }
+  }
+  if (error == SequenceCache::kCancelledError) {
+    outcome->error_code = "LOAD_CANCELLED";
+  }
+}
+
+void PlaybackEngine::DrainLoads() {
+  LoadOutcome outcome;
+  while (loads_.TryPop(&outcome)) {
+    FinishLoad(&outcome);
+    if (progress_listener_) {
+      PublishProgress(Clock::now());
+    }
+  }
+}
+
+void PlaybackEngine::FinishLoad(LoadOutcome* outcome) {
+  if (outcome->preload) {
+    FinishPreload(outcome);
+    return;
+  }
+  const int id = outcome->player;
+  Player* player = players_[id].get();
+  // A cancelled load was answered when it was superseded.
+  if (!player || player->load_cancel != outcome->cancel) {
+    return;
+  }
+  CommandResult result;
+  result.player = id;
+  if (!outcome->error_code.empty()) {
+    result.error_code = outcome->error_code;
+    result.error_message = outcome->error_message;
+  } else if (outcome->stream) {
+    std::string error;
+    bool opened = player->backend->OpenStream(
+        outcome->source, std::move(outcome->stream), &error);
+    FinishOpen(player, outcome->source, opened, outcome->duration_ms, error,
+               &result);
+  } else {
+    OpenSequence(player, outcome->source, std::move(outcome->sequence),
+                 &result);
+  }
+  if (result.ok() && player->load_autoplay) {
+    std::string error;
+    if (player->backend->Play(&error)) {
+      player->state = PlaybackState::kPlaying;
+    }
+  }
+  player->load_autoplay = false;
+  CompleteLoad(id, player, &result);
+  SchedulePreload(id, player);
+}
+
+void PlaybackEngine::FinishPreload(LoadOutcome* outcome) {
+  const int id = outcome->player;
+  Player* player = players_[id].get();
+  // Dropped since, by a load or a queue change.
+  if (!player || player->preload_cancel != outcome->cancel) {
+    return;
+  }
+  player->preload_cancel.reset();
+  if (!outcome->error_code.empty()) {
+    // Skip a queued file that cannot be played.
+    player->queue.pop_front();
+    SchedulePreload(id, player);
+    return;
+  }
+  player->preloaded = true;
+  uint32_t duration_ms = outcome->sequence->duration_ms();
+  std::string error;
+  if (player->backend->Chain(outcome->source, std::move(outcome->sequence),
+                             &error)) {
+    player->chained = true;
+    player->chained_duration_ms = duration_ms;
+  }
+}
+
+void PlaybackEngine::CompleteLoad(int id, Player* player,
+                                  CommandResult* result) {
+  player->load_cancel.reset();
+  player->progress_dirty = true;
+  player->deadline = Clock::time_point::min();
+  PublishAnchor(id);
+  result->info = CurrentInfo(player);
+  CommandCallback done = std::move(player->load_done);
+  player->load_done = nullptr;
+  if (done) {
+    done(*result);
+  }
+  std::deque<Command> deferred;
+  deferred.swap(player->deferred);
+  for (Command& command : deferred) {
+    Execute(&command);
+  }
+}
+
+void PlaybackEngine::OpenSequence(Player* player, const std::string& source,
+                                  std::shared_ptr<const Sequence> sequence,
+                                  CommandResult* result) {
+  std::string error;
+  uint32_t duration_ms = sequence->duration_ms();
+  bool opened = player->backend->Open(source, std::move(sequence), &error);
+  FinishOpen(player, source, opened, duration_ms, error, result);
+}
+
+void PlaybackEngine::FinishOpen(Player* player, const std::string& source,
+                                bool opened, uint32_t duration_ms,
+                                const std::string& error,
+                                CommandResult* result) {
+  player->state = PlaybackState::kStopped;
+  // On failure the backend closed the previous file.
+  player->loaded = opened;
+  player->duration_ms = opened ? duration_ms : 0;
+  if (!opened) {
+    result->error_code = "LOAD_ERROR";
+    result->error_message = error + " Path: " + source;
+  }
+}
+
+PlaybackEngine::Clock::time_point PlaybackEngine::PublishProgress(
+    Clock::time_point now) {
+  Clock::time_point next = Clock::time_point::max();
+  for (int id = 0; id < kMaxPlayers; ++id) {
+    Player* player = players_[id].get();
+    if (!player) {
+      continue;
+    }
+    bool playing = player->state == PlaybackState::kPlaying;
+    if (player->progress_dirty || (playing && now >= player->next_progress)) {
+      progress_listener_(id, CurrentInfo(player));
+      player->progress_dirty = false;
+      player->next_progress = now + progress_interval_;
+    }
+    if (playing) {
+      next = std::min(next, player->next_progress);
+    }
+  }
+  return next;
+}
+
+PlaybackInfo PlaybackEngine::Snapshot(int player,
+                                      Clock::time_point now) const {
+  if (player < 0 || player >= kMaxPlayers) {
+    return PlaybackInfo();
+  }
+  Anchor anchor = anchors_[player].Load();
+  PlaybackInfo info;
+  info.state = anchor.state;
+  info.duration_ms = anchor.duration_ms;
+  uint64_t position_us = anchor.position_us;
+  int64_t elapsed_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          now.time_since_epoch())
+          .count() -
+      anchor.time_ns;
+  if (anchor.state == PlaybackState::kPlaying && elapsed_ns > 0) {
+    position_us += static_cast<uint64_t>(elapsed_ns / 1000 * anchor.speed);
+  }
+  info.position_ms = static_cast<uint32_t>(
+      std::min<uint64_t>(position_us / 1000, info.duration_ms));
+  return info;
+}
+
+void PlaybackEngine::PublishAnchor(int id) {
+  Anchor anchor;
+  anchor.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       Clock::now().time_since_epoch())
+                       .count();
+  // A disposed player reads as stopped and empty.
+  if (const Player* player = players_[id].get()) {
+    anchor.state = player->state;
+    anchor.speed = player->speed;
+    if (player->loaded) {
+      anchor.duration_ms = player->duration_ms;
+      anchor.position_us =
+          static_cast<uint64_t>(player->backend->PositionMs()) * 1000;
+    }
+  }
+  anchors_[id].Store(anchor);
+}
+
+PlaybackInfo PlaybackEngine::CurrentInfo(Player* player) {
+  PlaybackInfo info;
+  info.state = player->state;
+  if (player->loaded) {
+    info.duration_ms = player->duration_ms;
+    info.position_ms =
+        std::min(player->backend->PositionMs(), info.duration_ms);
+  }
+  return info;
+}
+
+}  // namespace playmidifile
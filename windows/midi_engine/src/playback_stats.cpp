@@ -0,0 +1,113 @@
+#include "midi_engine/playback_stats.h"
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace playmidifile {
+
+namespace {
+
+// Number of significant bits in |value|; 0 for 0.
+size_t BitWidth(uint64_t value) {
+  if (value == 0) {
+    return 0;
+  }
+#if defined(_MSC_VER)
+  unsigned long index;
+  _BitScanReverse64(&index, value);
+  return static_cast<size_t>(index) + 1;
+#else
+  return 64 - static_cast<size_t>(__builtin_clzll(value));
+#endif
+}
+
+// Largest value that lands in |bucket|.
+uint64_t BucketLimit(size_t bucket) {
+  return bucket == 0 ? 0 : (uint64_t{1} << bucket) - 1;
+}
+
+}  // namespace
+
+StatsHistogram::StatsHistogram() { Reset(); }
+
+void StatsHistogram::Record(uint64_t value) {
+  size_t bucket = std::min(BitWidth(value), kBuckets - 1);
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+HistogramSummary StatsHistogram::Summary() const {
+  uint64_t buckets[kBuckets];
+  uint64_t count = 0;
+  for (size_t i = 0; i < kBuckets; ++i) {
+    buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+    count += buckets[i];
+  }
+  HistogramSummary summary;
+  // Counted from the buckets so the percentiles are self-consistent while
+  // samples keep arriving.
+  summary.count = count;
+  summary.max = max_.load(std::memory_order_relaxed);
+  if (count == 0) {
+    return summary;
+  }
+  uint64_t recorded = std::max<uint64_t>(
+      count_.load(std::memory_order_relaxed), 1);
+  summary.mean = static_cast<double>(sum_.load(std::memory_order_relaxed)) /
+                 static_cast<double>(recorded);
+  auto percentile = [&](uint64_t per_mille) {
+    // The smallest bucket covering ceil(count * per_mille / 1000) samples.
+    uint64_t wanted = (count * per_mille + 999) / 1000;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += buckets[i];
+      if (seen >= wanted) {
+        return std::min(BucketLimit(i), summary.max);
+      }
+    }
+    return summary.max;
+  };
+  summary.p50 = percentile(500);
+  summary.p90 = percentile(900);
+  summary.p99 = percentile(990);
+  return summary;
+}
+
+void StatsHistogram::Reset() {
+  for (std::atomic<uint64_t>& bucket : buckets_) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+PlaybackStatsSnapshot PlaybackStats::Snapshot() const {
+  PlaybackStatsSnapshot snapshot;
+  snapshot.dispatch_lateness_us = dispatch_lateness.Summary();
+  snapshot.service_duration_us = service_duration.Summary();
+  snapshot.audio_callback_us = audio_callback.Summary();
+  snapshot.command_queue_depth = command_queue_depth.Summary();
+  snapshot.seek_latency_us = seek_latency.Summary();
+  snapshot.underruns = underruns.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void PlaybackStats::Reset() {
+  dispatch_lateness.Reset();
+  service_duration.Reset();
+  audio_callback.Reset();
+  underruns.store(0, std::memory_order_relaxed);
+  command_queue_depth.Reset();
+  seek_latency.Reset();
+}
+
+}  // namespace playmidifile
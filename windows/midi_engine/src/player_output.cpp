@@ -0,0 +1,100 @@
+#include "midi_engine/player_output.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+namespace playmidifile {
+
+namespace {
+
+constexpr uint8_t kControlVolume = 7;
+constexpr uint8_t kControlSustain = 64;
+constexpr uint8_t kControlAllNotesOff = 123;
+// The General MIDI power-on channel volume.
+constexpr uint8_t kDefaultChannelVolume = 100;
+
+}  // namespace
+
+PlayerOutput::PlayerOutput(MidiOutput* output)
+    : output_(output), volume_(1.0), used_channels_(0) {
+  std::fill(std::begin(channel_volume_), std::end(channel_volume_),
+            kDefaultChannelVolume);
+  std::memset(sounding_, 0, sizeof(sounding_));
+}
+
+void PlayerOutput::SendChannelMessage(uint8_t status, uint8_t data1,
+                                      uint8_t data2) {
+  int channel = status & 0x0F;
+  uint16_t bit = static_cast<uint16_t>(1u << channel);
+  uint64_t key_bit = uint64_t{1} << (data1 & 63);
+  uint64_t& keys = sounding_[channel][(data1 >> 6) & 1];
+  switch (status & 0xF0) {
+    case 0x80:
+      keys &= ~key_bit;
+      break;
+    case 0x90:
+      if (data2 == 0) {
+        keys &= ~key_bit;
+      } else {
+        keys |= key_bit;
+      }
+      break;
+    case 0xB0:
+      if (data1 == kControlAllNotesOff) {
+        ReleaseNotes(channel);
+        return;
+      }
+      if (data1 == kControlSustain && !(used_channels_ & bit)) {
+        // Silencing traffic on a channel this player never used.
+        return;
+      }
+      if (data1 == kControlVolume) {
+        used_channels_ |= bit;
+        channel_volume_[channel] = data2;
+        SendVolume(channel);
+        return;
+      }
+      break;
+    default:
+      break;
+  }
+  used_channels_ |= bit;
+  output_->SendChannelMessage(status, data1, data2);
+}
+
+void PlayerOutput::SendSysEx(const uint8_t* data, size_t size) {
+  output_->SendSysEx(data, size);
+}
+
+void PlayerOutput::SetVolume(double volume) {
+  volume_ = std::max(0.0, std::min(1.0, volume));
+  for (int channel = 0; channel < kMidiChannelCount; ++channel) {
+    if (used_channels_ & (1u << channel)) {
+      SendVolume(channel);
+    }
+  }
+}
+
+void PlayerOutput::SendVolume(int channel) {
+  output_->SendChannelMessage(
+      static_cast<uint8_t>(0xB0 | channel), kControlVolume,
+      static_cast<uint8_t>(std::lround(channel_volume_[channel] * volume_)));
+}
+
+void PlayerOutput::ReleaseNotes(int channel) {
+  uint8_t note_off = static_cast<uint8_t>(0x80 | channel);
+  for (int word = 0; word < 2; ++word) {
+    uint64_t keys = sounding_[channel][word];
+    for (int bit = 0; keys != 0; ++bit, keys >>= 1) {
+      if (keys & 1) {
+        output_->SendChannelMessage(note_off,
+                                    static_cast<uint8_t>(word * 64 + bit), 0);
+      }
+    }
+    sounding_[channel][word] = 0;
+  }
+}
+
+}  // namespace playmidifile
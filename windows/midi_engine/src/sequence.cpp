@@ -0,0 +1,240 @@
+#include "midi_engine/sequence.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "midi_engine/thread_pool.h"
+
+namespace playmidifile {
+
+namespace {
+
+// Payload indexes share a 32-bit message word with the status byte.
+constexpr size_t kMaxPayloadRefs = size_t{1} << 24;
+
+// Events between checks of the cancel flag.
+constexpr size_t kCancelCheckInterval = 4096;
+
+bool Cancelled(const std::atomic<bool>* cancel) {
+  return cancel && cancel->load(std::memory_order_relaxed);
+}
+
+}  // namespace
+
+Sequence::Sequence()
+    : ticks_(ArenaAllocator<uint32_t>(&arena_)),
+      messages_(ArenaAllocator<uint32_t>(&arena_)),
+      payload_refs_(ArenaAllocator<PayloadRef>(&arena_)),
+      payloads_(ArenaAllocator<uint8_t>(&arena_)),
+      checkpoints_(ArenaAllocator<ChannelStateSet>(&arena_)) {}
+
+// static
+std::shared_ptr<const Sequence> Sequence::Compile(
+    const MidiFile& file, size_t checkpoint_interval, ThreadPool* pool,
+    const std::atomic<bool>* cancel) {
+  std::shared_ptr<Sequence> sequence(new Sequence());
+  sequence->checkpoint_interval_ = checkpoint_interval;
+  const SmfFile& smf = file.smf();
+  sequence->end_tick_ = file.info().end_tick;
+  sequence->duration_us_ = file.info().duration_us;
+
+  // Each track decodes into its own packed arrays, which only need each
+  // other again for the merge.
+  std::vector<DecodedTrack> tracks(smf.tracks.size());
+  auto decode = [&](size_t index) {
+    DecodeTrack(smf.tracks[index], cancel, &tracks[index]);
+  };
+  if (pool) {
+    pool->ParallelFor(tracks.size(), decode);
+  } else {
+    for (size_t i = 0; i < tracks.size(); ++i) {
+      decode(i);
+    }
+  }
+  if (Cancelled(cancel)) {
+    return nullptr;
+  }
+  sequence->ReserveStorage(tracks, file.info().tempo_map);
+  if (!sequence->Merge(&tracks, cancel)) {
+    return nullptr;
+  }
+  sequence->BuildCheckpoints();
+  return sequence;
+}
+
+// static
+bool Sequence::DecodeTrack(const SmfTrack& track,
+                           const std::atomic<bool>* cancel,
+                           DecodedTrack* decoded) {
+  // Every event takes at least two bytes (a delta and a data byte under
+  // running status), so this bound means the arrays never regrow: one
+  // allocation each instead of a doubling series, and about the same peak
+  // as the series would reach.
+  decoded->ticks.reserve(track.size / 2);
+  decoded->messages.reserve(track.size / 2);
+  TrackReader reader(track);
+  MidiEvent event;
+  uint32_t tick = 0;
+  for (size_t count = 1; reader.Next(&event); ++count) {
+    if (count % kCancelCheckInterval == 0 && Cancelled(cancel)) {
+      return false;
+    }
+    tick += event.delta_ticks;
+    uint32_t message = event.status;
+    if (event.type == MidiEventType::kSysEx) {
+      PayloadRef ref = {static_cast<uint32_t>(decoded->payloads.size()), 0};
+      // Stored as wire bytes: a 0xF0 event's payload omits the status.
+      if (event.status == 0xF0) {
+        decoded->payloads.push_back(0xF0);
+      }
+      decoded->payloads.insert(decoded->payloads.end(), event.payload,
+                               event.payload + event.payload_size);
+      ref.size = static_cast<uint32_t>(decoded->payloads.size()) - ref.offset;
+      // Indexes the track's own refs until the merge renumbers it.
+      message |= static_cast<uint32_t>(decoded->payload_refs.size()) << 8;
+      decoded->payload_refs.push_back(ref);
+    } else if (event.type == MidiEventType::kMeta) {
+      // Tempo is already in the tempo map; other meta events are not
+      // played.
+      continue;
+    } else {
+      message |= static_cast<uint32_t>(event.data1) << 8 |
+                 static_cast<uint32_t>(event.data2) << 16;
+    }
+    decoded->ticks.push_back(tick);
+    decoded->messages.push_back(message);
+  }
+  return true;
+}
+
+void Sequence::ReserveStorage(const std::vector<DecodedTrack>& tracks,
+                              const TempoMap& tempo_map) {
+  size_t events = 0;
+  size_t refs = 0;
+  size_t payload_bytes = 0;
+  for (const DecodedTrack& track : tracks) {
+    events += track.ticks.size();
+    refs += track.payload_refs.size();
+    payload_bytes += track.payloads.size();
+  }
+  refs = std::min(refs, kMaxPayloadRefs);
+  size_t checkpoints =
+      checkpoint_interval_ > 0 ? events / checkpoint_interval_ + 1 : 0;
+  arena_.Reserve(tempo_map.memory_bytes() + alignof(std::max_align_t) +
+                 2 * ArenaBytes<uint32_t>(events) +
+                 ArenaBytes<PayloadRef>(refs) +
+                 ArenaBytes<uint8_t>(payload_bytes) +
+                 ArenaBytes<ChannelStateSet>(checkpoints));
+  tempo_map_ = TempoMap(tempo_map, &arena_);
+  ticks_.reserve(events);
+  messages_.reserve(events);
+  payload_refs_.reserve(refs);
+  payloads_.reserve(payload_bytes);
+  checkpoints_.reserve(checkpoints);
+}
+
+bool Sequence::Merge(std::vector<DecodedTrack>* tracks,
+                     const std::atomic<bool>* cancel) {
+  // Payloads are concatenated in track order; a track's refs are shifted by
+  // where its block starts.
+  std::vector<uint32_t> payload_base(tracks->size());
+  for (size_t i = 0; i < tracks->size(); ++i) {
+    payload_base[i] = static_cast<uint32_t>(payloads_.size());
+    DecodedTrack& track = (*tracks)[i];
+    payloads_.insert(payloads_.end(), track.payloads.begin(),
+                     track.payloads.end());
+    std::vector<uint8_t>().swap(track.payloads);
+  }
+
+  // Min-heap of (next tick, track index). Each track is already in tick
+  // order, and ties go to the lower track, so events at the same tick keep
+  // track order, then file order.
+  using Head = std::pair<uint32_t, uint32_t>;
+  std::vector<Head> heap;
+  heap.reserve(tracks->size());
+  std::vector<size_t> position(tracks->size(), 0);
+  for (size_t i = 0; i < tracks->size(); ++i) {
+    if (!(*tracks)[i].ticks.empty()) {
+      heap.emplace_back((*tracks)[i].ticks[0], static_cast<uint32_t>(i));
+    }
+  }
+  std::greater<Head> later;
+  std::make_heap(heap.begin(), heap.end(), later);
+  for (size_t count = 1; !heap.empty(); ++count) {
+    if (count % kCancelCheckInterval == 0 && Cancelled(cancel)) {
+      return false;
+    }
+    std::pop_heap(heap.begin(), heap.end(), later);
+    const uint32_t index = heap.back().second;
+    const DecodedTrack& track = (*tracks)[index];
+    size_t& at = position[index];
+    uint32_t message = track.messages[at];
+    bool keep = true;
+    if (static_cast<uint8_t>(message) >= 0xF0) {
+      if (payload_refs_.size() == kMaxPayloadRefs) {
+        keep = false;
+      } else {
+        PayloadRef ref = track.payload_refs[message >> 8];
+        ref.offset += payload_base[index];
+        message = (message & 0xFF) |
+                  static_cast<uint32_t>(payload_refs_.size()) << 8;
+        payload_refs_.push_back(ref);
+      }
+    }
+    if (keep) {
+      ticks_.push_back(track.ticks[at]);
+      messages_.push_back(message);
+    }
+    if (++at < track.ticks.size()) {
+      heap.back().first = track.ticks[at];
+      std::push_heap(heap.begin(), heap.end(), later);
+    } else {
+      heap.pop_back();
+    }
+  }
+  return true;
+}
+
+void Sequence::StateAt(size_t event_index, ChannelStateSet* state) const {
+  event_index = std::min(event_index, event_count());
+  size_t start = 0;
+  if (checkpoint_interval_ > 0 && !checkpoints_.empty()) {
+    size_t checkpoint = std::min(event_index / checkpoint_interval_,
+                                 checkpoints_.size() - 1);
+    *state = checkpoints_[checkpoint];
+    start = checkpoint * checkpoint_interval_;
+  } else {
+    state->Reset();
+  }
+  Replay(start, event_index, state);
+}
+
+void Sequence::Replay(size_t begin, size_t end,
+                      ChannelStateSet* state) const {
+  for (size_t i = begin; i < end; ++i) {
+    uint32_t message = messages_[i];
+    uint8_t status = static_cast<uint8_t>(message);
+    if (status < 0xF0) {
+      state->Apply(status, static_cast<uint8_t>(message >> 8),
+                   static_cast<uint8_t>(message >> 16));
+    }
+  }
+}
+
+size_t Sequence::memory_bytes() const {
+  return sizeof(Sequence) + arena_.bytes_used();
+}
+
+void Sequence::BuildCheckpoints() {
+  if (checkpoint_interval_ == 0) {
+    return;
+  }
+  ChannelStateSet state;
+  for (size_t i = 0; i < event_count(); i += checkpoint_interval_) {
+    checkpoints_.push_back(state);
+    Replay(i, std::min(i + checkpoint_interval_, event_count()), &state);
+  }
+}
+
+}  // namespace playmidifile
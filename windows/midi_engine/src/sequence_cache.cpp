@@ -0,0 +1,164 @@
+#include "midi_engine/sequence_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <thread>
+#include <utility>
+
+#include "midi_engine/midi_file.h"
+#include "utf8_path.h"
+
+namespace playmidifile {
+
+namespace {
+
+// 64-bit FNV-1a.
+uint64_t HashBytes(const uint8_t* data, size_t size) {
+  uint64_t hash = 14695981039346656037ull;
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ data[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+int CompileThreads(int requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  int hardware = static_cast<int>(std::thread::hardware_concurrency());
+  return std::max(1, std::min(hardware, SequenceCache::kMaxCompileThreads));
+}
+
+}  // namespace
+
+SequenceCache::SequenceCache(size_t budget_bytes, int compile_threads)
+    : pool_(CompileThreads(compile_threads)) {
+  stats_.budget_bytes = budget_bytes;
+}
+
+SequenceCache::~SequenceCache() = default;
+
+std::shared_ptr<const Sequence> SequenceCache::Load(
+    const std::string& utf8_path, std::string* error,
+    const std::atomic<bool>* cancel) {
+  FileStamp stamp;
+  if (!StatFileUtf8(utf8_path, &stamp, error)) {
+    return nullptr;
+  }
+  std::shared_ptr<const Sequence> sequence =
+      Find(stamp.canonical_path, stamp.size, stamp.mtime);
+  if (sequence) {
+    return sequence;
+  }
+  std::unique_ptr<MidiFile> file = MidiFile::Open(utf8_path, error);
+  if (!file) {
+    return nullptr;
+  }
+  sequence = Sequence::Compile(*file, Sequence::kDefaultCheckpointInterval,
+                               &pool_, cancel);
+  if (!sequence) {
+    *error = kCancelledError;
+    return nullptr;
+  }
+  Insert(stamp.canonical_path, stamp.size, stamp.mtime, sequence);
+  return sequence;
+}
+
+std::shared_ptr<const Sequence> SequenceCache::LoadBytes(
+    const uint8_t* data, size_t size, std::string* error,
+    const std::atomic<bool>* cancel) {
+  // Paths are absolute, so this cannot collide with a file key.
+  char key[32];
+  std::snprintf(key, sizeof(key), "bytes:%016llx",
+                static_cast<unsigned long long>(HashBytes(data, size)));
+  std::shared_ptr<const Sequence> sequence = Find(key, size, 0);
+  if (sequence) {
+    return sequence;
+  }
+  std::unique_ptr<MidiFile> file = MidiFile::Parse(data, size, error);
+  if (!file) {
+    return nullptr;
+  }
+  sequence = Sequence::Compile(*file, Sequence::kDefaultCheckpointInterval,
+                               &pool_, cancel);
+  if (!sequence) {
+    *error = kCancelledError;
+    return nullptr;
+  }
+  Insert(key, size, 0, sequence);
+  return sequence;
+}
+
+void SequenceCache::SetBudget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.budget_bytes = budget_bytes;
+  EvictToBudget();
+}
+
+void SequenceCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  index_.clear();
+  stats_.bytes = 0;
+}
+
+SequenceCacheStats SequenceCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  SequenceCacheStats stats = stats_;
+  stats.entries = entries_.size();
+  return stats;
+}
+
+std::shared_ptr<const Sequence> SequenceCache::Find(const std::string& key,
+                                                    uint64_t size,
+                                                    int64_t mtime) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    EntryList::iterator entry = it->second;
+    if (entry->size == size && entry->mtime == mtime) {
+      ++stats_.hits;
+      entries_.splice(entries_.begin(), entries_, entry);
+      return entry->sequence;
+    }
+    // The file changed since it was cached.
+    Remove(entry);
+  }
+  ++stats_.misses;
+  return nullptr;
+}
+
+void SequenceCache::Insert(const std::string& key, uint64_t size,
+                           int64_t mtime,
+                           const std::shared_ptr<const Sequence>& sequence) {
+  size_t bytes = sequence->memory_bytes();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > stats_.budget_bytes) {
+    return;
+  }
+  // Another thread may have loaded the same file meanwhile.
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    Remove(it->second);
+  }
+  entries_.push_front(Entry{key, size, mtime, sequence, bytes});
+  index_[key] = entries_.begin();
+  stats_.bytes += bytes;
+  EvictToBudget();
+}
+
+void SequenceCache::Remove(EntryList::iterator entry) {
+  stats_.bytes -= entry->bytes;
+  index_.erase(entry->key);
+  entries_.erase(entry);
+}
+
+void SequenceCache::EvictToBudget() {
+  while (stats_.bytes > stats_.budget_bytes) {
+    Remove(std::prev(entries_.end()));
+    ++stats_.evictions;
+  }
+}
+
+}  // namespace playmidifile
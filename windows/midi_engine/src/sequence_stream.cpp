@@ -0,0 +1,463 @@
+#include "midi_engine/sequence_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "utf8_path.h"
+
+namespace playmidifile {
+
+namespace {
+
+constexpr size_t kChunkHeaderSize = 8;
+
+uint32_t ReadBigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint16_t ReadBigEndian16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// std::fseek() and std::ftell() take a long, which is 32 bits on Windows;
+// these reach past 2 GiB.
+bool SeekFile(std::FILE* file, uint64_t offset, int origin) {
+#ifdef _WIN32
+  return _fseeki64(file, static_cast<__int64>(offset), origin) == 0;
+#else
+  return fseeko(file, static_cast<off_t>(offset), origin) == 0;
+#endif
+}
+
+int64_t TellFile(std::FILE* file) {
+#ifdef _WIN32
+  return _ftelli64(file);
+#else
+  return static_cast<int64_t>(ftello(file));
+#endif
+}
+
+bool ReadAt(std::FILE* file, uint64_t offset, void* data, size_t size) {
+  return SeekFile(file, offset, SEEK_SET) &&
+         std::fread(data, 1, size, file) == size;
+}
+
+}  // namespace
+
+// One MTrk chunk, decoded through a buffer that holds a slice of its body.
+struct SequenceStream::Track {
+  // Where the chunk body starts in the file, and its length.
+  uint64_t offset = 0;
+  uint64_t size = 0;
+  // Bytes of the body read into |buffer| so far.
+  uint64_t read = 0;
+  std::vector<uint8_t> buffer;
+  // Undecoded bytes are buffer[begin, end).
+  size_t begin = 0;
+  size_t end = 0;
+  uint8_t running_status = 0;
+  // Where the last Fetch() started in the body, and the running status
+  // then, so a checkpoint can resume at the pending event.
+  uint64_t event_offset = 0;
+  uint8_t event_running_status = 0;
+  bool done = false;
+  bool failed = false;
+  // The pending event, from the last Fetch(). Its payload points into
+  // |buffer| and is only valid until the next Fetch().
+  bool has_event = false;
+  MidiEvent event = {};
+  // Absolute tick of |event|.
+  uint32_t tick = 0;
+};
+
+// static
+std::unique_ptr<SequenceStream> SequenceStream::Open(
+    const std::string& utf8_path, std::string* error, size_t window_events,
+    size_t track_buffer_bytes, size_t checkpoint_interval) {
+  std::unique_ptr<SequenceStream> stream(new SequenceStream(
+      window_events, track_buffer_bytes, checkpoint_interval));
+  stream->file_ = OpenFileUtf8(utf8_path, "rb");
+  if (!stream->file_) {
+    *error = "File not found";
+    return nullptr;
+  }
+  if (!stream->Scan(error)) {
+    return nullptr;
+  }
+  stream->Rewind();
+  stream->Refill();
+  return stream;
+}
+
+SequenceStream::SequenceStream(size_t window_events,
+                               size_t track_buffer_bytes,
+                               size_t checkpoint_interval)
+    : window_capacity_(std::max<size_t>(window_events, 1)),
+      track_buffer_bytes_(std::max<size_t>(track_buffer_bytes, 16)),
+      checkpoint_interval_(checkpoint_interval),
+      file_(nullptr),
+      header_(),
+      tempo_cursor_(&tempo_map_),
+      end_tick_(0),
+      duration_us_(0),
+      window_position_(0),
+      next_event_us_(0),
+      next_event_us_valid_(false) {
+  window_.reserve(window_capacity_);
+}
+
+SequenceStream::~SequenceStream() {
+  if (file_) {
+    std::fclose(file_);
+  }
+}
+
+bool SequenceStream::Scan(std::string* error) {
+  // The same checks as ParseSmf(), reading only the chunk headers.
+  uint8_t header[kChunkHeaderSize + 6];
+  if (!ReadAt(file_, 0, header, sizeof(header)) ||
+      std::memcmp(header, "MThd", 4) != 0) {
+    *error = "Not a Standard MIDI File";
+    return false;
+  }
+  int64_t end = SeekFile(file_, 0, SEEK_END) ? TellFile(file_) : -1;
+  if (end < 0) {
+    *error = "Not a Standard MIDI File";
+    return false;
+  }
+  uint64_t file_size = static_cast<uint64_t>(end);
+  uint32_t header_length = ReadBigEndian32(header + 4);
+  if (header_length < 6 || header_length > file_size - kChunkHeaderSize) {
+    *error = "Invalid MIDI header";
+    return false;
+  }
+  header_.format = ReadBigEndian16(header + kChunkHeaderSize);
+  header_.track_count = ReadBigEndian16(header + kChunkHeaderSize + 2);
+  header_.division = ReadBigEndian16(header + kChunkHeaderSize + 4);
+  if (header_.format > 1) {
+    *error = "Unsupported MIDI format " + std::to_string(header_.format);
+    return false;
+  }
+  if (!TempoMap::IsValidDivision(header_.division)) {
+    *error = "Invalid MIDI time division";
+    return false;
+  }
+
+  uint64_t offset = kChunkHeaderSize + header_length;
+  while (tracks_.size() < header_.track_count &&
+         offset + kChunkHeaderSize <= file_size) {
+    uint8_t chunk[kChunkHeaderSize];
+    if (!ReadAt(file_, offset, chunk, sizeof(chunk))) {
+      break;
+    }
+    uint64_t length = ReadBigEndian32(chunk + 4);
+    uint64_t available = file_size - offset - kChunkHeaderSize;
+    // Some writers get the last chunk length wrong; clamp rather than reject.
+    if (length > available) {
+      length = available;
+    }
+    if (std::memcmp(chunk, "MTrk", 4) == 0) {
+      std::unique_ptr<Track> track(new Track());
+      track->offset = offset + kChunkHeaderSize;
+      track->size = length;
+      tracks_.push_back(std::move(track));
+    }
+    offset += kChunkHeaderSize + length;
+  }
+  if (tracks_.empty()) {
+    *error = "MIDI file contains no tracks";
+    return false;
+  }
+  if (header_.format == 0) {
+    tracks_.resize(1);
+  }
+
+  // The same pass as MidiFile::Load(), but with the tracks merged as
+  // TakeNext() does, meta events included, so that the channel state can be
+  // chased for the checkpoints. The tempo changes come out sorted.
+  std::vector<TempoChange> tempo_changes;
+  bool collect_tempo = !header_.is_smpte();
+  ChannelStateSet state;
+  size_t playable = 0;
+  for (std::unique_ptr<Track>& track : tracks_) {
+    Fetch(track.get());
+  }
+  while (true) {
+    Track* next = nullptr;
+    for (std::unique_ptr<Track>& track : tracks_) {
+      if (track->has_event && (!next || track->tick < next->tick)) {
+        next = track.get();
+      }
+    }
+    if (!next) {
+      break;
+    }
+    const MidiEvent& event = next->event;
+    if (event.type == MidiEventType::kMeta) {
+      if (collect_tempo && event.data1 == kMetaTempo &&
+          event.payload_size >= 3) {
+        uint32_t micros = (static_cast<uint32_t>(event.payload[0]) << 16) |
+                          (static_cast<uint32_t>(event.payload[1]) << 8) |
+                          static_cast<uint32_t>(event.payload[2]);
+        if (micros > 0) {
+          tempo_changes.push_back(TempoChange{next->tick, micros});
+        }
+      }
+    } else {
+      if (checkpoint_interval_ > 0 && playable > 0 &&
+          playable % checkpoint_interval_ == 0) {
+        AddCheckpoint(next->tick, state);
+      }
+      ++playable;
+      if (event.status < 0xF0) {
+        state.Apply(event.status, event.data1, event.data2);
+      }
+    }
+    Fetch(next);
+  }
+  for (std::unique_ptr<Track>& track : tracks_) {
+    if (track->failed) {
+      *error = "Malformed MIDI track data";
+      return false;
+    }
+    end_tick_ = std::max(end_tick_, track->tick);
+  }
+  checkpoints_.shrink_to_fit();
+  checkpoint_tracks_.shrink_to_fit();
+  tempo_map_ = TempoMap(tempo_changes, header_.division);
+  duration_us_ = tempo_map_.TicksToMicros(end_tick_);
+  return true;
+}
+
+void SequenceStream::AddCheckpoint(uint32_t tick,
+                                   const ChannelStateSet& state) {
+  checkpoints_.push_back(Checkpoint{tick, state});
+  for (const std::unique_ptr<Track>& track : tracks_) {
+    TrackPosition position;
+    position.done = !track->has_event;
+    if (track->has_event) {
+      position.offset = track->event_offset;
+      position.tick = track->tick - track->event.delta_ticks;
+      position.running_status = track->event_running_status;
+    }
+    checkpoint_tracks_.push_back(position);
+  }
+}
+
+void SequenceStream::Rewind() {
+  for (std::unique_ptr<Track>& track : tracks_) {
+    Resume(track.get(), TrackPosition());
+  }
+  ResetWindow();
+}
+
+void SequenceStream::Restore(size_t index) {
+  const TrackPosition* positions =
+      checkpoint_tracks_.data() + index * tracks_.size();
+  for (size_t i = 0; i < tracks_.size(); ++i) {
+    Resume(tracks_[i].get(), positions[i]);
+  }
+  ResetWindow();
+}
+
+void SequenceStream::Resume(Track* track, const TrackPosition& position) {
+  track->read = position.offset;
+  track->begin = 0;
+  track->end = 0;
+  track->running_status = position.running_status;
+  track->done = position.done;
+  track->failed = false;
+  track->tick = position.tick;
+  FetchPlayable(track);
+}
+
+void SequenceStream::ResetWindow() {
+  // The tempo cursor only walks forward.
+  tempo_cursor_ = TempoMap::Cursor(&tempo_map_);
+  window_.clear();
+  window_payloads_.clear();
+  window_position_ = 0;
+  next_event_us_valid_ = false;
+}
+
+bool SequenceStream::Fetch(Track* track) {
+  track->has_event = false;
+  track->event_offset = track->read - (track->end - track->begin);
+  track->event_running_status = track->running_status;
+  while (!track->done) {
+    SmfTrack view = {track->buffer.data() + track->begin,
+                     track->end - track->begin};
+    TrackReader reader(view, track->running_status);
+    if (reader.Next(&track->event)) {
+      track->begin += reader.offset();
+      track->running_status = reader.running_status();
+      track->tick += track->event.delta_ticks;
+      // Set once the end-of-track event was decoded.
+      track->done = reader.finished();
+      track->has_event = true;
+      return true;
+    }
+    if (track->read == track->size) {
+      // The whole body was buffered, so this is the real end of the track.
+      track->failed = reader.failed();
+      track->done = true;
+      break;
+    }
+    // The event straddles the end of the buffer.
+    if (!ReadMore(track)) {
+      track->failed = true;
+      track->done = true;
+    }
+  }
+  return false;
+}
+
+void SequenceStream::FetchPlayable(Track* track) {
+  while (Fetch(track) && track->event.type == MidiEventType::kMeta) {
+  }
+}
+
+bool SequenceStream::ReadMore(Track* track) {
+  if (track->buffer.empty()) {
+    track->buffer.resize(static_cast<size_t>(
+        std::min<uint64_t>(track_buffer_bytes_, track->size)));
+  }
+  size_t pending = track->end - track->begin;
+  if (pending > 0 && track->begin > 0) {
+    std::memmove(track->buffer.data(), track->buffer.data() + track->begin,
+                 pending);
+  }
+  track->begin = 0;
+  track->end = pending;
+  if (pending == track->buffer.size()) {
+    // A single event larger than the buffer, e.g. a long sysex dump.
+    track->buffer.resize(track->buffer.size() * 2);
+  }
+  size_t wanted = static_cast<size_t>(std::min<uint64_t>(
+      track->buffer.size() - pending, track->size - track->read));
+  if (!ReadAt(file_, track->offset + track->read,
+              track->buffer.data() + pending, wanted)) {
+    return false;
+  }
+  track->end += wanted;
+  track->read += wanted;
+  return true;
+}
+
+bool SequenceStream::TakeNext(SequenceEvent* event) {
+  // Few tracks, so a linear scan beats a heap. Ties go to the lower track,
+  // which is the order Sequence::Compile()'s stable sort produces.
+  Track* next = nullptr;
+  for (std::unique_ptr<Track>& track : tracks_) {
+    if (track->has_event && (!next || track->tick < next->tick)) {
+      next = track.get();
+    }
+  }
+  if (!next) {
+    return false;
+  }
+  const MidiEvent& source = next->event;
+  *event = SequenceEvent{next->tick, source.status, source.data1,
+                         source.data2, 0, 0};
+  if (source.type == MidiEventType::kSysEx) {
+    event->payload_offset = static_cast<uint32_t>(window_payloads_.size());
+    // Stored as wire bytes: a 0xF0 event's payload omits the status.
+    if (source.status == 0xF0) {
+      window_payloads_.push_back(0xF0);
+    }
+    window_payloads_.insert(window_payloads_.end(), source.payload,
+                            source.payload + source.payload_size);
+    event->payload_size =
+        static_cast<uint32_t>(window_payloads_.size()) - event->payload_offset;
+  }
+  FetchPlayable(next);
+  return true;
+}
+
+void SequenceStream::Refill() {
+  window_.clear();
+  window_payloads_.clear();
+  window_position_ = 0;
+  SequenceEvent event;
+  while (window_.size() < window_capacity_ && TakeNext(&event)) {
+    window_.push_back(event);
+  }
+}
+
+const SequenceEvent* SequenceStream::Peek(uint64_t* micros) {
+  if (window_position_ >= window_.size()) {
+    return nullptr;
+  }
+  const SequenceEvent& event = window_[window_position_];
+  if (!next_event_us_valid_) {
+    next_event_us_ = tempo_cursor_.TicksToMicros(event.tick);
+    next_event_us_valid_ = true;
+  }
+  *micros = next_event_us_;
+  return &event;
+}
+
+const uint8_t* SequenceStream::Payload(const SequenceEvent& event) const {
+  return window_payloads_.data() + event.payload_offset;
+}
+
+void SequenceStream::Advance() {
+  ++window_position_;
+  next_event_us_valid_ = false;
+  if (window_position_ >= window_.size()) {
+    Refill();
+  }
+}
+
+void SequenceStream::Seek(uint64_t position_us, ChannelStateSet* state) {
+  uint32_t target_tick = tempo_map_.MicrosToTicks(position_us);
+  // Resume from the last checkpoint before the target tick. One exactly at
+  // it could come after events at that tick, which must be played.
+  auto checkpoint = std::lower_bound(
+      checkpoints_.begin(), checkpoints_.end(), target_tick,
+      [](const Checkpoint& checkpoint, uint32_t tick) {
+        return checkpoint.tick < tick;
+      });
+  if (checkpoint == checkpoints_.begin()) {
+    Rewind();
+    state->Reset();
+  } else {
+    size_t index = static_cast<size_t>(checkpoint - checkpoints_.begin()) - 1;
+    Restore(index);
+    *state = checkpoints_[index].state;
+  }
+  SequenceEvent event;
+  while (true) {
+    // Only the payload of the event that starts the window is kept.
+    window_payloads_.clear();
+    if (!TakeNext(&event)) {
+      break;
+    }
+    if (event.tick >= target_tick) {
+      window_.push_back(event);
+      break;
+    }
+    if (event.status < 0xF0) {
+      state->Apply(event.status, event.data1, event.data2);
+    }
+  }
+  while (window_.size() < window_capacity_ && TakeNext(&event)) {
+    window_.push_back(event);
+  }
+}
+
+size_t SequenceStream::memory_bytes() const {
+  size_t bytes = sizeof(SequenceStream) +
+                 window_.capacity() * sizeof(SequenceEvent) +
+                 window_payloads_.capacity() + tempo_map_.memory_bytes() +
+                 checkpoints_.capacity() * sizeof(Checkpoint) +
+                 checkpoint_tracks_.capacity() * sizeof(TrackPosition);
+  for (const std::unique_ptr<Track>& track : tracks_) {
+    bytes += sizeof(Track) + track->buffer.capacity();
+  }
+  return bytes;
+}
+
+}  // namespace playmidifile
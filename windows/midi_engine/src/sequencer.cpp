@@ -0,0 +1,183 @@
+#include "midi_engine/sequencer.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "midi_engine/channel_state.h"
+
+namespace playmidifile {
+
+Sequencer::Sequencer(MidiOutput* output)
+    : output_(output),
+      stats_(nullptr),
+      running_(false),
+      transitioned_(false),
+      finished_(false),
+      speed_(1.0),
+      anchor_song_us_(0) {}
+
+void Sequencer::Load(std::shared_ptr<const Sequence> sequence) {
+  Load(std::make_unique<SequenceCursor>(std::move(sequence)));
+}
+
+void Sequencer::Load(std::unique_ptr<EventCursor> events) {
+  if (running_) {
+    SilenceAllChannels(output_);
+  }
+  events_ = std::move(events);
+  next_.reset();
+  transitioned_ = false;
+  running_ = false;
+  finished_ = false;
+  anchor_song_us_ = 0;
+}
+
+void Sequencer::Unload() {
+  if (running_) {
+    SilenceAllChannels(output_);
+  }
+  events_.reset();
+  next_.reset();
+  transitioned_ = false;
+  running_ = false;
+  finished_ = false;
+}
+
+void Sequencer::Chain(std::shared_ptr<const Sequence> next) {
+  if (!next) {
+    next_.reset();
+    return;
+  }
+  Chain(std::make_unique<SequenceCursor>(std::move(next)));
+}
+
+void Sequencer::Chain(std::unique_ptr<EventCursor> next) {
+  next_ = std::move(next);
+}
+
+bool Sequencer::TakeTransition() {
+  bool transitioned = transitioned_;
+  transitioned_ = false;
+  return transitioned;
+}
+
+void Sequencer::Play(Clock::time_point now) {
+  if (!events_ || running_) {
+    return;
+  }
+  finished_ = false;
+  running_ = true;
+  anchor_wall_ = now;
+}
+
+void Sequencer::Pause(Clock::time_point now) {
+  if (!running_) {
+    return;
+  }
+  anchor_song_us_ = PositionUs(now);
+  running_ = false;
+  SilenceAllChannels(output_);
+}
+
+void Sequencer::Seek(uint64_t position_us, Clock::time_point now) {
+  if (!events_) {
+    return;
+  }
+  position_us = std::min(position_us, events_->duration_us());
+  SilenceAllChannels(output_);
+
+  ChannelStateSet state;
+  events_->Seek(position_us, &state);
+  state.Emit(output_);
+
+  anchor_song_us_ = position_us;
+  anchor_wall_ = now;
+  finished_ = false;
+}
+
+void Sequencer::SetSpeed(double speed, Clock::time_point now) {
+  if (speed <= 0.0) {
+    return;
+  }
+  if (running_) {
+    anchor_song_us_ = PositionUs(now);
+    anchor_wall_ = now;
+  }
+  speed_ = speed;
+}
+
+Sequencer::Clock::time_point Sequencer::Dispatch(Clock::time_point now) {
+  if (!running_) {
+    return Clock::time_point::max();
+  }
+  // Due-ness is decided in the wall-clock domain with the same rounding
+  // used for the returned deadline, so waking at a deadline always makes
+  // progress.
+  uint64_t event_us = 0;
+  const SequenceEvent* event = events_->Peek(&event_us);
+  Clock::time_point deadline;
+  while (true) {
+    while (event != nullptr && (deadline = DeadlineFor(event_us)) <= now) {
+      if (stats_) {
+        stats_->dispatch_lateness.Record(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(now -
+                                                                  deadline)
+                .count()));
+      }
+      Send(*event);
+      events_->Advance();
+      event = events_->Peek(&event_us);
+    }
+    if (event != nullptr) {
+      return deadline;
+    }
+    // Trailing silence up to the end of the longest track still counts.
+    Clock::time_point end = DeadlineFor(events_->duration_us());
+    if (end > now) {
+      return end;
+    }
+    if (!next_) {
+      break;
+    }
+    // The chained piece starts where this one ends, not where the engine
+    // happened to notice, so late wakeups do not open a gap.
+    SilenceAllChannels(output_);
+    events_ = std::move(next_);
+    anchor_song_us_ = 0;
+    anchor_wall_ = end;
+    transitioned_ = true;
+    event = events_->Peek(&event_us);
+  }
+  anchor_song_us_ = events_->duration_us();
+  running_ = false;
+  finished_ = true;
+  SilenceAllChannels(output_);
+  return Clock::time_point::max();
+}
+
+uint64_t Sequencer::PositionUs(Clock::time_point now) const {
+  if (!running_ || now <= anchor_wall_) {
+    return anchor_song_us_;
+  }
+  double elapsed_us =
+      std::chrono::duration<double, std::micro>(now - anchor_wall_).count();
+  return anchor_song_us_ + static_cast<uint64_t>(elapsed_us * speed_);
+}
+
+Sequencer::Clock::time_point Sequencer::DeadlineFor(uint64_t song_us) const {
+  double wall_us =
+      static_cast<double>(song_us - std::min(song_us, anchor_song_us_)) /
+      speed_;
+  return anchor_wall_ + std::chrono::ceil<Clock::duration>(
+                            std::chrono::duration<double, std::micro>(wall_us));
+}
+
+void Sequencer::Send(const SequenceEvent& event) {
+  if (event.status >= 0xF0) {
+    output_->SendSysEx(events_->Payload(event), event.payload_size);
+  } else {
+    output_->SendChannelMessage(event.status, event.data1, event.data2);
+  }
+}
+
+}  // namespace playmidifile
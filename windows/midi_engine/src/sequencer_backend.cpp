@@ -0,0 +1,78 @@
+#include "midi_engine/sequencer_backend.h"
+
+#include <utility>
+
+namespace playmidifile {
+
+SequencerBackend::SequencerBackend(MidiOutput* output)
+    : output_(output), sequencer_(output) {}
+
+SequencerBackend::SequencerBackend(std::unique_ptr<MidiOutput> output)
+    : owned_output_(std::move(output)),
+      output_(owned_output_.get()),
+      sequencer_(output_) {}
+
+SequencerBackend::~SequencerBackend() { Close(); }
+
+bool SequencerBackend::Open(const std::string& path,
+                            std::shared_ptr<const Sequence> sequence,
+                            std::string* error) {
+  sequencer_.Load(std::move(sequence));
+  return true;
+}
+
+bool SequencerBackend::OpenStream(const std::string& path,
+                                  std::unique_ptr<EventCursor> events,
+                                  std::string* error) {
+  sequencer_.Load(std::move(events));
+  return true;
+}
+
+void SequencerBackend::Close() { sequencer_.Unload(); }
+
+bool SequencerBackend::Chain(const std::string& path,
+                             std::shared_ptr<const Sequence> next,
+                             std::string* error) {
+  sequencer_.Chain(std::move(next));
+  return true;
+}
+
+bool SequencerBackend::Play(std::string* error) {
+  sequencer_.Play(Clock::now());
+  return true;
+}
+
+bool SequencerBackend::Pause(std::string* error) {
+  sequencer_.Pause(Clock::now());
+  return true;
+}
+
+bool SequencerBackend::Stop(std::string* error) {
+  sequencer_.Pause(Clock::now());
+  return true;
+}
+
+bool SequencerBackend::Seek(uint32_t position_ms, std::string* error) {
+  sequencer_.Seek(static_cast<uint64_t>(position_ms) * 1000, Clock::now());
+  return true;
+}
+
+void SequencerBackend::SetVolume(double volume) { output_->SetVolume(volume); }
+
+bool SequencerBackend::SetSpeed(double speed) {
+  sequencer_.SetSpeed(speed, Clock::now());
+  return true;
+}
+
+uint32_t SequencerBackend::PositionMs() {
+  return static_cast<uint32_t>(sequencer_.PositionUs(Clock::now()) / 1000);
+}
+
+PlaybackBackend::Clock::time_point SequencerBackend::Service(
+    Clock::time_point now, bool* finished) {
+  Clock::time_point deadline = sequencer_.Dispatch(now);
+  *finished = sequencer_.finished();
+  return deadline;
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,192 @@
+#include "midi_engine/smf_parser.h"
+
+#include <cstring>
+
+#include "midi_engine/tempo_map.h"
+
+namespace playmidifile {
+
+namespace {
+
+constexpr size_t kChunkHeaderSize = 8;
+
+uint32_t ReadBigEndian32(const uint8_t* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) |
+         (static_cast<uint32_t>(p[1]) << 16) |
+         (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+uint16_t ReadBigEndian16(const uint8_t* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// Number of data bytes following a channel status byte.
+int ChannelMessageLength(uint8_t status) {
+  switch (status & 0xF0) {
+    case 0xC0:
+    case 0xD0:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+}  // namespace
+
+bool ParseSmf(const uint8_t* data, size_t size, SmfFile* file,
+              std::string* error) {
+  file->tracks.clear();
+  if (size < kChunkHeaderSize + 6 || std::memcmp(data, "MThd", 4) != 0) {
+    *error = "Not a Standard MIDI File";
+    return false;
+  }
+  uint32_t header_length = ReadBigEndian32(data + 4);
+  if (header_length < 6 || header_length > size - kChunkHeaderSize) {
+    *error = "Invalid MIDI header";
+    return false;
+  }
+  const uint8_t* header = data + kChunkHeaderSize;
+  file->header.format = ReadBigEndian16(header);
+  file->header.track_count = ReadBigEndian16(header + 2);
+  file->header.division = ReadBigEndian16(header + 4);
+  if (file->header.format > 1) {
+    *error = "Unsupported MIDI format " + std::to_string(file->header.format);
+    return false;
+  }
+  if (!TempoMap::IsValidDivision(file->header.division)) {
+    *error = "Invalid MIDI time division";
+    return false;
+  }
+
+  file->tracks.reserve(file->header.track_count);
+  size_t offset = kChunkHeaderSize + header_length;
+  while (file->tracks.size() < file->header.track_count &&
+         offset + kChunkHeaderSize <= size) {
+    const uint8_t* chunk = data + offset;
+    size_t length = ReadBigEndian32(chunk + 4);
+    size_t available = size - offset - kChunkHeaderSize;
+    // Some writers get the last chunk length wrong; clamp rather than reject.
+    if (length > available) {
+      length = available;
+    }
+    // Unknown chunk types must be skipped (SMF 1.0, section 2.2).
+    if (std::memcmp(chunk, "MTrk", 4) == 0) {
+      file->tracks.push_back(SmfTrack{chunk + kChunkHeaderSize, length});
+    }
+    offset += kChunkHeaderSize + length;
+  }
+  if (file->tracks.empty()) {
+    *error = "MIDI file contains no tracks";
+    return false;
+  }
+  if (file->header.format == 0 && file->tracks.size() != 1) {
+    file->tracks.resize(1);
+  }
+  return true;
+}
+
+TrackReader::TrackReader(const SmfTrack& track) : TrackReader(track, 0) {}
+
+TrackReader::TrackReader(const SmfTrack& track, uint8_t running_status)
+    : begin_(track.data),
+      cursor_(track.data),
+      end_(track.data + track.size),
+      running_status_(running_status),
+      finished_(false),
+      failed_(false) {}
+
+bool TrackReader::ReadVarLen(uint32_t* value) {
+  uint32_t result = 0;
+  for (int i = 0; i < 4; ++i) {
+    if (cursor_ >= end_) {
+      return false;
+    }
+    uint8_t byte = *cursor_++;
+    result = (result << 7) | (byte & 0x7F);
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return true;
+    }
+  }
+  // Quantities are limited to four bytes.
+  return false;
+}
+
+bool TrackReader::Next(MidiEvent* event) {
+  if (finished_ || failed_) {
+    return false;
+  }
+  if (cursor_ >= end_) {
+    // A missing end-of-track event is common enough to tolerate.
+    finished_ = true;
+    return false;
+  }
+  if (!ReadVarLen(&event->delta_ticks) || cursor_ >= end_) {
+    failed_ = true;
+    return false;
+  }
+  event->payload = nullptr;
+  event->payload_size = 0;
+  event->data2 = 0;
+
+  uint8_t status = *cursor_;
+  if (status < 0x80) {
+    // Running status: reuse the previous channel status byte.
+    if (running_status_ == 0) {
+      failed_ = true;
+      return false;
+    }
+    status = running_status_;
+  } else {
+    ++cursor_;
+  }
+  event->status = status;
+
+  if (status < 0xF0) {
+    running_status_ = status;
+    int length = ChannelMessageLength(status);
+    if (end_ - cursor_ < length) {
+      failed_ = true;
+      return false;
+    }
+    event->type = MidiEventType::kChannel;
+    event->data1 = cursor_[0] & 0x7F;
+    if (length == 2) {
+      event->data2 = cursor_[1] & 0x7F;
+    }
+    cursor_ += length;
+    return true;
+  }
+
+  if (status == 0xFF) {
+    if (cursor_ >= end_) {
+      failed_ = true;
+      return false;
+    }
+    event->type = MidiEventType::kMeta;
+    event->data1 = *cursor_++;
+  } else if (status == 0xF0 || status == 0xF7) {
+    event->type = MidiEventType::kSysEx;
+    event->data1 = 0;
+  } else {
+    // System common and real-time messages are not valid in a file.
+    failed_ = true;
+    return false;
+  }
+
+  uint32_t length = 0;
+  if (!ReadVarLen(&length) || static_cast<size_t>(end_ - cursor_) < length) {
+    failed_ = true;
+    return false;
+  }
+  event->payload = cursor_;
+  event->payload_size = length;
+  cursor_ += length;
+  if (event->type == MidiEventType::kMeta &&
+      event->data1 == kMetaEndOfTrack) {
+    finished_ = true;
+  }
+  return true;
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,518 @@
+#include "midi_engine/soundfont.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include "midi_engine/mapped_file.h"
+
+namespace playmidifile {
+
+namespace {
+
+// SF2 generator operators used by the synthesizer (SF2.04 section 8.1.2).
+enum Generator : uint16_t {
+  kStartAddrsOffset = 0,
+  kEndAddrsOffset = 1,
+  kStartloopAddrsOffset = 2,
+  kEndloopAddrsOffset = 3,
+  kStartAddrsCoarseOffset = 4,
+  kEndAddrsCoarseOffset = 12,
+  kPan = 17,
+  kDelayVolEnv = 33,
+  kAttackVolEnv = 34,
+  kHoldVolEnv = 35,
+  kDecayVolEnv = 36,
+  kSustainVolEnv = 37,
+  kReleaseVolEnv = 38,
+  kInstrument = 41,
+  kKeyRange = 43,
+  kVelRange = 44,
+  kStartloopAddrsCoarseOffset = 45,
+  kInitialAttenuation = 48,
+  kEndloopAddrsCoarseOffset = 50,
+  kCoarseTune = 51,
+  kFineTune = 52,
+  kSampleId = 53,
+  kSampleModes = 54,
+  kScaleTuning = 56,
+  kExclusiveClass = 57,
+  kOverridingRootKey = 58,
+  kGeneratorCount = 61,
+};
+
+// Generators that only have meaning at the instrument level.
+bool IsInstrumentOnly(uint16_t generator) {
+  switch (generator) {
+    case kStartAddrsOffset:
+    case kEndAddrsOffset:
+    case kStartloopAddrsOffset:
+    case kEndloopAddrsOffset:
+    case kStartAddrsCoarseOffset:
+    case kEndAddrsCoarseOffset:
+    case kStartloopAddrsCoarseOffset:
+    case kEndloopAddrsCoarseOffset:
+    case kSampleId:
+    case kSampleModes:
+    case kExclusiveClass:
+    case kOverridingRootKey:
+      return true;
+    default:
+      return false;
+  }
+}
+
+constexpr uint16_t kRomSampleFlag = 0x8000;
+
+// Smallest page size of the platforms we run on; touching one byte per
+// page faults each in.
+constexpr size_t kPageBytes = 4096;
+
+bool IsLittleEndian() {
+  const uint16_t probe = 1;
+  return *reinterpret_cast<const uint8_t*>(&probe) == 1;
+}
+
+void TouchPages(const uint8_t* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  uint8_t sum = 0;
+  for (size_t offset = 0; offset < size; offset += kPageBytes) {
+    sum += *static_cast<const volatile uint8_t*>(data + offset);
+  }
+  sum += *static_cast<const volatile uint8_t*>(data + size - 1);
+  static_cast<void>(sum);
+}
+
+uint16_t Read16(const uint8_t* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t Read32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+struct Chunk {
+  const uint8_t* data = nullptr;
+  uint32_t size = 0;
+};
+
+// Finds the chunk |id| among the chunks in [data, data + size). For LIST
+// chunks |list_type| selects the list and the returned chunk is its body.
+bool FindChunk(const uint8_t* data, size_t size, const char* id,
+               const char* list_type, Chunk* chunk) {
+  size_t offset = 0;
+  while (offset + 8 <= size) {
+    const uint8_t* header = data + offset;
+    uint32_t chunk_size = Read32(header + 4);
+    size_t available = size - offset - 8;
+    if (chunk_size > available) {
+      chunk_size = static_cast<uint32_t>(available);
+    }
+    if (std::memcmp(header, id, 4) == 0) {
+      if (list_type == nullptr) {
+        chunk->data = header + 8;
+        chunk->size = chunk_size;
+        return true;
+      }
+      if (chunk_size >= 4 && std::memcmp(header + 8, list_type, 4) == 0) {
+        chunk->data = header + 12;
+        chunk->size = chunk_size - 4;
+        return true;
+      }
+    }
+    // Chunks are padded to an even size.
+    offset += 8 + static_cast<size_t>(chunk_size) + (chunk_size & 1);
+  }
+  return false;
+}
+
+// A fixed-size record table from pdta. Every table ends with a terminal
+// record, which count() includes.
+struct Table {
+  const uint8_t* data = nullptr;
+  size_t count = 0;
+  size_t record_size = 0;
+
+  const uint8_t* at(size_t i) const { return data + i * record_size; }
+};
+
+bool ReadTable(const Chunk& pdta, const char* id, size_t record_size,
+               Table* table, std::string* error) {
+  Chunk chunk;
+  if (!FindChunk(pdta.data, pdta.size, id, nullptr, &chunk) ||
+      chunk.size < record_size) {
+    *error = std::string("Malformed SoundFont: missing ") + id + " chunk";
+    return false;
+  }
+  table->data = chunk.data;
+  table->record_size = record_size;
+  table->count = chunk.size / record_size;
+  return true;
+}
+
+// The generators of one zone, with a flag per operator set in the file.
+struct ZoneGenerators {
+  int32_t values[kGeneratorCount] = {};
+  bool set[kGeneratorCount] = {};
+  uint8_t key_low = 0;
+  uint8_t key_high = 127;
+  uint8_t velocity_low = 0;
+  uint8_t velocity_high = 127;
+
+  bool has(uint16_t generator) const { return set[generator]; }
+};
+
+// Reads the generators of bag |bag| in |bags| / |gens| on top of |zone|.
+void ReadZone(const Table& bags, const Table& gens, size_t bag,
+              ZoneGenerators* zone) {
+  size_t first = Read16(bags.at(bag));
+  size_t last = Read16(bags.at(bag + 1));
+  last = std::min(last, gens.count - 1);
+  for (size_t i = first; i < last; ++i) {
+    const uint8_t* record = gens.at(i);
+    uint16_t oper = Read16(record);
+    if (oper >= kGeneratorCount) {
+      continue;
+    }
+    if (oper == kKeyRange) {
+      zone->key_low = record[2];
+      zone->key_high = record[3];
+    } else if (oper == kVelRange) {
+      zone->velocity_low = record[2];
+      zone->velocity_high = record[3];
+    } else {
+      zone->values[oper] = static_cast<int16_t>(Read16(record + 2));
+    }
+    zone->set[oper] = true;
+  }
+}
+
+int32_t Clamp(int32_t value, int32_t low, int32_t high) {
+  return std::max(low, std::min(high, value));
+}
+
+struct SampleHeader {
+  uint32_t start;
+  uint32_t end;
+  uint32_t loop_start;
+  uint32_t loop_end;
+  uint32_t sample_rate;
+  uint8_t original_pitch;
+  int8_t pitch_correction;
+  uint16_t type;
+};
+
+// Combines an instrument zone with the preset zone that references it.
+bool BuildRegion(const ZoneGenerators& instrument,
+                 const ZoneGenerators& preset,
+                 const std::vector<SampleHeader>& samples,
+                 size_t sample_data_size, SoundFontRegion* region) {
+  if (!instrument.has(kSampleId)) {
+    return false;
+  }
+  size_t sample_index = static_cast<uint16_t>(instrument.values[kSampleId]);
+  if (sample_index >= samples.size()) {
+    return false;
+  }
+  const SampleHeader& sample = samples[sample_index];
+  if (sample.type & kRomSampleFlag) {
+    return false;
+  }
+
+  region->key_low = std::max(instrument.key_low, preset.key_low);
+  region->key_high = std::min(instrument.key_high, preset.key_high);
+  region->velocity_low =
+      std::max(instrument.velocity_low, preset.velocity_low);
+  region->velocity_high =
+      std::min(instrument.velocity_high, preset.velocity_high);
+  if (region->key_low > region->key_high ||
+      region->velocity_low > region->velocity_high) {
+    return false;
+  }
+
+  auto value = [&](uint16_t generator) {
+    return instrument.values[generator] + preset.values[generator];
+  };
+  auto offset = [&](uint16_t fine, uint16_t coarse) {
+    return static_cast<int64_t>(instrument.values[fine]) +
+           static_cast<int64_t>(instrument.values[coarse]) * 32768;
+  };
+  int64_t limit = static_cast<int64_t>(sample_data_size);
+  auto address = [&](uint32_t base, int64_t delta) {
+    return static_cast<uint32_t>(
+        std::max<int64_t>(0, std::min<int64_t>(limit, base + delta)));
+  };
+  region->start = address(
+      sample.start, offset(kStartAddrsOffset, kStartAddrsCoarseOffset));
+  region->end =
+      address(sample.end, offset(kEndAddrsOffset, kEndAddrsCoarseOffset));
+  region->loop_start = address(
+      sample.loop_start,
+      offset(kStartloopAddrsOffset, kStartloopAddrsCoarseOffset));
+  region->loop_end = address(
+      sample.loop_end, offset(kEndloopAddrsOffset, kEndloopAddrsCoarseOffset));
+  if (region->start >= region->end) {
+    return false;
+  }
+  region->sample_rate = sample.sample_rate > 0 ? sample.sample_rate : 44100;
+
+  int32_t modes = instrument.values[kSampleModes] & 3;
+  region->loop_mode = modes == 1   ? LoopMode::kContinuous
+                      : modes == 3 ? LoopMode::kUntilRelease
+                                   : LoopMode::kNone;
+  if (region->loop_start < region->start ||
+      region->loop_end > region->end ||
+      region->loop_start + 1 >= region->loop_end) {
+    region->loop_mode = LoopMode::kNone;
+  }
+
+  int32_t root = instrument.has(kOverridingRootKey) &&
+                         instrument.values[kOverridingRootKey] >= 0
+                     ? instrument.values[kOverridingRootKey]
+                     : sample.original_pitch;
+  region->root_key = static_cast<int16_t>(Clamp(root, 0, 127));
+  region->scale_tuning =
+      static_cast<int16_t>(Clamp(value(kScaleTuning), 0, 1200));
+  region->tune = static_cast<int16_t>(Clamp(
+      value(kCoarseTune) * 100 + value(kFineTune) + sample.pitch_correction,
+      -12800, 12800));
+  region->attenuation =
+      static_cast<int16_t>(Clamp(value(kInitialAttenuation), 0, 1440));
+  region->pan = static_cast<int16_t>(Clamp(value(kPan), -500, 500));
+  region->exclusive_class = static_cast<uint16_t>(
+      Clamp(instrument.values[kExclusiveClass], 0, 65535));
+
+  // -32768 is "no time at all"; -12000 (the default) is about 1 ms.
+  auto time = [&](uint16_t generator) {
+    return static_cast<int16_t>(Clamp(value(generator), -32768, 8000));
+  };
+  region->envelope.delay = time(kDelayVolEnv);
+  region->envelope.attack = time(kAttackVolEnv);
+  region->envelope.hold = time(kHoldVolEnv);
+  region->envelope.decay = time(kDecayVolEnv);
+  region->envelope.sustain =
+      static_cast<int16_t>(Clamp(value(kSustainVolEnv), 0, 1440));
+  region->envelope.release = time(kReleaseVolEnv);
+  return true;
+}
+
+void SetInstrumentDefaults(ZoneGenerators* zone) {
+  for (uint16_t generator :
+       {kDelayVolEnv, kAttackVolEnv, kHoldVolEnv, kDecayVolEnv,
+        kReleaseVolEnv}) {
+    zone->values[generator] = -12000;
+  }
+  zone->values[kScaleTuning] = 100;
+  zone->values[kOverridingRootKey] = -1;
+}
+
+struct PresetTables {
+  Table phdr, pbag, pgen, inst, ibag, igen, shdr;
+  std::vector<SampleHeader> samples;
+  size_t sample_data_size = 0;
+};
+
+// Appends a region for every zone of the instrument |preset_zone| points at.
+void AddInstrumentRegions(const PresetTables& tables,
+                          ZoneGenerators preset_zone,
+                          std::vector<SoundFontRegion>* regions) {
+  size_t instrument = static_cast<uint16_t>(preset_zone.values[kInstrument]);
+  if (instrument + 1 >= tables.inst.count) {
+    return;
+  }
+  for (uint16_t generator = 0; generator < kGeneratorCount; ++generator) {
+    if (IsInstrumentOnly(generator)) {
+      preset_zone.values[generator] = 0;
+    }
+  }
+
+  ZoneGenerators global;
+  SetInstrumentDefaults(&global);
+  size_t first = Read16(tables.inst.at(instrument) + 20);
+  size_t last = std::min<size_t>(Read16(tables.inst.at(instrument + 1) + 20),
+                                 tables.ibag.count - 1);
+  for (size_t bag = first; bag < last; ++bag) {
+    ZoneGenerators zone = global;
+    ReadZone(tables.ibag, tables.igen, bag, &zone);
+    if (!zone.has(kSampleId)) {
+      if (bag == first) {
+        global = zone;
+      }
+      continue;
+    }
+    SoundFontRegion region;
+    if (BuildRegion(zone, preset_zone, tables.samples,
+                    tables.sample_data_size, &region)) {
+      regions->push_back(region);
+    }
+  }
+}
+
+}  // namespace
+
+SoundFont::SoundFont()
+    : samples_(nullptr), sample_count_(0), prepared_count_(0) {}
+
+// static
+std::unique_ptr<SoundFont> SoundFont::Open(const std::string& utf8_path,
+                                           std::string* error) {
+  std::unique_ptr<SoundFont> font(new SoundFont());
+  // Notes read their samples wherever they are in the file.
+  if (!font->mapping_.Open(utf8_path, error, MappedFile::Access::kRandom) ||
+      !font->Load(font->mapping_.data(), font->mapping_.size(), true,
+                  error)) {
+    return nullptr;
+  }
+  if (font->samples_ == font->sample_copy_.data()) {
+    // The samples had to be copied, so the mapping is no longer needed.
+    font->mapping_.Close();
+  }
+  return font;
+}
+
+// static
+std::unique_ptr<SoundFont> SoundFont::Parse(const uint8_t* data, size_t size,
+                                            std::string* error) {
+  std::unique_ptr<SoundFont> font(new SoundFont());
+  if (!font->Load(data, size, false, error)) {
+    return nullptr;
+  }
+  return font;
+}
+
+void SoundFont::PrepareSamples(const SoundFontPreset& preset) const {
+  if (samples_prepared(preset)) {
+    return;
+  }
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(samples_);
+  for (const SoundFontRegion& region : preset.regions) {
+    TouchPages(data + region.start * sizeof(int16_t),
+               (region.end - region.start) * sizeof(int16_t));
+  }
+  // Set once the pages are in; two threads racing here both touch them.
+  size_t index = static_cast<size_t>(&preset - presets_.data());
+  if (!prepared_[index].exchange(true, std::memory_order_release)) {
+    prepared_count_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool SoundFont::samples_prepared(const SoundFontPreset& preset) const {
+  size_t index = static_cast<size_t>(&preset - presets_.data());
+  return !mapped() || index >= presets_.size() ||
+         prepared_[index].load(std::memory_order_acquire);
+}
+
+const SoundFontPreset* SoundFont::FindPreset(uint16_t bank,
+                                             uint16_t program) const {
+  const SoundFontPreset* fallback = nullptr;
+  uint16_t fallback_bank = bank >= 128 ? 128 : 0;
+  for (const SoundFontPreset& preset : presets_) {
+    if (preset.program != program) {
+      continue;
+    }
+    if (preset.bank == bank) {
+      return &preset;
+    }
+    if (preset.bank == fallback_bank && fallback == nullptr) {
+      fallback = &preset;
+    }
+  }
+  if (fallback != nullptr) {
+    return fallback;
+  }
+  return presets_.empty() ? nullptr : &presets_.front();
+}
+
+bool SoundFont::Load(const uint8_t* data, size_t size, bool borrow_samples,
+                     std::string* error) {
+  if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 ||
+      std::memcmp(data + 8, "sfbk", 4) != 0) {
+    *error = "Not a SoundFont 2 file";
+    return false;
+  }
+  size_t riff_size = std::min<size_t>(Read32(data + 4), size - 8);
+  const uint8_t* body = data + 12;
+  size_t body_size = riff_size >= 4 ? riff_size - 4 : 0;
+
+  Chunk sdta;
+  Chunk smpl;
+  if (!FindChunk(body, body_size, "LIST", "sdta", &sdta) ||
+      !FindChunk(sdta.data, sdta.size, "smpl", nullptr, &smpl)) {
+    *error = "Malformed SoundFont: missing sample data";
+    return false;
+  }
+  sample_count_ = smpl.size / 2;
+  if (borrow_samples && IsLittleEndian() &&
+      reinterpret_cast<uintptr_t>(smpl.data) % alignof(int16_t) == 0) {
+    samples_ = reinterpret_cast<const int16_t*>(smpl.data);
+  } else {
+    sample_copy_.resize(sample_count_);
+    for (size_t i = 0; i < sample_count_; ++i) {
+      sample_copy_[i] = static_cast<int16_t>(Read16(smpl.data + i * 2));
+    }
+    samples_ = sample_copy_.data();
+  }
+
+  Chunk pdta;
+  if (!FindChunk(body, body_size, "LIST", "pdta", &pdta)) {
+    *error = "Malformed SoundFont: missing preset data";
+    return false;
+  }
+  PresetTables tables;
+  if (!ReadTable(pdta, "phdr", 38, &tables.phdr, error) ||
+      !ReadTable(pdta, "pbag", 4, &tables.pbag, error) ||
+      !ReadTable(pdta, "pgen", 4, &tables.pgen, error) ||
+      !ReadTable(pdta, "inst", 22, &tables.inst, error) ||
+      !ReadTable(pdta, "ibag", 4, &tables.ibag, error) ||
+      !ReadTable(pdta, "igen", 4, &tables.igen, error) ||
+      !ReadTable(pdta, "shdr", 46, &tables.shdr, error)) {
+    return false;
+  }
+  tables.sample_data_size = sample_count_;
+  for (size_t i = 0; i + 1 < tables.shdr.count; ++i) {
+    const uint8_t* record = tables.shdr.at(i);
+    tables.samples.push_back(SampleHeader{
+        Read32(record + 20), Read32(record + 24), Read32(record + 28),
+        Read32(record + 32), Read32(record + 36), record[40],
+        static_cast<int8_t>(record[41]), Read16(record + 44)});
+  }
+
+  presets_.reserve(tables.phdr.count - 1);
+  for (size_t p = 0; p + 1 < tables.phdr.count; ++p) {
+    const uint8_t* header = tables.phdr.at(p);
+    SoundFontPreset preset;
+    const char* name = reinterpret_cast<const char*>(header);
+    preset.name.assign(name, std::find(name, name + 20, '\0'));
+    preset.program = Read16(header + 20);
+    preset.bank = Read16(header + 22);
+
+    // Only the first zone may be global; later zones without an instrument
+    // are ignored.
+    ZoneGenerators global;
+    size_t first = Read16(header + 24);
+    size_t last = std::min<size_t>(Read16(tables.phdr.at(p + 1) + 24),
+                                   tables.pbag.count - 1);
+    for (size_t bag = first; bag < last; ++bag) {
+      ZoneGenerators zone = global;
+      ReadZone(tables.pbag, tables.pgen, bag, &zone);
+      if (zone.has(kInstrument)) {
+        AddInstrumentRegions(tables, zone, &preset.regions);
+      } else if (bag == first) {
+        global = zone;
+      }
+    }
+    presets_.push_back(std::move(preset));
+  }
+  prepared_.reset(new std::atomic<bool>[presets_.size()]);
+  for (size_t i = 0; i < presets_.size(); ++i) {
+    prepared_[i].store(false, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+}  // namespace playmidifile
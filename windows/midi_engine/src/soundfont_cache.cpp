@@ -0,0 +1,70 @@
+#include "midi_engine/soundfont_cache.h"
+
+#include <utility>
+
+#include "utf8_path.h"
+
+namespace playmidifile {
+
+SoundFontCache::SoundFontCache() = default;
+
+SoundFontCache::~SoundFontCache() = default;
+
+std::shared_ptr<const SoundFont> SoundFontCache::Open(
+    const std::string& utf8_path, std::string* error) {
+  FileStamp stamp;
+  if (!StatFileUtf8(utf8_path, &stamp, error)) {
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(stamp.canonical_path);
+    if (it != entries_.end() && it->second.size == stamp.size &&
+        it->second.mtime == stamp.mtime) {
+      std::shared_ptr<const SoundFont> font = it->second.font.lock();
+      if (font) {
+        return font;
+      }
+    }
+  }
+
+  std::shared_ptr<const SoundFont> font = SoundFont::Open(utf8_path, error);
+  if (!font) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  Entry& entry = entries_[stamp.canonical_path];
+  if (entry.size == stamp.size && entry.mtime == stamp.mtime) {
+    // Another thread opened it meanwhile; share theirs.
+    std::shared_ptr<const SoundFont> existing = entry.font.lock();
+    if (existing) {
+      return existing;
+    }
+  }
+  entry = Entry{stamp.size, stamp.mtime, font};
+  DropExpired();
+  return font;
+}
+
+size_t SoundFontCache::open_fonts() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t count = 0;
+  for (const auto& entry : entries_) {
+    if (!entry.second.font.expired()) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+void SoundFontCache::DropExpired() {
+  for (auto it = entries_.begin(); it != entries_.end();) {
+    if (it->second.font.expired()) {
+      it = entries_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,211 @@
+#include "midi_engine/synth_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PLAYMIDIFILE_X86_64 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of x86-64, so only AVX2 needs enabling per function. MSVC
+// accepts any intrinsic without it.
+#if defined(__GNUC__) || defined(__clang__)
+#define PLAYMIDIFILE_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define PLAYMIDIFILE_TARGET_AVX2
+#endif
+
+namespace playmidifile {
+
+namespace {
+
+// The scalar loops double as the reference and as the tails of the vector
+// ones. Keep each statement the same operations, in the same order, as the
+// vector bodies.
+
+void InterpolateScalar(const float* s0, const float* s1, const float* fraction,
+                       float scale, float* out, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    out[i] = (s0[i] + fraction[i] * (s1[i] - s0[i])) * scale;
+  }
+}
+
+void ApplyEnvelopeScalar(float* samples, const float* envelope,
+                         size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    samples[i] *= envelope[i];
+  }
+}
+
+void MixStereoScalar(const float* samples, float left_gain, float right_gain,
+                     float* output, size_t frames) {
+  for (size_t i = 0; i < frames; ++i) {
+    output[i * 2] += samples[i] * left_gain;
+    output[i * 2 + 1] += samples[i] * right_gain;
+  }
+}
+
+#ifdef PLAYMIDIFILE_X86_64
+
+void InterpolateSse2(const float* s0, const float* s1, const float* fraction,
+                     float scale, float* out, size_t frames) {
+  const __m128 scale4 = _mm_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    __m128 a = _mm_loadu_ps(s0 + i);
+    __m128 b = _mm_loadu_ps(s1 + i);
+    __m128 t = _mm_mul_ps(_mm_loadu_ps(fraction + i), _mm_sub_ps(b, a));
+    _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(a, t), scale4));
+  }
+  InterpolateScalar(s0 + i, s1 + i, fraction + i, scale, out + i, frames - i);
+}
+
+void ApplyEnvelopeSse2(float* samples, const float* envelope, size_t frames) {
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i),
+                                          _mm_loadu_ps(envelope + i)));
+  }
+  ApplyEnvelopeScalar(samples + i, envelope + i, frames - i);
+}
+
+void MixStereoSse2(const float* samples, float left_gain, float right_gain,
+                   float* output, size_t frames) {
+  const __m128 left4 = _mm_set1_ps(left_gain);
+  const __m128 right4 = _mm_set1_ps(right_gain);
+  size_t i = 0;
+  for (; i + 4 <= frames; i += 4) {
+    __m128 mono = _mm_loadu_ps(samples + i);
+    __m128 left = _mm_mul_ps(mono, left4);
+    __m128 right = _mm_mul_ps(mono, right4);
+    // L0 R0 L1 R1, L2 R2 L3 R3.
+    float* out = output + i * 2;
+    _mm_storeu_ps(out, _mm_add_ps(_mm_loadu_ps(out),
+                                  _mm_unpacklo_ps(left, right)));
+    _mm_storeu_ps(out + 4, _mm_add_ps(_mm_loadu_ps(out + 4),
+                                      _mm_unpackhi_ps(left, right)));
+  }
+  MixStereoScalar(samples + i, left_gain, right_gain, output + i * 2,
+                  frames - i);
+}
+
+PLAYMIDIFILE_TARGET_AVX2
+void InterpolateAvx2(const float* s0, const float* s1, const float* fraction,
+                     float scale, float* out, size_t frames) {
+  const __m256 scale8 = _mm256_set1_ps(scale);
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    __m256 a = _mm256_loadu_ps(s0 + i);
+    __m256 b = _mm256_loadu_ps(s1 + i);
+    __m256 t =
+        _mm256_mul_ps(_mm256_loadu_ps(fraction + i), _mm256_sub_ps(b, a));
+    _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_add_ps(a, t), scale8));
+  }
+  InterpolateScalar(s0 + i, s1 + i, fraction + i, scale, out + i, frames - i);
+}
+
+PLAYMIDIFILE_TARGET_AVX2
+void ApplyEnvelopeAvx2(float* samples, const float* envelope, size_t frames) {
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    _mm256_storeu_ps(samples + i,
+                     _mm256_mul_ps(_mm256_loadu_ps(samples + i),
+                                   _mm256_loadu_ps(envelope + i)));
+  }
+  ApplyEnvelopeScalar(samples + i, envelope + i, frames - i);
+}
+
+PLAYMIDIFILE_TARGET_AVX2
+void MixStereoAvx2(const float* samples, float left_gain, float right_gain,
+                   float* output, size_t frames) {
+  const __m256 left8 = _mm256_set1_ps(left_gain);
+  const __m256 right8 = _mm256_set1_ps(right_gain);
+  size_t i = 0;
+  for (; i + 8 <= frames; i += 8) {
+    __m256 mono = _mm256_loadu_ps(samples + i);
+    __m256 left = _mm256_mul_ps(mono, left8);
+    __m256 right = _mm256_mul_ps(mono, right8);
+    // Unpacking works within 128-bit lanes: L0 R0 L1 R1 | L4 R4 L5 R5 and
+    // L2 R2 L3 R3 | L6 R6 L7 R7, so swap the middle halves into order.
+    __m256 low = _mm256_unpacklo_ps(left, right);
+    __m256 high = _mm256_unpackhi_ps(left, right);
+    float* out = output + i * 2;
+    _mm256_storeu_ps(out, _mm256_add_ps(_mm256_loadu_ps(out),
+                                        _mm256_permute2f128_ps(low, high,
+                                                               0x20)));
+    _mm256_storeu_ps(out + 8, _mm256_add_ps(_mm256_loadu_ps(out + 8),
+                                            _mm256_permute2f128_ps(
+                                                low, high, 0x31)));
+  }
+  MixStereoScalar(samples + i, left_gain, right_gain, output + i * 2,
+                  frames - i);
+}
+
+bool CpuHasAvx2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7) {
+    return false;
+  }
+  // The OS must save the YMM registers (OSXSAVE, then XCR0 bits 1 and 2)
+  // as well as the CPU having AVX and AVX2.
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  // Also checks that the OS saves the YMM registers.
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif  // PLAYMIDIFILE_X86_64
+
+const SynthKernels kScalarKernels = {SimdLevel::kScalar, "scalar",
+                                     InterpolateScalar, ApplyEnvelopeScalar,
+                                     MixStereoScalar};
+#ifdef PLAYMIDIFILE_X86_64
+const SynthKernels kSse2Kernels = {SimdLevel::kSse2, "sse2", InterpolateSse2,
+                                   ApplyEnvelopeSse2, MixStereoSse2};
+const SynthKernels kAvx2Kernels = {SimdLevel::kAvx2, "avx2", InterpolateAvx2,
+                                   ApplyEnvelopeAvx2, MixStereoAvx2};
+#endif
+
+}  // namespace
+
+SimdLevel DetectSimdLevel() {
+#ifdef PLAYMIDIFILE_X86_64
+  static const SimdLevel level =
+      CpuHasAvx2() ? SimdLevel::kAvx2 : SimdLevel::kSse2;
+  return level;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+bool IsSimdLevelSupported(SimdLevel level) {
+  return static_cast<int>(level) <= static_cast<int>(DetectSimdLevel());
+}
+
+const SynthKernels& GetSynthKernels(SimdLevel level) {
+#ifdef PLAYMIDIFILE_X86_64
+  switch (level) {
+    case SimdLevel::kAvx2:
+      return kAvx2Kernels;
+    case SimdLevel::kSse2:
+      return kSse2Kernels;
+    case SimdLevel::kScalar:
+      break;
+  }
+#endif
+  return kScalarKernels;
+}
+
+}  // namespace playmidifile
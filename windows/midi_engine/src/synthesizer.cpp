@@ -0,0 +1,629 @@
+#include "midi_engine/synthesizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include "midi_engine/sequence.h"
+
+namespace playmidifile {
+
+namespace {
+
+constexpr int kPercussionChannel = 9;
+constexpr uint16_t kPercussionBank = 128;
+constexpr uint16_t kNoRpn = 0x3FFF;
+constexpr uint16_t kRpnPitchBendRange = 0;
+
+// The bank a program change on |channel| selects from.
+uint16_t PresetBank(int channel, uint8_t bank) {
+  return channel == kPercussionChannel ? kPercussionBank : bank;
+}
+
+// Envelope decay and release times are the time to fall by 96 dB, at which
+// point a voice is inaudible and is freed.
+constexpr double kEnvelopeRangeCentibels = 960.0;
+const float kSilence =
+    static_cast<float>(std::pow(10.0, -kEnvelopeRangeCentibels / 200.0));
+
+constexpr double kHalfPi = 1.57079632679489661923;
+constexpr float kSampleScale = 1.0f / 32768.0f;
+
+// Frames per kernel call. Small enough that the per-voice scratch arrays
+// stay in L1 on the stack, large enough to amortise the call.
+constexpr size_t kKernelBlock = 128;
+
+float CentibelsToGain(double centibels) {
+  return static_cast<float>(std::pow(10.0, -centibels / 200.0));
+}
+
+// The concave 40 * log10 curve of the SF2 default velocity, volume and
+// expression modulators, as a gain.
+float SquaredRatio(uint8_t value) {
+  float ratio = value / 127.0f;
+  return ratio * ratio;
+}
+
+// How loud a voice is for voice stealing. A voice still in its delay or
+// attack counts at the full level it is heading for, so a note that has
+// only just started is not mistaken for a quiet one.
+float StealLoudness(float level, bool rising, float left_gain,
+                    float right_gain) {
+  return (rising ? 1.0f : level) * (left_gain + right_gain);
+}
+
+// Compares a system exclusive message against |expected|, ignoring the
+// device id in the third byte.
+bool IsSysEx(const uint8_t* data, size_t size,
+             std::initializer_list<uint8_t> expected) {
+  if (size != expected.size()) {
+    return false;
+  }
+  size_t i = 0;
+  for (uint8_t byte : expected) {
+    if (i != 2 && data[i] != byte) {
+      return false;
+    }
+    ++i;
+  }
+  return true;
+}
+
+}  // namespace
+
+Synthesizer::Synthesizer(std::shared_ptr<const SoundFont> font,
+                         uint32_t sample_rate, int polyphony)
+    : font_(std::move(font)),
+      sample_rate_(sample_rate),
+      kernels_(&GetSynthKernels(DetectSimdLevel())),
+      master_gain_(1.0f),
+      voices_(static_cast<size_t>(std::max(polyphony, 1))),
+      next_voice_id_(0),
+      stolen_voices_(0),
+      unprepared_presets_(0) {
+  for (int channel = 0; channel < kMidiChannelCount; ++channel) {
+    ResetChannel(channel);
+  }
+}
+
+Synthesizer::~Synthesizer() = default;
+
+// static
+void Synthesizer::PrepareSamples(const SoundFont& font,
+                                 const Sequence& sequence) {
+  auto prepare = [&font](uint16_t bank, uint16_t program) {
+    if (const SoundFontPreset* preset = font.FindPreset(bank, program)) {
+      font.PrepareSamples(*preset);
+    }
+  };
+  // What every channel starts on, and goes back to on a reset.
+  prepare(0, 0);
+  prepare(kPercussionBank, 0);
+  uint8_t banks[kMidiChannelCount] = {};
+  for (size_t i = 0; i < sequence.event_count(); ++i) {
+    const SequenceEvent event = sequence.event(i);
+    const int channel = event.status & 0x0F;
+    switch (event.status & 0xF0) {
+      case 0xB0:
+        if (event.data1 == 0) {
+          banks[channel] = event.data2;
+        }
+        break;
+      case 0xC0:
+        prepare(PresetBank(channel, banks[channel]), event.data1);
+        // A reset in between would have put the channel back on bank 0.
+        if (channel != kPercussionChannel && banks[channel] != 0) {
+          prepare(0, event.data1);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+void Synthesizer::SendChannelMessage(uint8_t status, uint8_t data1,
+                                     uint8_t data2) {
+  int channel = status & 0x0F;
+  switch (status & 0xF0) {
+    case 0x80:
+      NoteOff(channel, data1);
+      break;
+    case 0x90:
+      if (data2 == 0) {
+        NoteOff(channel, data1);
+      } else {
+        NoteOn(channel, data1, data2);
+      }
+      break;
+    case 0xB0:
+      ControlChange(channel, data1, data2);
+      break;
+    case 0xC0:
+      channels_[channel].program = data1;
+      SelectPreset(channel);
+      break;
+    case 0xE0:
+      channels_[channel].pitch_bend =
+          static_cast<uint16_t>(data1 | (data2 << 7));
+      UpdateChannelVoices(channel, true, false);
+      break;
+    default:
+      // Aftertouch has no default modulator.
+      break;
+  }
+}
+
+void Synthesizer::SendSysEx(const uint8_t* data, size_t size) {
+  // GM System On and GS Reset.
+  if (IsSysEx(data, size, {0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7}) ||
+      IsSysEx(data, size, {0xF0, 0x41, 0x7F, 0x42, 0x12, 0x40, 0x00, 0x7F,
+                           0x00, 0x41, 0xF7})) {
+    Reset();
+  }
+}
+
+void Synthesizer::SetVolume(double volume) {
+  master_gain_ = static_cast<float>(std::max(0.0, std::min(1.0, volume)));
+  for (Voice& voice : voices_) {
+    if (voice.active) {
+      UpdateGain(&voice);
+    }
+  }
+}
+
+void Synthesizer::Render(float* output, size_t frames) {
+  std::memset(output, 0, frames * 2 * sizeof(float));
+  for (Voice& voice : voices_) {
+    if (voice.active) {
+      RenderVoice(&voice, output, frames);
+    }
+  }
+}
+
+void Synthesizer::Reset() {
+  for (Voice& voice : voices_) {
+    voice.active = false;
+  }
+  for (int channel = 0; channel < kMidiChannelCount; ++channel) {
+    ResetChannel(channel);
+  }
+}
+
+void Synthesizer::SetSimdLevel(SimdLevel level) {
+  if (IsSimdLevelSupported(level)) {
+    kernels_ = &GetSynthKernels(level);
+  }
+}
+
+int Synthesizer::active_voices() const {
+  return static_cast<int>(
+      std::count_if(voices_.begin(), voices_.end(),
+                    [](const Voice& voice) { return voice.active; }));
+}
+
+void Synthesizer::NoteOn(int channel, uint8_t key, uint8_t velocity) {
+  const SoundFontPreset* preset = channels_[channel].preset;
+  if (preset == nullptr) {
+    return;
+  }
+  for (const SoundFontRegion& region : preset->regions) {
+    if (!region.Matches(key, velocity)) {
+      continue;
+    }
+    if (region.exclusive_class != 0) {
+      for (Voice& other : voices_) {
+        if (other.active && other.channel == channel &&
+            other.region->exclusive_class == region.exclusive_class) {
+          other.active = false;
+        }
+      }
+    }
+    Voice* voice = AllocateVoice();
+    *voice = Voice();
+    voice->region = &region;
+    voice->active = true;
+    voice->channel = static_cast<uint8_t>(channel);
+    voice->key = key;
+    voice->velocity = velocity;
+    voice->id = next_voice_id_++;
+    voice->position = region.start;
+    UpdatePitch(voice);
+    UpdateGain(voice);
+    EnterStage(voice, Stage::kDelay);
+  }
+}
+
+void Synthesizer::NoteOff(int channel, uint8_t key) {
+  bool sustain = channels_[channel].sustain;
+  for (Voice& voice : voices_) {
+    if (!voice.active || voice.released || voice.channel != channel ||
+        voice.key != key) {
+      continue;
+    }
+    if (sustain) {
+      voice.held_by_pedal = true;
+    } else {
+      ReleaseVoice(&voice);
+    }
+  }
+}
+
+void Synthesizer::ControlChange(int channel, uint8_t control, uint8_t value) {
+  Channel& state = channels_[channel];
+  switch (control) {
+    case 0:
+      state.bank = value;
+      break;
+    case 6:
+      if (state.rpn == kRpnPitchBendRange) {
+        state.bend_range_cents = value * 100 + state.bend_range_cents % 100;
+        UpdateChannelVoices(channel, true, false);
+      }
+      break;
+    case 38:
+      if (state.rpn == kRpnPitchBendRange) {
+        state.bend_range_cents = state.bend_range_cents / 100 * 100 + value;
+        UpdateChannelVoices(channel, true, false);
+      }
+      break;
+    case 7:
+      state.volume = value;
+      UpdateChannelVoices(channel, false, true);
+      break;
+    case 10:
+      state.pan = value;
+      UpdateChannelVoices(channel, false, true);
+      break;
+    case 11:
+      state.expression = value;
+      UpdateChannelVoices(channel, false, true);
+      break;
+    case 64:
+      state.sustain = value >= 64;
+      if (!state.sustain) {
+        for (Voice& voice : voices_) {
+          if (voice.active && voice.channel == channel &&
+              voice.held_by_pedal) {
+            ReleaseVoice(&voice);
+          }
+        }
+      }
+      break;
+    case 100:
+      state.rpn = static_cast<uint16_t>((state.rpn & 0x3F80) | value);
+      break;
+    case 101:
+      state.rpn = static_cast<uint16_t>((value << 7) | (state.rpn & 0x7F));
+      break;
+    case 120:
+      // All sound off: cut without release.
+      for (Voice& voice : voices_) {
+        if (voice.channel == channel) {
+          voice.active = false;
+        }
+      }
+      break;
+    case 121:
+      // Reset all controllers (RP-015): volume, pan and programs are kept.
+      state.expression = 127;
+      state.pitch_bend = 8192;
+      state.rpn = kNoRpn;
+      ControlChange(channel, 64, 0);
+      UpdateChannelVoices(channel, true, true);
+      break;
+    case 123:
+      // All notes off; keys held by the pedal keep sounding until it lifts.
+      for (Voice& voice : voices_) {
+        if (voice.active && voice.channel == channel) {
+          NoteOff(channel, voice.key);
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+void Synthesizer::ReleaseVoice(Voice* voice) {
+  voice->held_by_pedal = false;
+  voice->released = true;
+  EnterStage(voice, Stage::kRelease);
+}
+
+void Synthesizer::EnterStage(Voice* voice, Stage stage) const {
+  const VolumeEnvelope& envelope = voice->region->envelope;
+  auto samples = [this](int16_t timecents) -> uint32_t {
+    if (timecents <= -32768) {
+      return 0;
+    }
+    return static_cast<uint32_t>(std::lround(
+        std::pow(2.0, timecents / 1200.0) * sample_rate_));
+  };
+  // Multiplier that falls by the envelope range over |count| samples.
+  auto decay_factor = [](uint32_t count) {
+    return static_cast<float>(
+        std::pow(10.0, -kEnvelopeRangeCentibels / 200.0 / count));
+  };
+
+  voice->stage = stage;
+  switch (stage) {
+    case Stage::kDelay:
+      voice->level = 0.0f;
+      voice->stage_samples = samples(envelope.delay);
+      if (voice->stage_samples == 0) {
+        EnterStage(voice, Stage::kAttack);
+      }
+      break;
+    case Stage::kAttack:
+      voice->stage_samples = samples(envelope.attack);
+      if (voice->stage_samples == 0) {
+        EnterStage(voice, Stage::kHold);
+      } else {
+        voice->attack_step = 1.0f / voice->stage_samples;
+      }
+      break;
+    case Stage::kHold:
+      voice->level = 1.0f;
+      voice->stage_samples = samples(envelope.hold);
+      if (voice->stage_samples == 0) {
+        EnterStage(voice, Stage::kDecay);
+      }
+      break;
+    case Stage::kDecay: {
+      voice->sustain_level = CentibelsToGain(envelope.sustain);
+      uint32_t count = samples(envelope.decay);
+      if (count == 0 || voice->level <= voice->sustain_level) {
+        voice->level = std::min(voice->level, voice->sustain_level);
+        EnterStage(voice, Stage::kSustain);
+      } else {
+        voice->decay_factor = decay_factor(count);
+      }
+      break;
+    }
+    case Stage::kSustain:
+      // A sustain level below the envelope range is silence.
+      if (voice->level <= kSilence) {
+        voice->active = false;
+      }
+      break;
+    case Stage::kRelease: {
+      uint32_t count = samples(envelope.release);
+      if (count == 0 || voice->level <= kSilence) {
+        voice->active = false;
+      } else {
+        voice->release_factor = decay_factor(count);
+      }
+      break;
+    }
+  }
+}
+
+Synthesizer::Voice* Synthesizer::AllocateVoice() {
+  // Steal the first voice by (not released, loudness, age): each rule only
+  // breaks ties in the one before.
+  Voice* victim = nullptr;
+  float victim_loudness = 0.0f;
+  for (Voice& voice : voices_) {
+    if (!voice.active) {
+      return &voice;
+    }
+    bool rising = voice.stage == Stage::kDelay || voice.stage == Stage::kAttack;
+    float loudness = StealLoudness(voice.level, rising, voice.left_gain,
+                                   voice.right_gain);
+    bool better;
+    if (victim == nullptr) {
+      better = true;
+    } else if (voice.released != victim->released) {
+      better = voice.released;
+    } else if (loudness != victim_loudness) {
+      better = loudness < victim_loudness;
+    } else {
+      better = voice.id < victim->id;
+    }
+    if (better) {
+      victim = &voice;
+      victim_loudness = loudness;
+    }
+  }
+  ++stolen_voices_;
+  return victim;
+}
+
+void Synthesizer::UpdatePitch(Voice* voice) const {
+  const SoundFontRegion& region = *voice->region;
+  const Channel& channel = channels_[voice->channel];
+  double bend =
+      (channel.pitch_bend - 8192) / 8192.0 * channel.bend_range_cents;
+  double cents = (voice->key - region.root_key) * region.scale_tuning +
+                 region.tune + bend;
+  voice->step = std::pow(2.0, cents / 1200.0) * region.sample_rate /
+                sample_rate_;
+}
+
+void Synthesizer::UpdateGain(Voice* voice) const {
+  const SoundFontRegion& region = *voice->region;
+  const Channel& channel = channels_[voice->channel];
+  float gain = CentibelsToGain(region.attenuation) *
+               SquaredRatio(voice->velocity) * SquaredRatio(channel.volume) *
+               SquaredRatio(channel.expression) * master_gain_;
+  int pan = region.pan + (channel.pan - 64) * 500 / 64;
+  pan = std::max(-500, std::min(500, pan));
+  // Equal-power pan law.
+  double angle = (pan + 500) / 1000.0 * kHalfPi;
+  voice->left_gain = gain * static_cast<float>(std::cos(angle));
+  voice->right_gain = gain * static_cast<float>(std::sin(angle));
+}
+
+void Synthesizer::UpdateChannelVoices(int channel, bool pitch, bool gain) {
+  for (Voice& voice : voices_) {
+    if (!voice.active || voice.channel != channel) {
+      continue;
+    }
+    if (pitch) {
+      UpdatePitch(&voice);
+    }
+    if (gain) {
+      UpdateGain(&voice);
+    }
+  }
+}
+
+void Synthesizer::ResetChannel(int channel) {
+  Channel& state = channels_[channel];
+  state.bank = 0;
+  state.program = 0;
+  state.volume = 100;
+  state.expression = 127;
+  state.pan = 64;
+  state.sustain = false;
+  state.pitch_bend = 8192;
+  state.bend_range_cents = 200;
+  state.rpn = kNoRpn;
+  SelectPreset(channel);
+}
+
+void Synthesizer::SelectPreset(int channel) {
+  Channel& state = channels_[channel];
+  state.preset =
+      font_->FindPreset(PresetBank(channel, state.bank), state.program);
+  if (state.preset != nullptr && !font_->samples_prepared(*state.preset)) {
+    ++unprepared_presets_;
+  }
+}
+
+size_t Synthesizer::AdvanceEnvelope(Voice* voice, float* envelope,
+                                    size_t frames) const {
+  // Each stage runs as a tight loop up to its end or the end of the block;
+  // the level sequence is the same as stepping sample by sample.
+  size_t frame = 0;
+  while (frame < frames) {
+    switch (voice->stage) {
+      case Stage::kDelay:
+      case Stage::kHold: {
+        size_t count = std::min<size_t>(frames - frame, voice->stage_samples);
+        std::fill(envelope + frame, envelope + frame + count, voice->level);
+        frame += count;
+        voice->stage_samples -= static_cast<uint32_t>(count);
+        if (voice->stage_samples == 0) {
+          EnterStage(voice, voice->stage == Stage::kDelay ? Stage::kAttack
+                                                          : Stage::kDecay);
+        }
+        break;
+      }
+      case Stage::kAttack: {
+        size_t count = std::min<size_t>(frames - frame, voice->stage_samples);
+        for (size_t i = 0; i < count; ++i) {
+          envelope[frame++] = voice->level;
+          voice->level += voice->attack_step;
+        }
+        voice->stage_samples -= static_cast<uint32_t>(count);
+        if (voice->stage_samples == 0) {
+          EnterStage(voice, Stage::kHold);
+        }
+        break;
+      }
+      case Stage::kDecay:
+        while (frame < frames) {
+          envelope[frame++] = voice->level;
+          voice->level *= voice->decay_factor;
+          if (voice->level <= voice->sustain_level) {
+            voice->level = voice->sustain_level;
+            EnterStage(voice, Stage::kSustain);
+            break;
+          }
+        }
+        break;
+      case Stage::kSustain:
+        std::fill(envelope + frame, envelope + frames, voice->level);
+        frame = frames;
+        break;
+      case Stage::kRelease:
+        while (frame < frames) {
+          envelope[frame++] = voice->level;
+          voice->level *= voice->release_factor;
+          if (voice->level <= kSilence) {
+            voice->active = false;
+            break;
+          }
+        }
+        break;
+    }
+    if (!voice->active) {
+      return frame;
+    }
+  }
+  return frames;
+}
+
+size_t Synthesizer::FetchSamples(Voice* voice, float* s0, float* s1,
+                                 float* fraction, size_t frames) const {
+  const SoundFontRegion& region = *voice->region;
+  const int16_t* data = font_->samples();
+  const double loop_start = region.loop_start;
+  const double loop_end = region.loop_end;
+  const double loop_length = loop_end - loop_start;
+  const bool looping =
+      region.loop_mode == LoopMode::kContinuous ||
+      (region.loop_mode == LoopMode::kUntilRelease && !voice->released);
+  // Below this position the next frame is simply the following one and
+  // there is nothing to wrap or end, which is nearly always.
+  const double plain_end =
+      (looping ? loop_end : static_cast<double>(region.end)) - 1.0;
+
+  double position = voice->position;
+  const double step = voice->step;
+  for (size_t frame = 0; frame < frames; ++frame) {
+    uint32_t index = static_cast<uint32_t>(position);
+    fraction[frame] = static_cast<float>(position - index);
+    s0[frame] = data[index];
+    if (position < plain_end) {
+      s1[frame] = data[index + 1];
+    } else {
+      uint32_t next = index + 1;
+      if (looping && next >= region.loop_end) {
+        next = region.loop_start;
+      }
+      s1[frame] = next < region.end ? data[next] : 0.0f;
+    }
+
+    position += step;
+    if (position >= plain_end) {
+      if (looping) {
+        while (position >= loop_end) {
+          position -= loop_length;
+        }
+      } else if (position >= region.end) {
+        voice->position = position;
+        voice->active = false;
+        return frame + 1;
+      }
+    }
+  }
+  voice->position = position;
+  return frames;
+}
+
+void Synthesizer::RenderVoice(Voice* voice, float* output, size_t frames) {
+  float envelope[kKernelBlock];
+  float s0[kKernelBlock];
+  float s1[kKernelBlock];
+  float fraction[kKernelBlock];
+  float mono[kKernelBlock];
+  while (frames > 0 && voice->active) {
+    size_t count = std::min(frames, kKernelBlock);
+    // Whichever ends the voice first, the frame it ends on still sounds.
+    count = AdvanceEnvelope(voice, envelope, count);
+    count = FetchSamples(voice, s0, s1, fraction, count);
+    kernels_->interpolate(s0, s1, fraction, kSampleScale, mono, count);
+    kernels_->apply_envelope(mono, envelope, count);
+    kernels_->mix_stereo(mono, voice->left_gain, voice->right_gain, output,
+                         count);
+    output += count * 2;
+    frames -= count;
+  }
+}
+
+}  // namespace playmidifile
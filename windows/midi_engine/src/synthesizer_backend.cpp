@@ -0,0 +1,179 @@
+#include "midi_engine/synthesizer_backend.h"
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+namespace playmidifile {
+
+namespace {
+
+// How often to check for the end of the file. The render thread finds it;
+// this only decides how soon the engine hears about it.
+constexpr std::chrono::milliseconds kServiceInterval(10);
+
+// Every part of the mixer was taken when the backend was made, so it has
+// none to play; each command that needs one fails with this.
+constexpr char kNoPartError[] = "Too many synthesizer players";
+
+}  // namespace
+
+SynthesizerBackend::SynthesizerBackend(SynthesizerMixer* mixer)
+    : mixer_(mixer),
+      part_(mixer->AddPart()),
+      duration_us_(0),
+      chained_duration_us_(0),
+      transitions_(0),
+      position_us_(0),
+      speed_(1.0),
+      playing_(false) {
+  if (part_ >= 0) {
+    transitions_ = mixer_->transitions(part_);
+  }
+}
+
+SynthesizerBackend::~SynthesizerBackend() {
+  if (part_ >= 0) {
+    mixer_->RemovePart(part_);
+  }
+}
+
+bool SynthesizerBackend::Open(const std::string& path,
+                              std::shared_ptr<const Sequence> sequence,
+                              std::string* error) {
+  if (part_ < 0) {
+    *error = kNoPartError;
+    return false;
+  }
+  duration_us_ = sequence->duration_us();
+  chained_duration_us_ = 0;
+  position_us_ = 0;
+  playing_ = false;
+  mixer_->Open(part_, std::move(sequence));
+  return true;
+}
+
+void SynthesizerBackend::Close() {
+  if (part_ >= 0) {
+    mixer_->Close(part_);
+  }
+  playing_ = false;
+}
+
+bool SynthesizerBackend::Chain(const std::string& path,
+                               std::shared_ptr<const Sequence> next,
+                               std::string* error) {
+  if (part_ < 0) {
+    *error = kNoPartError;
+    return false;
+  }
+  chained_duration_us_ = next ? next->duration_us() : 0;
+  mixer_->Chain(part_, std::move(next));
+  return true;
+}
+
+bool SynthesizerBackend::TakeTransition() {
+  if (part_ < 0) {
+    return false;
+  }
+  uint64_t transitions = mixer_->transitions(part_);
+  if (transitions == transitions_) {
+    return false;
+  }
+  transitions_ = transitions;
+  // Whatever the clock ran past the old end belongs to the new file.
+  Clock::time_point now = Clock::now();
+  uint64_t position_us = PositionUs(now);
+  position_us_ = position_us > duration_us_ ? position_us - duration_us_ : 0;
+  anchor_ = now;
+  duration_us_ = chained_duration_us_;
+  chained_duration_us_ = 0;
+  return true;
+}
+
+bool SynthesizerBackend::Play(std::string* error) {
+  if (part_ < 0) {
+    *error = kNoPartError;
+    return false;
+  }
+  if (!playing_) {
+    anchor_ = Clock::now();
+    playing_ = true;
+  }
+  mixer_->Play(part_);
+  return true;
+}
+
+bool SynthesizerBackend::Pause(std::string* error) {
+  if (part_ < 0) {
+    *error = kNoPartError;
+    return false;
+  }
+  Rebase(Clock::now());
+  playing_ = false;
+  mixer_->Pause(part_);
+  return true;
+}
+
+bool SynthesizerBackend::Stop(std::string* error) { return Pause(error); }
+
+bool SynthesizerBackend::Seek(uint32_t position_ms, std::string* error) {
+  if (part_ < 0) {
+    *error = kNoPartError;
+    return false;
+  }
+  position_us_ = static_cast<uint64_t>(position_ms) * 1000;
+  anchor_ = Clock::now();
+  mixer_->Seek(part_, position_us_);
+  return true;
+}
+
+void SynthesizerBackend::SetVolume(double volume) {
+  if (part_ >= 0) {
+    mixer_->SetVolume(part_, volume);
+  }
+}
+
+bool SynthesizerBackend::SetSpeed(double speed) {
+  if (part_ < 0) {
+    return false;
+  }
+  Rebase(Clock::now());
+  speed_ = speed;
+  mixer_->SetSpeed(part_, speed);
+  return true;
+}
+
+uint32_t SynthesizerBackend::PositionMs() {
+  return static_cast<uint32_t>(
+      std::min(PositionUs(Clock::now()), duration_us_) / 1000);
+}
+
+PlaybackBackend::Clock::time_point SynthesizerBackend::Service(
+    Clock::time_point now, bool* finished) {
+  *finished = part_ >= 0 && mixer_->finished(part_);
+  if (*finished) {
+    // Stopped where the render thread is, so that the engine's rewind
+    // renders a lead-in for the next play().
+    Rebase(now);
+    playing_ = false;
+    mixer_->Pause(part_);
+  }
+  return now + kServiceInterval;
+}
+
+uint64_t SynthesizerBackend::PositionUs(Clock::time_point now) const {
+  if (!playing_ || now <= anchor_) {
+    return position_us_;
+  }
+  double elapsed_us =
+      std::chrono::duration<double, std::micro>(now - anchor_).count();
+  return position_us_ + static_cast<uint64_t>(elapsed_us * speed_);
+}
+
+void SynthesizerBackend::Rebase(Clock::time_point now) {
+  position_us_ = PositionUs(now);
+  anchor_ = now;
+}
+
+}  // namespace playmidifile
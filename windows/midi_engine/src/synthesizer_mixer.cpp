@@ -0,0 +1,512 @@
+#include "midi_engine/synthesizer_mixer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace playmidifile {
+
+namespace {
+
+using Clock = Sequencer::Clock;
+
+constexpr size_t kCommandQueueCapacity = 1024;
+constexpr size_t kRetiredQueueCapacity = 256;
+// Frames a part renders between checks for due events, at most.
+constexpr size_t kBlock = 256;
+constexpr uint64_t kNanosPerSecond = 1000000000;
+
+}  // namespace
+
+// A sequencer playing into a synthesizer on a clock of its own: frame n
+// plays at n / sample_rate seconds after the epoch, whichever thread renders
+// it and whenever.
+struct SynthesizerMixer::Part {
+  Part(std::shared_ptr<const SoundFont> font, uint32_t sample_rate,
+       int polyphony)
+      : synthesizer(std::move(font), sample_rate, polyphony),
+        sequencer(&synthesizer),
+        rate(sample_rate),
+        frame(0) {}
+
+  Clock::time_point Now() const {
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(
+        std::chrono::nanoseconds(frame / rate * kNanosPerSecond +
+                                 frame % rate * kNanosPerSecond / rate)));
+  }
+
+  // First frame at or after |time|.
+  uint64_t FrameAt(Clock::time_point time) const {
+    if (time == Clock::time_point::max()) {
+      return UINT64_MAX;
+    }
+    uint64_t nanos = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            time.time_since_epoch())
+            .count());
+    return nanos / kNanosPerSecond * rate +
+           (nanos % kNanosPerSecond * rate + kNanosPerSecond - 1) /
+               kNanosPerSecond;
+  }
+
+  // Adds |frames| frames to |mix|, sending each event just before the frame
+  // it falls on.
+  void Render(float* mix, size_t frames) {
+    if (!sequencer.running() && synthesizer.active_voices() == 0) {
+      frame += frames;
+      return;
+    }
+    float block[kBlock * 2];
+    while (frames > 0) {
+      uint64_t next = FrameAt(sequencer.Dispatch(Now()));
+      size_t count = std::min(frames, kBlock);
+      if (next > frame && next - frame < count) {
+        count = static_cast<size_t>(next - frame);
+      }
+      synthesizer.Render(block, count);
+      for (size_t i = 0; i < count * 2; ++i) {
+        mix[i] += block[i];
+      }
+      mix += count * 2;
+      frames -= count;
+      frame += count;
+    }
+  }
+
+  Synthesizer synthesizer;
+  Sequencer sequencer;
+  const uint32_t rate;
+  uint64_t frame;
+};
+
+// A part's next stretch of audio, rendered ahead, and the part as it is at
+// the end of it.
+struct SynthesizerMixer::LeadIn {
+  int part = 0;
+  uint64_t generation = 0;
+  uint64_t position_us = 0;
+  std::unique_ptr<Part> state;
+  std::vector<float> audio;
+  size_t frames = 0;
+};
+
+SynthesizerMixer::SynthesizerMixer(std::shared_ptr<const SoundFont> font,
+                                   uint32_t sample_rate, int polyphony)
+    : font_(std::move(font)),
+      sample_rate_(sample_rate),
+      polyphony_(polyphony),
+      output_(nullptr),
+      lead_in_ms_(0),
+      commands_(kCommandQueueCapacity),
+      lead_ins_(kMaxParts),
+      retired_parts_(kRetiredQueueCapacity),
+      retired_lead_ins_(kRetiredQueueCapacity),
+      worker_(std::make_unique<WorkerThread>()) {}
+
+SynthesizerMixer::~SynthesizerMixer() {
+  worker_.reset();
+}
+
+void SynthesizerMixer::SetLeadInMs(uint32_t lead_in_ms) {
+  lead_in_ms_ = lead_in_ms;
+}
+
+int SynthesizerMixer::AddPart() {
+  for (int part = 0; part < kMaxParts; ++part) {
+    if (!controls_[part].added) {
+      controls_[part].added = true;
+      controls_[part].speed = 1.0;
+      controls_[part].volume = 1.0;
+      return part;
+    }
+  }
+  return -1;
+}
+
+void SynthesizerMixer::RemovePart(int part) {
+  Close(part);
+  controls_[part].added = false;
+}
+
+void SynthesizerMixer::Open(int part,
+                            std::shared_ptr<const Sequence> sequence) {
+  DrainRetired();
+  if (sequence) {
+    Synthesizer::PrepareSamples(*font_, *sequence);
+  }
+  Control& control = controls_[part];
+  control.sequence = sequence;
+  control.chained = nullptr;
+  control.position_us = 0;
+  control.position_known = true;
+  control.playing = false;
+  Command command = NewCommand(part, Command::Kind::kOpen);
+  command.state = NewPart(std::move(sequence), control.speed, control.volume);
+  Send(std::move(command));
+  RequestLeadIn(part);
+}
+
+void SynthesizerMixer::Close(int part) {
+  DrainRetired();
+  Control& control = controls_[part];
+  control.sequence = nullptr;
+  control.chained = nullptr;
+  control.position_known = false;
+  control.playing = false;
+  Send(NewCommand(part, Command::Kind::kClose));
+}
+
+void SynthesizerMixer::Chain(int part, std::shared_ptr<const Sequence> next) {
+  DrainRetired();
+  if (next) {
+    Synthesizer::PrepareSamples(*font_, *next);
+  }
+  controls_[part].chained = next;
+  Command command = NewCommand(part, Command::Kind::kChain);
+  if (next) {
+    command.next = std::make_unique<SequenceCursor>(std::move(next));
+  }
+  Send(std::move(command));
+  RequestLeadIn(part);
+}
+
+void SynthesizerMixer::Play(int part) {
+  DrainRetired();
+  controls_[part].playing = true;
+  controls_[part].position_known = false;
+  Send(NewCommand(part, Command::Kind::kPlay));
+}
+
+void SynthesizerMixer::Pause(int part) {
+  DrainRetired();
+  // Nothing to stop, and a lead-in to keep.
+  if (!controls_[part].playing) {
+    return;
+  }
+  controls_[part].playing = false;
+  Send(NewCommand(part, Command::Kind::kPause));
+}
+
+void SynthesizerMixer::Seek(int part, uint64_t position_us) {
+  DrainRetired();
+  const Control& control = controls_[part];
+  // Already there, as after a stop: keep the lead-in that is rendering.
+  if (control.position_known && !control.playing &&
+      control.position_us == position_us) {
+    return;
+  }
+  controls_[part].position_us = position_us;
+  controls_[part].position_known = true;
+  Command command = NewCommand(part, Command::Kind::kSeek);
+  command.position_us = position_us;
+  Send(std::move(command));
+  RequestLeadIn(part);
+}
+
+void SynthesizerMixer::SetSpeed(int part, double speed) {
+  DrainRetired();
+  controls_[part].speed = speed;
+  Command command = NewCommand(part, Command::Kind::kSpeed);
+  command.value = speed;
+  Send(std::move(command));
+  RequestLeadIn(part);
+}
+
+void SynthesizerMixer::SetVolume(int part, double volume) {
+  DrainRetired();
+  controls_[part].volume = volume;
+  Command command = NewCommand(part, Command::Kind::kVolume);
+  command.value = volume;
+  Send(std::move(command));
+  RequestLeadIn(part);
+}
+
+bool SynthesizerMixer::finished(int part) const {
+  return slots_[part].finished_generation.load(std::memory_order_acquire) ==
+         controls_[part].generation.load(std::memory_order_relaxed);
+}
+
+bool SynthesizerMixer::lead_in_ready(int part) const {
+  return slots_[part].ready_generation.load(std::memory_order_acquire) ==
+         controls_[part].generation.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<SynthesizerMixer::Part> SynthesizerMixer::NewPart(
+    std::shared_ptr<const Sequence> sequence, double speed,
+    double volume) const {
+  auto part = std::make_unique<Part>(font_, sample_rate_, polyphony_);
+  part->sequencer.Load(std::move(sequence));
+  part->sequencer.SetSpeed(speed, part->Now());
+  part->synthesizer.SetVolume(volume);
+  return part;
+}
+
+void SynthesizerMixer::Send(Command&& command) {
+  // The render thread empties the queue every period; only a burst of
+  // commands far beyond any real use would wait here.
+  while (!commands_.TryPush(std::move(command))) {
+    std::this_thread::yield();
+  }
+  if (output_) {
+    output_->Wake();
+  }
+}
+
+SynthesizerMixer::Command SynthesizerMixer::NewCommand(int part,
+                                                       Command::Kind kind) {
+  Command command;
+  command.kind = kind;
+  command.part = part;
+  command.generation =
+      controls_[part].generation.fetch_add(1, std::memory_order_relaxed) + 1;
+  return command;
+}
+
+void SynthesizerMixer::RequestLeadIn(int part) {
+  const Control& control = controls_[part];
+  if (!output_ || lead_in_ms_ == 0 || !control.sequence ||
+      !control.position_known || control.playing) {
+    return;
+  }
+  auto lead_in = std::make_unique<LeadIn>();
+  lead_in->part = part;
+  lead_in->generation = control.generation.load(std::memory_order_relaxed);
+  lead_in->position_us = control.position_us;
+  lead_in->frames =
+      static_cast<size_t>(uint64_t{lead_in_ms_} * sample_rate_ / 1000);
+  // The live part joins in once the ring has caught up with the lead-in,
+  // which takes the ring's whole length at most, plus a period in flight.
+  if (lead_in->frames <
+      output_->latency_frames() + output_->format().period_frames) {
+    return;
+  }
+  // std::function needs a copyable task.
+  struct Job {
+    std::unique_ptr<LeadIn> lead_in;
+    std::shared_ptr<const Sequence> sequence;
+    std::shared_ptr<const Sequence> chained;
+  };
+  auto job = std::make_shared<Job>();
+  job->lead_in = std::move(lead_in);
+  job->sequence = control.sequence;
+  job->chained = control.chained;
+  uint64_t position_us = control.position_us;
+  double speed = control.speed;
+  double volume = control.volume;
+  worker_->Post([this, job, position_us, speed, volume] {
+    RenderLeadIn(std::move(job->lead_in), std::move(job->sequence),
+                 std::move(job->chained), position_us, speed, volume);
+  });
+}
+
+void SynthesizerMixer::DrainRetired() {
+  std::unique_ptr<Part> part;
+  while (retired_parts_.TryPop(&part)) {
+    part.reset();
+  }
+  std::unique_ptr<LeadIn> lead_in;
+  while (retired_lead_ins_.TryPop(&lead_in)) {
+    lead_in.reset();
+  }
+}
+
+void SynthesizerMixer::RenderLeadIn(std::unique_ptr<LeadIn> lead_in,
+                                    std::shared_ptr<const Sequence> sequence,
+                                    std::shared_ptr<const Sequence> chained,
+                                    uint64_t position_us, double speed,
+                                    double volume) {
+  lead_in->state = NewPart(std::move(sequence), speed, volume);
+  Part* part = lead_in->state.get();
+  if (chained) {
+    part->sequencer.Chain(std::move(chained));
+  }
+  // Seeking chases the programs in effect, which also pages in their
+  // samples here rather than on the render thread.
+  part->sequencer.Seek(position_us, part->Now());
+  part->sequencer.Play(part->Now());
+  lead_in->audio.assign(lead_in->frames * 2, 0.0f);
+  part->Render(lead_in->audio.data(), lead_in->frames);
+  // A full queue means the render thread is not polling; drop it.
+  lead_ins_.TryPush(std::move(lead_in));
+}
+
+void SynthesizerMixer::Poll() {
+  Command command;
+  while (commands_.TryPop(&command)) {
+    Execute(&command);
+  }
+  std::unique_ptr<LeadIn> lead_in;
+  while (lead_ins_.TryPop(&lead_in)) {
+    Slot& slot = slots_[lead_in->part];
+    // Only the newest request counts, and only while the part is still
+    // where it was asked for.
+    if (lead_in->generation != slot.generation || !slot.part ||
+        slot.part->sequencer.running()) {
+      Retire(std::move(lead_in));
+      continue;
+    }
+    Retire(std::move(slot.lead_in));
+    slot.lead_in = std::move(lead_in);
+    slot.ready_generation.store(slot.generation, std::memory_order_release);
+  }
+  ReleaseOverlays();
+}
+
+void SynthesizerMixer::Execute(Command* command) {
+  Slot& slot = slots_[command->part];
+  const uint64_t previous = slot.generation;
+  slot.generation = command->generation;
+  Part* part = slot.part.get();
+  // A lead-in is for the state it was rendered from; every command but a
+  // play that uses it moves on from there.
+  std::unique_ptr<LeadIn> lead_in = std::move(slot.lead_in);
+  switch (command->kind) {
+    case Command::Kind::kOpen:
+      StopLeadIn(&slot);
+      Retire(std::move(slot.part));
+      slot.part = std::move(command->state);
+      break;
+    case Command::Kind::kClose:
+      StopLeadIn(&slot);
+      Retire(std::move(slot.part));
+      break;
+    case Command::Kind::kChain:
+      if (part) {
+        part->sequencer.Chain(std::move(command->next));
+      }
+      break;
+    case Command::Kind::kPlay: {
+      if (!part || part->sequencer.running()) {
+        break;
+      }
+      int overlay = -1;
+      if (lead_in && lead_in->generation == previous) {
+        overlay = output_->StartOverlay(lead_in->audio.data(), lead_in->frames);
+      }
+      if (overlay < 0) {
+        part->sequencer.Play(part->Now());
+        break;
+      }
+      // The lead-in's copy of the part, already past the audio the device
+      // is about to play, becomes the live part.
+      Retire(std::move(slot.part));
+      slot.part = std::move(lead_in->state);
+      slot.waiting = true;
+      slot.overlay = overlay;
+      slot.lead_in_frames = lead_in->frames;
+      slot.lead_in_position_us = lead_in->position_us;
+      overlays_[overlay] = std::move(lead_in);
+      break;
+    }
+    case Command::Kind::kPause:
+      if (slot.waiting) {
+        // The live part is already at the lead-in's end; take it back to
+        // about where the device has got to in the lead-in.
+        int64_t start = output_->OverlayStartFrame(slot.overlay);
+        uint64_t played = 0;
+        if (start >= 0) {
+          played = std::min<uint64_t>(
+              output_->read_frame() - static_cast<uint64_t>(start),
+              slot.lead_in_frames);
+        }
+        part->sequencer.Seek(
+            slot.lead_in_position_us +
+                static_cast<uint64_t>(played * 1e6 *
+                                      part->sequencer.speed() / sample_rate_),
+            part->Now());
+      }
+      StopLeadIn(&slot);
+      if (part) {
+        part->sequencer.Pause(part->Now());
+      }
+      break;
+    case Command::Kind::kSeek:
+      StopLeadIn(&slot);
+      if (part) {
+        part->sequencer.Seek(command->position_us, part->Now());
+      }
+      break;
+    case Command::Kind::kSpeed:
+      if (part) {
+        part->sequencer.SetSpeed(command->value, part->Now());
+      }
+      break;
+    case Command::Kind::kVolume:
+      if (part) {
+        part->synthesizer.SetVolume(command->value);
+      }
+      break;
+  }
+  Retire(std::move(lead_in));
+}
+
+void SynthesizerMixer::StopLeadIn(Slot* slot) {
+  if (slot->overlay >= 0) {
+    output_->CancelOverlay(slot->overlay);
+    slot->overlay = -1;
+  }
+  slot->waiting = false;
+}
+
+void SynthesizerMixer::ReleaseOverlays() {
+  for (int id = 0; id < AudioOutput::kMaxOverlays; ++id) {
+    if (overlays_[id] && output_->TryReleaseOverlay(id)) {
+      Retire(std::move(overlays_[id]));
+    }
+  }
+}
+
+void SynthesizerMixer::Render(float* output, size_t frames) {
+  Poll();
+  std::fill(output, output + frames * 2, 0.0f);
+  const uint64_t first = output_ ? output_->render_frame() : 0;
+  for (Slot& slot : slots_) {
+    if (!slot.part) {
+      continue;
+    }
+    size_t offset = 0;
+    if (slot.waiting) {
+      int64_t start = output_->OverlayStartFrame(slot.overlay);
+      if (start < 0) {
+        continue;
+      }
+      uint64_t join = static_cast<uint64_t>(start) + slot.lead_in_frames;
+      if (join >= first + frames) {
+        continue;
+      }
+      // Later than |first| unless the render thread fell behind the
+      // device, in which case the part comes in late rather than never.
+      offset = join > first ? static_cast<size_t>(join - first) : 0;
+      slot.waiting = false;
+      slot.overlay = -1;
+    }
+    Part* part = slot.part.get();
+    part->Render(output + offset * 2, frames - offset);
+    if (part->sequencer.TakeTransition()) {
+      slot.transitions.fetch_add(1, std::memory_order_release);
+    }
+    if (part->sequencer.finished()) {
+      slot.finished_generation.store(slot.generation,
+                                     std::memory_order_release);
+    }
+  }
+}
+
+void SynthesizerMixer::Retire(std::unique_ptr<Part> part) {
+  // Freeing here would be a heap call on the render thread; the engine
+  // thread frees it on its next command instead. If even that queue is
+  // full, freeing beats leaking.
+  if (part && !retired_parts_.TryPush(std::move(part))) {
+    part.reset();
+  }
+}
+
+void SynthesizerMixer::Retire(std::unique_ptr<LeadIn> lead_in) {
+  if (lead_in && !retired_lead_ins_.TryPush(std::move(lead_in))) {
+    lead_in.reset();
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,138 @@
+#include "midi_engine/tempo_map.h"
+
+#include <algorithm>
+
+#include "midi_engine/smf_parser.h"
+
+namespace playmidifile {
+
+namespace {
+
+constexpr uint16_t kDefaultDivision = 480;
+
+}  // namespace
+
+TempoMap::TempoMap()
+    : TempoMap(std::vector<TempoChange>(), kDefaultDivision) {}
+
+TempoMap::TempoMap(const std::vector<TempoChange>& changes,
+                   uint16_t division) {
+  // Guards the divisions below; the parsers have already rejected these.
+  if (!IsValidDivision(division)) {
+    division = kDefaultDivision;
+  }
+  smpte_ = (division & 0x8000) != 0;
+  if (smpte_) {
+    // frames/second * ticks/frame ticks per second; 29 means 29.97 drop
+    // frame, kept exact by scaling both sides by 100.
+    int frames = -static_cast<int8_t>(division >> 8);
+    uint64_t ticks_per_frame = division & 0xFF;
+    uint64_t fps_x100 =
+        frames == 29 ? 2997 : static_cast<uint64_t>(frames) * 100;
+    denominator_ = fps_x100 * ticks_per_frame;
+    segments_.push_back(Segment{0, 100000000, 0});
+    return;
+  }
+
+  denominator_ = division;
+  segments_.reserve(changes.size() + 1);
+  segments_.push_back(Segment{0, kDefaultMicrosPerQuarter, 0});
+  for (const TempoChange& change : changes) {
+    Segment& last = segments_.back();
+    if (change.tick == last.tick) {
+      // Several changes at one tick: the last one wins.
+      last.rate = change.micros_per_quarter;
+      continue;
+    }
+    uint64_t scaled_start =
+        last.scaled_start +
+        static_cast<uint64_t>(change.tick - last.tick) * last.rate;
+    segments_.push_back(
+        Segment{change.tick, change.micros_per_quarter, scaled_start});
+  }
+}
+
+TempoMap::TempoMap(const TempoMap& other, Arena* arena)
+    : segments_(ArenaAllocator<Segment>(arena)),
+      denominator_(other.denominator_),
+      smpte_(other.smpte_) {
+  segments_.reserve(other.segments_.size());
+  segments_.assign(other.segments_.begin(), other.segments_.end());
+}
+
+// static
+bool TempoMap::IsValidDivision(uint16_t division) {
+  if ((division & 0x8000) == 0) {
+    return division != 0;
+  }
+  int frames = -static_cast<int8_t>(division >> 8);
+  bool known_rate = frames == 24 || frames == 25 || frames == 29 ||
+                    frames == 30;
+  return known_rate && (division & 0xFF) != 0;
+}
+
+uint64_t TempoMap::TicksToMicros(uint32_t tick) const {
+  return SegmentTicksToMicros(segments_[SegmentForTick(tick)], tick);
+}
+
+uint32_t TempoMap::MicrosToTicks(uint64_t micros) const {
+  // Last tick whose (floored) time is <= micros, so that the conversion is
+  // an exact inverse of TicksToMicros().
+  uint64_t scaled = micros * denominator_ + denominator_ - 1;
+  auto it = std::upper_bound(
+      segments_.begin(), segments_.end(), scaled,
+      [](uint64_t value, const Segment& segment) {
+        return value < segment.scaled_start;
+      });
+  const Segment& segment = *(it - 1);
+  uint64_t ticks = (scaled - segment.scaled_start) / segment.rate;
+  return static_cast<uint32_t>(
+      std::min<uint64_t>(segment.tick + ticks, UINT32_MAX));
+}
+
+uint64_t TempoMap::TicksToMicros(uint32_t tick, double speed) const {
+  return static_cast<uint64_t>(static_cast<double>(TicksToMicros(tick)) /
+                               speed);
+}
+
+uint32_t TempoMap::MicrosToTicks(uint64_t micros, double speed) const {
+  return MicrosToTicks(
+      static_cast<uint64_t>(static_cast<double>(micros) * speed));
+}
+
+uint32_t TempoMap::MicrosPerQuarterAt(uint32_t tick) const {
+  if (smpte_) {
+    return 0;
+  }
+  return static_cast<uint32_t>(segments_[SegmentForTick(tick)].rate);
+}
+
+size_t TempoMap::SegmentForTick(uint32_t tick) const {
+  auto it = std::upper_bound(segments_.begin(), segments_.end(), tick,
+                             [](uint32_t value, const Segment& segment) {
+                               return value < segment.tick;
+                             });
+  return static_cast<size_t>(it - segments_.begin()) - 1;
+}
+
+uint64_t TempoMap::SegmentTicksToMicros(const Segment& segment,
+                                        uint32_t tick) const {
+  return (segment.scaled_start +
+          static_cast<uint64_t>(tick - segment.tick) * segment.rate) /
+         denominator_;
+}
+
+uint64_t TempoMap::Cursor::TicksToMicros(uint32_t tick) {
+  const ArenaVector<Segment>& segments = map_->segments_;
+  if (tick < segments[segment_].tick) {
+    segment_ = map_->SegmentForTick(tick);
+  } else {
+    while (segment_ + 1 < segments.size() &&
+           segments[segment_ + 1].tick <= tick) {
+      ++segment_;
+    }
+  }
+  return map_->SegmentTicksToMicros(segments[segment_], tick);
+}
+
+}  // namespace playmidifile
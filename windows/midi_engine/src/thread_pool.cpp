@@ -0,0 +1,82 @@
+#include "midi_engine/thread_pool.h"
+
+#include <algorithm>
+
+namespace playmidifile {
+
+ThreadPool::ThreadPool(int threads)
+    : generation_(0),
+      busy_(0),
+      quit_(false),
+      task_(nullptr),
+      count_(0),
+      next_(0) {
+  for (int i = 1; i < threads; ++i) {
+    workers_.emplace_back(&ThreadPool::Run, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)>& task) {
+  if (workers_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      task(i);
+    }
+    return;
+  }
+  std::lock_guard<std::mutex> job_lock(job_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_ = &task;
+    count_ = count;
+    next_.store(0, std::memory_order_relaxed);
+    busy_ = static_cast<int>(workers_.size());
+    ++generation_;
+  }
+  wake_.notify_all();
+  Work();
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return busy_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::Run() {
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this, seen] { return quit_ || generation_ != seen; });
+    if (quit_) {
+      return;
+    }
+    seen = generation_;
+    lock.unlock();
+    Work();
+    lock.lock();
+    if (--busy_ == 0) {
+      done_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::Work() {
+  while (true) {
+    size_t i = next_.fetch_add(1, std::memory_order_relaxed);
+    if (i >= count_) {
+      return;
+    }
+    (*task_)(i);
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,105 @@
+#include "utf8_path.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#endif
+
+namespace playmidifile {
+
+#ifdef _WIN32
+
+std::wstring Utf8ToWide(const std::string& utf8) {
+  if (utf8.empty()) {
+    return std::wstring();
+  }
+  int size_needed = MultiByteToWideChar(CP_UTF8, 0, utf8.data(),
+                                        static_cast<int>(utf8.size()),
+                                        nullptr, 0);
+  std::wstring wide(size_needed, L'\0');
+  MultiByteToWideChar(CP_UTF8, 0, utf8.data(), static_cast<int>(utf8.size()),
+                      &wide[0], size_needed);
+  return wide;
+}
+
+std::string WideToUtf8(const std::wstring& wide) {
+  if (wide.empty()) {
+    return std::string();
+  }
+  int size_needed = WideCharToMultiByte(CP_UTF8, 0, wide.data(),
+                                        static_cast<int>(wide.size()),
+                                        nullptr, 0, nullptr, nullptr);
+  std::string utf8(size_needed, '\0');
+  WideCharToMultiByte(CP_UTF8, 0, wide.data(), static_cast<int>(wide.size()),
+                      &utf8[0], size_needed, nullptr, nullptr);
+  return utf8;
+}
+
+std::FILE* OpenFileUtf8(const std::string& utf8_path, const char* mode) {
+  std::wstring wide_mode(mode, mode + std::char_traits<char>::length(mode));
+  return _wfopen(Utf8ToWide(utf8_path).c_str(), wide_mode.c_str());
+}
+
+bool StatFileUtf8(const std::string& utf8_path, FileStamp* stamp,
+                  std::string* error) {
+  // No access rights are needed to query the name and attributes, and
+  // opening without them never conflicts with writers.
+  HANDLE file = CreateFileW(Utf8ToWide(utf8_path).c_str(), 0,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE |
+                                FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, 0, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = "File not found";
+    return false;
+  }
+  BY_HANDLE_FILE_INFORMATION info;
+  wchar_t path[MAX_PATH * 2];
+  DWORD length = GetFinalPathNameByHandleW(file, path, MAX_PATH * 2,
+                                           FILE_NAME_NORMALIZED);
+  bool ok = GetFileInformationByHandle(file, &info) && length > 0 &&
+            length < MAX_PATH * 2;
+  CloseHandle(file);
+  if (!ok) {
+    *error = "Cannot query file";
+    return false;
+  }
+  stamp->canonical_path = WideToUtf8(std::wstring(path, length));
+  stamp->size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) |
+                info.nFileSizeLow;
+  stamp->mtime = static_cast<int64_t>(
+      (static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+      info.ftLastWriteTime.dwLowDateTime);
+  return true;
+}
+
+#else  // _WIN32
+
+std::FILE* OpenFileUtf8(const std::string& utf8_path, const char* mode) {
+  return std::fopen(utf8_path.c_str(), mode);
+}
+
+bool StatFileUtf8(const std::string& utf8_path, FileStamp* stamp,
+                  std::string* error) {
+  char resolved[PATH_MAX];
+  struct stat info;
+  if (realpath(utf8_path.c_str(), resolved) == nullptr ||
+      stat(resolved, &info) != 0) {
+    *error = errno == ENOENT ? "File not found" : std::strerror(errno);
+    return false;
+  }
+  stamp->canonical_path = resolved;
+  stamp->size = static_cast<uint64_t>(info.st_size);
+  stamp->mtime = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+                 info.st_mtim.tv_nsec;
+  return true;
+}
+
+#endif  // _WIN32
+
+}  // namespace playmidifile
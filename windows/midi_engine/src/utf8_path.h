@@ -0,0 +1,38 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_SRC_UTF8_PATH_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_SRC_UTF8_PATH_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+namespace playmidifile {
+
+// Paths cross the plugin boundary as UTF-8. Windows file APIs need them as
+// UTF-16; elsewhere they are passed through.
+
+#ifdef _WIN32
+std::wstring Utf8ToWide(const std::string& utf8);
+std::string WideToUtf8(const std::wstring& wide);
+#endif
+
+// fopen() for a UTF-8 path.
+std::FILE* OpenFileUtf8(const std::string& utf8_path, const char* mode);
+
+// Identifies a file and the version of its contents: the same file reached
+// through different spellings of its path gets the same |canonical_path|,
+// and rewriting it changes |size| or |mtime|.
+struct FileStamp {
+  std::string canonical_path;
+  uint64_t size = 0;
+  // Last write time in platform units (100 ns on Windows, 1 ns elsewhere).
+  int64_t mtime = 0;
+};
+
+// Fills |stamp| for |utf8_path|. Fails with "File not found" when the file
+// does not exist.
+bool StatFileUtf8(const std::string& utf8_path, FileStamp* stamp,
+                  std::string* error);
+
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_SRC_UTF8_PATH_H_
@@ -0,0 +1,120 @@
+#include "midi_engine/wav_writer.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "utf8_path.h"
+
+namespace playmidifile {
+
+namespace {
+
+constexpr size_t kHeaderSize = 44;
+constexpr uint16_t kBytesPerSample = 2;
+
+void Put16(uint8_t* p, uint16_t value) {
+  p[0] = static_cast<uint8_t>(value);
+  p[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void Put32(uint8_t* p, uint32_t value) {
+  Put16(p, static_cast<uint16_t>(value));
+  Put16(p + 2, static_cast<uint16_t>(value >> 16));
+}
+
+void FillHeader(uint8_t* header, uint32_t sample_rate, uint16_t channels,
+                uint32_t data_size) {
+  uint16_t block_align = static_cast<uint16_t>(channels * kBytesPerSample);
+  std::copy_n("RIFF", 4, header);
+  Put32(header + 4, 36 + data_size);
+  std::copy_n("WAVEfmt ", 8, header + 8);
+  Put32(header + 16, 16);
+  Put16(header + 20, 1);  // PCM.
+  Put16(header + 22, channels);
+  Put32(header + 24, sample_rate);
+  Put32(header + 28, sample_rate * block_align);
+  Put16(header + 32, block_align);
+  Put16(header + 34, kBytesPerSample * 8);
+  std::copy_n("data", 4, header + 36);
+  Put32(header + 40, data_size);
+}
+
+}  // namespace
+
+WavWriter::WavWriter()
+    : file_(nullptr), sample_rate_(0), channels_(0), frames_written_(0) {}
+
+WavWriter::~WavWriter() {
+  std::string ignored;
+  Close(&ignored);
+}
+
+bool WavWriter::Open(const std::string& utf8_path, uint32_t sample_rate,
+                     uint16_t channels, std::string* error) {
+  std::string ignored;
+  Close(&ignored);
+  file_ = OpenFileUtf8(utf8_path, "wb");
+  if (file_ == nullptr) {
+    *error = "Failed to create " + utf8_path;
+    return false;
+  }
+  sample_rate_ = sample_rate;
+  channels_ = channels;
+  frames_written_ = 0;
+  uint8_t header[kHeaderSize];
+  FillHeader(header, sample_rate, channels, 0);
+  if (std::fwrite(header, 1, kHeaderSize, file_) != kHeaderSize) {
+    *error = "Failed to write " + utf8_path;
+    std::fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool WavWriter::Write(const float* samples, size_t frames,
+                      std::string* error) {
+  size_t count = frames * channels_;
+  scratch_.resize(count * kBytesPerSample);
+  for (size_t i = 0; i < count; ++i) {
+    float clipped = std::max(-1.0f, std::min(1.0f, samples[i]));
+    int16_t value = static_cast<int16_t>(std::lrint(clipped * 32767.0f));
+    Put16(&scratch_[i * kBytesPerSample], static_cast<uint16_t>(value));
+  }
+  if (std::fwrite(scratch_.data(), 1, scratch_.size(), file_) !=
+      scratch_.size()) {
+    *error = "Failed to write audio data";
+    return false;
+  }
+  frames_written_ += frames;
+  return true;
+}
+
+bool WavWriter::Close(std::string* error) {
+  if (file_ == nullptr) {
+    return true;
+  }
+  bool ok = true;
+  uint64_t data_size = frames_written_ * channels_ * kBytesPerSample;
+  if (data_size > UINT32_MAX - 36) {
+    *error = "Audio data exceeds the 4 GB WAV limit";
+    ok = false;
+  } else {
+    uint8_t header[kHeaderSize];
+    FillHeader(header, sample_rate_, channels_,
+               static_cast<uint32_t>(data_size));
+    ok = std::fseek(file_, 0, SEEK_SET) == 0 &&
+         std::fwrite(header, 1, kHeaderSize, file_) == kHeaderSize;
+    if (!ok) {
+      *error = "Failed to finalize WAV header";
+    }
+  }
+  if (std::fclose(file_) != 0 && ok) {
+    *error = "Failed to close WAV file";
+    ok = false;
+  }
+  file_ = nullptr;
+  return ok;
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,44 @@
+#include "midi_engine/worker_thread.h"
+
+#include <utility>
+
+namespace playmidifile {
+
+WorkerThread::WorkerThread() : quit_(false) {
+  thread_ = std::thread(&WorkerThread::Run, this);
+}
+
+WorkerThread::~WorkerThread() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quit_ = true;
+    tasks_.clear();
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void WorkerThread::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  wake_.notify_one();
+}
+
+void WorkerThread::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this] { return quit_ || !tasks_.empty(); });
+    if (quit_) {
+      return;
+    }
+    std::function<void()> task = std::move(tasks_.front());
+    tasks_.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,43 @@
+#include "allocation_counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace playmidifile {
+namespace testing {
+namespace {
+
+std::atomic<uint64_t> g_allocations(0);
+std::atomic<uint64_t> g_frees(0);
+std::atomic<uint64_t> g_bytes(0);
+
+}  // namespace
+
+AllocationCounts CurrentAllocationCounts() {
+  AllocationCounts counts;
+  counts.allocations = g_allocations.load(std::memory_order_relaxed);
+  counts.frees = g_frees.load(std::memory_order_relaxed);
+  counts.bytes = g_bytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+}  // namespace testing
+}  // namespace playmidifile
+
+// The array, nothrow and sized forms all forward to these two by default.
+void* operator new(std::size_t size) {
+  playmidifile::testing::g_allocations.fetch_add(1, std::memory_order_relaxed);
+  playmidifile::testing::g_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void* memory = std::malloc(size ? size : 1)) {
+    return memory;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+  if (memory) {
+    playmidifile::testing::g_frees.fetch_add(1, std::memory_order_relaxed);
+  }
+  std::free(memory);
+}
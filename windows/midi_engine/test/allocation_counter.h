@@ -0,0 +1,40 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_TEST_ALLOCATION_COUNTER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_TEST_ALLOCATION_COUNTER_H_
+
+#include <cstdint>
+
+namespace playmidifile {
+namespace testing {
+
+// Process-wide counts of calls to the global operator new and delete. The
+// replacement operators live in allocation_counter.cpp, which must be
+// linked into the binary; they cost one relaxed atomic add per call.
+struct AllocationCounts {
+  uint64_t allocations = 0;
+  uint64_t frees = 0;
+  uint64_t bytes = 0;
+};
+
+AllocationCounts CurrentAllocationCounts();
+
+// Counts taken since construction.
+class AllocationScope {
+ public:
+  AllocationScope() : start_(CurrentAllocationCounts()) {}
+
+  AllocationCounts counts() const {
+    AllocationCounts now = CurrentAllocationCounts();
+    now.allocations -= start_.allocations;
+    now.frees -= start_.frees;
+    now.bytes -= start_.bytes;
+    return now;
+  }
+
+ private:
+  AllocationCounts start_;
+};
+
+}  // namespace testing
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_TEST_ALLOCATION_COUNTER_H_
@@ -0,0 +1,61 @@
+#include "midi_engine/arena.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace playmidifile {
+namespace {
+
+TEST(ArenaTest, AlignsAndBumpsWithinAChunk) {
+  Arena arena(1024);
+  auto* byte = static_cast<uint8_t*>(arena.Allocate(1, 1));
+  auto* word = static_cast<uint64_t*>(arena.Allocate(8, 8));
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(word) % 8, 0u);
+  EXPECT_EQ(reinterpret_cast<uint8_t*>(word) - byte, 8);
+  EXPECT_EQ(arena.bytes_used(), 16u);
+  EXPECT_EQ(arena.chunk_count(), 1u);
+}
+
+TEST(ArenaTest, GrowsByChunksAndReleasesAtOnce) {
+  Arena arena(64);
+  arena.Allocate(48);
+  arena.Allocate(48);
+  // Larger than a chunk: gets one of its own.
+  arena.Allocate(1000);
+  EXPECT_EQ(arena.chunk_count(), 3u);
+  EXPECT_EQ(arena.bytes_reserved(), 64u + 64u + 1000u);
+  arena.Release();
+  EXPECT_EQ(arena.chunk_count(), 0u);
+  EXPECT_EQ(arena.bytes_used(), 0u);
+  arena.Allocate(8);
+  EXPECT_EQ(arena.chunk_count(), 1u);
+}
+
+TEST(ArenaTest, ReservedStorageNeedsNoFurtherChunks) {
+  Arena arena(16);
+  arena.Reserve(ArenaBytes<uint32_t>(100) + ArenaBytes<uint16_t>(7));
+  ArenaVector<uint32_t> words{ArenaAllocator<uint32_t>(&arena)};
+  ArenaVector<uint16_t> halves{ArenaAllocator<uint16_t>(&arena)};
+  halves.reserve(7);
+  words.reserve(100);
+  EXPECT_EQ(arena.chunk_count(), 1u);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(words.data()) % alignof(uint32_t),
+            0u);
+}
+
+TEST(ArenaTest, CopiesOfArenaVectorsUseTheHeap) {
+  Arena arena;
+  ArenaVector<int> stored{ArenaAllocator<int>(&arena)};
+  stored.assign({1, 2, 3});
+  ArenaVector<int> copy = stored;
+  EXPECT_EQ(copy.get_allocator().arena(), nullptr);
+  EXPECT_EQ(copy, stored);
+  // Moving keeps the storage, and so the arena.
+  ArenaVector<int> moved = std::move(stored);
+  EXPECT_EQ(moved.get_allocator().arena(), &arena);
+}
+
+}  // namespace
+}  // namespace playmidifile
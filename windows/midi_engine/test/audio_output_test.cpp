@@ -0,0 +1,294 @@
+#include "midi_engine/audio_output.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midi_engine/mapped_file.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::WriteTempFile;
+
+constexpr uint32_t kRate = 48000;
+// 5 ms periods keep the tests short.
+constexpr size_t kPeriod = 240;
+
+AudioOutputOptions TestOptions() {
+  AudioOutputOptions options;
+  options.sample_rate = kRate;
+  options.period_frames = kPeriod;
+  options.periods = 4;
+  return options;
+}
+
+// Renders frame n of its output as n / 2^15 on both channels, so a
+// recording shows exactly which frames arrived. Optionally takes |delay|
+// per period, to starve the device.
+class RampSource : public AudioSource {
+ public:
+  explicit RampSource(
+      std::chrono::microseconds delay = std::chrono::microseconds(0))
+      : delay_(delay), next_(0) {}
+
+  void Render(float* output, size_t frames) override {
+    for (size_t i = 0; i < frames; ++i) {
+      float value = static_cast<float>(next_++ % 16384 + 1) / 32768.0f;
+      output[i * 2] = value;
+      output[i * 2 + 1] = value;
+    }
+    if (delay_.count() > 0) {
+      std::this_thread::sleep_for(delay_);
+    }
+  }
+
+ private:
+  std::chrono::microseconds delay_;
+  uint64_t next_;
+};
+
+// The 16-bit left samples of a .wav file WavWriter wrote.
+std::vector<int16_t> ReadLeftSamples(const std::string& path) {
+  MappedFile wav;
+  std::string error;
+  EXPECT_TRUE(wav.Open(path, &error)) << error;
+  std::vector<int16_t> samples;
+  for (size_t offset = 44; offset + 4 <= wav.size(); offset += 4) {
+    samples.push_back(static_cast<int16_t>(wav.data()[offset] |
+                                           (wav.data()[offset + 1] << 8)));
+  }
+  return samples;
+}
+
+TEST(AudioOutputTest, WavSinkRecordsEveryRenderedFrameInOrder) {
+  std::string path = WriteTempFile("audio_output_test_ramp.wav", {});
+  RampSource source;
+  PlaybackStats stats;
+  std::string error;
+  {
+    AudioOutput output(std::make_unique<WavFileAudioSink>(path), &source,
+                       TestOptions());
+    output.SetStats(&stats);
+    ASSERT_TRUE(output.Start(&error)) << error;
+    EXPECT_TRUE(output.running());
+    EXPECT_EQ(output.format().period_frames, kPeriod);
+    EXPECT_EQ(output.latency_frames(), kPeriod * 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    output.Stop();
+    EXPECT_FALSE(output.running());
+    EXPECT_EQ(output.underruns(), 0u);
+    EXPECT_GT(output.frames_played(), 0u);
+  }
+
+  std::vector<int16_t> left = ReadLeftSamples(path);
+  ASSERT_GT(left.size(), kPeriod * 4);
+  EXPECT_EQ(left.size() % kPeriod, 0u);
+  for (size_t i = 0; i < left.size(); ++i) {
+    ASSERT_EQ(left[i], static_cast<int16_t>(i % 16384 + 1)) << i;
+  }
+  PlaybackStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot.underruns, 0u);
+  // Every period played was rendered, plus the ring still full at the end.
+  EXPECT_GE(snapshot.audio_callback_us.count, left.size() / kPeriod);
+  std::remove(path.c_str());
+}
+
+TEST(AudioOutputTest, CountsUnderrunsAndPlaysSilenceForThem) {
+  std::string path = WriteTempFile("audio_output_test_underrun.wav", {});
+  // Each 5 ms period takes 10 ms to render.
+  RampSource source(std::chrono::milliseconds(10));
+  PlaybackStats stats;
+  std::string error;
+  uint64_t underruns = 0;
+  {
+    AudioOutput output(std::make_unique<WavFileAudioSink>(path), &source,
+                       TestOptions());
+    output.SetStats(&stats);
+    ASSERT_TRUE(output.Start(&error)) << error;
+    std::this_thread::sleep_for(std::chrono::milliseconds(150));
+    output.Stop();
+    underruns = output.underruns();
+  }
+  EXPECT_GT(underruns, 0u);
+  PlaybackStatsSnapshot snapshot = stats.Snapshot();
+  EXPECT_EQ(snapshot.underruns, underruns);
+  EXPECT_GE(snapshot.audio_callback_us.p50, 10000u);
+
+  std::vector<int16_t> left = ReadLeftSamples(path);
+  size_t silent = 0;
+  for (int16_t sample : left) {
+    silent += sample == 0;
+  }
+  EXPECT_GT(silent, 0u);
+  std::remove(path.c_str());
+}
+
+TEST(AudioOutputTest, NullSinkPullsInRealTime) {
+  RampSource source;
+  auto sink = std::make_unique<NullAudioSink>();
+  NullAudioSink* null_sink = sink.get();
+  AudioOutput output(std::move(sink), &source, TestOptions());
+  std::string error;
+  ASSERT_TRUE(output.Start(&error)) << error;
+  auto start = std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  uint64_t periods = null_sink->periods();
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  output.Stop();
+  // About one period per 5 ms, the first one right away. Loose bounds: the
+  // point is that it is paced, not free-running.
+  EXPECT_GE(periods, 5u);
+  EXPECT_LE(periods, static_cast<uint64_t>(elapsed / 0.005) + 2);
+  EXPECT_EQ(output.frames_played(), periods * kPeriod);
+}
+
+TEST(AudioOutputTest, RejectsInvalidFormat) {
+  RampSource source;
+  AudioOutputOptions options = TestOptions();
+  options.period_frames = 0;
+  AudioOutput output(std::make_unique<NullAudioSink>(), &source, options);
+  std::string error;
+  EXPECT_FALSE(output.Start(&error));
+  EXPECT_FALSE(error.empty());
+  EXPECT_FALSE(output.running());
+}
+
+// Plays silence, and on request a ramp of (k + 1) / 2^15 as an overlay.
+class OverlaySource : public AudioSource {
+ public:
+  explicit OverlaySource(size_t frames)
+      : ramp_(frames * 2),
+        output_(nullptr),
+        start_(false),
+        cancel_(false),
+        id_(-1),
+        start_frame_(-1),
+        released_(false) {
+    for (size_t i = 0; i < frames; ++i) {
+      ramp_[i * 2] = static_cast<float>(i % 16384 + 1) / 32768.0f;
+      ramp_[i * 2 + 1] = ramp_[i * 2];
+    }
+  }
+
+  void set_output(AudioOutput* output) { output_ = output; }
+  void Start() { start_ = true; }
+  void Cancel() { cancel_ = true; }
+  int64_t start_frame() const { return start_frame_; }
+  bool released() const { return released_; }
+
+  void Render(float* output, size_t frames) override {
+    std::fill(output, output + frames * 2, 0.0f);
+  }
+
+  void Poll() override {
+    if (start_.exchange(false)) {
+      id_ = output_->StartOverlay(ramp_.data(), ramp_.size() / 2);
+    }
+    if (id_ < 0) {
+      return;
+    }
+    if (cancel_.exchange(false)) {
+      output_->CancelOverlay(id_);
+    }
+    if (start_frame_ < 0) {
+      start_frame_ = output_->OverlayStartFrame(id_);
+    }
+    if (output_->TryReleaseOverlay(id_)) {
+      id_ = -1;
+      released_ = true;
+    }
+  }
+
+ private:
+  std::vector<float> ramp_;
+  AudioOutput* output_;
+  std::atomic<bool> start_;
+  std::atomic<bool> cancel_;
+  int id_;
+  std::atomic<int64_t> start_frame_;
+  std::atomic<bool> released_;
+};
+
+// Waits up to a second for |source| to let go of its overlay.
+bool WaitForRelease(const OverlaySource& source) {
+  for (int i = 0; i < 1000 && !source.released(); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return source.released();
+}
+
+TEST(AudioOutputTest, OverlayPlaysFromTheNextPullOnTopOfTheRing) {
+  std::string path = WriteTempFile("audio_output_test_overlay.wav", {});
+  OverlaySource source(kPeriod * 3 + 17);
+  int64_t start = -1;
+  {
+    AudioOutput output(std::make_unique<WavFileAudioSink>(path), &source,
+                       TestOptions());
+    source.set_output(&output);
+    std::string error;
+    ASSERT_TRUE(output.Start(&error)) << error;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    uint64_t played = output.frames_played();
+    source.Start();
+    output.Wake();
+    ASSERT_TRUE(WaitForRelease(source));
+    start = source.start_frame();
+    // Not behind the 20 ms of silence already in the ring.
+    EXPECT_GE(static_cast<uint64_t>(start), played);
+    EXPECT_LE(static_cast<uint64_t>(start), played + kPeriod * 2);
+    output.Stop();
+    EXPECT_EQ(output.underruns(), 0u);
+  }
+  std::vector<int16_t> left = ReadLeftSamples(path);
+  ASSERT_GE(left.size(), static_cast<size_t>(start) + kPeriod * 3 + 18);
+  for (size_t i = 0; i < left.size(); ++i) {
+    int64_t k = static_cast<int64_t>(i) - start;
+    int16_t expected =
+        k >= 0 && k < static_cast<int64_t>(kPeriod * 3 + 17)
+            ? static_cast<int16_t>(k + 1)
+            : 0;
+    ASSERT_EQ(left[i], expected) << i;
+  }
+  std::remove(path.c_str());
+}
+
+TEST(AudioOutputTest, CancelledOverlayStops) {
+  std::string path = WriteTempFile("audio_output_test_cancel.wav", {});
+  // Ten seconds: only a cancel ends it within the test.
+  OverlaySource source(kRate * 10);
+  {
+    AudioOutput output(std::make_unique<WavFileAudioSink>(path), &source,
+                       TestOptions());
+    source.set_output(&output);
+    std::string error;
+    ASSERT_TRUE(output.Start(&error)) << error;
+    source.Start();
+    output.Wake();
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    source.Cancel();
+    output.Wake();
+    ASSERT_TRUE(WaitForRelease(source));
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    output.Stop();
+  }
+  std::vector<int16_t> left = ReadLeftSamples(path);
+  ASSERT_FALSE(left.empty());
+  EXPECT_NE(left[static_cast<size_t>(source.start_frame())], 0);
+  EXPECT_EQ(left.back(), 0);
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,111 @@
+#include "midi_engine/audio_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace playmidifile {
+namespace {
+
+// |frames| stereo frames whose left and right samples count up from
+// |first| * 2.
+std::vector<float> Frames(size_t first, size_t frames) {
+  std::vector<float> samples(frames * 2);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    samples[i] = static_cast<float>(first * 2 + i);
+  }
+  return samples;
+}
+
+TEST(AudioRingTest, KeepsExactCapacity) {
+  AudioRing ring(480 * 3, 2);
+  EXPECT_EQ(ring.capacity(), 1440u);
+  EXPECT_EQ(ring.writable(), 1440u);
+  EXPECT_EQ(ring.readable(), 0u);
+}
+
+TEST(AudioRingTest, ReadsWhatWasWrittenAcrossWrapAround) {
+  AudioRing ring(5, 2);
+  size_t next_write = 0;
+  size_t next_read = 0;
+  // Chunks that do not divide the capacity, so copies split at the end.
+  for (int round = 0; round < 20; ++round) {
+    std::vector<float> input = Frames(next_write, 3);
+    ASSERT_EQ(ring.Write(input.data(), 3), 3u);
+    next_write += 3;
+    std::vector<float> output(6);
+    ASSERT_EQ(ring.Read(output.data(), 3), 3u);
+    EXPECT_EQ(output, Frames(next_read, 3));
+    next_read += 3;
+  }
+}
+
+TEST(AudioRingTest, WritesAndReadsOnlyWhatFits) {
+  AudioRing ring(4, 2);
+  std::vector<float> input = Frames(0, 6);
+  EXPECT_EQ(ring.Write(input.data(), 6), 4u);
+  EXPECT_EQ(ring.writable(), 0u);
+  EXPECT_EQ(ring.Write(input.data(), 1), 0u);
+
+  std::vector<float> output(12, -1.0f);
+  EXPECT_EQ(ring.Read(output.data(), 6), 4u);
+  EXPECT_EQ(std::vector<float>(output.begin(), output.begin() + 8),
+            Frames(0, 4));
+  // Nothing past what was read is touched.
+  EXPECT_EQ(output[8], -1.0f);
+  EXPECT_EQ(ring.Read(output.data(), 1), 0u);
+}
+
+TEST(AudioRingTest, SkipDropsBufferedFrames) {
+  AudioRing ring(8, 2);
+  std::vector<float> input = Frames(0, 6);
+  ring.Write(input.data(), 6);
+  EXPECT_EQ(ring.Skip(4), 4u);
+  EXPECT_EQ(ring.readable(), 2u);
+  EXPECT_EQ(ring.Skip(10), 2u);
+  EXPECT_EQ(ring.writable(), 8u);
+}
+
+// Streams frames from a producer thread in odd-sized chunks and checks the
+// consumer sees every one, in order.
+TEST(AudioRingTest, TransfersBetweenThreadsInOrder) {
+  constexpr size_t kFrames = 1000000;
+  AudioRing ring(256, 2);
+  std::thread producer([&ring] {
+    size_t sent = 0;
+    while (sent < kFrames) {
+      size_t chunk = std::min<size_t>(37, kFrames - sent);
+      std::vector<float> input = Frames(sent, chunk);
+      size_t done = 0;
+      while (done < chunk) {
+        done += ring.Write(input.data() + done * 2, chunk - done);
+        if (done < chunk) {
+          std::this_thread::yield();
+        }
+      }
+      sent += chunk;
+    }
+  });
+  size_t received = 0;
+  bool in_order = true;
+  std::vector<float> output(53 * 2);
+  while (received < kFrames) {
+    size_t read = ring.Read(output.data(), 53);
+    for (size_t i = 0; i < read * 2; ++i) {
+      // Exact up to 2^24, which the counts stay below.
+      in_order &= output[i] == static_cast<float>(received * 2 + i);
+    }
+    received += read;
+    if (read == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  EXPECT_TRUE(in_order);
+  EXPECT_EQ(ring.readable(), 0u);
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,109 @@
+#include "midi_engine/midi_file.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <string>
+
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::SmfBuilder;
+using testing::WriteTempFile;
+
+TEST(MidiFileTest, ParsesExampleAsset) {
+  std::string error;
+  std::unique_ptr<MidiFile> file =
+      MidiFile::Open(MIDI_ENGINE_TEST_ASSETS_DIR "/demo.mid", &error);
+  ASSERT_TRUE(file) << error;
+  const MidiFileInfo& info = file->info();
+  EXPECT_EQ(info.format, 1);
+  EXPECT_EQ(info.track_count, 3);
+  EXPECT_EQ(info.ppq, 480);
+  EXPECT_EQ(info.end_tick, 153120u);
+  ASSERT_EQ(info.tempo_changes.size(), 1u);
+  EXPECT_EQ(info.tempo_changes[0].micros_per_quarter, 333333u);
+  EXPECT_NEAR(info.initial_bpm(), 180.0, 0.01);
+  EXPECT_EQ(info.duration_ms(), 106333u);
+}
+
+TEST(MidiFileTest, AppliesTempoChangesFromAnyTrack) {
+  // One quarter at 120 BPM, then one quarter at 60 BPM set from track 2.
+  std::vector<uint8_t> data = SmfBuilder(1, 100)
+                                  .BeginTrack()
+                                  .EndTrack()
+                                  .BeginTrack()
+                                  .NoteOn(0, 0, 60, 100)
+                                  .Tempo(100, 1000000)
+                                  .NoteOff(100, 0, 60)
+                                  .EndTrack()
+                                  .Build();
+  std::string path = WriteTempFile("midi_file_test_tempo.mid", data);
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  ASSERT_TRUE(file) << error;
+  EXPECT_EQ(file->info().end_tick, 200u);
+  EXPECT_EQ(file->info().duration_us, 1500000u);
+  EXPECT_EQ(file->TicksToMicros(50), 250000u);
+  EXPECT_EQ(file->TicksToMicros(150), 1000000u);
+  std::remove(path.c_str());
+}
+
+TEST(MidiFileTest, SupportsSmpteDivision) {
+  // 25 fps with 40 ticks per frame is one tick per millisecond.
+  uint16_t division = static_cast<uint16_t>((0x100 - 25) << 8 | 40);
+  std::vector<uint8_t> data = SmfBuilder(0, division)
+                                  .BeginTrack()
+                                  .Tempo(0, 1000000)
+                                  .NoteOn(0, 0, 60, 100)
+                                  .NoteOff(2000, 0, 60)
+                                  .EndTrack()
+                                  .Build();
+  std::string path = WriteTempFile("midi_file_test_smpte.mid", data);
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  ASSERT_TRUE(file) << error;
+  EXPECT_EQ(file->info().ppq, 0);
+  EXPECT_TRUE(file->info().tempo_changes.empty());
+  EXPECT_EQ(file->info().duration_ms(), 2000u);
+  std::remove(path.c_str());
+}
+
+TEST(MidiFileTest, ParsesFromMemory) {
+  std::vector<uint8_t> data = SmfBuilder(0, 480)
+                                  .BeginTrack()
+                                  .Tempo(0, 250000)
+                                  .NoteOn(0, 0, 60, 100)
+                                  .NoteOff(960, 0, 60)
+                                  .EndTrack()
+                                  .Build();
+  std::string error;
+  std::unique_ptr<MidiFile> file =
+      MidiFile::Parse(data.data(), data.size(), &error);
+  ASSERT_TRUE(file) << error;
+  EXPECT_EQ(file->info().end_tick, 960u);
+  EXPECT_EQ(file->info().duration_ms(), 500u);
+  // Tracks point into |data| rather than a copy.
+  EXPECT_GE(file->smf().tracks[0].data, data.data());
+  EXPECT_LT(file->smf().tracks[0].data, data.data() + data.size());
+
+  EXPECT_FALSE(MidiFile::Parse(data.data(), 10, &error));
+}
+
+TEST(MidiFileTest, ReportsMissingAndMalformedFiles) {
+  std::string error;
+  EXPECT_FALSE(MidiFile::Open("/nonexistent/file.mid", &error));
+  EXPECT_EQ(error, "File not found");
+
+  std::vector<uint8_t> data =
+      SmfBuilder(0).BeginTrack().Raw(0, {60, 100}).EndTrack().Build();
+  std::string path = WriteTempFile("midi_file_test_bad.mid", data);
+  EXPECT_FALSE(MidiFile::Open(path, &error));
+  EXPECT_EQ(error, "Malformed MIDI track data");
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,277 @@
+#include "midi_engine/offline_renderer.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "midi_engine/mapped_file.h"
+#include "sf2_builder.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::AllocationScope;
+using testing::Sf2Builder;
+using testing::SmfBuilder;
+using testing::WriteTempFile;
+namespace sf2 = testing::sf2;
+
+constexpr uint32_t kRate = 44100;
+// With 500 ticks per quarter at the default 120 BPM one tick is 1 ms.
+constexpr uint16_t kMillisecondTicks = 500;
+constexpr uint16_t kNoTime = 0x8000;
+
+// A font whose every preset plays a looped constant at the root key with an
+// instant attack and a ~1 ms release.
+std::shared_ptr<const SoundFont> ConstantFont() {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample;
+  sample.data.assign(64, 8192);
+  sample.loop_end = 64;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 0, id,
+                       {{sf2::kDelayVolEnv, kNoTime},
+                        {sf2::kAttackVolEnv, kNoTime},
+                        {sf2::kHoldVolEnv, kNoTime},
+                        {sf2::kDecayVolEnv, kNoTime},
+                        {sf2::kSampleModes, 1}});
+  std::vector<uint8_t> data = builder.Build();
+  std::string error;
+  std::shared_ptr<const SoundFont> font =
+      SoundFont::Parse(data.data(), data.size(), &error);
+  EXPECT_TRUE(font) << error;
+  return font;
+}
+
+std::shared_ptr<const Sequence> CompileBytes(const std::vector<uint8_t>& data,
+                                             const std::string& name) {
+  std::string path = WriteTempFile(name, data);
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  std::remove(path.c_str());
+  EXPECT_TRUE(file) << error;
+  return file ? Sequence::Compile(*file) : nullptr;
+}
+
+// Index of the first frame with a non-zero left sample, or -1.
+int64_t FirstSoundingFrame(const std::vector<float>& audio, size_t from = 0) {
+  for (size_t frame = from; frame < audio.size() / 2; ++frame) {
+    if (audio[frame * 2] != 0.0f) {
+      return static_cast<int64_t>(frame);
+    }
+  }
+  return -1;
+}
+
+TEST(OfflineRendererTest, StartsEventsOnTheirExactFrame) {
+  std::shared_ptr<const Sequence> sequence = CompileBytes(
+      SmfBuilder(0, kMillisecondTicks)
+          .BeginTrack()
+          .NoteOn(100, 0, 60, 127)
+          .NoteOff(100, 0, 60)
+          .NoteOn(50, 0, 60, 127)
+          .NoteOff(50, 0, 60)
+          .EndTrack()
+          .Build(),
+      "offline_renderer_test_frames.mid");
+  std::vector<float> audio;
+  std::string error;
+  ASSERT_TRUE(
+      RenderToBuffer(sequence, ConstantFont(), RenderOptions(), &audio,
+                     &error))
+      << error;
+  EXPECT_EQ(FirstSoundingFrame(audio), 4410);
+  // Silent between the first release and the second note at 250 ms.
+  EXPECT_EQ(audio[(11025 - 1) * 2], 0.0f);
+  EXPECT_EQ(FirstSoundingFrame(audio, 9000), 11025);
+  // Ends shortly after the last note off at 300 ms, once the release has
+  // died away.
+  EXPECT_GE(audio.size() / 2, 13230u);
+  EXPECT_LT(audio.size() / 2, 13230u + kRate / 100);
+}
+
+TEST(OfflineRendererTest, ParallelChannelGroupsMatchSingleThread) {
+  SmfBuilder builder(1, kMillisecondTicks);
+  for (uint8_t channel = 0; channel < 16; ++channel) {
+    builder.BeginTrack()
+        .ControlChange(0, channel, 10, static_cast<uint8_t>(channel * 8))
+        .NoteOn(channel * 7, channel, static_cast<uint8_t>(48 + channel), 100)
+        .NoteOff(300, channel, static_cast<uint8_t>(48 + channel))
+        .EndTrack();
+  }
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(builder.Build(), "offline_renderer_test_groups.mid");
+  std::shared_ptr<const SoundFont> font = ConstantFont();
+
+  RenderOptions options;
+  std::vector<float> single;
+  std::vector<float> parallel;
+  std::string error;
+  ASSERT_TRUE(RenderToBuffer(sequence, font, options, &single, &error));
+  options.threads = 4;
+  ASSERT_TRUE(RenderToBuffer(sequence, font, options, &parallel, &error));
+  ASSERT_EQ(parallel.size(), single.size());
+  for (size_t i = 0; i < single.size(); ++i) {
+    ASSERT_NEAR(parallel[i], single[i], 1e-5f) << i;
+  }
+}
+
+TEST(OfflineRendererTest, PlaylistHasNoGapBetweenPieces) {
+  // Ends 150 ms after its note, at 250 ms.
+  std::shared_ptr<const Sequence> first =
+      CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(0, 0, 60, 127)
+                       .NoteOff(100, 0, 60)
+                       .EndTrack(150)
+                       .Build(),
+                   "offline_renderer_test_first.mid");
+  std::shared_ptr<const Sequence> second =
+      CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(0, 1, 64, 127)
+                       .NoteOff(50, 1, 64)
+                       .EndTrack()
+                       .Build(),
+                   "offline_renderer_test_second.mid");
+  OfflineRenderer renderer({first, second}, ConstantFont(), RenderOptions());
+  EXPECT_EQ(renderer.start_frame(1), 11025u);
+  EXPECT_EQ(renderer.end_frame(), 11025u + 2205u);
+  std::vector<float> audio((renderer.end_frame() + kRate) * 2);
+  audio.resize(renderer.Render(audio.data(), audio.size() / 2) * 2);
+
+  // The second piece sounds on the very frame the first one ends.
+  int64_t gap = FirstSoundingFrame(audio, 6000) -
+                static_cast<int64_t>(renderer.start_frame(1));
+  RecordProperty("transition_gap_frames", std::to_string(gap));
+  EXPECT_EQ(gap, 0);
+  EXPECT_EQ(audio[(11025 - 1) * 2], 0.0f);
+}
+
+TEST(OfflineRendererTest, StopsAtTailLimit) {
+  // A looped note that is never released.
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(0, 0, 60, 127)
+                       .EndTrack(10)
+                       .Build(),
+                   "offline_renderer_test_tail.mid");
+  RenderOptions options;
+  options.max_tail_ms = 500;
+  OfflineRenderer renderer(sequence, ConstantFont(), options);
+  std::vector<float> block(4096 * 2);
+  uint64_t total = 0;
+  size_t rendered;
+  while ((rendered = renderer.Render(block.data(), 4096)) > 0) {
+    total += rendered;
+  }
+  EXPECT_TRUE(renderer.finished());
+  EXPECT_EQ(total, renderer.end_frame() + kRate / 2);
+}
+
+TEST(OfflineRendererTest, WritesWavFile) {
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(0, 0, 60, 127)
+                       .NoteOff(20, 0, 60)
+                       .EndTrack()
+                       .Build(),
+                   "offline_renderer_test_wav.mid");
+  std::string path = WriteTempFile("offline_renderer_test.wav", {});
+  RenderOptions options;
+  options.sample_rate = 22050;
+  uint64_t frames = 0;
+  std::string error;
+  ASSERT_TRUE(RenderToWavFile(sequence, ConstantFont(), options, path,
+                              &frames, &error))
+      << error;
+  EXPECT_GE(frames, 441u);
+
+  MappedFile wav;
+  ASSERT_TRUE(wav.Open(path, &error)) << error;
+  const uint8_t* data = wav.data();
+  ASSERT_EQ(wav.size(), 44 + frames * 4);
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(data), 4), "RIFF");
+  EXPECT_EQ(std::string(reinterpret_cast<const char*>(data + 8), 8),
+            "WAVEfmt ");
+  auto read32 = [data](size_t offset) {
+    return data[offset] | (data[offset + 1] << 8) |
+           (data[offset + 2] << 16) | (data[offset + 3] << 24);
+  };
+  EXPECT_EQ(read32(24), 22050);
+  EXPECT_EQ(data[22], 2);
+  EXPECT_EQ(static_cast<uint64_t>(read32(40)), frames * 4);
+  // 0.25 (the sample) * centre pan * (100/127)^2 channel volume.
+  int16_t first = static_cast<int16_t>(data[44] | (data[45] << 8));
+  float expected = 0.25f * 0.70710678f * (100.0f / 127) * (100.0f / 127);
+  EXPECT_NEAR(first / 32767.0f, expected, 1e-4f);
+  wav.Close();
+  std::remove(path.c_str());
+}
+
+TEST(OfflineRendererTest, HonoursCancellation) {
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(0, 0, 60, 127)
+                       .NoteOff(5000, 0, 60)
+                       .EndTrack()
+                       .Build(),
+                   "offline_renderer_test_cancel.mid");
+  std::atomic<bool> cancel(true);
+  RenderOptions options;
+  options.cancel = &cancel;
+  std::vector<float> audio;
+  std::string error;
+  EXPECT_FALSE(
+      RenderToBuffer(sequence, ConstantFont(), options, &audio, &error));
+  EXPECT_EQ(error, "Rendering cancelled");
+}
+
+TEST(OfflineRendererTest, RendersDenseFileWithoutAllocating) {
+  // All 16 channels hammer chords every 5 ms with controller and bend
+  // traffic in between, far more notes than the 32 voices can hold.
+  SmfBuilder builder(0, kMillisecondTicks);
+  builder.BeginTrack();
+  for (int step = 0; step < 400; ++step) {
+    for (uint8_t channel = 0; channel < 16; ++channel) {
+      uint8_t key = static_cast<uint8_t>(48 + (step * 7 + channel) % 36);
+      builder.NoteOn(0, channel, key, static_cast<uint8_t>(40 + step % 80))
+          .ControlChange(0, channel, 11, static_cast<uint8_t>(step % 128))
+          .PitchBend(0, channel, static_cast<uint16_t>(step * 40 % 16384));
+    }
+    builder.ControlChange(5, 0, 64, step % 2 == 0 ? 127 : 0);
+    for (uint8_t channel = 0; channel < 16; ++channel) {
+      builder.NoteOff(0, channel,
+                      static_cast<uint8_t>(48 + (step * 7 + channel) % 36));
+    }
+  }
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(builder.EndTrack().Build(), "dense.mid");
+  ASSERT_TRUE(sequence);
+  RenderOptions options;
+  options.polyphony = 32;
+  OfflineRenderer renderer(sequence, ConstantFont(), options);
+  std::vector<float> block(512 * 2);
+
+  AllocationScope scope;
+  while (renderer.Render(block.data(), 512) > 0) {
+  }
+  uint64_t allocations = scope.counts().allocations;
+
+  EXPECT_EQ(allocations, 0u);
+  EXPECT_TRUE(renderer.finished());
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,593 @@
+#include "midi_engine/playback_engine.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+constexpr char kDemoFile[] = MIDI_ENGINE_TEST_ASSETS_DIR "/demo.mid";
+
+// Records every call so tests can check what ran on the engine thread.
+class FakeBackend : public PlaybackBackend {
+ public:
+  struct Shared {
+    std::mutex mutex;
+    std::vector<std::string> calls;
+    std::thread::id thread_id;
+    std::atomic<bool> finish{false};
+  };
+
+  explicit FakeBackend(std::shared_ptr<Shared> shared)
+      : shared_(std::move(shared)) {}
+
+  bool Open(const std::string& path, std::shared_ptr<const Sequence> sequence,
+            std::string* error) override {
+    Record("open");
+    return true;
+  }
+  bool OpenStream(const std::string& path,
+                  std::unique_ptr<EventCursor> events,
+                  std::string* error) override {
+    Record("open_stream");
+    return true;
+  }
+  bool CanStream() const override { return true; }
+  void Close() override { Record("close"); }
+  bool Play(std::string* error) override {
+    Record("play");
+    return true;
+  }
+  bool Pause(std::string* error) override {
+    Record("pause");
+    return true;
+  }
+  bool Stop(std::string* error) override {
+    Record("stop");
+    return true;
+  }
+  bool Seek(uint32_t position_ms, std::string* error) override {
+    Record("seek:" + std::to_string(position_ms));
+    position_ms_ = position_ms;
+    return true;
+  }
+  void SetVolume(double volume) override { Record("volume"); }
+  bool SetSpeed(double speed) override { return false; }
+  uint32_t PositionMs() override { return position_ms_; }
+  Clock::time_point Service(Clock::time_point now, bool* finished) override {
+    *finished = shared_->finish.exchange(false);
+    return now + std::chrono::milliseconds(1);
+  }
+
+ private:
+  void Record(const std::string& call) {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    shared_->calls.push_back(call);
+    shared_->thread_id = std::this_thread::get_id();
+  }
+
+  std::shared_ptr<Shared> shared_;
+  uint32_t position_ms_ = 0;
+};
+
+class PlaybackEngineTest : public ::testing::Test {
+ protected:
+  PlaybackEngineTest()
+      : shared_(std::make_shared<FakeBackend::Shared>()),
+        engine_(std::make_unique<FakeBackend>(shared_)) {}
+
+  // Posts through |post| and blocks until the engine completes it.
+  template <typename PostFn>
+  CommandResult Run(PostFn post) {
+    std::promise<CommandResult> promise;
+    post([&promise](const CommandResult& result) {
+      promise.set_value(result);
+    });
+    return promise.get_future().get();
+  }
+
+  std::vector<std::string> Calls() {
+    std::lock_guard<std::mutex> lock(shared_->mutex);
+    return shared_->calls;
+  }
+
+  std::shared_ptr<FakeBackend::Shared> shared_;
+  PlaybackEngine engine_;
+};
+
+TEST_F(PlaybackEngineTest, LoadsOnEngineThread) {
+  CommandResult result = Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  EXPECT_EQ(result.info.duration_ms, 106333u);
+  EXPECT_EQ(result.info.state, PlaybackState::kStopped);
+  std::lock_guard<std::mutex> lock(shared_->mutex);
+  EXPECT_NE(shared_->thread_id, std::this_thread::get_id());
+}
+
+TEST_F(PlaybackEngineTest, LoadsBytes) {
+  std::FILE* demo = std::fopen(kDemoFile, "rb");
+  ASSERT_TRUE(demo);
+  std::vector<uint8_t> bytes(1 << 20);
+  bytes.resize(std::fread(bytes.data(), 1, bytes.size(), demo));
+  std::fclose(demo);
+
+  CommandResult result = Run([this, &bytes](CommandCallback done) {
+    engine_.LoadBytes(bytes, std::move(done));
+  });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  EXPECT_EQ(result.info.duration_ms, 106333u);
+
+  result = Run([this](CommandCallback done) {
+    engine_.LoadBytes({'M', 'T', 'h', 'd'}, std::move(done));
+  });
+  EXPECT_EQ(result.error_code, "LOAD_ERROR");
+}
+
+TEST_F(PlaybackEngineTest, StreamsLargeFiles) {
+  engine_.SetStreamingThreshold(1);
+  CommandResult result = Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  EXPECT_EQ(result.info.duration_ms, 106333u);
+
+  engine_.SetStreamingThreshold(0);
+  result = Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  std::vector<std::string> calls = Calls();
+  ASSERT_EQ(calls.size(), 2u);
+  EXPECT_EQ(calls[0], "open_stream");
+  EXPECT_EQ(calls[1], "open");
+}
+
+TEST_F(PlaybackEngineTest, CommandsWaitForPendingLoad) {
+  // Not waited for: the play must still see the file.
+  engine_.Load(kDemoFile, nullptr);
+  CommandResult result =
+      Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  EXPECT_EQ(result.info.state, PlaybackState::kPlaying);
+  EXPECT_EQ(result.info.duration_ms, 106333u);
+}
+
+TEST_F(PlaybackEngineTest, NewerLoadCancelsPendingOne) {
+  // Large enough that its parse is still running when the next load
+  // arrives.
+  testing::SmfBuilder builder(1, 480);
+  for (uint8_t channel = 0; channel < 16; ++channel) {
+    builder.BeginTrack();
+    for (int i = 0; i < 20000; ++i) {
+      builder.NoteOn(10, channel, 60, 100).NoteOff(10, channel, 60);
+    }
+    builder.EndTrack();
+  }
+  std::promise<CommandResult> first;
+  engine_.LoadBytes(builder.Build(), [&first](const CommandResult& result) {
+    first.set_value(result);
+  });
+  CommandResult second = Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  CommandResult cancelled = first.get_future().get();
+  EXPECT_EQ(cancelled.error_code, "LOAD_CANCELLED");
+  EXPECT_TRUE(second.ok()) << second.error_message;
+  EXPECT_EQ(second.info.duration_ms, 106333u);
+  // Only the newer file reached the backend.
+  std::vector<std::string> calls = Calls();
+  EXPECT_EQ(std::count(calls.begin(), calls.end(), "open"), 1);
+}
+
+TEST_F(PlaybackEngineTest, ReportsLoadErrors) {
+  CommandResult result = Run([this](CommandCallback done) {
+    engine_.Load("/nonexistent.mid", std::move(done));
+  });
+  EXPECT_EQ(result.error_code, "FILE_NOT_FOUND");
+  result = Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  EXPECT_EQ(result.error_code, "PLAY_ERROR");
+}
+
+TEST_F(PlaybackEngineTest, ExecutesTransportCommandsInOrder) {
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  engine_.Play(nullptr);
+  engine_.Seek(500000, nullptr);
+  engine_.Pause(nullptr);
+  CommandResult paused =
+      Run([this](CommandCallback done) { engine_.GetInfo(std::move(done)); });
+  EXPECT_EQ(paused.info.state, PlaybackState::kPaused);
+  // The seek target is clamped to the duration.
+  EXPECT_EQ(paused.info.position_ms, 106333u);
+  CommandResult stopped =
+      Run([this](CommandCallback done) { engine_.Stop(std::move(done)); });
+  EXPECT_EQ(stopped.info.state, PlaybackState::kStopped);
+  EXPECT_EQ(stopped.info.position_ms, 0u);
+
+  std::vector<std::string> expected = {"open",         "seek:0", "play",
+                                       "seek:106333",  "play",   "pause",
+                                       "stop",         "seek:0"};
+  EXPECT_EQ(Calls(), expected);
+}
+
+TEST_F(PlaybackEngineTest, DetectsEndOfPlayback) {
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  shared_->finish = true;
+  PlaybackState state = PlaybackState::kPlaying;
+  for (int i = 0; i < 200 && state == PlaybackState::kPlaying; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    state = Run([this](CommandCallback done) {
+              engine_.GetInfo(std::move(done));
+            }).info.state;
+  }
+  EXPECT_EQ(state, PlaybackState::kStopped);
+}
+
+TEST_F(PlaybackEngineTest, OpensQueuedFileWhenBackendCannotChain) {
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  std::string path = testing::WriteTempFile(
+      "playback_engine_test_queue.mid", testing::SmfBuilder(0, 500)
+                                            .BeginTrack()
+                                            .NoteOn(0, 0, 60, 100)
+                                            .NoteOff(250, 0, 60)
+                                            .EndTrack()
+                                            .Build());
+  Run([&](CommandCallback done) { engine_.Enqueue(path, std::move(done)); });
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  shared_->finish = true;
+  PlaybackInfo info;
+  for (int i = 0; i < 200 && info.duration_ms != 250; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    info = Run([this](CommandCallback done) {
+             engine_.GetInfo(std::move(done));
+           }).info;
+  }
+  std::remove(path.c_str());
+  EXPECT_EQ(info.duration_ms, 250u);
+  EXPECT_EQ(info.state, PlaybackState::kPlaying);
+  std::vector<std::string> calls = Calls();
+  EXPECT_EQ(std::count(calls.begin(), calls.end(), "open"), 2);
+}
+
+TEST_F(PlaybackEngineTest, NextLoadsQueuedFile) {
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  CommandResult result =
+      Run([this](CommandCallback done) { engine_.Next(std::move(done)); });
+  EXPECT_EQ(result.error_code, "QUEUE_EMPTY");
+
+  Run([this](CommandCallback done) {
+    engine_.SetQueue({kDemoFile}, std::move(done));
+  });
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  result = Run([this](CommandCallback done) { engine_.Next(std::move(done)); });
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  // Still playing, now the next file.
+  EXPECT_EQ(result.info.state, PlaybackState::kPlaying);
+  EXPECT_EQ(result.info.duration_ms, 106333u);
+  result = Run([this](CommandCallback done) { engine_.Next(std::move(done)); });
+  EXPECT_EQ(result.error_code, "QUEUE_EMPTY");
+}
+
+TEST_F(PlaybackEngineTest, RecordsTimingStats) {
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  Run([this](CommandCallback done) { engine_.Seek(1000, std::move(done)); });
+  // The fake backend wants servicing every millisecond.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  PlaybackStatsSnapshot stats = engine_.Stats();
+  EXPECT_EQ(stats.seek_latency_us.count, 1u);
+  EXPECT_GT(stats.service_duration_us.count, 0u);
+
+  engine_.ResetStats();
+  Run([this](CommandCallback done) { engine_.Pause(std::move(done)); });
+  stats = engine_.Stats();
+  EXPECT_EQ(stats.seek_latency_us.count, 0u);
+}
+
+TEST_F(PlaybackEngineTest, PushesProgress) {
+  std::mutex mutex;
+  std::vector<PlaybackInfo> updates;
+  auto count = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return updates.size();
+  };
+  auto last = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    return updates.back();
+  };
+  Run([&](CommandCallback done) {
+    engine_.SetProgressListener(
+        [&](int player, const PlaybackInfo& info) {
+          std::lock_guard<std::mutex> lock(mutex);
+          updates.push_back(info);
+        },
+        5, std::move(done));
+  });
+  // The first update follows the listener being set, so it is there
+  // before the next command runs.
+  Run([this](CommandCallback done) { engine_.GetInfo(std::move(done)); });
+  ASSERT_EQ(count(), 1u);
+  EXPECT_EQ(last().duration_ms, 0u);
+
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  Run([this](CommandCallback done) { engine_.GetInfo(std::move(done)); });
+  ASSERT_EQ(count(), 2u);
+  EXPECT_EQ(last().duration_ms, 106333u);
+
+  // Periodic updates while playing.
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  for (int i = 0; i < 200 && count() < 6; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_GE(count(), 6u);
+  EXPECT_EQ(last().state, PlaybackState::kPlaying);
+
+  // The end of the file is pushed without polling.
+  shared_->finish = true;
+  for (int i = 0; i < 200 && last().state != PlaybackState::kStopped; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  EXPECT_EQ(last().state, PlaybackState::kStopped);
+
+  // Stopped: no periodic updates.
+  Run([this](CommandCallback done) {
+    engine_.SetProgressListener(nullptr, 5, std::move(done));
+  });
+  size_t final_count = count();
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  EXPECT_EQ(count(), final_count);
+}
+
+TEST_F(PlaybackEngineTest, SnapshotExtrapolatesWhilePlaying) {
+  EXPECT_EQ(engine_.Snapshot().duration_ms, 0u);
+  Run([this](CommandCallback done) {
+    engine_.Load(kDemoFile, std::move(done));
+  });
+  PlaybackInfo loaded = engine_.Snapshot();
+  EXPECT_EQ(loaded.duration_ms, 106333u);
+  EXPECT_EQ(loaded.state, PlaybackState::kStopped);
+
+  Run([this](CommandCallback done) { engine_.Play(std::move(done)); });
+  auto now = PlaybackEngine::Clock::now();
+  PlaybackInfo first = engine_.Snapshot(now);
+  EXPECT_EQ(first.state, PlaybackState::kPlaying);
+  PlaybackInfo later =
+      engine_.Snapshot(now + std::chrono::milliseconds(250));
+  EXPECT_GE(later.position_ms, first.position_ms + 249);
+  EXPECT_LE(later.position_ms, first.position_ms + 250);
+  EXPECT_EQ(engine_.Snapshot(now + std::chrono::hours(1)).position_ms,
+            106333u);
+
+  // Frozen while paused.
+  Run([this](CommandCallback done) { engine_.Pause(std::move(done)); });
+  now = PlaybackEngine::Clock::now();
+  EXPECT_EQ(engine_.Snapshot(now + std::chrono::seconds(1)).position_ms,
+            engine_.Snapshot(now).position_ms);
+}
+
+TEST_F(PlaybackEngineTest, PlayersAreIndependent) {
+  PlaybackEngine engine(
+      [this] { return std::make_unique<FakeBackend>(shared_); });
+  CommandResult created;
+  int player = engine.CreatePlayer([&created](const CommandResult& result) {
+    created = result;
+  });
+  ASSERT_GT(player, PlaybackEngine::kDefaultPlayer);
+  Run([&](CommandCallback done) {
+    engine.Load(kDemoFile, std::move(done), player);
+  });
+  Run([&](CommandCallback done) { engine.Play(std::move(done), player); });
+  EXPECT_TRUE(created.ok());
+  EXPECT_EQ(created.player, player);
+
+  EXPECT_EQ(engine.Snapshot(player).state, PlaybackState::kPlaying);
+  EXPECT_EQ(engine.Snapshot(player).duration_ms, 106333u);
+  EXPECT_EQ(engine.Snapshot().state, PlaybackState::kStopped);
+  EXPECT_EQ(engine.Snapshot().duration_ms, 0u);
+  CommandResult result = Run(
+      [&](CommandCallback done) { engine.Play(std::move(done)); });
+  EXPECT_EQ(result.error_code, "PLAY_ERROR");
+
+  result = Run([&](CommandCallback done) {
+    engine.DisposePlayer(PlaybackEngine::kDefaultPlayer, std::move(done));
+  });
+  EXPECT_EQ(result.error_code, "INVALID_ARGUMENT");
+  Run([&](CommandCallback done) {
+    engine.DisposePlayer(player, std::move(done));
+  });
+  EXPECT_EQ(engine.Snapshot(player).state, PlaybackState::kStopped);
+  result = Run(
+      [&](CommandCallback done) { engine.GetInfo(std::move(done), player); });
+  EXPECT_EQ(result.error_code, "INVALID_ARGUMENT");
+  // The handle is free again.
+  EXPECT_EQ(engine.CreatePlayer(nullptr), player);
+}
+
+TEST_F(PlaybackEngineTest, SingleBackendEngineHasOnePlayer) {
+  CommandResult result;
+  EXPECT_EQ(engine_.CreatePlayer(
+                [&result](const CommandResult& r) { result = r; }),
+            -1);
+  EXPECT_EQ(result.error_code, "PLAYER_ERROR");
+}
+
+TEST_F(PlaybackEngineTest, RejectsCommandsWhenQueueIsFull) {
+  // A tiny ring and a backlog larger than it: overflowing posts must fail
+  // fast on the caller's thread rather than block.
+  PlaybackEngine engine(std::make_unique<FakeBackend>(shared_), nullptr, 2);
+  std::atomic<int> busy{0};
+  std::atomic<int> completed{0};
+  for (int i = 0; i < 10000; ++i) {
+    engine.GetInfo([&](const CommandResult& result) {
+      if (result.error_code == "BUSY") {
+        ++busy;
+      }
+      ++completed;
+    });
+  }
+  while (completed.load() < 10000) {
+    std::this_thread::yield();
+  }
+  EXPECT_EQ(completed.load(), 10000);
+}
+
+TEST_F(PlaybackEngineTest, BusyCreateAndDisposeKeepHandles) {
+  PlaybackEngine engine(
+      [this] { return std::make_unique<FakeBackend>(shared_); }, nullptr, 2);
+  int player = engine.CreatePlayer(nullptr);
+  ASSERT_GT(player, PlaybackEngine::kDefaultPlayer);
+  Run([&](CommandCallback done) { engine.GetInfo(std::move(done), player); });
+
+  // Hold the engine thread in a reply, then fill the ring behind it.
+  std::promise<void> entered;
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  engine.GetInfo([&entered, released](const CommandResult&) {
+    entered.set_value();
+    released.wait();
+  });
+  entered.get_future().wait();
+  std::atomic<int> busy{0};
+  auto count_busy = [&busy](const CommandResult& result) {
+    if (result.error_code == "BUSY") {
+      ++busy;
+    }
+  };
+  while (busy.load() == 0) {
+    engine.GetInfo(count_busy);
+  }
+
+  busy = 0;
+  EXPECT_EQ(engine.CreatePlayer(count_busy), -1);
+  engine.DisposePlayer(player, count_busy);
+  EXPECT_EQ(busy.load(), 2);
+  release.set_value();
+
+  // The rejected dispose left |player| alive and its handle taken. Retried
+  // until the engine has drained the ring.
+  CommandResult result;
+  do {
+    result = Run([&](CommandCallback done) {
+      engine.GetInfo(std::move(done), player);
+    });
+  } while (result.error_code == "BUSY");
+  EXPECT_TRUE(result.ok()) << result.error_message;
+  // The rejected create took no handle: every other one can still be made.
+  int created = 0;
+  while (engine.CreatePlayer(nullptr) >= 0) {
+    ++created;
+    // Let the engine keep up with the tiny ring.
+    Run([&](CommandCallback done) { engine.GetInfo(std::move(done)); });
+  }
+  EXPECT_EQ(created, PlaybackEngine::kMaxPlayers - 2);
+}
+
+TEST_F(PlaybackEngineTest, DisposeFailsPendingLoadAndWaitingNext) {
+  PlaybackEngine engine(
+      [this] { return std::make_unique<FakeBackend>(shared_); });
+  int player = engine.CreatePlayer(nullptr);
+  ASSERT_GT(player, PlaybackEngine::kDefaultPlayer);
+  Run([&](CommandCallback done) {
+    engine.Enqueue(kDemoFile, std::move(done), player);
+  });
+
+  // Hold the engine thread in a reply so the load, the next waiting for it
+  // and the dispose all run before the load can finish.
+  std::promise<void> entered;
+  std::promise<void> release;
+  std::shared_future<void> released = release.get_future().share();
+  engine.GetInfo([&entered, released](const CommandResult&) {
+    entered.set_value();
+    released.wait();
+  });
+  entered.get_future().wait();
+  std::promise<CommandResult> loaded;
+  std::promise<CommandResult> next;
+  engine.Load(
+      kDemoFile,
+      [&loaded](const CommandResult& result) { loaded.set_value(result); },
+      player);
+  engine.Next(
+      [&next](const CommandResult& result) { next.set_value(result); },
+      player);
+  std::promise<CommandResult> disposed;
+  engine.DisposePlayer(player, [&disposed](const CommandResult& result) {
+    disposed.set_value(result);
+  });
+  release.set_value();
+
+  CommandResult load_result = loaded.get_future().get();
+  CommandResult next_result = next.get_future().get();
+  EXPECT_EQ(load_result.error_code, "INVALID_ARGUMENT");
+  EXPECT_EQ(next_result.error_code, "INVALID_ARGUMENT");
+  EXPECT_EQ(next_result.error_message, "Player disposed");
+  EXPECT_TRUE(disposed.get_future().get().ok());
+  // Neither file reached the dead player's backend.
+  std::vector<std::string> calls = Calls();
+  EXPECT_EQ(std::count(calls.begin(), calls.end(), "open"), 0);
+}
+
+// Measures command round-trip latency and throughput through the ring.
+TEST_F(PlaybackEngineTest, RoundTripLatency) {
+  constexpr int kRoundTrips = 2000;
+  std::vector<double> latencies_us;
+  latencies_us.reserve(kRoundTrips);
+  for (int i = 0; i < kRoundTrips; ++i) {
+    auto start = std::chrono::steady_clock::now();
+    Run([this](CommandCallback done) { engine_.GetInfo(std::move(done)); });
+    latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                               std::chrono::steady_clock::now() - start)
+                               .count());
+  }
+  std::sort(latencies_us.begin(), latencies_us.end());
+  double p50 = latencies_us[kRoundTrips / 2];
+  double p99 = latencies_us[kRoundTrips * 99 / 100];
+  RecordProperty("round_trip_p50_us", std::to_string(p50));
+  RecordProperty("round_trip_p99_us", std::to_string(p99));
+  // Generous bound: this only guards against the engine thread stalling.
+  EXPECT_LT(p50, 20000.0);
+
+  constexpr int kBurst = 100000;
+  std::atomic<int> completed{0};
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kBurst; ++i) {
+    engine_.GetInfo([&completed](const CommandResult&) { ++completed; });
+  }
+  while (completed.load() < kBurst) {
+    std::this_thread::yield();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  RecordProperty("commands_per_second",
+                 std::to_string(static_cast<int64_t>(kBurst / seconds)));
+}
+
+}  // namespace
+}  // namespace playmidifile
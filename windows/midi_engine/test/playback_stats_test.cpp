@@ -0,0 +1,68 @@
+#include "midi_engine/playback_stats.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace playmidifile {
+namespace {
+
+TEST(PlaybackStatsTest, SummarizesSamples) {
+  StatsHistogram histogram;
+  EXPECT_EQ(histogram.Summary().count, 0u);
+  // 1..100: the buckets are powers of two, so percentiles round up to the
+  // end of their bucket but never past the maximum.
+  for (uint64_t i = 1; i <= 100; ++i) {
+    histogram.Record(i);
+  }
+  HistogramSummary summary = histogram.Summary();
+  EXPECT_EQ(summary.count, 100u);
+  EXPECT_DOUBLE_EQ(summary.mean, 50.5);
+  EXPECT_EQ(summary.max, 100u);
+  EXPECT_EQ(summary.p50, 63u);
+  EXPECT_EQ(summary.p90, 100u);
+  EXPECT_EQ(summary.p99, 100u);
+
+  histogram.Record(0);
+  histogram.Record(uint64_t{1} << 62);
+  EXPECT_EQ(histogram.Summary().max, uint64_t{1} << 62);
+}
+
+TEST(PlaybackStatsTest, ResetClearsEverything) {
+  PlaybackStats stats;
+  stats.dispatch_lateness.Record(5);
+  stats.seek_latency.Record(100);
+  stats.underruns.fetch_add(2);
+  PlaybackStatsSnapshot before = stats.Snapshot();
+  EXPECT_EQ(before.dispatch_lateness_us.count, 1u);
+  EXPECT_EQ(before.seek_latency_us.max, 100u);
+  EXPECT_EQ(before.underruns, 2u);
+  stats.Reset();
+  PlaybackStatsSnapshot after = stats.Snapshot();
+  EXPECT_EQ(after.dispatch_lateness_us.count, 0u);
+  EXPECT_EQ(after.seek_latency_us.max, 0u);
+  EXPECT_EQ(after.underruns, 0u);
+}
+
+TEST(PlaybackStatsTest, ConcurrentRecordersLoseNothing) {
+  StatsHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&histogram] {
+      for (uint64_t i = 0; i < 10000; ++i) {
+        histogram.Record(i % 1000);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  HistogramSummary summary = histogram.Summary();
+  EXPECT_EQ(summary.count, 40000u);
+  EXPECT_EQ(summary.max, 999u);
+}
+
+}  // namespace
+}  // namespace playmidifile
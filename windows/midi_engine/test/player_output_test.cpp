@@ -0,0 +1,64 @@
+#include "midi_engine/player_output.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "midi_engine/channel_state.h"
+#include "recording_output.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::RecordingOutput;
+
+TEST(PlayerOutputTest, SilencingReleasesOnlyOwnNotes) {
+  RecordingOutput device;
+  PlayerOutput first(&device);
+  PlayerOutput second(&device);
+  first.SendChannelMessage(0x90, 60, 100);
+  first.SendChannelMessage(0x90, 100, 100);
+  second.SendChannelMessage(0x90, 64, 100);
+  first.SendChannelMessage(0x80, 60, 0);
+  device.Clear();
+
+  SilenceAllChannels(&first);
+  std::vector<RecordingOutput::Message> messages = device.messages();
+  // A note-off for the one note still sounding, plus the pedal release on
+  // the only channel the player used; nothing reaches |second|'s note.
+  ASSERT_EQ(messages.size(), 2u);
+  EXPECT_EQ(messages[0].status, 0xB0);
+  EXPECT_EQ(messages[0].data1, 64);
+  EXPECT_EQ(messages[1].status, 0x80);
+  EXPECT_EQ(messages[1].data1, 100);
+
+  // Already silent: only the pedal release again.
+  device.Clear();
+  SilenceAllChannels(&first);
+  EXPECT_EQ(device.messages().size(), 1u);
+}
+
+TEST(PlayerOutputTest, ScalesChannelVolume) {
+  RecordingOutput device;
+  PlayerOutput output(&device);
+  output.SendChannelMessage(0xB2, 7, 120);
+  output.SendChannelMessage(0x95, 60, 100);
+  output.SetVolume(0.5);
+  output.SendChannelMessage(0xB2, 7, 80);
+
+  std::vector<RecordingOutput::Message> messages = device.messages();
+  ASSERT_EQ(messages.size(), 5u);
+  EXPECT_EQ(messages[0].data2, 120);
+  // SetVolume() re-sends CC7 on both channels in use, the one that never
+  // set it at the General MIDI default of 100.
+  EXPECT_EQ(messages[2].status, 0xB2);
+  EXPECT_EQ(messages[2].data2, 60);
+  EXPECT_EQ(messages[3].status, 0xB5);
+  EXPECT_EQ(messages[3].data2, 50);
+  EXPECT_EQ(messages[4].data2, 40);
+  // The device volume is left alone.
+  EXPECT_EQ(device.volume(), 1.0);
+}
+
+}  // namespace
+}  // namespace playmidifile
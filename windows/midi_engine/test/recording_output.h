@@ -0,0 +1,74 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_TEST_RECORDING_OUTPUT_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_TEST_RECORDING_OUTPUT_H_
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "midi_engine/midi_output.h"
+
+namespace playmidifile {
+namespace testing {
+
+// MidiOutput that records every message with the time it was sent.
+class RecordingOutput : public MidiOutput {
+ public:
+  struct Message {
+    std::chrono::steady_clock::time_point time;
+    uint8_t status;
+    uint8_t data1;
+    uint8_t data2;
+    std::vector<uint8_t> sysex;
+  };
+
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    messages_.push_back(
+        Message{std::chrono::steady_clock::now(), status, data1, data2, {}});
+  }
+
+  void SendSysEx(const uint8_t* data, size_t size) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    messages_.push_back(Message{std::chrono::steady_clock::now(), 0xF0, 0, 0,
+                                std::vector<uint8_t>(data, data + size)});
+  }
+
+  void SetVolume(double volume) override { volume_ = volume; }
+
+  std::vector<Message> messages() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return messages_;
+  }
+
+  // Note on/off and aftertouch only, which filters out chase and silence
+  // traffic.
+  std::vector<Message> notes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Message> notes;
+    for (const Message& message : messages_) {
+      if (message.status >= 0x80 && message.status < 0xB0) {
+        notes.push_back(message);
+      }
+    }
+    return notes;
+  }
+
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    messages_.clear();
+  }
+
+  double volume() const { return volume_; }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Message> messages_;
+  double volume_ = 1.0;
+};
+
+}  // namespace testing
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_TEST_RECORDING_OUTPUT_H_
@@ -0,0 +1,69 @@
+#include "midi_engine/seqlock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace playmidifile {
+namespace {
+
+// Every field holds the same value, so a torn read shows as a mismatch.
+struct Quad {
+  uint64_t a;
+  uint64_t b;
+  uint32_t c;
+  uint8_t d;
+};
+
+TEST(SeqlockTest, LoadsWhatWasStored) {
+  Seqlock<Quad> seqlock(Quad{1, 1, 1, 1});
+  EXPECT_EQ(seqlock.Load().b, 1u);
+  seqlock.Store(Quad{7, 8, 9, 10});
+  Quad value = seqlock.Load();
+  EXPECT_EQ(value.a, 7u);
+  EXPECT_EQ(value.b, 8u);
+  EXPECT_EQ(value.c, 9u);
+  EXPECT_EQ(value.d, 10u);
+}
+
+TEST(SeqlockTest, ReadersNeverSeeTornValues) {
+  constexpr uint64_t kWrites = 200000;
+  Seqlock<Quad> seqlock(Quad{0, 0, 0, 0});
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::atomic<int> backwards(0);
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; ++i) {
+    readers.emplace_back([&] {
+      uint64_t last = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        Quad value = seqlock.Load();
+        if (value.b != value.a || value.c != static_cast<uint32_t>(value.a) ||
+            value.d != static_cast<uint8_t>(value.a)) {
+          ++torn;
+        }
+        if (value.a < last) {
+          ++backwards;
+        }
+        last = value.a;
+      }
+    });
+  }
+  for (uint64_t i = 1; i <= kWrites; ++i) {
+    seqlock.Store(Quad{i, i, static_cast<uint32_t>(i),
+                       static_cast<uint8_t>(i)});
+  }
+  done.store(true, std::memory_order_release);
+  for (std::thread& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(torn.load(), 0);
+  EXPECT_EQ(backwards.load(), 0);
+  EXPECT_EQ(seqlock.Load().a, kWrites);
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,167 @@
+#include "midi_engine/sequence_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::SmfBuilder;
+using testing::WriteTempFile;
+
+// A single-track file with |notes| quarter notes.
+std::vector<uint8_t> Notes(int notes) {
+  SmfBuilder builder(0, 480);
+  builder.BeginTrack();
+  for (int i = 0; i < notes; ++i) {
+    builder.NoteOn(0, 0, 60, 100).NoteOff(480, 0, 60);
+  }
+  return builder.EndTrack().Build();
+}
+
+// |path| with "./" inserted before the file name.
+std::string OtherSpelling(const std::string& path) {
+  size_t separator = path.find_last_of("/\\");
+  return path.substr(0, separator + 1) + "." + path[separator] +
+         path.substr(separator + 1);
+}
+
+class SequenceCacheTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    for (const std::string& path : paths_) {
+      std::remove(path.c_str());
+    }
+  }
+
+  std::string Write(const std::string& name, int notes) {
+    paths_.push_back(WriteTempFile(name, Notes(notes)));
+    return paths_.back();
+  }
+
+  // Bytes one cached copy of a file written by Write(|notes|) takes.
+  size_t BytesFor(int notes) {
+    SequenceCache cache;
+    std::string error;
+    return cache.Load(Write("sequence_cache_test_size.mid", notes), &error)
+        ->memory_bytes();
+  }
+
+  std::vector<std::string> paths_;
+};
+
+TEST_F(SequenceCacheTest, ReturnsCachedSequenceOnRepeatLoad) {
+  std::string path = Write("sequence_cache_test_repeat.mid", 8);
+  SequenceCache cache;
+  std::string error;
+  std::shared_ptr<const Sequence> first = cache.Load(path, &error);
+  ASSERT_TRUE(first) << error;
+  std::shared_ptr<const Sequence> second = cache.Load(path, &error);
+  std::shared_ptr<const Sequence> third =
+      cache.Load(OtherSpelling(path), &error);
+  EXPECT_EQ(second, first);
+  EXPECT_EQ(third, first);
+
+  SequenceCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.hits, 2u);
+  EXPECT_EQ(stats.misses, 1u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.bytes, first->memory_bytes());
+}
+
+TEST_F(SequenceCacheTest, ReloadsChangedFile) {
+  std::string path = Write("sequence_cache_test_changed.mid", 8);
+  SequenceCache cache;
+  std::string error;
+  std::shared_ptr<const Sequence> before = cache.Load(path, &error);
+  ASSERT_TRUE(before) << error;
+  WriteTempFile("sequence_cache_test_changed.mid", Notes(9));
+  std::shared_ptr<const Sequence> after = cache.Load(path, &error);
+  ASSERT_TRUE(after) << error;
+  EXPECT_NE(after, before);
+  EXPECT_EQ(after->event_count(), 18u);
+
+  SequenceCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.evictions, 0u);
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.bytes, after->memory_bytes());
+}
+
+TEST_F(SequenceCacheTest, EvictsLeastRecentlyUsedOverBudget) {
+  size_t bytes = BytesFor(8);
+  std::string a = Write("sequence_cache_test_a.mid", 8);
+  std::string b = Write("sequence_cache_test_b.mid", 8);
+  std::string c = Write("sequence_cache_test_c.mid", 8);
+  SequenceCache cache(bytes * 2);
+  std::string error;
+  std::shared_ptr<const Sequence> first_a = cache.Load(a, &error);
+  cache.Load(b, &error);
+  // Touch |a| so that |b| is the least recently used.
+  cache.Load(a, &error);
+  cache.Load(c, &error);
+  EXPECT_EQ(cache.stats().evictions, 1u);
+  EXPECT_EQ(cache.stats().entries, 2u);
+
+  EXPECT_EQ(cache.Load(a, &error), first_a);
+  uint64_t misses = cache.stats().misses;
+  cache.Load(b, &error);
+  EXPECT_EQ(cache.stats().misses, misses + 1);
+}
+
+TEST_F(SequenceCacheTest, SetBudgetEvictsAndZeroDisablesCaching) {
+  std::string a = Write("sequence_cache_test_budget_a.mid", 8);
+  std::string b = Write("sequence_cache_test_budget_b.mid", 8);
+  SequenceCache cache;
+  std::string error;
+  cache.Load(a, &error);
+  cache.Load(b, &error);
+  cache.SetBudget(0);
+  SequenceCacheStats stats = cache.stats();
+  EXPECT_EQ(stats.entries, 0u);
+  EXPECT_EQ(stats.bytes, 0u);
+  EXPECT_EQ(stats.evictions, 2u);
+  EXPECT_EQ(stats.budget_bytes, 0u);
+
+  EXPECT_TRUE(cache.Load(a, &error));
+  EXPECT_TRUE(cache.Load(a, &error));
+  EXPECT_EQ(cache.stats().hits, 0u);
+  EXPECT_EQ(cache.stats().entries, 0u);
+}
+
+TEST_F(SequenceCacheTest, KeysBytesByContent) {
+  SequenceCache cache;
+  std::string error;
+  std::vector<uint8_t> data = Notes(8);
+  std::shared_ptr<const Sequence> first =
+      cache.LoadBytes(data.data(), data.size(), &error);
+  ASSERT_TRUE(first) << error;
+  std::vector<uint8_t> copy = data;
+  EXPECT_EQ(cache.LoadBytes(copy.data(), copy.size(), &error), first);
+
+  std::vector<uint8_t> other = Notes(9);
+  std::shared_ptr<const Sequence> second =
+      cache.LoadBytes(other.data(), other.size(), &error);
+  ASSERT_TRUE(second) << error;
+  EXPECT_NE(second, first);
+  EXPECT_EQ(cache.stats().hits, 1u);
+  EXPECT_EQ(cache.stats().entries, 2u);
+}
+
+TEST_F(SequenceCacheTest, ReportsMissingFile) {
+  SequenceCache cache;
+  std::string error;
+  EXPECT_FALSE(cache.Load("/nonexistent.mid", &error));
+  EXPECT_EQ(error, "File not found");
+  EXPECT_EQ(cache.stats().entries, 0u);
+}
+
+}  // namespace
+}  // namespace playmidifile
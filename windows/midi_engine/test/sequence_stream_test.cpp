@@ -0,0 +1,284 @@
+#include "midi_engine/sequence_stream.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/midi_file.h"
+#include "recording_output.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::RecordingOutput;
+using testing::SmfBuilder;
+using testing::WriteTempFile;
+
+constexpr char kDemoFile[] = MIDI_ENGINE_TEST_ASSETS_DIR "/demo.mid";
+
+std::shared_ptr<const Sequence> Compile(const std::string& path) {
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  EXPECT_TRUE(file) << error;
+  return file ? Sequence::Compile(*file) : nullptr;
+}
+
+// Streams |path| through a deliberately tiny window and track buffers and
+// checks every event against the compiled sequence.
+void ExpectSameAsCompiled(const std::string& path, size_t window_events,
+                          size_t track_buffer_bytes) {
+  std::shared_ptr<const Sequence> sequence = Compile(path);
+  ASSERT_TRUE(sequence);
+  std::string error;
+  std::unique_ptr<SequenceStream> stream =
+      SequenceStream::Open(path, &error, window_events, track_buffer_bytes);
+  ASSERT_TRUE(stream) << error;
+  EXPECT_EQ(stream->end_tick(), sequence->end_tick());
+  EXPECT_EQ(stream->duration_us(), sequence->duration_us());
+
+  size_t index = 0;
+  uint64_t micros = 0;
+  while (const SequenceEvent* event = stream->Peek(&micros)) {
+    ASSERT_LT(index, sequence->event_count());
+    const SequenceEvent expected = sequence->event(index);
+    ASSERT_EQ(event->tick, expected.tick) << "event " << index;
+    ASSERT_EQ(event->status, expected.status) << "event " << index;
+    ASSERT_EQ(event->data1, expected.data1) << "event " << index;
+    ASSERT_EQ(event->data2, expected.data2) << "event " << index;
+    ASSERT_EQ(event->payload_size, expected.payload_size);
+    EXPECT_TRUE(std::equal(stream->Payload(*event),
+                           stream->Payload(*event) + event->payload_size,
+                           sequence->payload(expected)));
+    EXPECT_EQ(micros, sequence->tempo_map().TicksToMicros(expected.tick));
+    stream->Advance();
+    ++index;
+  }
+  EXPECT_EQ(index, sequence->event_count());
+}
+
+TEST(SequenceStreamTest, MatchesCompiledSequence) {
+  ExpectSameAsCompiled(kDemoFile, 7, 16);
+  ExpectSameAsCompiled(kDemoFile, SequenceStream::kDefaultWindowEvents,
+                       SequenceStream::kDefaultTrackBufferBytes);
+}
+
+TEST(SequenceStreamTest, HandlesEventsLargerThanTheBuffer) {
+  std::vector<uint8_t> dump(300, 0x11);
+  dump.push_back(0xF7);
+  std::string path = WriteTempFile(
+      "sequence_stream_test_sysex.mid",
+      SmfBuilder()
+          .BeginTrack()
+          .Tempo(0, 400000)
+          .NoteOn(0, 0, 60, 100)
+          // Running status across buffer refills.
+          .Raw(10, {62, 100})
+          .SysEx(5, dump)
+          .Tempo(20, 600000)
+          .NoteOff(0, 0, 60)
+          .EndTrack()
+          .BeginTrack()
+          .NoteOn(10, 1, 40, 90)
+          .SysEx(0, {0x41, 0xF7})
+          .NoteOff(40, 1, 40)
+          .EndTrack()
+          .Build());
+  ExpectSameAsCompiled(path, 2, 16);
+  std::remove(path.c_str());
+}
+
+TEST(SequenceStreamTest, SeekChasesState) {
+  std::string path = WriteTempFile(
+      "sequence_stream_test_seek.mid",
+      SmfBuilder(1, 500)
+          .BeginTrack()
+          .ProgramChange(0, 0, 5)
+          .ControlChange(100, 0, 7, 90)
+          .NoteOn(0, 0, 60, 100)
+          .ControlChange(400, 0, 7, 30)
+          .NoteOn(0, 0, 62, 100)
+          .EndTrack()
+          .BeginTrack()
+          .PitchBend(200, 3, 0x3000)
+          .EndTrack()
+          .Build());
+  std::shared_ptr<const Sequence> sequence = Compile(path);
+  ASSERT_TRUE(sequence);
+  std::string error;
+  std::unique_ptr<SequenceStream> stream =
+      SequenceStream::Open(path, &error, 2, 16);
+  std::remove(path.c_str());
+  ASSERT_TRUE(stream) << error;
+
+  // 300 ms is tick 300: after the bend, before the second volume change.
+  ChannelStateSet state;
+  stream->Seek(300000, &state);
+  uint64_t micros = 0;
+  const SequenceEvent* event = stream->Peek(&micros);
+  ASSERT_TRUE(event);
+  EXPECT_EQ(event->tick, 500u);
+  EXPECT_EQ(event->data2, 30);
+
+  ChannelStateSet expected;
+  sequence->StateAt(4, &expected);
+  RecordingOutput streamed_state;
+  RecordingOutput compiled_state;
+  state.Emit(&streamed_state);
+  expected.Emit(&compiled_state);
+  std::vector<RecordingOutput::Message> got = streamed_state.messages();
+  std::vector<RecordingOutput::Message> want = compiled_state.messages();
+  ASSERT_EQ(got.size(), want.size());
+  ASSERT_FALSE(got.empty());
+  for (size_t i = 0; i < got.size(); ++i) {
+    EXPECT_EQ(got[i].status, want[i].status);
+    EXPECT_EQ(got[i].data1, want[i].data1);
+    EXPECT_EQ(got[i].data2, want[i].data2);
+  }
+
+  // Seeking back to the start plays the first event again.
+  stream->Seek(0, &state);
+  event = stream->Peek(&micros);
+  ASSERT_TRUE(event);
+  EXPECT_EQ(event->status, 0xC0);
+  // Past the last event.
+  stream->Seek(sequence->duration_us() + 1000, &state);
+  EXPECT_FALSE(stream->Peek(&micros));
+}
+
+// The state chased by seeking |stream| to |tick|, as messages, followed by
+// the next few events.
+std::vector<RecordingOutput::Message> SeekTo(SequenceStream* stream,
+                                             uint32_t tick) {
+  ChannelStateSet state;
+  stream->Seek(stream->tempo_map().TicksToMicros(tick), &state);
+  RecordingOutput output;
+  state.Emit(&output);
+  std::vector<RecordingOutput::Message> messages = output.messages();
+  uint64_t micros = 0;
+  for (int i = 0; i < 8; ++i) {
+    const SequenceEvent* event = stream->Peek(&micros);
+    if (!event) {
+      break;
+    }
+    RecordingOutput::Message message;
+    message.status = event->status;
+    message.data1 = event->data1;
+    message.data2 = event->data2;
+    messages.push_back(message);
+    stream->Advance();
+  }
+  return messages;
+}
+
+TEST(SequenceStreamTest, SeekResumesFromCheckpoints) {
+  SmfBuilder builder(1, 500);
+  builder.BeginTrack().Tempo(0, 400000);
+  for (int i = 0; i < 300; ++i) {
+    uint8_t value = static_cast<uint8_t>(i % 128);
+    // Running status carries across events and checkpoints.
+    builder.ControlChange(1, 0, 7, value)
+        .Raw(0, {10, value})
+        .NoteOn(1, 0, 60, 100)
+        .NoteOff(1, 0, 60);
+    if (i % 100 == 99) {
+      builder.Tempo(0, 400000 + static_cast<uint32_t>(i) * 1000);
+    }
+  }
+  builder.EndTrack().BeginTrack();
+  for (int i = 0; i < 200; ++i) {
+    builder.PitchBend(3, 1, static_cast<uint16_t>(i * 50))
+        .ProgramChange(0, 1, static_cast<uint8_t>(i % 128));
+  }
+  std::string path = WriteTempFile("sequence_stream_test_checkpoints.mid",
+                                   builder.EndTrack().Build());
+  std::string error;
+  std::unique_ptr<SequenceStream> checkpointed =
+      SequenceStream::Open(path, &error, 7, 16, 16);
+  std::unique_ptr<SequenceStream> rewound =
+      SequenceStream::Open(path, &error, 7, 16, 0);
+  std::remove(path.c_str());
+  ASSERT_TRUE(checkpointed && rewound) << error;
+  EXPECT_GT(checkpointed->checkpoint_count(), 50u);
+  EXPECT_EQ(rewound->checkpoint_count(), 0u);
+
+  // Every few ticks, landing on checkpoints and between them, then back.
+  std::vector<uint32_t> ticks;
+  for (uint32_t tick = 0; tick <= checkpointed->end_tick() + 10; tick += 3) {
+    ticks.push_back(tick);
+  }
+  ticks.push_back(100);
+  ticks.push_back(0);
+  for (uint32_t tick : ticks) {
+    std::vector<RecordingOutput::Message> got =
+        SeekTo(checkpointed.get(), tick);
+    std::vector<RecordingOutput::Message> want = SeekTo(rewound.get(), tick);
+    ASSERT_EQ(got.size(), want.size()) << "tick " << tick;
+    for (size_t i = 0; i < got.size(); ++i) {
+      ASSERT_EQ(got[i].status, want[i].status) << "tick " << tick;
+      ASSERT_EQ(got[i].data1, want[i].data1) << "tick " << tick;
+      ASSERT_EQ(got[i].data2, want[i].data2) << "tick " << tick;
+    }
+  }
+}
+
+TEST(SequenceStreamTest, MemoryDoesNotGrowWithLength) {
+  SmfBuilder short_file;
+  SmfBuilder long_file;
+  short_file.BeginTrack();
+  long_file.BeginTrack();
+  for (int i = 0; i < 50000; ++i) {
+    if (i < 5000) {
+      short_file.NoteOn(1, 0, 60, 100).NoteOff(1, 0, 60);
+    }
+    long_file.NoteOn(1, 0, 60, 100).NoteOff(1, 0, 60);
+  }
+  std::string short_path = WriteTempFile("sequence_stream_test_short.mid",
+                                         short_file.EndTrack().Build());
+  std::string long_path = WriteTempFile("sequence_stream_test_long.mid",
+                                        long_file.EndTrack().Build());
+  std::string error;
+  // Checkpoints are the only part that grows.
+  std::unique_ptr<SequenceStream> short_stream = SequenceStream::Open(
+      short_path, &error, SequenceStream::kDefaultWindowEvents,
+      SequenceStream::kDefaultTrackBufferBytes, 0);
+  std::unique_ptr<SequenceStream> long_stream = SequenceStream::Open(
+      long_path, &error, SequenceStream::kDefaultWindowEvents,
+      SequenceStream::kDefaultTrackBufferBytes, 0);
+  std::unique_ptr<SequenceStream> checkpointed =
+      SequenceStream::Open(long_path, &error);
+  std::remove(short_path.c_str());
+  std::remove(long_path.c_str());
+  ASSERT_TRUE(short_stream && long_stream && checkpointed) << error;
+  EXPECT_EQ(short_stream->memory_bytes(), long_stream->memory_bytes());
+  EXPECT_EQ(checkpointed->checkpoint_count(),
+            100000 / SequenceStream::kDefaultCheckpointInterval);
+  EXPECT_GT(checkpointed->memory_bytes(), long_stream->memory_bytes());
+}
+
+TEST(SequenceStreamTest, ReportsErrors) {
+  std::string error;
+  EXPECT_FALSE(SequenceStream::Open("/nonexistent.mid", &error));
+  EXPECT_EQ(error, "File not found");
+
+  std::string path = WriteTempFile(
+      "sequence_stream_test_bad.mid",
+      SmfBuilder().BeginTrack().NoteOn(0, 0, 60, 100).Raw(0, {0xF1}).Build());
+  EXPECT_FALSE(SequenceStream::Open(path, &error));
+  EXPECT_EQ(error, "Malformed MIDI track data");
+  std::remove(path.c_str());
+
+  // Checked like ParseSmf does: SMPTE timing with no ticks per frame.
+  path = WriteTempFile("sequence_stream_test_division.mid",
+                       SmfBuilder(0, 0xE700).BeginTrack().EndTrack().Build());
+  EXPECT_FALSE(SequenceStream::Open(path, &error));
+  EXPECT_EQ(error, "Invalid MIDI time division");
+  std::remove(path.c_str());
+}
+
+}  // namespace
+}  // namespace playmidifile
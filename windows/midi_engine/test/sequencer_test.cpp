@@ -0,0 +1,463 @@
+#include "midi_engine/sequencer.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "midi_engine/playback_engine.h"
+#include "midi_engine/sequencer_backend.h"
+#include "midi_engine/thread_pool.h"
+#include "recording_output.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using std::chrono::milliseconds;
+using testing::RecordingOutput;
+using testing::SmfBuilder;
+using testing::WriteTempFile;
+using Clock = Sequencer::Clock;
+
+// With 500 ticks per quarter at the default 120 BPM one tick is 1 ms.
+constexpr uint16_t kMillisecondTicks = 500;
+
+std::shared_ptr<const Sequence> CompileBytes(
+    const std::vector<uint8_t>& data, const std::string& name,
+    size_t checkpoint_interval = Sequence::kDefaultCheckpointInterval) {
+  std::string path = WriteTempFile(name, data);
+  std::string error;
+  std::unique_ptr<MidiFile> file = MidiFile::Open(path, &error);
+  std::remove(path.c_str());
+  EXPECT_TRUE(file) << error;
+  return file ? Sequence::Compile(*file, checkpoint_interval) : nullptr;
+}
+
+class SequencerTest : public ::testing::Test {
+ protected:
+  SequencerTest() : sequencer_(&output_), t0_(Clock::now()) {}
+
+  std::vector<uint8_t> NoteTrain() {
+    return SmfBuilder(0, kMillisecondTicks)
+        .BeginTrack()
+        .NoteOn(0, 0, 60, 100)
+        .NoteOff(100, 0, 60)
+        .NoteOn(100, 0, 62, 100)
+        .NoteOff(100, 0, 62)
+        .EndTrack(100)
+        .Build();
+  }
+
+  RecordingOutput output_;
+  Sequencer sequencer_;
+  Clock::time_point t0_;
+};
+
+TEST_F(SequencerTest, CompilesTracksIntoOneTimeline) {
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(SmfBuilder(1, kMillisecondTicks)
+                       .BeginTrack()
+                       .NoteOn(10, 1, 50, 1)
+                       .EndTrack()
+                       .BeginTrack()
+                       .NoteOn(0, 2, 40, 1)
+                       .NoteOn(10, 2, 41, 1)
+                       .SysEx(5, {0x41, 0xF7})
+                       .EndTrack()
+                       .Build(),
+                   "sequencer_test_merge.mid");
+  ASSERT_TRUE(sequence);
+  ASSERT_EQ(sequence->event_count(), 4u);
+  std::vector<SequenceEvent> events;
+  for (size_t i = 0; i < sequence->event_count(); ++i) {
+    events.push_back(sequence->event(i));
+  }
+  EXPECT_EQ(events[0].data1, 40);
+  // Same tick: the earlier track wins.
+  EXPECT_EQ(events[1].data1, 50);
+  EXPECT_EQ(events[2].data1, 41);
+  EXPECT_EQ(events[3].status, 0xF0);
+  ASSERT_EQ(events[3].payload_size, 3u);
+  EXPECT_EQ(sequence->payload(events[3])[0], 0xF0);
+  EXPECT_EQ(sequence->payload(events[3])[2], 0xF7);
+}
+
+TEST_F(SequencerTest, StoresEightBytesPerChannelEvent) {
+  SmfBuilder builder(0, kMillisecondTicks);
+  builder.BeginTrack();
+  for (int i = 0; i < 1000; ++i) {
+    builder.NoteOn(1, 0, 60, 100).NoteOff(1, 0, 60);
+  }
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(builder.EndTrack().Build(), "sequencer_test_packed.mid", 0);
+  ASSERT_TRUE(sequence);
+  ASSERT_EQ(sequence->event_count(), 2000u);
+  EXPECT_LE(sequence->memory_bytes(),
+            sizeof(Sequence) + sequence->tempo_map().memory_bytes() +
+                8 * sequence->event_count());
+  SequenceEvent event = sequence->event(1);
+  EXPECT_EQ(event.tick, 2u);
+  EXPECT_EQ(event.status, 0x80);
+  EXPECT_EQ(event.data1, 60);
+}
+
+TEST_F(SequencerTest, KeepsAllStorageInOneHeapBlock) {
+  SmfBuilder builder(1, kMillisecondTicks);
+  builder.BeginTrack().Tempo(0, 400000).Tempo(500, 600000).EndTrack();
+  for (uint8_t channel = 0; channel < 4; ++channel) {
+    builder.BeginTrack().SysEx(0, {0x7E, 0x7F, 0x09, 0x01, 0xF7});
+    for (int i = 0; i < 3000; ++i) {
+      builder.NoteOn(1, channel, 60, 100).NoteOff(1, channel, 60);
+    }
+    builder.EndTrack();
+  }
+  std::shared_ptr<const Sequence> sequence =
+      CompileBytes(builder.Build(), "sequencer_test_arena.mid", 256);
+  ASSERT_TRUE(sequence);
+  EXPECT_EQ(sequence->event_count(), 24004u);
+  EXPECT_GT(sequence->checkpoint_count(), 0u);
+  EXPECT_EQ(sequence->heap_blocks(), 1u);
+  EXPECT_EQ(sequence->tempo_map().segment_count(), 2u);
+}
+
+TEST_F(SequencerTest, ParallelCompileMatchesSerial) {
+  // Many tracks with events on shared ticks and sysex in several of them.
+  SmfBuilder builder(1, kMillisecondTicks);
+  for (uint8_t track = 0; track < 32; ++track) {
+    builder.BeginTrack();
+    for (int i = 0; i < 50; ++i) {
+      uint8_t channel = track % 16;
+      builder.NoteOn(static_cast<uint32_t>(track % 3), channel,
+                     static_cast<uint8_t>(40 + i % 40), track)
+          .NoteOff(5, channel, static_cast<uint8_t>(40 + i % 40));
+      if (i % 10 == track % 10) {
+        builder.SysEx(0, {0x41, track, 0xF7});
+      }
+    }
+    builder.EndTrack();
+  }
+  std::vector<uint8_t> data = builder.Build();
+  std::string error;
+  std::unique_ptr<MidiFile> file =
+      MidiFile::Parse(data.data(), data.size(), &error);
+  ASSERT_TRUE(file) << error;
+  std::shared_ptr<const Sequence> serial = Sequence::Compile(*file);
+  ThreadPool pool(4);
+  std::shared_ptr<const Sequence> parallel =
+      Sequence::Compile(*file, Sequence::kDefaultCheckpointInterval, &pool);
+  ASSERT_EQ(parallel->event_count(), serial->event_count());
+  for (size_t i = 0; i < serial->event_count(); ++i) {
+    SequenceEvent a = serial->event(i);
+    SequenceEvent b = parallel->event(i);
+    ASSERT_EQ(b.tick, a.tick) << i;
+    ASSERT_EQ(b.status, a.status) << i;
+    ASSERT_EQ(b.data1, a.data1) << i;
+    ASSERT_EQ(b.data2, a.data2) << i;
+    ASSERT_EQ(b.payload_size, a.payload_size) << i;
+    ASSERT_TRUE(std::equal(serial->payload(a),
+                           serial->payload(a) + a.payload_size,
+                           parallel->payload(b)))
+        << i;
+  }
+  // Ticks never go backwards, and ties keep track order.
+  for (size_t i = 1; i < parallel->event_count(); ++i) {
+    ASSERT_LE(parallel->tick(i - 1), parallel->tick(i));
+  }
+}
+
+TEST_F(SequencerTest, CompileStopsWhenCancelled) {
+  SmfBuilder builder(0, kMillisecondTicks);
+  builder.BeginTrack();
+  for (int i = 0; i < 10000; ++i) {
+    builder.NoteOn(1, 0, 60, 100);
+  }
+  std::vector<uint8_t> data = builder.EndTrack().Build();
+  std::string error;
+  std::unique_ptr<MidiFile> file =
+      MidiFile::Parse(data.data(), data.size(), &error);
+  ASSERT_TRUE(file) << error;
+  std::atomic<bool> cancel(true);
+  EXPECT_FALSE(Sequence::Compile(*file, Sequence::kDefaultCheckpointInterval,
+                                 nullptr, &cancel));
+  cancel = false;
+  EXPECT_TRUE(Sequence::Compile(*file, Sequence::kDefaultCheckpointInterval,
+                                nullptr, &cancel));
+}
+
+TEST_F(SequencerTest, DispatchesEventsAtTheirDeadlines) {
+  sequencer_.Load(CompileBytes(NoteTrain(), "sequencer_test_train.mid"));
+  sequencer_.Play(t0_);
+  EXPECT_EQ(sequencer_.Dispatch(t0_), t0_ + milliseconds(100));
+  EXPECT_EQ(output_.notes().size(), 1u);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(99)),
+            t0_ + milliseconds(100));
+  EXPECT_EQ(output_.notes().size(), 1u);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(100)),
+            t0_ + milliseconds(200));
+  EXPECT_EQ(output_.notes().size(), 2u);
+  // A late wake-up sends everything that is due in one go.
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(350)),
+            t0_ + milliseconds(400));
+  EXPECT_EQ(output_.notes().size(), 4u);
+  EXPECT_FALSE(sequencer_.finished());
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(400)),
+            Clock::time_point::max());
+  EXPECT_TRUE(sequencer_.finished());
+  EXPECT_EQ(sequencer_.PositionUs(t0_ + milliseconds(500)), 400000u);
+}
+
+TEST_F(SequencerTest, ChainedSequenceStartsWhereThePreviousEnds) {
+  sequencer_.Load(CompileBytes(NoteTrain(), "sequencer_test_first.mid"));
+  sequencer_.Chain(CompileBytes(NoteTrain(), "sequencer_test_second.mid"));
+  sequencer_.Play(t0_);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(350)),
+            t0_ + milliseconds(400));
+  EXPECT_FALSE(sequencer_.TakeTransition());
+  // Woken 50 ms late: the second piece is still anchored at 400 ms.
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(450)),
+            t0_ + milliseconds(500));
+  EXPECT_TRUE(sequencer_.TakeTransition());
+  EXPECT_FALSE(sequencer_.TakeTransition());
+  EXPECT_FALSE(sequencer_.finished());
+  EXPECT_FALSE(sequencer_.chained());
+  EXPECT_EQ(output_.notes().size(), 5u);
+  EXPECT_EQ(sequencer_.PositionUs(t0_ + milliseconds(450)), 50000u);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(800)),
+            Clock::time_point::max());
+  EXPECT_TRUE(sequencer_.finished());
+  EXPECT_EQ(output_.notes().size(), 8u);
+}
+
+TEST_F(SequencerTest, RecordsDispatchLateness) {
+  PlaybackStats stats;
+  sequencer_.set_stats(&stats);
+  sequencer_.Load(CompileBytes(NoteTrain(), "sequencer_test_stats.mid"));
+  sequencer_.Play(t0_);
+  // The notes at 0 and 100 ms go out 150 and 50 ms late.
+  sequencer_.Dispatch(t0_ + milliseconds(150));
+  HistogramSummary lateness = stats.Snapshot().dispatch_lateness_us;
+  EXPECT_EQ(lateness.count, 2u);
+  EXPECT_EQ(lateness.max, 150000u);
+  EXPECT_DOUBLE_EQ(lateness.mean, 100000.0);
+}
+
+TEST_F(SequencerTest, SpeedChangeAppliesFromTheNextEvent) {
+  sequencer_.Load(CompileBytes(NoteTrain(), "sequencer_test_speed.mid"));
+  sequencer_.Play(t0_);
+  sequencer_.Dispatch(t0_);
+  sequencer_.Dispatch(t0_ + milliseconds(100));
+  // Halfway to the next note, double the speed: the remaining 50 ms of
+  // song time now take 25 ms.
+  sequencer_.SetSpeed(2.0, t0_ + milliseconds(150));
+  EXPECT_EQ(sequencer_.PositionUs(t0_ + milliseconds(150)), 150000u);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(150)),
+            t0_ + milliseconds(175));
+  sequencer_.Dispatch(t0_ + milliseconds(175));
+  EXPECT_EQ(output_.notes().size(), 3u);
+  // Half speed from here: 100 ms of song time take 200 ms.
+  sequencer_.SetSpeed(0.5, t0_ + milliseconds(175));
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(176)),
+            t0_ + milliseconds(375));
+}
+
+TEST_F(SequencerTest, PauseFreezesPositionAndSilences) {
+  sequencer_.Load(CompileBytes(NoteTrain(), "sequencer_test_pause.mid"));
+  sequencer_.Play(t0_);
+  sequencer_.Dispatch(t0_);
+  sequencer_.Pause(t0_ + milliseconds(50));
+  EXPECT_FALSE(sequencer_.running());
+  EXPECT_EQ(sequencer_.PositionUs(t0_ + milliseconds(500)), 50000u);
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(500)),
+            Clock::time_point::max());
+  // All notes off (CC 123) went out on every channel.
+  std::vector<RecordingOutput::Message> messages = output_.messages();
+  EXPECT_EQ(std::count_if(messages.begin(), messages.end(),
+                          [](const RecordingOutput::Message& m) {
+                            return (m.status & 0xF0) == 0xB0 &&
+                                   m.data1 == 123;
+                          }),
+            16);
+  // Resuming continues from the frozen position.
+  sequencer_.Play(t0_ + milliseconds(1000));
+  EXPECT_EQ(sequencer_.Dispatch(t0_ + milliseconds(1000)),
+            t0_ + milliseconds(1050));
+}
+
+TEST_F(SequencerTest, SeekRestoresControllerState) {
+  sequencer_.Load(CompileBytes(SmfBuilder(0, kMillisecondTicks)
+                                   .BeginTrack()
+                                   .ControlChange(0, 3, 0, 1)
+                                   .ProgramChange(0, 3, 40)
+                                   .ControlChange(10, 3, 7, 90)
+                                   .NoteOn(0, 3, 60, 100)
+                                   .PitchBend(10, 3, 0x2100)
+                                   .NoteOff(10, 3, 60)
+                                   .ProgramChange(100, 3, 41)
+                                   .NoteOn(10, 3, 64, 100)
+                                   .EndTrack()
+                                   .Build(),
+                               "sequencer_test_seek.mid"));
+  sequencer_.Seek(50000, t0_);
+  std::vector<RecordingOutput::Message> messages = output_.messages();
+  auto sent = [&messages](uint8_t status, uint8_t data1, uint8_t data2) {
+    return std::find_if(messages.begin(), messages.end(),
+                        [=](const RecordingOutput::Message& m) {
+                          return m.status == status && m.data1 == data1 &&
+                                 m.data2 == data2;
+                        });
+  };
+  auto bank = sent(0xB3, 0, 1);
+  auto program = sent(0xC3, 40, 0);
+  ASSERT_NE(bank, messages.end());
+  ASSERT_NE(program, messages.end());
+  EXPECT_LT(bank, program);
+  EXPECT_NE(sent(0xB3, 7, 90), messages.end());
+  EXPECT_NE(sent(0xE3, 0x00, 0x42), messages.end());
+  // State after the target and notes before it are not sent.
+  EXPECT_EQ(sent(0xC3, 41, 0), messages.end());
+  EXPECT_TRUE(output_.notes().empty());
+
+  sequencer_.Play(t0_);
+  EXPECT_EQ(sequencer_.Dispatch(t0_), t0_ + milliseconds(80));
+  EXPECT_EQ(sequencer_.PositionUs(t0_ + milliseconds(10)), 60000u);
+}
+
+TEST_F(SequencerTest, CheckpointsMatchFullReplay) {
+  SmfBuilder builder(1, kMillisecondTicks);
+  for (uint8_t track = 0; track < 4; ++track) {
+    builder.BeginTrack();
+    for (uint8_t i = 0; i < 50; ++i) {
+      uint8_t channel = static_cast<uint8_t>((track * 5 + i) % 16);
+      builder.ControlChange(3, channel, i % 8, i)
+          .ProgramChange(0, channel, static_cast<uint8_t>(i + track))
+          .NoteOn(1, channel, 60, 100)
+          .PitchBend(2, channel, static_cast<uint16_t>(i * 300))
+          .NoteOff(1, channel, 60);
+    }
+    builder.EndTrack();
+  }
+  std::vector<uint8_t> data = builder.Build();
+  std::shared_ptr<const Sequence> replayed =
+      CompileBytes(data, "sequencer_test_replay.mid", 0);
+  std::shared_ptr<const Sequence> checkpointed =
+      CompileBytes(data, "sequencer_test_checkpoints.mid", 7);
+  ASSERT_EQ(replayed->checkpoint_count(), 0u);
+  ASSERT_EQ(checkpointed->checkpoint_count(),
+            (checkpointed->event_count() + 6) / 7);
+
+  for (size_t index = 0; index <= replayed->event_count() + 1; ++index) {
+    ChannelStateSet expected;
+    ChannelStateSet actual;
+    replayed->StateAt(index, &expected);
+    checkpointed->StateAt(index, &actual);
+    RecordingOutput expected_output;
+    RecordingOutput actual_output;
+    expected.Emit(&expected_output);
+    actual.Emit(&actual_output);
+    std::vector<RecordingOutput::Message> want = expected_output.messages();
+    std::vector<RecordingOutput::Message> got = actual_output.messages();
+    ASSERT_EQ(got.size(), want.size()) << "event " << index;
+    for (size_t i = 0; i < want.size(); ++i) {
+      ASSERT_EQ(got[i].status, want[i].status) << "event " << index;
+      ASSERT_EQ(got[i].data1, want[i].data1) << "event " << index;
+      ASSERT_EQ(got[i].data2, want[i].data2) << "event " << index;
+    }
+  }
+}
+
+// Plays a dense note train through the engine thread and measures how late
+// each note is relative to the first one.
+TEST(SequencerTimingTest, DispatchJitter) {
+  constexpr int kNotes = 200;
+  constexpr int kIntervalMs = 5;
+  SmfBuilder builder(0, kMillisecondTicks);
+  builder.BeginTrack();
+  for (int i = 0; i < kNotes; ++i) {
+    builder.NoteOn(i == 0 ? 0 : kIntervalMs, 0, 60, 100);
+  }
+  builder.EndTrack();
+  std::string path = WriteTempFile("sequencer_test_jitter.mid",
+                                   builder.Build());
+
+  RecordingOutput output;
+  {
+    PlaybackEngine engine(std::make_unique<SequencerBackend>(&output));
+    std::promise<void> loaded;
+    engine.Load(path, [&loaded](const CommandResult&) { loaded.set_value(); });
+    loaded.get_future().wait();
+    engine.Play(nullptr);
+    std::this_thread::sleep_for(milliseconds(kNotes * kIntervalMs + 100));
+  }
+  std::remove(path.c_str());
+
+  std::vector<RecordingOutput::Message> notes = output.notes();
+  ASSERT_EQ(notes.size(), static_cast<size_t>(kNotes));
+  std::vector<double> lateness_us;
+  for (int i = 0; i < kNotes; ++i) {
+    double offset_us = std::chrono::duration<double, std::micro>(
+                           notes[i].time - notes[0].time)
+                           .count();
+    lateness_us.push_back(offset_us - i * kIntervalMs * 1000.0);
+  }
+  std::sort(lateness_us.begin(), lateness_us.end());
+  double p50 = lateness_us[kNotes / 2];
+  double p99 = lateness_us[kNotes * 99 / 100];
+  RecordProperty("lateness_p50_us", std::to_string(p50));
+  RecordProperty("lateness_p99_us", std::to_string(p99));
+  RecordProperty("lateness_max_us", std::to_string(lateness_us.back()));
+  // Never early, and on time to well within a millisecond typically. The
+  // p99 bound is loose so that loaded CI machines do not flake.
+  EXPECT_GE(lateness_us.front(), -1000.0);
+  EXPECT_LT(p50, 1000.0);
+  EXPECT_LT(p99, 10000.0);
+}
+
+// Plays two queued files through the engine thread: the second is parsed
+// while the first plays and starts when the first ends, with no gap.
+TEST(SequencerTimingTest, QueuedFilePlaysWithoutGap) {
+  std::vector<uint8_t> train = SmfBuilder(0, kMillisecondTicks)
+                                   .BeginTrack()
+                                   .NoteOn(0, 0, 60, 100)
+                                   .NoteOff(100, 0, 60)
+                                   .EndTrack(100)
+                                   .Build();
+  std::string first = WriteTempFile("sequencer_test_queue_a.mid", train);
+  std::string second = WriteTempFile("sequencer_test_queue_b.mid", train);
+
+  RecordingOutput output;
+  {
+    PlaybackEngine engine(std::make_unique<SequencerBackend>(&output));
+    std::promise<void> loaded;
+    engine.Load(first,
+                [&loaded](const CommandResult&) { loaded.set_value(); });
+    loaded.get_future().wait();
+    engine.Enqueue(second, nullptr);
+    engine.Play(nullptr);
+    std::this_thread::sleep_for(milliseconds(500));
+    PlaybackInfo info = engine.Snapshot();
+    EXPECT_EQ(info.state, PlaybackState::kStopped);
+    EXPECT_EQ(info.duration_ms, 200u);
+  }
+  std::remove(first.c_str());
+  std::remove(second.c_str());
+
+  std::vector<RecordingOutput::Message> notes = output.notes();
+  ASSERT_EQ(notes.size(), 4u);
+  double start_us = std::chrono::duration<double, std::micro>(
+                        notes[2].time - notes[0].time)
+                        .count();
+  RecordProperty("transition_lateness_us",
+                 std::to_string(start_us - 200000.0));
+  EXPECT_GE(start_us, 199000.0);
+  EXPECT_LT(start_us, 210000.0);
+}
+
+}  // namespace
+}  // namespace playmidifile
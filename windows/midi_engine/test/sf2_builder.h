@@ -0,0 +1,258 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_TEST_SF2_BUILDER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_TEST_SF2_BUILDER_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace playmidifile {
+namespace testing {
+
+// SF2 generator operators used by the tests.
+namespace sf2 {
+constexpr uint16_t kStartAddrsOffset = 0;
+constexpr uint16_t kEndAddrsOffset = 1;
+constexpr uint16_t kPan = 17;
+constexpr uint16_t kDelayVolEnv = 33;
+constexpr uint16_t kAttackVolEnv = 34;
+constexpr uint16_t kHoldVolEnv = 35;
+constexpr uint16_t kDecayVolEnv = 36;
+constexpr uint16_t kSustainVolEnv = 37;
+constexpr uint16_t kReleaseVolEnv = 38;
+constexpr uint16_t kKeyRange = 43;
+constexpr uint16_t kVelRange = 44;
+constexpr uint16_t kInitialAttenuation = 48;
+constexpr uint16_t kCoarseTune = 51;
+constexpr uint16_t kFineTune = 52;
+constexpr uint16_t kSampleModes = 54;
+constexpr uint16_t kExclusiveClass = 57;
+constexpr uint16_t kOverridingRootKey = 58;
+
+// Amount for kKeyRange / kVelRange.
+inline uint16_t Range(uint8_t low, uint8_t high) {
+  return static_cast<uint16_t>(low | (high << 8));
+}
+}  // namespace sf2
+
+// Assembles SoundFont 2 files in memory. A zone is a list of (generator,
+// amount) pairs; the builder appends the terminal instrument / sampleID
+// generator itself. A zone without a sample (or instrument) is a global
+// zone and must come first.
+class Sf2Builder {
+ public:
+  using Generators = std::vector<std::pair<uint16_t, uint16_t>>;
+
+  struct Sample {
+    std::vector<int16_t> data;
+    uint32_t sample_rate = 44100;
+    uint8_t root_key = 60;
+    int8_t pitch_correction = 0;
+    // Relative to the start of |data|.
+    uint32_t loop_start = 0;
+    uint32_t loop_end = 0;
+  };
+
+  // Returns the sample id.
+  int AddSample(const Sample& sample) {
+    samples_.push_back(sample);
+    return static_cast<int>(samples_.size()) - 1;
+  }
+
+  // Starts a new instrument and returns its index.
+  int BeginInstrument(const std::string& name) {
+    instruments_.push_back(Instrument{name, {}});
+    return static_cast<int>(instruments_.size()) - 1;
+  }
+
+  // Adds a zone to the current instrument. |sample| < 0 makes it global.
+  Sf2Builder& InstrumentZone(int sample, const Generators& generators = {}) {
+    instruments_.back().zones.push_back(Zone{sample, generators});
+    return *this;
+  }
+
+  void BeginPreset(const std::string& name, uint16_t bank, uint16_t program) {
+    presets_.push_back(Preset{name, bank, program, {}});
+  }
+
+  // Adds a zone to the current preset. |instrument| < 0 makes it global.
+  Sf2Builder& PresetZone(int instrument, const Generators& generators = {}) {
+    presets_.back().zones.push_back(Zone{instrument, generators});
+    return *this;
+  }
+
+  // Convenience: one preset with one instrument holding one zone.
+  Sf2Builder& SimplePreset(uint16_t bank, uint16_t program, int sample,
+                           const Generators& generators = {}) {
+    int instrument = BeginInstrument("inst" + std::to_string(program));
+    InstrumentZone(sample, generators);
+    BeginPreset("preset" + std::to_string(program), bank, program);
+    PresetZone(instrument);
+    return *this;
+  }
+
+  std::vector<uint8_t> Build() const {
+    std::vector<uint8_t> smpl;
+    std::vector<uint8_t> shdr;
+    uint32_t offset = 0;
+    for (size_t i = 0; i < samples_.size(); ++i) {
+      const Sample& sample = samples_[i];
+      for (int16_t value : sample.data) {
+        Write16(&smpl, static_cast<uint16_t>(value));
+      }
+      // 46 zero guard points follow every sample.
+      smpl.insert(smpl.end(), 46 * 2, 0);
+      WriteName(&shdr, "sample" + std::to_string(i));
+      Write32(&shdr, offset);
+      Write32(&shdr, offset + static_cast<uint32_t>(sample.data.size()));
+      Write32(&shdr, offset + sample.loop_start);
+      Write32(&shdr, offset + sample.loop_end);
+      Write32(&shdr, sample.sample_rate);
+      shdr.push_back(sample.root_key);
+      shdr.push_back(static_cast<uint8_t>(sample.pitch_correction));
+      Write16(&shdr, 0);
+      Write16(&shdr, 1);  // Mono.
+      offset += static_cast<uint32_t>(sample.data.size()) + 46;
+    }
+    WriteName(&shdr, "EOS");
+    shdr.insert(shdr.end(), 26, 0);
+
+    std::vector<uint8_t> inst, ibag, igen;
+    WriteInstruments(&inst, &ibag, &igen);
+    std::vector<uint8_t> phdr, pbag, pgen;
+    WritePresets(&phdr, &pbag, &pgen);
+    std::vector<uint8_t> pmod(10, 0), imod(10, 0);
+
+    std::vector<uint8_t> pdta = {'p', 'd', 't', 'a'};
+    AppendChunk(&pdta, "phdr", phdr);
+    AppendChunk(&pdta, "pbag", pbag);
+    AppendChunk(&pdta, "pmod", pmod);
+    AppendChunk(&pdta, "pgen", pgen);
+    AppendChunk(&pdta, "inst", inst);
+    AppendChunk(&pdta, "ibag", ibag);
+    AppendChunk(&pdta, "imod", imod);
+    AppendChunk(&pdta, "igen", igen);
+    AppendChunk(&pdta, "shdr", shdr);
+
+    std::vector<uint8_t> info = {'I', 'N', 'F', 'O'};
+    AppendChunk(&info, "ifil", {2, 0, 1, 0});
+    std::vector<uint8_t> sdta = {'s', 'd', 't', 'a'};
+    AppendChunk(&sdta, "smpl", smpl);
+
+    std::vector<uint8_t> body = {'s', 'f', 'b', 'k'};
+    AppendChunk(&body, "LIST", info);
+    AppendChunk(&body, "LIST", sdta);
+    AppendChunk(&body, "LIST", pdta);
+    std::vector<uint8_t> out;
+    AppendChunk(&out, "RIFF", body);
+    return out;
+  }
+
+ private:
+  struct Zone {
+    // Sample id (instrument zones) or instrument index (preset zones).
+    int target;
+    Generators generators;
+  };
+  struct Instrument {
+    std::string name;
+    std::vector<Zone> zones;
+  };
+  struct Preset {
+    std::string name;
+    uint16_t bank;
+    uint16_t program;
+    std::vector<Zone> zones;
+  };
+
+  static void Write16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back(static_cast<uint8_t>(value));
+    out->push_back(static_cast<uint8_t>(value >> 8));
+  }
+
+  static void Write32(std::vector<uint8_t>* out, uint32_t value) {
+    Write16(out, static_cast<uint16_t>(value));
+    Write16(out, static_cast<uint16_t>(value >> 16));
+  }
+
+  static void WriteName(std::vector<uint8_t>* out, const std::string& name) {
+    char buffer[20] = {};
+    std::strncpy(buffer, name.c_str(), sizeof(buffer) - 1);
+    out->insert(out->end(), buffer, buffer + sizeof(buffer));
+  }
+
+  static void AppendChunk(std::vector<uint8_t>* out, const char* id,
+                          const std::vector<uint8_t>& data) {
+    out->insert(out->end(), id, id + 4);
+    Write32(out, static_cast<uint32_t>(data.size()));
+    out->insert(out->end(), data.begin(), data.end());
+    if (data.size() & 1) {
+      out->push_back(0);
+    }
+  }
+
+  // Writes the bags and generators of |zones|, terminating each zone that
+  // has a target with |terminal| = target.
+  static void WriteZones(const std::vector<Zone>& zones, uint16_t terminal,
+                         std::vector<uint8_t>* bags,
+                         std::vector<uint8_t>* gens) {
+    for (const Zone& zone : zones) {
+      Write16(bags, static_cast<uint16_t>(gens->size() / 4));
+      Write16(bags, 0);
+      for (const auto& generator : zone.generators) {
+        Write16(gens, generator.first);
+        Write16(gens, generator.second);
+      }
+      if (zone.target >= 0) {
+        Write16(gens, terminal);
+        Write16(gens, static_cast<uint16_t>(zone.target));
+      }
+    }
+  }
+
+  void WriteInstruments(std::vector<uint8_t>* inst, std::vector<uint8_t>* ibag,
+                        std::vector<uint8_t>* igen) const {
+    constexpr uint16_t kSampleId = 53;
+    for (const Instrument& instrument : instruments_) {
+      WriteName(inst, instrument.name);
+      Write16(inst, static_cast<uint16_t>(ibag->size() / 4));
+      WriteZones(instrument.zones, kSampleId, ibag, igen);
+    }
+    WriteName(inst, "EOI");
+    Write16(inst, static_cast<uint16_t>(ibag->size() / 4));
+    Write16(ibag, static_cast<uint16_t>(igen->size() / 4));
+    Write16(ibag, 0);
+    igen->insert(igen->end(), 4, 0);
+  }
+
+  void WritePresets(std::vector<uint8_t>* phdr, std::vector<uint8_t>* pbag,
+                    std::vector<uint8_t>* pgen) const {
+    constexpr uint16_t kInstrument = 41;
+    for (const Preset& preset : presets_) {
+      WriteName(phdr, preset.name);
+      Write16(phdr, preset.program);
+      Write16(phdr, preset.bank);
+      Write16(phdr, static_cast<uint16_t>(pbag->size() / 4));
+      phdr->insert(phdr->end(), 12, 0);
+      WriteZones(preset.zones, kInstrument, pbag, pgen);
+    }
+    WriteName(phdr, "EOP");
+    Write16(phdr, 0);
+    Write16(phdr, 0);
+    Write16(phdr, static_cast<uint16_t>(pbag->size() / 4));
+    phdr->insert(phdr->end(), 12, 0);
+    Write16(pbag, static_cast<uint16_t>(pgen->size() / 4));
+    Write16(pbag, 0);
+    pgen->insert(pgen->end(), 4, 0);
+  }
+
+  std::vector<Sample> samples_;
+  std::vector<Instrument> instruments_;
+  std::vector<Preset> presets_;
+};
+
+}  // namespace testing
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_TEST_SF2_BUILDER_H_
@@ -0,0 +1,142 @@
+#ifndef PLAYMIDIFILE_MIDI_ENGINE_TEST_SMF_BUILDER_H_
+#define PLAYMIDIFILE_MIDI_ENGINE_TEST_SMF_BUILDER_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace playmidifile {
+namespace testing {
+
+// Assembles Standard MIDI Files in memory for tests. Events are appended to
+// the track opened by the most recent BeginTrack().
+class SmfBuilder {
+ public:
+  explicit SmfBuilder(uint16_t format = 1, uint16_t division = 480)
+      : format_(format), division_(division) {}
+
+  SmfBuilder& BeginTrack() {
+    tracks_.emplace_back();
+    return *this;
+  }
+
+  // Appends |delta| followed by |bytes| verbatim, so tests can exercise
+  // running status and malformed data.
+  SmfBuilder& Raw(uint32_t delta, std::initializer_list<uint8_t> bytes) {
+    WriteVarLen(delta);
+    current().insert(current().end(), bytes.begin(), bytes.end());
+    return *this;
+  }
+
+  SmfBuilder& NoteOn(uint32_t delta, uint8_t channel, uint8_t note,
+                     uint8_t velocity) {
+    return Raw(delta, {static_cast<uint8_t>(0x90 | channel), note, velocity});
+  }
+
+  SmfBuilder& NoteOff(uint32_t delta, uint8_t channel, uint8_t note) {
+    return Raw(delta, {static_cast<uint8_t>(0x80 | channel), note, 0});
+  }
+
+  SmfBuilder& ControlChange(uint32_t delta, uint8_t channel, uint8_t control,
+                            uint8_t value) {
+    return Raw(delta, {static_cast<uint8_t>(0xB0 | channel), control, value});
+  }
+
+  SmfBuilder& ProgramChange(uint32_t delta, uint8_t channel,
+                            uint8_t program) {
+    return Raw(delta, {static_cast<uint8_t>(0xC0 | channel), program});
+  }
+
+  SmfBuilder& PitchBend(uint32_t delta, uint8_t channel, uint16_t value) {
+    return Raw(delta, {static_cast<uint8_t>(0xE0 | channel),
+                       static_cast<uint8_t>(value & 0x7F),
+                       static_cast<uint8_t>((value >> 7) & 0x7F)});
+  }
+
+  SmfBuilder& Tempo(uint32_t delta, uint32_t micros_per_quarter) {
+    return Raw(delta, {0xFF, 0x51, 0x03,
+                       static_cast<uint8_t>(micros_per_quarter >> 16),
+                       static_cast<uint8_t>(micros_per_quarter >> 8),
+                       static_cast<uint8_t>(micros_per_quarter)});
+  }
+
+  SmfBuilder& SysEx(uint32_t delta, const std::vector<uint8_t>& body) {
+    WriteVarLen(delta);
+    current().push_back(0xF0);
+    WriteVarLen(static_cast<uint32_t>(body.size()));
+    current().insert(current().end(), body.begin(), body.end());
+    return *this;
+  }
+
+  SmfBuilder& EndTrack(uint32_t delta = 0) {
+    return Raw(delta, {0xFF, 0x2F, 0x00});
+  }
+
+  std::vector<uint8_t> Build() const {
+    std::vector<uint8_t> out = {'M', 'T', 'h', 'd', 0, 0, 0, 6};
+    Write16(&out, format_);
+    Write16(&out, static_cast<uint16_t>(tracks_.size()));
+    Write16(&out, division_);
+    for (const std::vector<uint8_t>& track : tracks_) {
+      out.insert(out.end(), {'M', 'T', 'r', 'k'});
+      Write32(&out, static_cast<uint32_t>(track.size()));
+      out.insert(out.end(), track.begin(), track.end());
+    }
+    return out;
+  }
+
+ private:
+  std::vector<uint8_t>& current() { return tracks_.back(); }
+
+  void WriteVarLen(uint32_t value) {
+    uint8_t buffer[4];
+    int count = 0;
+    do {
+      buffer[count++] = static_cast<uint8_t>(value & 0x7F);
+      value >>= 7;
+    } while (value != 0);
+    while (count > 1) {
+      current().push_back(buffer[--count] | 0x80);
+    }
+    current().push_back(buffer[0]);
+  }
+
+  static void Write16(std::vector<uint8_t>* out, uint16_t value) {
+    out->push_back(static_cast<uint8_t>(value >> 8));
+    out->push_back(static_cast<uint8_t>(value));
+  }
+
+  static void Write32(std::vector<uint8_t>* out, uint32_t value) {
+    Write16(out, static_cast<uint16_t>(value >> 16));
+    Write16(out, static_cast<uint16_t>(value));
+  }
+
+  uint16_t format_;
+  uint16_t division_;
+  std::vector<std::vector<uint8_t>> tracks_;
+};
+
+// Writes |bytes| to a file in the temp directory and returns its path.
+inline std::string WriteTempFile(const std::string& name,
+                                 const std::vector<uint8_t>& bytes) {
+#ifdef _WIN32
+  const char* dir = std::getenv("TEMP");
+  std::string path = std::string(dir ? dir : ".") + "\\" + name;
+#else
+  std::string path = "/tmp/" + name;
+#endif
+  FILE* file = std::fopen(path.c_str(), "wb");
+  if (file) {
+    std::fwrite(bytes.data(), 1, bytes.size(), file);
+    std::fclose(file);
+  }
+  return path;
+}
+
+}  // namespace testing
+}  // namespace playmidifile
+
+#endif  // PLAYMIDIFILE_MIDI_ENGINE_TEST_SMF_BUILDER_H_
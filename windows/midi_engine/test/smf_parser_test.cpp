@@ -0,0 +1,176 @@
+#include "midi_engine/smf_parser.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::SmfBuilder;
+
+std::vector<MidiEvent> ReadAll(const SmfTrack& track, bool* failed) {
+  std::vector<MidiEvent> events;
+  TrackReader reader(track);
+  MidiEvent event;
+  while (reader.Next(&event)) {
+    events.push_back(event);
+  }
+  *failed = reader.failed();
+  return events;
+}
+
+TEST(SmfParserTest, ParsesHeaderAndTracks) {
+  std::vector<uint8_t> data = SmfBuilder(1, 96)
+                                  .BeginTrack()
+                                  .Tempo(0, 600000)
+                                  .EndTrack()
+                                  .BeginTrack()
+                                  .NoteOn(0, 0, 60, 100)
+                                  .NoteOff(96, 0, 60)
+                                  .EndTrack()
+                                  .Build();
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  EXPECT_EQ(file.header.format, 1);
+  EXPECT_EQ(file.header.track_count, 2);
+  EXPECT_EQ(file.header.division, 96);
+  EXPECT_FALSE(file.header.is_smpte());
+  ASSERT_EQ(file.tracks.size(), 2u);
+  // Tracks are views into the source buffer, not copies.
+  EXPECT_GT(file.tracks[0].data, data.data());
+  EXPECT_LT(file.tracks[1].data + file.tracks[1].size,
+            data.data() + data.size() + 1);
+}
+
+TEST(SmfParserTest, DecodesRunningStatus) {
+  std::vector<uint8_t> data = SmfBuilder(0)
+                                  .BeginTrack()
+                                  .Raw(0, {0x91, 60, 100})
+                                  .Raw(10, {64, 90})
+                                  .Raw(10, {67, 80})
+                                  .Raw(10, {0xC1, 5})
+                                  .Raw(0, {6})
+                                  .EndTrack()
+                                  .Build();
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  bool failed = true;
+  std::vector<MidiEvent> events = ReadAll(file.tracks[0], &failed);
+  EXPECT_FALSE(failed);
+  ASSERT_EQ(events.size(), 6u);
+  EXPECT_EQ(events[1].status, 0x91);
+  EXPECT_EQ(events[1].data1, 64);
+  EXPECT_EQ(events[1].data2, 90);
+  EXPECT_EQ(events[2].delta_ticks, 10u);
+  EXPECT_EQ(events[2].data1, 67);
+  EXPECT_EQ(events[4].status, 0xC1);
+  EXPECT_EQ(events[4].data1, 6);
+  EXPECT_EQ(events[4].data2, 0);
+  EXPECT_EQ(events[5].type, MidiEventType::kMeta);
+  EXPECT_EQ(events[5].data1, kMetaEndOfTrack);
+}
+
+TEST(SmfParserTest, DecodesSysExAndMetaPayloadsInPlace) {
+  std::vector<uint8_t> data = SmfBuilder(0)
+                                  .BeginTrack()
+                                  .SysEx(0, {0x7E, 0x7F, 0x09, 0x01, 0xF7})
+                                  .Tempo(0x81, 400000)
+                                  .EndTrack()
+                                  .Build();
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  bool failed = true;
+  std::vector<MidiEvent> events = ReadAll(file.tracks[0], &failed);
+  EXPECT_FALSE(failed);
+  ASSERT_EQ(events.size(), 3u);
+  EXPECT_EQ(events[0].type, MidiEventType::kSysEx);
+  EXPECT_EQ(events[0].status, 0xF0);
+  ASSERT_EQ(events[0].payload_size, 5u);
+  EXPECT_EQ(events[0].payload[0], 0x7E);
+  EXPECT_EQ(events[0].payload[4], 0xF7);
+  EXPECT_GE(events[0].payload, data.data());
+  EXPECT_LT(events[0].payload, data.data() + data.size());
+  EXPECT_EQ(events[1].type, MidiEventType::kMeta);
+  EXPECT_EQ(events[1].data1, kMetaTempo);
+  EXPECT_EQ(events[1].delta_ticks, 0x81u);
+  ASSERT_EQ(events[1].payload_size, 3u);
+  EXPECT_EQ(events[1].payload[0], 0x06);
+}
+
+TEST(SmfParserTest, SkipsUnknownChunks) {
+  std::vector<uint8_t> data = SmfBuilder(0)
+                                  .BeginTrack()
+                                  .NoteOn(0, 0, 60, 100)
+                                  .EndTrack()
+                                  .Build();
+  // Splice an unknown chunk between the header and the track.
+  std::vector<uint8_t> junk = {'X', 'F', 'I', 'H', 0, 0, 0, 2, 0xAA, 0xBB};
+  data.insert(data.begin() + 14, junk.begin(), junk.end());
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  ASSERT_EQ(file.tracks.size(), 1u);
+  EXPECT_EQ(file.tracks[0].data[1], 0x90);
+}
+
+TEST(SmfParserTest, RejectsInvalidFiles) {
+  SmfFile file;
+  std::string error;
+  std::vector<uint8_t> not_midi = {'R', 'I', 'F', 'F', 0, 0, 0, 0,
+                                   0,   0,   0,   0,   0, 0};
+  EXPECT_FALSE(ParseSmf(not_midi.data(), not_midi.size(), &file, &error));
+  EXPECT_FALSE(error.empty());
+
+  std::vector<uint8_t> format2 =
+      SmfBuilder(2).BeginTrack().EndTrack().Build();
+  EXPECT_FALSE(ParseSmf(format2.data(), format2.size(), &file, &error));
+
+  std::vector<uint8_t> no_tracks = SmfBuilder(1).Build();
+  EXPECT_FALSE(ParseSmf(no_tracks.data(), no_tracks.size(), &file, &error));
+
+  // SMPTE timing with no ticks per frame would divide by zero.
+  std::vector<uint8_t> no_ticks =
+      SmfBuilder(0, 0xE700).BeginTrack().EndTrack().Build();
+  EXPECT_FALSE(ParseSmf(no_ticks.data(), no_ticks.size(), &file, &error));
+  EXPECT_EQ(error, "Invalid MIDI time division");
+}
+
+TEST(SmfParserTest, FlagsMalformedTrackData) {
+  // A data byte with no preceding status byte.
+  std::vector<uint8_t> data =
+      SmfBuilder(0).BeginTrack().Raw(0, {60, 100}).EndTrack().Build();
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  bool failed = false;
+  ReadAll(file.tracks[0], &failed);
+  EXPECT_TRUE(failed);
+
+  // A meta event whose length runs past the end of the chunk.
+  data = SmfBuilder(0).BeginTrack().Raw(0, {0xFF, 0x01, 0x20, 'a'}).Build();
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  ReadAll(file.tracks[0], &failed);
+  EXPECT_TRUE(failed);
+}
+
+TEST(SmfParserTest, ToleratesMissingEndOfTrack) {
+  std::vector<uint8_t> data =
+      SmfBuilder(0).BeginTrack().NoteOn(0, 0, 60, 100).Build();
+  SmfFile file;
+  std::string error;
+  ASSERT_TRUE(ParseSmf(data.data(), data.size(), &file, &error)) << error;
+  bool failed = true;
+  std::vector<MidiEvent> events = ReadAll(file.tracks[0], &failed);
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(events.size(), 1u);
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,100 @@
+#include "midi_engine/soundfont_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#include "sf2_builder.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::Sf2Builder;
+using testing::WriteTempFile;
+
+std::vector<uint8_t> FontBytes(size_t sample_frames) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample;
+  sample.data.assign(sample_frames, 1000);
+  builder.SimplePreset(0, 0, builder.AddSample(sample), {});
+  return builder.Build();
+}
+
+// Moves |from| over |to| in one step, as an editor saving a file does.
+bool MoveOver(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+  return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+class SoundFontCacheTest : public ::testing::Test {
+ protected:
+  // A file per test, so that tests run in parallel processes do not share
+  // one.
+  void SetUp() override {
+    name_ = std::string("soundfont_cache_test_") +
+            ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    path_ = WriteTempFile(name_ + ".sf2", FontBytes(64));
+  }
+  void TearDown() override { std::remove(path_.c_str()); }
+
+  std::string name_;
+  std::string path_;
+  SoundFontCache cache_;
+};
+
+TEST_F(SoundFontCacheTest, SharesOneFontBetweenUsers) {
+  std::string error;
+  std::shared_ptr<const SoundFont> first = cache_.Open(path_, &error);
+  ASSERT_TRUE(first) << error;
+  std::shared_ptr<const SoundFont> second = cache_.Open(path_, &error);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(cache_.open_fonts(), 1u);
+}
+
+TEST_F(SoundFontCacheTest, ClosesFontWithItsLastUser) {
+  std::string error;
+  std::shared_ptr<const SoundFont> font = cache_.Open(path_, &error);
+  ASSERT_TRUE(font) << error;
+  std::weak_ptr<const SoundFont> weak = font;
+  font.reset();
+  EXPECT_TRUE(weak.expired());
+  EXPECT_EQ(cache_.open_fonts(), 0u);
+
+  font = cache_.Open(path_, &error);
+  ASSERT_TRUE(font) << error;
+  EXPECT_EQ(cache_.open_fonts(), 1u);
+}
+
+TEST_F(SoundFontCacheTest, ReopensChangedFile) {
+  std::string error;
+  std::shared_ptr<const SoundFont> before = cache_.Open(path_, &error);
+  ASSERT_TRUE(before) << error;
+  // |before| still maps the file, so it is replaced rather than rewritten.
+  std::string changed = WriteTempFile(name_ + "_changed.sf2", FontBytes(128));
+  ASSERT_TRUE(MoveOver(changed, path_));
+  std::shared_ptr<const SoundFont> after = cache_.Open(path_, &error);
+  ASSERT_TRUE(after) << error;
+  EXPECT_NE(before, after);
+  EXPECT_EQ(after->sample_count(), 128u + 46u);
+}
+
+TEST_F(SoundFontCacheTest, ReportsMissingFile) {
+  std::string error;
+  EXPECT_FALSE(cache_.Open("/nonexistent/font.sf2", &error));
+  EXPECT_EQ(error, "File not found");
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,245 @@
+#include "midi_engine/soundfont.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "midi_engine/midi_file.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/synthesizer.h"
+#include "sf2_builder.h"
+#include "smf_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::Sf2Builder;
+using testing::WriteTempFile;
+namespace sf2 = testing::sf2;
+
+std::unique_ptr<SoundFont> ParseFont(const Sf2Builder& builder) {
+  std::vector<uint8_t> data = builder.Build();
+  std::string error;
+  std::unique_ptr<SoundFont> font =
+      SoundFont::Parse(data.data(), data.size(), &error);
+  EXPECT_TRUE(font) << error;
+  return font;
+}
+
+Sf2Builder::Sample Ramp(size_t size) {
+  Sf2Builder::Sample sample;
+  for (size_t i = 0; i < size; ++i) {
+    sample.data.push_back(static_cast<int16_t>(i * 10));
+  }
+  return sample;
+}
+
+TEST(SoundFontTest, ResolvesRegionFromSampleAndGenerators) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(200);
+  sample.sample_rate = 22050;
+  sample.root_key = 57;
+  sample.pitch_correction = -5;
+  sample.loop_start = 50;
+  sample.loop_end = 150;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 5, id,
+                       {{sf2::kKeyRange, sf2::Range(40, 80)},
+                        {sf2::kVelRange, sf2::Range(10, 100)},
+                        {sf2::kCoarseTune, 2},
+                        {sf2::kFineTune, static_cast<uint16_t>(-20)},
+                        {sf2::kInitialAttenuation, 60},
+                        {sf2::kPan, static_cast<uint16_t>(-250)},
+                        {sf2::kSampleModes, 1},
+                        {sf2::kAttackVolEnv, 1200},
+                        {sf2::kSustainVolEnv, 100},
+                        {sf2::kStartAddrsOffset, 10},
+                        {sf2::kEndAddrsOffset, static_cast<uint16_t>(-20)}});
+  std::unique_ptr<SoundFont> font = ParseFont(builder);
+  ASSERT_TRUE(font);
+  ASSERT_EQ(font->presets().size(), 1u);
+  const SoundFontPreset& preset = font->presets()[0];
+  EXPECT_EQ(preset.name, "preset5");
+  EXPECT_EQ(preset.program, 5);
+  ASSERT_EQ(preset.regions.size(), 1u);
+
+  const SoundFontRegion& region = preset.regions[0];
+  EXPECT_EQ(region.key_low, 40);
+  EXPECT_EQ(region.key_high, 80);
+  EXPECT_EQ(region.velocity_low, 10);
+  EXPECT_EQ(region.velocity_high, 100);
+  EXPECT_TRUE(region.Matches(60, 64));
+  EXPECT_FALSE(region.Matches(30, 64));
+  EXPECT_FALSE(region.Matches(60, 120));
+  EXPECT_EQ(region.start, 10u);
+  EXPECT_EQ(region.end, 180u);
+  EXPECT_EQ(region.loop_start, 50u);
+  EXPECT_EQ(region.loop_end, 150u);
+  EXPECT_EQ(region.loop_mode, LoopMode::kContinuous);
+  EXPECT_EQ(region.sample_rate, 22050u);
+  EXPECT_EQ(region.root_key, 57);
+  EXPECT_EQ(region.tune, 200 - 20 - 5);
+  EXPECT_EQ(region.attenuation, 60);
+  EXPECT_EQ(region.pan, -250);
+  EXPECT_EQ(region.envelope.attack, 1200);
+  EXPECT_EQ(region.envelope.sustain, 100);
+  EXPECT_EQ(region.envelope.release, -12000);
+
+  ASSERT_EQ(font->sample_count(), 200u + 46u);
+  EXPECT_EQ(font->samples()[199], 1990);
+}
+
+TEST(SoundFontTest, CombinesGlobalZonesAndPresetLevel) {
+  Sf2Builder builder;
+  int low = builder.AddSample(Ramp(64));
+  Sf2Builder::Sample high_sample = Ramp(64);
+  high_sample.root_key = 72;
+  int high = builder.AddSample(high_sample);
+  int instrument = builder.BeginInstrument("split");
+  builder.InstrumentZone(-1, {{sf2::kInitialAttenuation, 30},
+                              {sf2::kOverridingRootKey, 48}})
+      .InstrumentZone(low, {{sf2::kKeyRange, sf2::Range(0, 59)}})
+      .InstrumentZone(high, {{sf2::kKeyRange, sf2::Range(60, 127)},
+                             {sf2::kOverridingRootKey,
+                              static_cast<uint16_t>(-1)}});
+  builder.BeginPreset("piano", 8, 1);
+  builder.PresetZone(-1, {{sf2::kInitialAttenuation, 20}})
+      .PresetZone(instrument, {{sf2::kKeyRange, sf2::Range(50, 70)},
+                               {sf2::kCoarseTune, 1}});
+  std::unique_ptr<SoundFont> font = ParseFont(builder);
+  ASSERT_TRUE(font);
+  const std::vector<SoundFontRegion>& regions = font->presets()[0].regions;
+  ASSERT_EQ(regions.size(), 2u);
+  // Key ranges intersect; preset attenuation and tuning add.
+  EXPECT_EQ(regions[0].key_low, 50);
+  EXPECT_EQ(regions[0].key_high, 59);
+  EXPECT_EQ(regions[0].attenuation, 50);
+  EXPECT_EQ(regions[0].tune, 100);
+  EXPECT_EQ(regions[0].root_key, 48);
+  EXPECT_EQ(regions[1].key_low, 60);
+  EXPECT_EQ(regions[1].key_high, 70);
+  // -1 falls back to the sample's own pitch.
+  EXPECT_EQ(regions[1].root_key, 72);
+}
+
+TEST(SoundFontTest, FindPresetFallsBack) {
+  Sf2Builder builder;
+  int id = builder.AddSample(Ramp(64));
+  builder.SimplePreset(0, 0, id);
+  builder.SimplePreset(0, 40, id);
+  builder.SimplePreset(128, 0, id);
+  std::unique_ptr<SoundFont> font = ParseFont(builder);
+  ASSERT_TRUE(font);
+  EXPECT_EQ(font->FindPreset(0, 40)->program, 40);
+  // Unknown bank: same program in bank 0.
+  EXPECT_EQ(font->FindPreset(5, 40)->bank, 0);
+  EXPECT_EQ(font->FindPreset(5, 40)->program, 40);
+  EXPECT_EQ(font->FindPreset(128, 0)->bank, 128);
+  // Unknown program: the first preset.
+  EXPECT_EQ(font->FindPreset(0, 99), &font->presets()[0]);
+}
+
+TEST(SoundFontTest, DropsInvalidLoops) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_start = 40;
+  sample.loop_end = 90;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 0, id, {{sf2::kSampleModes, 1}});
+  std::unique_ptr<SoundFont> font = ParseFont(builder);
+  ASSERT_TRUE(font);
+  EXPECT_EQ(font->presets()[0].regions[0].loop_mode, LoopMode::kNone);
+}
+
+TEST(SoundFontTest, RejectsMalformedFiles) {
+  std::string error;
+  std::vector<uint8_t> not_riff = {'M', 'T', 'h', 'd', 0, 0, 0, 6};
+  EXPECT_FALSE(SoundFont::Parse(not_riff.data(), not_riff.size(), &error));
+  EXPECT_EQ(error, "Not a SoundFont 2 file");
+
+  std::vector<uint8_t> truncated = Sf2Builder().Build();
+  truncated.resize(truncated.size() - 60);
+  EXPECT_FALSE(SoundFont::Parse(truncated.data(), truncated.size(), &error));
+  EXPECT_EQ(error.find("Malformed SoundFont"), 0u) << error;
+
+  EXPECT_FALSE(SoundFont::Open("/nonexistent/font.sf2", &error));
+  EXPECT_EQ(error, "File not found");
+}
+
+// Programs 0 and 1, each with its own sample.
+Sf2Builder TwoPresets() {
+  Sf2Builder builder;
+  builder.SimplePreset(0, 0, builder.AddSample(Ramp(5000)), {});
+  builder.SimplePreset(0, 1, builder.AddSample(Ramp(7000)), {});
+  return builder;
+}
+
+TEST(SoundFontTest, OpenedFontPlaysSamplesFromTheMapping) {
+  std::vector<uint8_t> data = TwoPresets().Build();
+  std::string path = WriteTempFile("mapped.sf2", data);
+  std::string error;
+  std::unique_ptr<SoundFont> font = SoundFont::Open(path, &error);
+  std::remove(path.c_str());
+  ASSERT_TRUE(font) << error;
+  std::unique_ptr<SoundFont> parsed =
+      SoundFont::Parse(data.data(), data.size(), &error);
+  ASSERT_TRUE(parsed) << error;
+
+  EXPECT_TRUE(font->mapped());
+  EXPECT_FALSE(parsed->mapped());
+  ASSERT_EQ(font->sample_count(), parsed->sample_count());
+  for (size_t i = 0; i < font->sample_count(); ++i) {
+    ASSERT_EQ(font->samples()[i], parsed->samples()[i]) << i;
+  }
+
+  // Nothing is paged in until a preset is used, and then only once.
+  EXPECT_EQ(font->prepared_presets(), 0u);
+  font->PrepareSamples(font->presets()[1]);
+  font->PrepareSamples(font->presets()[1]);
+  EXPECT_EQ(font->prepared_presets(), 1u);
+  parsed->PrepareSamples(parsed->presets()[1]);
+  EXPECT_EQ(parsed->prepared_presets(), 0u);
+}
+
+TEST(SoundFontTest, SequencesArePreparedBeforeTheSynthesizerPlaysThem) {
+  std::string path = WriteTempFile("programs.sf2", TwoPresets().Build());
+  std::string error;
+  std::shared_ptr<const SoundFont> font = SoundFont::Open(path, &error);
+  std::remove(path.c_str());
+  ASSERT_TRUE(font) << error;
+  std::string midi_path = WriteTempFile(
+      "programs.mid", testing::SmfBuilder()
+                          .BeginTrack()
+                          .ProgramChange(0, 3, 1)
+                          .NoteOn(0, 3, 60, 100)
+                          .EndTrack()
+                          .Build());
+  std::unique_ptr<MidiFile> file = MidiFile::Open(midi_path, &error);
+  std::remove(midi_path.c_str());
+  ASSERT_TRUE(file) << error;
+  std::shared_ptr<const Sequence> sequence = Sequence::Compile(*file);
+
+  // The synthesizer itself never pages samples in: it only notes presets
+  // selected unprepared, program 0 on every channel here.
+  {
+    Synthesizer synth(font, 44100);
+    EXPECT_EQ(font->prepared_presets(), 0u);
+    EXPECT_EQ(synth.unprepared_presets(), 16u);
+  }
+
+  // Every channel starts on program 0, percussion included; program 1 is
+  // the one the file selects.
+  Synthesizer::PrepareSamples(*font, *sequence);
+  EXPECT_EQ(font->prepared_presets(), 2u);
+  EXPECT_TRUE(font->samples_prepared(*font->FindPreset(0, 1)));
+  Synthesizer synth(font, 44100);
+  synth.SendChannelMessage(0xC3, 1, 0);
+  EXPECT_EQ(synth.unprepared_presets(), 0u);
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,84 @@
+#include "midi_engine/spsc_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace playmidifile {
+namespace {
+
+TEST(SpscQueueTest, RoundsCapacityUpToPowerOfTwo) {
+  SpscQueue<int> queue(5);
+  EXPECT_EQ(queue.capacity(), 8u);
+}
+
+TEST(SpscQueueTest, PushesAndPopsInOrderAcrossWrapAround) {
+  SpscQueue<int> queue(4);
+  int value = 0;
+  EXPECT_FALSE(queue.TryPop(&value));
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 4; ++i) {
+      int item = round * 10 + i;
+      EXPECT_TRUE(queue.TryPush(std::move(item)));
+    }
+    int overflow = -1;
+    EXPECT_FALSE(queue.TryPush(std::move(overflow)));
+    EXPECT_EQ(overflow, -1);
+    EXPECT_EQ(queue.SizeApprox(), 4u);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.TryPop(&value));
+      EXPECT_EQ(value, round * 10 + i);
+    }
+    EXPECT_FALSE(queue.TryPop(&value));
+  }
+}
+
+TEST(SpscQueueTest, MovesOwnershipThroughTheRing) {
+  SpscQueue<std::unique_ptr<std::string>> queue(2);
+  EXPECT_TRUE(queue.TryPush(std::make_unique<std::string>("note")));
+  std::unique_ptr<std::string> out;
+  ASSERT_TRUE(queue.TryPop(&out));
+  ASSERT_TRUE(out);
+  EXPECT_EQ(*out, "note");
+}
+
+// Streams items between two threads and checks nothing is lost or
+// reordered. Also reports throughput for reference.
+TEST(SpscQueueTest, TransfersBetweenThreadsInOrder) {
+  constexpr uint64_t kItems = 2000000;
+  SpscQueue<uint64_t> queue(1024);
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&queue] {
+    for (uint64_t i = 0; i < kItems; ++i) {
+      uint64_t item = i;
+      while (!queue.TryPush(std::move(item))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+  uint64_t expected = 0;
+  bool in_order = true;
+  while (expected < kItems) {
+    uint64_t value;
+    if (queue.TryPop(&value)) {
+      in_order = in_order && value == expected;
+      ++expected;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  EXPECT_TRUE(in_order);
+  RecordProperty("items_per_second",
+                 std::to_string(static_cast<uint64_t>(kItems / seconds)));
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,147 @@
+#include "midi_engine/synth_kernels.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "midi_engine/synthesizer.h"
+#include "sf2_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::Sf2Builder;
+namespace sf2 = testing::sf2;
+
+const SimdLevel kAllLevels[] = {SimdLevel::kScalar, SimdLevel::kSse2,
+                                SimdLevel::kAvx2};
+
+// Lengths around the vector widths, so every tail size is covered.
+const size_t kLengths[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 128, 1001};
+
+std::vector<float> RandomFloats(std::mt19937* random, size_t count, float low,
+                                float high) {
+  std::uniform_real_distribution<float> distribution(low, high);
+  std::vector<float> values(count);
+  for (float& value : values) {
+    value = distribution(*random);
+  }
+  return values;
+}
+
+bool BitEqual(const std::vector<float>& a, const std::vector<float>& b) {
+  return a.size() == b.size() &&
+         std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+TEST(SynthKernelsTest, DetectedLevelIsSupported) {
+  EXPECT_TRUE(IsSimdLevelSupported(SimdLevel::kScalar));
+  SimdLevel level = DetectSimdLevel();
+  EXPECT_TRUE(IsSimdLevelSupported(level));
+  EXPECT_EQ(GetSynthKernels(level).level, level);
+}
+
+TEST(SynthKernelsTest, VectorKernelsMatchScalarBitForBit) {
+  const SynthKernels& scalar = GetSynthKernels(SimdLevel::kScalar);
+  std::mt19937 random(7);
+  for (SimdLevel level : kAllLevels) {
+    if (!IsSimdLevelSupported(level)) {
+      continue;
+    }
+    const SynthKernels& kernels = GetSynthKernels(level);
+    for (size_t frames : kLengths) {
+      SCOPED_TRACE(std::string(kernels.name) + " " + std::to_string(frames));
+      std::vector<float> s0 = RandomFloats(&random, frames, -32768, 32767);
+      std::vector<float> s1 = RandomFloats(&random, frames, -32768, 32767);
+      std::vector<float> fraction = RandomFloats(&random, frames, 0, 1);
+      std::vector<float> envelope = RandomFloats(&random, frames, 0, 1);
+      std::vector<float> mix = RandomFloats(&random, frames * 2, -1, 1);
+
+      std::vector<float> expected(frames);
+      std::vector<float> actual(frames);
+      scalar.interpolate(s0.data(), s1.data(), fraction.data(),
+                         1.0f / 32768.0f, expected.data(), frames);
+      kernels.interpolate(s0.data(), s1.data(), fraction.data(),
+                          1.0f / 32768.0f, actual.data(), frames);
+      EXPECT_TRUE(BitEqual(actual, expected));
+
+      scalar.apply_envelope(expected.data(), envelope.data(), frames);
+      kernels.apply_envelope(actual.data(), envelope.data(), frames);
+      EXPECT_TRUE(BitEqual(actual, expected));
+
+      std::vector<float> expected_mix = mix;
+      std::vector<float> actual_mix = mix;
+      scalar.mix_stereo(expected.data(), 0.3f, 0.9f, expected_mix.data(),
+                        frames);
+      kernels.mix_stereo(actual.data(), 0.3f, 0.9f, actual_mix.data(),
+                         frames);
+      EXPECT_TRUE(BitEqual(actual_mix, expected_mix));
+    }
+  }
+}
+
+// Plays a chord with bends, pans, envelopes, a one-shot sample and releases
+// at |level| and returns the output.
+std::vector<float> RenderChord(SimdLevel level) {
+  Sf2Builder builder;
+  Sf2Builder::Sample looped;
+  for (int i = 0; i < 100; ++i) {
+    looped.data.push_back(
+        static_cast<int16_t>(16000 * std::sin(2 * 3.14159265358979 * i / 100)));
+  }
+  looped.loop_end = 100;
+  int looped_id = builder.AddSample(looped);
+  builder.SimplePreset(0, 0, looped_id,
+                       {{sf2::kAttackVolEnv, static_cast<uint16_t>(-7973)},
+                        {sf2::kDecayVolEnv, static_cast<uint16_t>(-2400)},
+                        {sf2::kSustainVolEnv, 120},
+                        {sf2::kReleaseVolEnv, static_cast<uint16_t>(-2786)},
+                        {sf2::kSampleModes, 1}});
+  Sf2Builder::Sample one_shot = looped;
+  one_shot.loop_end = 0;
+  int one_shot_id = builder.AddSample(one_shot);
+  builder.SimplePreset(0, 1, one_shot_id, {});
+  std::vector<uint8_t> data = builder.Build();
+  std::string error;
+  std::shared_ptr<const SoundFont> font =
+      SoundFont::Parse(data.data(), data.size(), &error);
+  EXPECT_TRUE(font) << error;
+
+  Synthesizer synth(font, 48000);
+  synth.SetSimdLevel(level);
+  EXPECT_EQ(synth.simd_level(), level);
+  synth.SendChannelMessage(0xC1, 1, 0);
+  for (uint8_t i = 0; i < 12; ++i) {
+    uint8_t channel = i % 2;
+    synth.SendChannelMessage(0xB0 | channel, 10, i * 10);
+    synth.SendChannelMessage(0x90 | channel, 48 + i * 3, 60 + i * 5);
+  }
+  std::vector<float> output(48000 * 2);
+  synth.Render(output.data(), 1001);
+  synth.SendChannelMessage(0xE0, 0x11, 0x50);
+  synth.Render(output.data() + 1001 * 2, 9000);
+  for (uint8_t i = 0; i < 12; i += 2) {
+    synth.SendChannelMessage(0x80, 48 + i * 3, 0);
+  }
+  synth.Render(output.data() + 10001 * 2, 48000 - 10001);
+  return output;
+}
+
+TEST(SynthKernelsTest, SynthesizerOutputIsIdenticalAtEveryLevel) {
+  std::vector<float> expected = RenderChord(SimdLevel::kScalar);
+  for (SimdLevel level : kAllLevels) {
+    if (IsSimdLevelSupported(level)) {
+      SCOPED_TRACE(GetSynthKernels(level).name);
+      EXPECT_TRUE(BitEqual(RenderChord(level), expected));
+    }
+  }
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -0,0 +1,360 @@
+#include "midi_engine/synthesizer.h"
+
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sf2_builder.h"
+
+namespace playmidifile {
+namespace {
+
+using testing::Sf2Builder;
+namespace sf2 = testing::sf2;
+
+constexpr uint32_t kRate = 44100;
+constexpr float kCentrePan = 0.70710678f;
+constexpr float kTolerance = 1e-5f;
+constexpr uint16_t kNoTime = 0x8000;  // -32768 timecents.
+
+// Envelope that is at full level from the first sample.
+const Sf2Builder::Generators kInstantEnvelope = {{sf2::kDelayVolEnv, kNoTime},
+                                                 {sf2::kAttackVolEnv, kNoTime},
+                                                 {sf2::kHoldVolEnv, kNoTime},
+                                                 {sf2::kDecayVolEnv, kNoTime}};
+
+Sf2Builder::Generators WithInstantEnvelope(Sf2Builder::Generators extra) {
+  Sf2Builder::Generators generators = kInstantEnvelope;
+  generators.insert(generators.end(), extra.begin(), extra.end());
+  return generators;
+}
+
+// A sample whose values are easy to predict: 100 * (i + 1).
+Sf2Builder::Sample Ramp(size_t size) {
+  Sf2Builder::Sample sample;
+  for (size_t i = 0; i < size; ++i) {
+    sample.data.push_back(static_cast<int16_t>(100 * (i + 1)));
+  }
+  return sample;
+}
+
+float RampValue(double position) {
+  return static_cast<float>(100.0 * (position + 1.0) / 32768.0);
+}
+
+std::shared_ptr<const SoundFont> BuildFont(const Sf2Builder& builder) {
+  std::vector<uint8_t> data = builder.Build();
+  std::string error;
+  std::shared_ptr<const SoundFont> font =
+      SoundFont::Parse(data.data(), data.size(), &error);
+  EXPECT_TRUE(font) << error;
+  return font;
+}
+
+class SynthesizerTest : public ::testing::Test {
+ protected:
+  // One preset (program 0) playing a 64-frame ramp at root key 60.
+  void UseRamp(const Sf2Builder::Generators& generators,
+               Sf2Builder::Sample sample = Ramp(64)) {
+    Sf2Builder builder;
+    int id = builder.AddSample(sample);
+    builder.SimplePreset(0, 0, id, generators);
+    synth_.reset(new Synthesizer(BuildFont(builder), kRate));
+    // Full channel volume so the channel gain is 1.
+    synth_->SendChannelMessage(0xB0, 7, 127);
+  }
+
+  std::vector<float> Render(size_t frames) {
+    std::vector<float> buffer(frames * 2, -1.0f);
+    synth_->Render(buffer.data(), frames);
+    return buffer;
+  }
+
+  std::unique_ptr<Synthesizer> synth_;
+};
+
+TEST_F(SynthesizerTest, PlaysSampleAtRootKeyUnchanged) {
+  UseRamp(kInstantEnvelope);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  EXPECT_EQ(synth_->active_voices(), 1);
+  std::vector<float> out = Render(80);
+  for (size_t i = 0; i < 64; ++i) {
+    ASSERT_NEAR(out[i * 2], RampValue(i) * kCentrePan, kTolerance) << i;
+    ASSERT_NEAR(out[i * 2 + 1], RampValue(i) * kCentrePan, kTolerance) << i;
+  }
+  // Unlooped: the voice ends with the sample.
+  for (size_t i = 64; i < 80; ++i) {
+    ASSERT_EQ(out[i * 2], 0.0f) << i;
+  }
+  EXPECT_EQ(synth_->active_voices(), 0);
+}
+
+TEST_F(SynthesizerTest, ResamplesForPitchAndSampleRate) {
+  // An octave up reads every other frame.
+  UseRamp(kInstantEnvelope);
+  synth_->SendChannelMessage(0x90, 72, 127);
+  std::vector<float> out = Render(16);
+  for (size_t i = 0; i < 16; ++i) {
+    ASSERT_NEAR(out[i * 2], RampValue(i * 2) * kCentrePan, kTolerance) << i;
+  }
+
+  // A 22050 Hz sample at its root key advances half a frame per output
+  // frame, linearly interpolated.
+  Sf2Builder::Sample slow = Ramp(64);
+  slow.sample_rate = kRate / 2;
+  UseRamp(kInstantEnvelope, slow);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  out = Render(16);
+  for (size_t i = 0; i < 16; ++i) {
+    ASSERT_NEAR(out[i * 2], RampValue(i * 0.5) * kCentrePan, kTolerance)
+        << i;
+  }
+}
+
+TEST_F(SynthesizerTest, LoopsBetweenLoopPoints) {
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_start = 16;
+  sample.loop_end = 48;
+  UseRamp(WithInstantEnvelope({{sf2::kSampleModes, 1}}), sample);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  std::vector<float> out = Render(200);
+  for (size_t i = 0; i < 200; ++i) {
+    size_t position = i < 48 ? i : 16 + (i - 48) % 32;
+    ASSERT_NEAR(out[i * 2], RampValue(position) * kCentrePan, kTolerance)
+        << i;
+  }
+  EXPECT_EQ(synth_->active_voices(), 1);
+}
+
+TEST_F(SynthesizerTest, AppliesVelocityVolumePanAndAttenuation) {
+  UseRamp(WithInstantEnvelope({{sf2::kInitialAttenuation, 60}}));
+  synth_->SendChannelMessage(0xB0, 11, 64);
+  synth_->SendChannelMessage(0xB0, 10, 0);
+  synth_->SetVolume(0.5);
+  synth_->SendChannelMessage(0x90, 60, 100);
+  std::vector<float> out = Render(4);
+  float gain = std::pow(10.0f, -60.0f / 200.0f) * (100.0f / 127) *
+               (100.0f / 127) * (64.0f / 127) * (64.0f / 127) * 0.5f;
+  // CC10 = 0 is hard left.
+  EXPECT_NEAR(out[0], RampValue(0) * gain, kTolerance);
+  EXPECT_NEAR(out[1], 0.0f, kTolerance);
+}
+
+TEST_F(SynthesizerTest, SelectsZonesByKeyAndVelocity) {
+  Sf2Builder builder;
+  int low = builder.AddSample(Ramp(64));
+  Sf2Builder::Sample loud_sample = Ramp(64);
+  for (int16_t& value : loud_sample.data) {
+    value = static_cast<int16_t>(-value);
+  }
+  int loud = builder.AddSample(loud_sample);
+  int instrument = builder.BeginInstrument("layers");
+  builder.InstrumentZone(
+      low, WithInstantEnvelope({{sf2::kVelRange, sf2::Range(0, 99)}}));
+  builder.InstrumentZone(
+      loud, WithInstantEnvelope({{sf2::kVelRange, sf2::Range(100, 127)}}));
+  builder.BeginPreset("layers", 0, 0);
+  builder.PresetZone(instrument, {{sf2::kKeyRange, sf2::Range(60, 60)}});
+  synth_.reset(new Synthesizer(BuildFont(builder), kRate));
+
+  synth_->SendChannelMessage(0x90, 61, 127);
+  EXPECT_EQ(synth_->active_voices(), 0);
+  synth_->SendChannelMessage(0x90, 60, 50);
+  EXPECT_EQ(synth_->active_voices(), 1);
+  EXPECT_GT(Render(1)[0], 0.0f);
+  synth_->Reset();
+  synth_->SendChannelMessage(0x90, 60, 110);
+  EXPECT_LT(Render(1)[0], 0.0f);
+}
+
+TEST_F(SynthesizerTest, ReleaseEnvelopeFadesOutAndFreesVoice) {
+  Sf2Builder::Sample sample = Ramp(64);
+  for (int16_t& value : sample.data) {
+    value = 16384;
+  }
+  sample.loop_start = 0;
+  sample.loop_end = 64;
+  // Release over 2^(-1200/1200) = 0.5 s.
+  UseRamp(WithInstantEnvelope({{sf2::kSampleModes, 1},
+                               {sf2::kReleaseVolEnv,
+                                static_cast<uint16_t>(-1200)}}),
+          sample);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  Render(100);
+  synth_->SendChannelMessage(0x80, 60, 0);
+  // Halfway through the release the level is down 48 dB.
+  std::vector<float> out = Render(kRate / 4);
+  float expected = 0.5f * kCentrePan * std::pow(10.0f, -48.0f / 20.0f);
+  EXPECT_NEAR(out[(kRate / 4 - 1) * 2], expected, expected * 0.01f);
+  EXPECT_EQ(synth_->active_voices(), 1);
+  Render(kRate / 4 + 10);
+  EXPECT_EQ(synth_->active_voices(), 0);
+}
+
+TEST_F(SynthesizerTest, AttackRampsLinearly) {
+  // 2^(-6000/1200) s = 1/32 s.
+  UseRamp({{sf2::kDelayVolEnv, kNoTime},
+           {sf2::kAttackVolEnv, static_cast<uint16_t>(-6000)},
+           {sf2::kSampleModes, 1}},
+          [] {
+            Sf2Builder::Sample sample = Ramp(64);
+            for (int16_t& value : sample.data) {
+              value = 16384;
+            }
+            sample.loop_end = 64;
+            return sample;
+          }());
+  synth_->SendChannelMessage(0x90, 60, 127);
+  std::vector<float> out = Render(kRate / 32 + 1);
+  uint32_t attack = static_cast<uint32_t>(std::lround(kRate / 32.0));
+  EXPECT_NEAR(out[0], 0.0f, kTolerance);
+  EXPECT_NEAR(out[(attack / 2) * 2], 0.25f * kCentrePan, 1e-3f);
+  EXPECT_NEAR(out[attack * 2], 0.5f * kCentrePan, 1e-3f);
+}
+
+TEST_F(SynthesizerTest, SustainPedalHoldsReleasedKeys) {
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  UseRamp(WithInstantEnvelope({{sf2::kSampleModes, 1}}), sample);
+  synth_->SendChannelMessage(0xB0, 64, 127);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  synth_->SendChannelMessage(0x80, 60, 0);
+  Render(kRate / 10);
+  EXPECT_EQ(synth_->active_voices(), 1);
+  synth_->SendChannelMessage(0xB0, 64, 0);
+  // Default release is about 1 ms.
+  Render(kRate / 10);
+  EXPECT_EQ(synth_->active_voices(), 0);
+}
+
+TEST_F(SynthesizerTest, PitchBendUsesBendRange) {
+  UseRamp(kInstantEnvelope);
+  // RPN 0 = 12 semitones, then bend fully up: one octave.
+  synth_->SendChannelMessage(0xB0, 101, 0);
+  synth_->SendChannelMessage(0xB0, 100, 0);
+  synth_->SendChannelMessage(0xB0, 6, 12);
+  synth_->SendChannelMessage(0xE0, 0x7F, 0x7F);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  std::vector<float> out = Render(8);
+  double step = std::pow(2.0, 1200.0 * 8191 / 8192 / 1200.0);
+  for (size_t i = 0; i < 8; ++i) {
+    ASSERT_NEAR(out[i * 2], RampValue(i * step) * kCentrePan, 1e-4f) << i;
+  }
+}
+
+TEST_F(SynthesizerTest, ExclusiveClassCutsPreviousNote) {
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  UseRamp(WithInstantEnvelope({{sf2::kSampleModes, 1},
+                               {sf2::kExclusiveClass, 1}}),
+          sample);
+  synth_->SendChannelMessage(0x90, 42, 127);
+  synth_->SendChannelMessage(0x90, 46, 127);
+  EXPECT_EQ(synth_->active_voices(), 1);
+}
+
+TEST_F(SynthesizerTest, AllNotesOffAndResetSilence) {
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  UseRamp(WithInstantEnvelope({{sf2::kSampleModes, 1}}), sample);
+  synth_->SendChannelMessage(0x90, 60, 127);
+  synth_->SendChannelMessage(0x90, 64, 127);
+  synth_->SendChannelMessage(0xB0, 123, 0);
+  Render(kRate / 10);
+  EXPECT_EQ(synth_->active_voices(), 0);
+
+  synth_->SendChannelMessage(0x90, 60, 127);
+  const uint8_t gm_on[] = {0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7};
+  synth_->SendSysEx(gm_on, sizeof(gm_on));
+  EXPECT_EQ(synth_->active_voices(), 0);
+}
+
+TEST_F(SynthesizerTest, StealsOldestVoiceWhenFull) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 0, id, WithInstantEnvelope({{sf2::kSampleModes, 1}}));
+  synth_.reset(new Synthesizer(BuildFont(builder), kRate, 4));
+  for (uint8_t key = 60; key < 66; ++key) {
+    synth_->SendChannelMessage(0x90, key, 127);
+  }
+  EXPECT_EQ(synth_->active_voices(), 4);
+  // The two oldest keys were stolen, so releasing them changes nothing.
+  synth_->SendChannelMessage(0x80, 60, 0);
+  synth_->SendChannelMessage(0x80, 61, 0);
+  Render(kRate / 10);
+  EXPECT_EQ(synth_->active_voices(), 4);
+}
+
+TEST_F(SynthesizerTest, StealsReleasedVoiceBeforeSoundingOnes) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  int id = builder.AddSample(sample);
+  // Release over 0.5 s.
+  builder.SimplePreset(0, 0, id,
+                       WithInstantEnvelope({{sf2::kSampleModes, 1},
+                                            {sf2::kReleaseVolEnv,
+                                             static_cast<uint16_t>(-1200)}}));
+  synth_.reset(new Synthesizer(BuildFont(builder), kRate, 2));
+  synth_->SendChannelMessage(0x90, 60, 127);
+  synth_->SendChannelMessage(0x90, 61, 127);
+  synth_->SendChannelMessage(0x80, 61, 0);
+  // 61 is fading out, so it goes even though 60 is older.
+  synth_->SendChannelMessage(0x90, 62, 127);
+  EXPECT_EQ(synth_->stolen_voices(), 1u);
+  Render(kRate);
+  EXPECT_EQ(synth_->active_voices(), 2);
+}
+
+TEST_F(SynthesizerTest, StealsQuietestVoiceBeforeOldest) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 0, id, WithInstantEnvelope({{sf2::kSampleModes, 1}}));
+  synth_.reset(new Synthesizer(BuildFont(builder), kRate, 2));
+  synth_->SendChannelMessage(0x90, 60, 127);
+  synth_->SendChannelMessage(0x90, 61, 20);
+  synth_->SendChannelMessage(0x90, 62, 127);
+  // 60 survived the steal, so releasing it leaves only 62.
+  synth_->SendChannelMessage(0x80, 60, 0);
+  Render(kRate / 10);
+  EXPECT_EQ(synth_->active_voices(), 1);
+}
+
+TEST_F(SynthesizerTest, ReleaseTailsFreeEveryVoice) {
+  Sf2Builder builder;
+  Sf2Builder::Sample sample = Ramp(64);
+  sample.loop_end = 64;
+  int id = builder.AddSample(sample);
+  builder.SimplePreset(0, 0, id,
+                       WithInstantEnvelope({{sf2::kSampleModes, 1},
+                                            {sf2::kReleaseVolEnv,
+                                             static_cast<uint16_t>(-1200)}}));
+  synth_.reset(new Synthesizer(BuildFont(builder), kRate, 8));
+  // Overlapping notes, pedalled and not, several times more than the pool
+  // holds, with steals landing on voices mid-release.
+  for (int round = 0; round < 8; ++round) {
+    uint8_t channel = static_cast<uint8_t>(round % 2);
+    synth_->SendChannelMessage(0xB0 | channel, 64, round % 4 < 2 ? 127 : 0);
+    for (uint8_t key = 60; key < 72; ++key) {
+      synth_->SendChannelMessage(0x90 | channel, key, 100);
+      Render(64);
+      synth_->SendChannelMessage(0x80 | channel, key, 0);
+    }
+  }
+  synth_->SendChannelMessage(0xB0, 64, 0);
+  synth_->SendChannelMessage(0xB1, 64, 0);
+  EXPECT_GT(synth_->stolen_voices(), 0u);
+  Render(kRate / 2 + 10);
+  EXPECT_EQ(synth_->active_voices(), 0);
+}
+
+}  // namespace
+}  // namespace playmidifile
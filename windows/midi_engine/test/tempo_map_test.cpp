@@ -0,0 +1,119 @@
+#include "midi_engine/tempo_map.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace playmidifile {
+namespace {
+
+// Straightforward linear-scan conversion used as the reference.
+uint64_t ReferenceTicksToMicros(const std::vector<TempoChange>& changes,
+                                uint16_t ppq, uint32_t tick) {
+  // Accumulate exactly in micros * ppq and divide once at the end.
+  uint64_t scaled = 0;
+  uint32_t last_tick = 0;
+  uint64_t tempo = 500000;
+  for (const TempoChange& change : changes) {
+    if (change.tick > tick) {
+      break;
+    }
+    scaled += (change.tick - last_tick) * tempo;
+    last_tick = change.tick;
+    tempo = change.micros_per_quarter;
+  }
+  return (scaled + (tick - last_tick) * tempo) / ppq;
+}
+
+TEST(TempoMapTest, DefaultsTo120Bpm) {
+  TempoMap map({}, 480);
+  EXPECT_EQ(map.segment_count(), 1u);
+  EXPECT_EQ(map.TicksToMicros(480), 500000u);
+  EXPECT_EQ(map.MicrosToTicks(500000), 480u);
+  EXPECT_EQ(map.MicrosPerQuarterAt(100000), 500000u);
+}
+
+TEST(TempoMapTest, ConvertsAcrossTempoChanges) {
+  // 100 ticks per quarter: 120 BPM, then 60 BPM from tick 100, then 240 BPM
+  // from tick 300 (two changes at one tick; the last one wins).
+  TempoMap map({{100, 1000000}, {300, 400000}, {300, 250000}}, 100);
+  EXPECT_EQ(map.segment_count(), 3u);
+  EXPECT_EQ(map.TicksToMicros(100), 500000u);
+  EXPECT_EQ(map.TicksToMicros(200), 1500000u);
+  EXPECT_EQ(map.TicksToMicros(300), 2500000u);
+  EXPECT_EQ(map.TicksToMicros(400), 2750000u);
+  EXPECT_EQ(map.MicrosToTicks(499999), 99u);
+  EXPECT_EQ(map.MicrosToTicks(500000), 100u);
+  EXPECT_EQ(map.MicrosToTicks(2000000), 250u);
+  EXPECT_EQ(map.MicrosToTicks(2750000), 400u);
+  EXPECT_EQ(map.MicrosPerQuarterAt(299), 1000000u);
+  EXPECT_EQ(map.MicrosPerQuarterAt(300), 250000u);
+}
+
+TEST(TempoMapTest, AppliesSpeedFactor) {
+  TempoMap map({}, 480);
+  EXPECT_EQ(map.TicksToMicros(480, 2.0), 250000u);
+  EXPECT_EQ(map.TicksToMicros(480, 0.5), 1000000u);
+  EXPECT_EQ(map.MicrosToTicks(250000, 2.0), 480u);
+  EXPECT_EQ(map.MicrosToTicks(1000000, 0.5), 480u);
+}
+
+TEST(TempoMapTest, SupportsSmpteTiming) {
+  // 30 fps, 80 ticks per frame: 2400 ticks per second.
+  TempoMap map({{0, 1000000}}, static_cast<uint16_t>((0x100 - 30) << 8 | 80));
+  EXPECT_EQ(map.TicksToMicros(2400), 1000000u);
+  EXPECT_EQ(map.MicrosToTicks(500000), 1200u);
+  EXPECT_EQ(map.MicrosPerQuarterAt(0), 0u);
+  // 29.97 drop frame, 100 ticks per frame.
+  TempoMap drop_frame({}, static_cast<uint16_t>((0x100 - 29) << 8 | 100));
+  EXPECT_EQ(drop_frame.TicksToMicros(2997), 1000000u);
+}
+
+TEST(TempoMapTest, ValidatesDivisions) {
+  EXPECT_TRUE(TempoMap::IsValidDivision(480));
+  EXPECT_FALSE(TempoMap::IsValidDivision(0));
+  // 25 fps at 40 ticks per frame.
+  EXPECT_TRUE(TempoMap::IsValidDivision(0xE728));
+  // 25 fps at 0 ticks per frame.
+  EXPECT_FALSE(TempoMap::IsValidDivision(0xE700));
+  // 23 fps is not an SMPTE rate.
+  EXPECT_FALSE(TempoMap::IsValidDivision(0xE928));
+
+  // Built anyway, the map falls back to 480 ticks per quarter rather than
+  // dividing by zero.
+  TempoMap map({}, 0xE700);
+  EXPECT_EQ(map.TicksToMicros(480), 500000u);
+  EXPECT_EQ(map.MicrosToTicks(500000), 480u);
+}
+
+TEST(TempoMapTest, MatchesLinearReferenceOnManyTempoChanges) {
+  std::mt19937 random(1234);
+  std::vector<TempoChange> changes;
+  uint32_t tick = 0;
+  for (int i = 0; i < 10000; ++i) {
+    tick += 1 + random() % 200;
+    changes.push_back(
+        TempoChange{tick, 200000 + static_cast<uint32_t>(random() % 900000)});
+  }
+  TempoMap map(changes, 960);
+  TempoMap::Cursor cursor(&map);
+  uint32_t probe = 0;
+  for (int i = 0; i < 2000; ++i) {
+    probe += random() % 1000;
+    uint64_t expected = ReferenceTicksToMicros(changes, 960, probe);
+    ASSERT_EQ(map.TicksToMicros(probe), expected) << "tick " << probe;
+    ASSERT_EQ(cursor.TicksToMicros(probe), expected) << "tick " << probe;
+    // Round trip lands on the same tick, or the earlier one when the time
+    // falls inside a tick.
+    uint32_t back = map.MicrosToTicks(expected);
+    ASSERT_LE(back, probe);
+    ASSERT_EQ(map.TicksToMicros(back), expected);
+  }
+  // The cursor also handles going backwards.
+  EXPECT_EQ(cursor.TicksToMicros(10), ReferenceTicksToMicros(changes, 960, 10));
+}
+
+}  // namespace
+}  // namespace playmidifile
@@ -1,19 +1,168 @@
 #include "include/playmidifile/play_midifile_plugin_c_api.h"
 
 #include <flutter/plugin_registrar_windows.h>
+#include <flutter/event_channel.h>
+#include <flutter/event_stream_handler_functions.h>
 #include <flutter/method_channel.h>
 #include <flutter/standard_method_codec.h>
 #include <flutter/encodable_value.h>
 #define NOMINMAX  // Prevent Windows min/max macros from conflicting with std::min/std::max
 #include <windows.h>
-#include <mmsystem.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
-#pragma comment(lib, "winmm.lib")
+#include "midi_engine/audio_output.h"
+#include "midi_engine/offline_renderer.h"
+#include "midi_engine/playback_engine.h"
+#include "midi_engine/playback_stats.h"
+#include "midi_engine/player_output.h"
+#include "midi_engine/sequence.h"
+#include "midi_engine/sequence_cache.h"
+#include "midi_engine/sequencer_backend.h"
+#include "midi_engine/soundfont.h"
+#include "midi_engine/soundfont_cache.h"
+#include "midi_engine/spsc_queue.h"
+#include "midi_engine/synthesizer.h"
+#include "midi_engine/synthesizer_backend.h"
+#include "midi_engine/synthesizer_mixer.h"
+#include "midi_engine/worker_thread.h"
+#include "wasapi_audio_sink.h"
+#include "win_midi_output.h"
 
 namespace playmidifile {
 
+namespace {
+
+using MethodResultPtr =
+    std::shared_ptr<flutter::MethodResult<flutter::EncodableValue>>;
+
+// Posted to the hidden window when engine results are ready to be delivered.
+constexpr UINT kDrainRepliesMessage = WM_APP + 1;
+
+// Posted to the hidden window when a progress update is ready.
+constexpr UINT kDeliverProgressMessage = WM_APP + 2;
+
+// Default period of progress events while playing.
+constexpr uint32_t kDefaultProgressIntervalMs = 200;
+
+// Audio the synthesizer renders ahead after every load and seek, so that
+// play() is heard on the next device period.
+constexpr uint32_t kDefaultLeadInMs = 300;
+
+// Number of engine results that may wait for the platform thread.
+constexpr size_t kReplyQueueCapacity = 256;
+
+// Returns the value of |key| in |args|, or nullptr when absent.
+const flutter::EncodableValue* FindArgument(const flutter::EncodableMap& args,
+                                            const char* key) {
+  auto it = args.find(flutter::EncodableValue(key));
+  return it == args.end() ? nullptr : &it->second;
+}
+
+// Returns the "playerId" argument of |call|, or the default player when
+// there is none.
+int PlayerArgument(const flutter::MethodCall<flutter::EncodableValue>& call) {
+  const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+  const auto* player = args ? FindArgument(*args, "playerId") : nullptr;
+  return player ? std::get<int>(*player) : PlaybackEngine::kDefaultPlayer;
+}
+
+flutter::EncodableValue CacheStatsValue(const SequenceCacheStats& stats) {
+  flutter::EncodableMap map;
+  map[flutter::EncodableValue("hits")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.hits));
+  map[flutter::EncodableValue("misses")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.misses));
+  map[flutter::EncodableValue("evictions")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.evictions));
+  map[flutter::EncodableValue("entries")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.entries));
+  map[flutter::EncodableValue("bytes")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.bytes));
+  map[flutter::EncodableValue("budgetBytes")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.budget_bytes));
+  return flutter::EncodableValue(map);
+}
+
+flutter::EncodableValue HistogramValue(const HistogramSummary& summary) {
+  flutter::EncodableMap map;
+  map[flutter::EncodableValue("count")] =
+      flutter::EncodableValue(static_cast<int64_t>(summary.count));
+  map[flutter::EncodableValue("mean")] = flutter::EncodableValue(summary.mean);
+  map[flutter::EncodableValue("p50")] =
+      flutter::EncodableValue(static_cast<int64_t>(summary.p50));
+  map[flutter::EncodableValue("p90")] =
+      flutter::EncodableValue(static_cast<int64_t>(summary.p90));
+  map[flutter::EncodableValue("p99")] =
+      flutter::EncodableValue(static_cast<int64_t>(summary.p99));
+  map[flutter::EncodableValue("max")] =
+      flutter::EncodableValue(static_cast<int64_t>(summary.max));
+  return flutter::EncodableValue(map);
+}
+
+flutter::EncodableValue StatsValue(const PlaybackStatsSnapshot& stats) {
+  flutter::EncodableMap map;
+  map[flutter::EncodableValue("dispatchLatenessUs")] =
+      HistogramValue(stats.dispatch_lateness_us);
+  map[flutter::EncodableValue("serviceDurationUs")] =
+      HistogramValue(stats.service_duration_us);
+  map[flutter::EncodableValue("audioCallbackUs")] =
+      HistogramValue(stats.audio_callback_us);
+  map[flutter::EncodableValue("commandQueueDepth")] =
+      HistogramValue(stats.command_queue_depth);
+  map[flutter::EncodableValue("seekLatencyUs")] =
+      HistogramValue(stats.seek_latency_us);
+  map[flutter::EncodableValue("underruns")] =
+      flutter::EncodableValue(static_cast<int64_t>(stats.underruns));
+  return flutter::EncodableValue(map);
+}
+
+flutter::EncodableValue NoValue(const CommandResult& result) {
+  return flutter::EncodableValue();
+}
+
+flutter::EncodableValue LoadedValue(const CommandResult& result) {
+  return flutter::EncodableValue(true);
+}
+
+flutter::EncodableValue PlayerValue(const CommandResult& result) {
+  return flutter::EncodableValue(result.player);
+}
+
+flutter::EncodableMap InfoMap(const PlaybackInfo& playback) {
+  flutter::EncodableMap info;
+  info[flutter::EncodableValue("currentPositionMs")] = flutter::EncodableValue(static_cast<int>(playback.position_ms));
+  info[flutter::EncodableValue("durationMs")] = flutter::EncodableValue(static_cast<int>(playback.duration_ms));
+  double progress = playback.duration_ms > 0 ? static_cast<double>(playback.position_ms) / playback.duration_ms : 0.0;
+  // Ensure progress is within valid range
+  progress = (progress < 0.0) ? 0.0 : ((progress > 1.0) ? 1.0 : progress);
+  info[flutter::EncodableValue("progress")] = flutter::EncodableValue(progress);
+  return info;
+}
+
+flutter::EncodableValue InfoValue(const CommandResult& result) {
+  return flutter::EncodableValue(InfoMap(result.info));
+}
+
+// A progress event: the playback info plus the state name and the player
+// it belongs to.
+flutter::EncodableValue ProgressEventValue(int player,
+                                           const PlaybackInfo& playback) {
+  flutter::EncodableMap event = InfoMap(playback);
+  event[flutter::EncodableValue("state")] =
+      flutter::EncodableValue(PlaybackStateName(playback.state));
+  event[flutter::EncodableValue("playerId")] = flutter::EncodableValue(player);
+  return flutter::EncodableValue(event);
+}
+
+}  // namespace
+
 class PlayMidifilePlugin : public flutter::Plugin {
  public:
   static void RegisterWithRegistrar(flutter::PluginRegistrarWindows* registrar);
@@ -27,15 +176,114 @@ class PlayMidifilePlugin : public flutter::Plugin {
   PlayMidifilePlugin& operator=(const PlayMidifilePlugin&) = delete;
 
  private:
+  using SuccessValue = flutter::EncodableValue (*)(const CommandResult&);
+
+  // An offline render requested from Dart. An empty |output_path| renders
+  // to memory.
+  struct RenderJob {
+    std::string midi_path;
+    std::string output_path;
+    std::string sound_font_path;
+    RenderOptions options;
+  };
+
+  static LRESULT CALLBACK WindowProc(HWND window, UINT message, WPARAM wparam,
+                                     LPARAM lparam);
+
   // Called when a method is called on this plugin's channel from Dart.
   void HandleMethodCall(
       const flutter::MethodCall<flutter::EncodableValue>& method_call,
       std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result);
 
+  // Returns an engine callback that completes |result| on the platform
+  // thread, using |success_value| to build the reply on success.
+  CommandCallback ReplyOnPlatformThread(
+      std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+      SuccessValue success_value);
+
+  // Runs |reply| on the platform thread. Called from the engine thread, or
+  // directly on the platform thread when the engine rejects a command.
+  void PostToPlatformThread(std::function<void()> reply);
+
+  // Runs |reply| on the platform thread via |queue|, whose only producer
+  // must be the calling thread.
+  void PostReply(SpscQueue<std::function<void()>>* queue,
+                 std::function<void()> reply);
+
+  // Delivers queued replies. Runs on the platform thread.
+  void DrainReplies();
+
+  // Called when Dart listens to / cancels the progress event stream.
+  void StartProgressEvents(
+      std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> sink);
+  void StopProgressEvents();
+  // Points the engine's progress listener at OnProgress() at the current
+  // interval.
+  void InstallProgressListener();
+  // Engine thread: stores |info| as the latest update of |player| and wakes
+  // the platform thread unless a wake-up is already pending, so updates
+  // coalesce per player while Dart is busy.
+  void OnProgress(int player, const PlaybackInfo& info);
+  // Platform thread: sends the latest update of each player to Dart.
+  void DeliverProgress();
+
+  // Creates the hidden window used to marshal replies, if needed.
+  bool EnsureWindow();
+
+  // Parses renderToFile / renderToBuffer arguments and queues the render on
+  // |render_worker_|.
+  void StartRender(const flutter::MethodCall<flutter::EncodableValue>& call,
+                   bool to_file, MethodResultPtr result);
+
+  // Runs on |render_worker_|.
+  void RunRender(const RenderJob& job, MethodResultPtr result);
+  std::shared_ptr<const SoundFont> LoadSoundFont(const std::string& path,
+                                                 std::string* error);
+  // The flutter_assets directory next to the executable, looked up once.
+  const std::string& AssetDirectory();
+
+  // Hidden message-only window owned by the platform thread; engine results
+  // are marshalled back through its message queue.
   HWND midi_window_;
-  std::string current_state_;
-  DWORD duration_ms_;
-  DWORD current_position_ms_;
+  std::thread::id platform_thread_id_;
+  SpscQueue<std::function<void()>> replies_;
+  // Replies from |render_worker_|; a second ring keeps both single-producer.
+  SpscQueue<std::function<void()>> render_replies_;
+  std::atomic<bool> drain_posted_;
+  // Parsed files shared by playback and offline rendering.
+  std::shared_ptr<SequenceCache> cache_;
+  // Set on shutdown to abandon a render in progress.
+  std::atomic<bool> cancel_renders_;
+  // Created on the first render.
+  std::unique_ptr<WorkerThread> render_worker_;
+  // Opened SoundFonts, shared by every render that uses them.
+  std::shared_ptr<SoundFontCache> sound_fonts_;
+  // The SoundFont the last render used stays open between renders, with
+  // its prepared presets paged in. Only touched on the worker.
+  std::shared_ptr<const SoundFont> sound_font_;
+  std::string asset_directory_;
+  std::unique_ptr<flutter::EventChannel<flutter::EncodableValue>>
+      event_channel_;
+  // Set while Dart listens to progress events. Platform thread only.
+  std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> event_sink_;
+  uint32_t progress_interval_ms_;
+  // Applied to |engine_| when it is created, and on every change.
+  uint64_t streaming_threshold_;
+  std::mutex progress_mutex_;
+  PlaybackInfo pending_progress_[PlaybackEngine::kMaxPlayers];
+  // Bit p set: player p has an update in |pending_progress_|.
+  uint64_t pending_players_;
+  bool progress_posted_;
+  // Whichever of these initialize() chose must outlive |engine_|, which
+  // sends to it from the engine thread.
+  std::unique_ptr<WinMidiOutput> midi_output_;
+  std::unique_ptr<SynthesizerMixer> synth_mixer_;
+  std::unique_ptr<PlaybackEngine> engine_;
+  // Renders |synth_mixer_| to WASAPI when initialize() was given a
+  // SoundFont. Records into |engine_|'s stats, so must be stopped first,
+  // but freed after it: |synth_mixer_| wakes it while the engine's players
+  // are closed.
+  std::unique_ptr<AudioOutput> audio_output_;
 };
 
 // static
@@ -48,7 +296,29 @@ void PlayMidifilePlugin::RegisterWithRegistrar(
 
   auto plugin = std::make_unique<PlayMidifilePlugin>();
 
-  // Note: EventChannel support is temporarily disabled due to API compatibility issues
+  plugin->event_channel_ =
+      std::make_unique<flutter::EventChannel<flutter::EncodableValue>>(
+          registrar->messenger(), "playmidifile/events",
+          &flutter::StandardMethodCodec::GetInstance());
+  plugin->event_channel_->SetStreamHandler(
+      std::make_unique<
+          flutter::StreamHandlerFunctions<flutter::EncodableValue>>(
+          [plugin_pointer = plugin.get()](
+              const flutter::EncodableValue* arguments,
+              std::unique_ptr<flutter::EventSink<flutter::EncodableValue>>&&
+                  events)
+              -> std::unique_ptr<
+                  flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_pointer->StartProgressEvents(std::move(events));
+            return nullptr;
+          },
+          [plugin_pointer = plugin.get()](
+              const flutter::EncodableValue* arguments)
+              -> std::unique_ptr<
+                  flutter::StreamHandlerError<flutter::EncodableValue>> {
+            plugin_pointer->StopProgressEvents();
+            return nullptr;
+          }));
 
   channel->SetMethodCallHandler(
       [plugin_pointer = plugin.get()](const auto& call, auto result) {
@@ -58,218 +328,614 @@ void PlayMidifilePlugin::RegisterWithRegistrar(
   registrar->AddPlugin(std::move(plugin));
 }
 
-PlayMidifilePlugin::PlayMidifilePlugin() 
-    : midi_window_(nullptr), current_state_("stopped"), duration_ms_(0), current_position_ms_(0) {}
+PlayMidifilePlugin::PlayMidifilePlugin()
+    : midi_window_(nullptr),
+      platform_thread_id_(std::this_thread::get_id()),
+      replies_(kReplyQueueCapacity),
+      render_replies_(kReplyQueueCapacity),
+      drain_posted_(false),
+      cache_(std::make_shared<SequenceCache>()),
+      cancel_renders_(false),
+      sound_fonts_(std::make_shared<SoundFontCache>()),
+      progress_interval_ms_(kDefaultProgressIntervalMs),
+      streaming_threshold_(PlaybackEngine::kDefaultStreamingThreshold),
+      pending_players_(0),
+      progress_posted_(false) {}
 
 PlayMidifilePlugin::~PlayMidifilePlugin() {
+  cancel_renders_.store(true, std::memory_order_relaxed);
+  render_worker_.reset();
+  if (audio_output_) {
+    audio_output_->Stop();
+  }
+  // Stop the engine first so nothing posts to the window afterwards.
+  engine_.reset();
+  audio_output_.reset();
+  synth_mixer_.reset();
   if (midi_window_) {
-    mciSendString(L"close midi", nullptr, 0, midi_window_);
     DestroyWindow(midi_window_);
   }
 }
 
+// static
+LRESULT CALLBACK PlayMidifilePlugin::WindowProc(HWND window, UINT message,
+                                                WPARAM wparam, LPARAM lparam) {
+  if (message == kDrainRepliesMessage) {
+    auto* plugin = reinterpret_cast<PlayMidifilePlugin*>(
+        GetWindowLongPtr(window, GWLP_USERDATA));
+    if (plugin) {
+      plugin->DrainReplies();
+    }
+    return 0;
+  }
+  if (message == kDeliverProgressMessage) {
+    auto* plugin = reinterpret_cast<PlayMidifilePlugin*>(
+        GetWindowLongPtr(window, GWLP_USERDATA));
+    if (plugin) {
+      plugin->DeliverProgress();
+    }
+    return 0;
+  }
+  return DefWindowProc(window, message, wparam, lparam);
+}
+
+CommandCallback PlayMidifilePlugin::ReplyOnPlatformThread(
+    std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result,
+    SuccessValue success_value) {
+  MethodResultPtr shared_result(std::move(result));
+  return [this, shared_result, success_value](const CommandResult& command_result) {
+    PostToPlatformThread([shared_result, success_value, command_result]() {
+      if (command_result.ok()) {
+        shared_result->Success(success_value(command_result));
+      } else {
+        shared_result->Error(command_result.error_code,
+                             command_result.error_message);
+      }
+    });
+  };
+}
+
+void PlayMidifilePlugin::PostToPlatformThread(std::function<void()> reply) {
+  PostReply(&replies_, std::move(reply));
+}
+
+void PlayMidifilePlugin::PostReply(SpscQueue<std::function<void()>>* queue,
+                                   std::function<void()> reply) {
+  if (std::this_thread::get_id() == platform_thread_id_) {
+    reply();
+    return;
+  }
+  // The platform thread never waits on the engine or the render worker, so
+  // it will make room.
+  while (!queue->TryPush(std::move(reply))) {
+    std::this_thread::yield();
+  }
+  if (!drain_posted_.exchange(true, std::memory_order_acq_rel)) {
+    PostMessage(midi_window_, kDrainRepliesMessage, 0, 0);
+  }
+}
+
+void PlayMidifilePlugin::DrainReplies() {
+  drain_posted_.exchange(false, std::memory_order_acq_rel);
+  std::function<void()> reply;
+  while (replies_.TryPop(&reply)) {
+    reply();
+  }
+  while (render_replies_.TryPop(&reply)) {
+    reply();
+  }
+}
+
+void PlayMidifilePlugin::StartProgressEvents(
+    std::unique_ptr<flutter::EventSink<flutter::EncodableValue>> sink) {
+  event_sink_ = std::move(sink);
+  if (engine_) {
+    InstallProgressListener();
+  }
+}
+
+void PlayMidifilePlugin::StopProgressEvents() {
+  event_sink_.reset();
+  if (engine_) {
+    engine_->SetProgressListener(nullptr, 0, nullptr);
+  }
+}
+
+void PlayMidifilePlugin::InstallProgressListener() {
+  engine_->SetProgressListener(
+      [this](int player, const PlaybackInfo& info) {
+        OnProgress(player, info);
+      },
+      progress_interval_ms_, nullptr);
+}
+
+void PlayMidifilePlugin::OnProgress(int player, const PlaybackInfo& info) {
+  bool post;
+  {
+    std::lock_guard<std::mutex> lock(progress_mutex_);
+    pending_progress_[player] = info;
+    pending_players_ |= uint64_t{1} << player;
+    post = !progress_posted_;
+    progress_posted_ = true;
+  }
+  if (post) {
+    PostMessage(midi_window_, kDeliverProgressMessage, 0, 0);
+  }
+}
+
+void PlayMidifilePlugin::DeliverProgress() {
+  PlaybackInfo infos[PlaybackEngine::kMaxPlayers];
+  uint64_t players;
+  {
+    std::lock_guard<std::mutex> lock(progress_mutex_);
+    players = pending_players_;
+    for (int player = 0; player < PlaybackEngine::kMaxPlayers; ++player) {
+      if (players & (uint64_t{1} << player)) {
+        infos[player] = pending_progress_[player];
+      }
+    }
+    pending_players_ = 0;
+    progress_posted_ = false;
+  }
+  if (!event_sink_) {
+    return;
+  }
+  for (int player = 0; player < PlaybackEngine::kMaxPlayers; ++player) {
+    if (players & (uint64_t{1} << player)) {
+      event_sink_->Success(ProgressEventValue(player, infos[player]));
+    }
+  }
+}
+
+bool PlayMidifilePlugin::EnsureWindow() {
+  if (midi_window_) {
+    return true;
+  }
+  WNDCLASS wc = {};
+  wc.lpfnWndProc = &PlayMidifilePlugin::WindowProc;
+  wc.hInstance = GetModuleHandle(nullptr);
+  wc.lpszClassName = L"MidiPlayerWindow";
+  RegisterClass(&wc);
+
+  midi_window_ = CreateWindow(L"MidiPlayerWindow", L"MIDI Player", 0, 0, 0, 0, 0,
+                             HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
+  if (!midi_window_) {
+    return false;
+  }
+  SetWindowLongPtr(midi_window_, GWLP_USERDATA,
+                   reinterpret_cast<LONG_PTR>(this));
+  return true;
+}
+
+void PlayMidifilePlugin::StartRender(
+    const flutter::MethodCall<flutter::EncodableValue>& call, bool to_file,
+    MethodResultPtr result) {
+  const auto* args = std::get_if<flutter::EncodableMap>(call.arguments());
+  if (!args) {
+    result->Error("INVALID_ARGUMENT", "Arguments required");
+    return;
+  }
+  const auto* file_path = FindArgument(*args, "filePath");
+  const auto* output_path = FindArgument(*args, "outputPath");
+  const auto* sound_font_path = FindArgument(*args, "soundFontPath");
+  if (!file_path) {
+    result->Error("INVALID_ARGUMENT", "File path required");
+    return;
+  }
+  if (to_file && !output_path) {
+    result->Error("INVALID_ARGUMENT", "Output path required");
+    return;
+  }
+  if (!sound_font_path) {
+    result->Error("INVALID_ARGUMENT", "SoundFont path required");
+    return;
+  }
+  if (!EnsureWindow()) {
+    result->Error("INIT_ERROR", "Failed to initialize");
+    return;
+  }
+
+  RenderJob job;
+  job.midi_path = std::get<std::string>(*file_path);
+  if (to_file) {
+    job.output_path = std::get<std::string>(*output_path);
+  }
+  job.sound_font_path = std::get<std::string>(*sound_font_path);
+  if (const auto* sample_rate = FindArgument(*args, "sampleRate")) {
+    int rate = std::get<int>(*sample_rate);
+    if (rate < 8000 || rate > 192000) {
+      result->Error("INVALID_ARGUMENT", "Sample rate must be 8000-192000");
+      return;
+    }
+    job.options.sample_rate = static_cast<uint32_t>(rate);
+  }
+  if (const auto* threads = FindArgument(*args, "threads")) {
+    // The renderer clamps to the channel count.
+    job.options.threads = std::get<int>(*threads);
+  }
+  job.options.cancel = &cancel_renders_;
+
+  if (!render_worker_) {
+    render_worker_ = std::make_unique<WorkerThread>();
+  }
+  render_worker_->Post(
+      [this, job, result]() { RunRender(job, result); });
+}
+
+void PlayMidifilePlugin::RunRender(const RenderJob& job,
+                                   MethodResultPtr result) {
+  auto fail = [this, result](const std::string& code,
+                             const std::string& message) {
+    PostReply(&render_replies_,
+              [result, code, message]() { result->Error(code, message); });
+  };
+
+  std::string error;
+  std::shared_ptr<const Sequence> sequence =
+      cache_->Load(job.midi_path, &error);
+  if (!sequence) {
+    if (error == "File not found") {
+      fail("FILE_NOT_FOUND", error);
+    } else {
+      fail("RENDER_ERROR", error + " Path: " + job.midi_path);
+    }
+    return;
+  }
+  std::shared_ptr<const SoundFont> font =
+      LoadSoundFont(job.sound_font_path, &error);
+  if (!font) {
+    if (error == "File not found") {
+      fail("FILE_NOT_FOUND", "SoundFont not found");
+    } else {
+      fail("RENDER_ERROR", error + " Path: " + job.sound_font_path);
+    }
+    return;
+  }
+  auto start = std::chrono::steady_clock::now();
+  if (job.output_path.empty()) {
+    auto audio = std::make_shared<std::vector<float>>();
+    if (!RenderToBuffer(sequence, font, job.options, audio.get(), &error)) {
+      fail("RENDER_ERROR", error);
+      return;
+    }
+    PostReply(&render_replies_, [result, audio]() {
+      result->Success(flutter::EncodableValue(std::move(*audio)));
+    });
+    return;
+  }
+
+  uint64_t frames = 0;
+  if (!RenderToWavFile(sequence, font, job.options, job.output_path, &frames,
+                       &error)) {
+    fail("RENDER_ERROR", error);
+    return;
+  }
+  double render_ms = std::chrono::duration<double, std::milli>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+  double duration_ms = frames * 1000.0 / job.options.sample_rate;
+  PostReply(&render_replies_, [result, duration_ms, render_ms]() {
+    flutter::EncodableMap info;
+    info[flutter::EncodableValue("durationMs")] =
+        flutter::EncodableValue(static_cast<int>(duration_ms));
+    info[flutter::EncodableValue("renderTimeMs")] =
+        flutter::EncodableValue(static_cast<int>(render_ms));
+    info[flutter::EncodableValue("realtimeFactor")] = flutter::EncodableValue(
+        render_ms > 0.0 ? duration_ms / render_ms : 0.0);
+    result->Success(flutter::EncodableValue(info));
+  });
+}
+
+const std::string& PlayMidifilePlugin::AssetDirectory() {
+  if (asset_directory_.empty()) {
+    char exe_path[MAX_PATH];
+    GetModuleFileNameA(nullptr, exe_path, MAX_PATH);
+    std::string exe_dir = exe_path;
+    size_t pos = exe_dir.find_last_of("\\/");
+    if (pos != std::string::npos) {
+      exe_dir = exe_dir.substr(0, pos);
+    }
+    // Flutter Windows assets are in data/flutter_assets/ directory
+    asset_directory_ = exe_dir + "\\data\\flutter_assets\\";
+  }
+  return asset_directory_;
+}
+
+std::shared_ptr<const SoundFont> PlayMidifilePlugin::LoadSoundFont(
+    const std::string& path, std::string* error) {
+  std::shared_ptr<const SoundFont> font = sound_fonts_->Open(path, error);
+  if (font) {
+    sound_font_ = font;
+  }
+  return font;
+}
+
 void PlayMidifilePlugin::HandleMethodCall(
     const flutter::MethodCall<flutter::EncodableValue>& method_call,
     std::unique_ptr<flutter::MethodResult<flutter::EncodableValue>> result) {
   const std::string& method = method_call.method_name();
 
   if (method == "initialize") {
-    // Create hidden window for MIDI operations
-    WNDCLASS wc = {};
-    wc.lpfnWndProc = DefWindowProc;
-    wc.hInstance = GetModuleHandle(nullptr);
-    wc.lpszClassName = L"MidiPlayerWindow";
-    RegisterClass(&wc);
-    
-    midi_window_ = CreateWindow(L"MidiPlayerWindow", L"MIDI Player", 0, 0, 0, 0, 0, 
-                               HWND_MESSAGE, nullptr, GetModuleHandle(nullptr), nullptr);
-    
-    if (midi_window_) {
+    if (engine_) {
       result->Success();
-    } else {
+      return;
+    }
+
+    // Create hidden window for MIDI operations
+    if (!EnsureWindow()) {
       result->Error("INIT_ERROR", "Failed to initialize");
+      return;
     }
-  } else if (method == "loadFile") {
+
+    // With a SoundFont, play through the built-in synthesizer on WASAPI;
+    // otherwise through the system MIDI device.
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* sound_font_path =
+        args ? FindArgument(*args, "soundFontPath") : nullptr;
+    std::string error;
+    MidiOutput* device = nullptr;
+    AudioOutputOptions audio_options;
+    uint32_t lead_in_ms = kDefaultLeadInMs;
+    if (sound_font_path) {
+      if (const auto* sample_rate = FindArgument(*args, "sampleRate")) {
+        int rate = std::get<int>(*sample_rate);
+        if (rate < 8000 || rate > 192000) {
+          result->Error("INVALID_ARGUMENT", "Sample rate must be 8000-192000");
+          return;
+        }
+        audio_options.sample_rate = static_cast<uint32_t>(rate);
+      }
+      if (const auto* period_frames = FindArgument(*args, "periodFrames")) {
+        int frames = std::get<int>(*period_frames);
+        if (frames < 32 || frames > 8192) {
+          result->Error("INVALID_ARGUMENT", "Period must be 32-8192 frames");
+          return;
+        }
+        audio_options.period_frames = static_cast<size_t>(frames);
+      }
+      if (const auto* buffer_count = FindArgument(*args, "bufferCount")) {
+        int count = std::get<int>(*buffer_count);
+        if (count < 2 || count > 16) {
+          result->Error("INVALID_ARGUMENT", "Buffer count must be 2-16");
+          return;
+        }
+        audio_options.periods = count;
+      }
+      if (const auto* lead_in = FindArgument(*args, "leadInMs")) {
+        int ms = std::get<int>(*lead_in);
+        if (ms < 0 || ms > 2000) {
+          result->Error("INVALID_ARGUMENT", "Lead-in must be 0-2000 ms");
+          return;
+        }
+        lead_in_ms = static_cast<uint32_t>(ms);
+      }
+      std::string path = std::get<std::string>(*sound_font_path);
+      std::shared_ptr<const SoundFont> font = sound_fonts_->Open(path, &error);
+      if (!font) {
+        result->Error("INIT_ERROR", error + " Path: " + path);
+        return;
+      }
+      synth_mixer_ =
+          std::make_unique<SynthesizerMixer>(font, audio_options.sample_rate);
+    } else {
+      auto midi_output = std::make_unique<WinMidiOutput>();
+      if (!midi_output->Open(&error)) {
+        result->Error("INIT_ERROR", error);
+        return;
+      }
+      midi_output_ = std::move(midi_output);
+      device = midi_output_.get();
+    }
+    if (synth_mixer_) {
+      // Every player is a part of the mixer, sequenced on the audio thread.
+      SynthesizerMixer* mixer = synth_mixer_.get();
+      engine_ = std::make_unique<PlaybackEngine>(
+          [mixer]() { return std::make_unique<SynthesizerBackend>(mixer); },
+          cache_);
+      audio_output_ = std::make_unique<AudioOutput>(
+          std::make_unique<WasapiAudioSink>(), mixer, audio_options);
+      audio_output_->SetStats(engine_->mutable_stats());
+      mixer->SetOutput(audio_output_.get());
+      mixer->SetLeadInMs(lead_in_ms);
+      if (!audio_output_->Start(&error)) {
+        // Closing the engine's players still wakes the output.
+        engine_.reset();
+        audio_output_.reset();
+        synth_mixer_.reset();
+        result->Error("INIT_ERROR", error);
+        return;
+      }
+    } else {
+      // Every player sends through its own PlayerOutput, so players keep
+      // their own volume and silence only their own notes on the one
+      // device.
+      engine_ = std::make_unique<PlaybackEngine>(
+          [device]() {
+            return std::make_unique<SequencerBackend>(
+                std::make_unique<PlayerOutput>(device));
+          },
+          cache_);
+    }
+    engine_->SetStreamingThreshold(streaming_threshold_);
+    if (event_sink_) {
+      InstallProgressListener();
+    }
+    result->Success();
+    return;
+  }
+
+  // Offline rendering does not use the MIDI device, so it works without
+  // initialize().
+  if (method == "renderToFile" || method == "renderToBuffer") {
+    StartRender(method_call, method == "renderToFile",
+                MethodResultPtr(std::move(result)));
+    return;
+  }
+
+  if (method == "setProgressInterval") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* interval = args ? FindArgument(*args, "intervalMs") : nullptr;
+    if (!interval) {
+      result->Error("INVALID_ARGUMENT", "Interval required");
+      return;
+    }
+    int interval_ms = std::get<int>(*interval);
+    if (interval_ms < 1) {
+      result->Error("INVALID_ARGUMENT", "Interval must be positive");
+      return;
+    }
+    progress_interval_ms_ = static_cast<uint32_t>(interval_ms);
+    if (engine_ && event_sink_) {
+      InstallProgressListener();
+    }
+    result->Success();
+    return;
+  }
+
+  if (method == "getCacheStats") {
+    result->Success(CacheStatsValue(cache_->stats()));
+    return;
+  }
+  if (method == "setCacheBudget") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* bytes = args ? FindArgument(*args, "bytes") : nullptr;
+    if (!bytes) {
+      result->Error("INVALID_ARGUMENT", "Budget required");
+      return;
+    }
+    // Dart ints arrive as int32 or int64 depending on magnitude.
+    int64_t budget = bytes->LongValue();
+    if (budget < 0) {
+      result->Error("INVALID_ARGUMENT", "Budget must not be negative");
+      return;
+    }
+    cache_->SetBudget(static_cast<size_t>(budget));
+    result->Success();
+    return;
+  }
+  if (method == "setStreamingThreshold") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* bytes = args ? FindArgument(*args, "bytes") : nullptr;
+    if (!bytes) {
+      result->Error("INVALID_ARGUMENT", "Threshold required");
+      return;
+    }
+    int64_t threshold = bytes->LongValue();
+    if (threshold < 0) {
+      result->Error("INVALID_ARGUMENT", "Threshold must not be negative");
+      return;
+    }
+    streaming_threshold_ = static_cast<uint64_t>(threshold);
+    if (engine_) {
+      engine_->SetStreamingThreshold(streaming_threshold_);
+    }
+    result->Success();
+    return;
+  }
+
+  if (!engine_) {
+    result->Error("NOT_INITIALIZED", "Call initialize() first");
+    return;
+  }
+
+  // Every player method addresses the default player unless the call
+  // names another.
+  const int player = PlayerArgument(method_call);
+
+  if (method == "loadFile") {
     const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (args) {
       auto it = args->find(flutter::EncodableValue("filePath"));
       if (it != args->end()) {
         std::string file_path = std::get<std::string>(it->second);
-        std::wstring wide_path(file_path.begin(), file_path.end());
-        
-        // Check if file exists
-        DWORD attr = GetFileAttributes(wide_path.c_str());
-        if (attr == INVALID_FILE_ATTRIBUTES) {
-          result->Error("FILE_NOT_FOUND", "File not found");
-          return;
-        }
-        
-                 // Open MIDI file
-         std::wstring cmd = L"open \"" + wide_path + L"\" type sequencer alias midi";
-         MCIERROR error = mciSendString(cmd.c_str(), nullptr, 0, midi_window_);
-         
-         if (error == 0) {
-           // Set time format to milliseconds
-           mciSendString(L"set midi time format milliseconds", nullptr, 0, midi_window_);
-           
-           // Get duration
-           wchar_t buffer[256];
-           error = mciSendString(L"status midi length", buffer, sizeof(buffer)/sizeof(wchar_t), midi_window_);
-           if (error == 0) {
-             duration_ms_ = _wtoi(buffer);
-           }
-           current_state_ = "stopped";
-           result->Success(flutter::EncodableValue(true));
-         } else {
-           // Get error message
-           wchar_t error_buffer[256];
-           mciGetErrorString(error, error_buffer, sizeof(error_buffer)/sizeof(wchar_t));
-           std::string error_msg = "MCI Error: ";
-           int size_needed = WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, NULL, 0, NULL, NULL);
-           std::string error_str(size_needed, 0);
-           WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, &error_str[0], size_needed, NULL, NULL);
-           error_msg += error_str + " Path: " + file_path;
-           result->Error("LOAD_ERROR", error_msg);
-         }
+        engine_->Load(file_path, ReplyOnPlatformThread(std::move(result), &LoadedValue), player);
       } else {
         result->Error("INVALID_ARGUMENT", "File path required");
       }
     } else {
       result->Error("INVALID_ARGUMENT", "Arguments required");
     }
-     } else if (method == "loadAsset") {
-     const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
-     if (args) {
-       auto it = args->find(flutter::EncodableValue("assetPath"));
-       if (it != args->end()) {
-         std::string asset_path = std::get<std::string>(it->second);
-         
-         // Get executable directory
-         char exe_path[MAX_PATH];
-         GetModuleFileNameA(nullptr, exe_path, MAX_PATH);
-         std::string exe_dir = exe_path;
-         size_t pos = exe_dir.find_last_of("\\/");
-         if (pos != std::string::npos) {
-           exe_dir = exe_dir.substr(0, pos);
-         }
-         
-         // Flutter Windows assets are in data/flutter_assets/ directory
-         std::string full_path = exe_dir + "\\data\\flutter_assets\\" + asset_path;
-         std::wstring wide_path(full_path.begin(), full_path.end());
-        
-        // Check if file exists
-        DWORD attr = GetFileAttributes(wide_path.c_str());
-        if (attr == INVALID_FILE_ATTRIBUTES) {
-          result->Error("FILE_NOT_FOUND", "Asset file not found");
-          return;
-        }
-        
-                 // Open MIDI file
-         std::wstring cmd = L"open \"" + wide_path + L"\" type sequencer alias midi";
-         MCIERROR error = mciSendString(cmd.c_str(), nullptr, 0, midi_window_);
-         
-         if (error == 0) {
-           // Set time format to milliseconds
-           mciSendString(L"set midi time format milliseconds", nullptr, 0, midi_window_);
-           
-           // Get duration
-           wchar_t buffer[256];
-           error = mciSendString(L"status midi length", buffer, sizeof(buffer)/sizeof(wchar_t), midi_window_);
-           if (error == 0) {
-             duration_ms_ = _wtoi(buffer);
-           }
-           current_state_ = "stopped";
-           result->Success(flutter::EncodableValue(true));
-         } else {
-           // Get error message
-           wchar_t error_buffer[256];
-           mciGetErrorString(error, error_buffer, sizeof(error_buffer)/sizeof(wchar_t));
-           std::string error_msg = "MCI Error: ";
-           int size_needed = WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, NULL, 0, NULL, NULL);
-           std::string error_str(size_needed, 0);
-           WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, &error_str[0], size_needed, NULL, NULL);
-           error_msg += error_str + " Path: " + full_path;
-           result->Error("LOAD_ERROR", error_msg);
-         }
+  } else if (method == "loadBytes") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* value = args ? FindArgument(*args, "bytes") : nullptr;
+    const auto* bytes =
+        value ? std::get_if<std::vector<uint8_t>>(value) : nullptr;
+    if (bytes) {
+      // The method call only lives until we return, so the bytes are copied
+      // once for the engine thread, which parses them in place.
+      engine_->LoadBytes(*bytes,
+                         ReplyOnPlatformThread(std::move(result), &LoadedValue),
+                         player);
+    } else {
+      result->Error("INVALID_ARGUMENT", "Bytes required");
+    }
+  } else if (method == "loadAsset") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (args) {
+      auto it = args->find(flutter::EncodableValue("assetPath"));
+      if (it != args->end()) {
+        std::string asset_path = std::get<std::string>(it->second);
+        engine_->Load(AssetDirectory() + asset_path,
+                      ReplyOnPlatformThread(std::move(result), &LoadedValue),
+                      player);
       } else {
         result->Error("INVALID_ARGUMENT", "Asset path required");
       }
     } else {
       result->Error("INVALID_ARGUMENT", "Arguments required");
     }
-  } else if (method == "play") {
-    // Check current status first
-    wchar_t mode_buffer[256];
-    MCIERROR error = mciSendString(L"status midi mode", mode_buffer, sizeof(mode_buffer)/sizeof(wchar_t), midi_window_);
-    if (error == 0) {
-      std::wstring mode(mode_buffer);
-      // If stopped (including after completion), seek to beginning first
-      if (mode == L"stopped") {
-        mciSendString(L"seek midi to start", nullptr, 0, midi_window_);
-        current_position_ms_ = 0;
-      }
-    }
-    
-    error = mciSendString(L"play midi", nullptr, 0, midi_window_);
-    if (error == 0) {
-      current_state_ = "playing";
-      result->Success();
+  } else if (method == "enqueue") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* value = args ? FindArgument(*args, "filePath") : nullptr;
+    const auto* file_path = value ? std::get_if<std::string>(value) : nullptr;
+    if (file_path) {
+      engine_->Enqueue(*file_path,
+                       ReplyOnPlatformThread(std::move(result), &NoValue),
+                       player);
     } else {
-      // Get error message for debugging
-      wchar_t error_buffer[256];
-      mciGetErrorString(error, error_buffer, sizeof(error_buffer)/sizeof(wchar_t));
-      std::string error_msg = "MCI Play Error: ";
-      int size_needed = WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, NULL, 0, NULL, NULL);
-      std::string error_str(size_needed, 0);
-      WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, &error_str[0], size_needed, NULL, NULL);
-      error_msg += error_str;
-      result->Error("PLAY_ERROR", error_msg);
+      result->Error("INVALID_ARGUMENT", "File path required");
     }
-  } else if (method == "pause") {
-    MCIERROR error = mciSendString(L"pause midi", nullptr, 0, midi_window_);
-    if (error == 0) {
-      current_state_ = "paused";
-      result->Success();
-    } else {
-      result->Error("PAUSE_ERROR", "Failed to pause");
+  } else if (method == "setQueue") {
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    const auto* value = args ? FindArgument(*args, "filePaths") : nullptr;
+    const auto* list = value ? std::get_if<flutter::EncodableList>(value) : nullptr;
+    if (!list) {
+      result->Error("INVALID_ARGUMENT", "File paths required");
+      return;
     }
-  } else if (method == "stop") {
-    MCIERROR error = mciSendString(L"stop midi", nullptr, 0, midi_window_);
-    if (error == 0) {
-      // After stopping, seek to the beginning for next playback
-      mciSendString(L"seek midi to start", nullptr, 0, midi_window_);
-      current_position_ms_ = 0;
-      current_state_ = "stopped";
-      result->Success();
-    } else {
-      result->Error("STOP_ERROR", "Failed to stop");
+    std::vector<std::string> paths;
+    paths.reserve(list->size());
+    for (const flutter::EncodableValue& item : *list) {
+      const auto* file_path = std::get_if<std::string>(&item);
+      if (!file_path) {
+        result->Error("INVALID_ARGUMENT", "File paths must be strings");
+        return;
+      }
+      paths.push_back(*file_path);
     }
+    engine_->SetQueue(std::move(paths),
+                      ReplyOnPlatformThread(std::move(result), &NoValue),
+                      player);
+  } else if (method == "next") {
+    engine_->Next(ReplyOnPlatformThread(std::move(result), &LoadedValue),
+                  player);
+  } else if (method == "play") {
+    engine_->Play(ReplyOnPlatformThread(std::move(result), &NoValue), player);
+  } else if (method == "pause") {
+    engine_->Pause(ReplyOnPlatformThread(std::move(result), &NoValue), player);
+  } else if (method == "stop") {
+    engine_->Stop(ReplyOnPlatformThread(std::move(result), &NoValue), player);
   } else if (method == "seekTo") {
     const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
     if (args) {
       auto it = args->find(flutter::EncodableValue("positionMs"));
       if (it != args->end()) {
         int position_ms = std::get<int>(it->second);
-        
-        // Ensure position is within valid range
-        position_ms = (position_ms < 0) ? 0 : ((position_ms > static_cast<int>(duration_ms_)) ? static_cast<int>(duration_ms_) : position_ms);
-        
-        std::wstring cmd = L"seek midi to " + std::to_wstring(position_ms);
-        MCIERROR error = mciSendString(cmd.c_str(), nullptr, 0, midi_window_);
-        if (error == 0) {
-          current_position_ms_ = position_ms;
-          result->Success();
-        } else {
-          // Get error message for debugging
-          wchar_t error_buffer[256];
-          mciGetErrorString(error, error_buffer, sizeof(error_buffer)/sizeof(wchar_t));
-          std::string error_msg = "MCI Seek Error: ";
-          int size_needed = WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, NULL, 0, NULL, NULL);
-          std::string error_str(size_needed, 0);
-          WideCharToMultiByte(CP_UTF8, 0, error_buffer, -1, &error_str[0], size_needed, NULL, NULL);
-          error_msg += error_str;
-          result->Error("SEEK_ERROR", error_msg);
-        }
+        // The engine clamps to the duration.
+        position_ms = position_ms < 0 ? 0 : position_ms;
+        engine_->Seek(static_cast<uint32_t>(position_ms),
+                      ReplyOnPlatformThread(std::move(result), &NoValue),
+                      player);
       } else {
         result->Error("INVALID_ARGUMENT", "Position required");
       }
@@ -282,10 +948,7 @@ void PlayMidifilePlugin::HandleMethodCall(
       auto it = args->find(flutter::EncodableValue("volume"));
       if (it != args->end()) {
         double volume = std::get<double>(it->second);
-        int vol = static_cast<int>(volume * 1000);
-        std::wstring cmd = L"setaudio midi volume to " + std::to_wstring(vol);
-        mciSendString(cmd.c_str(), nullptr, 0, midi_window_);
-        result->Success();
+        engine_->SetVolume(volume, ReplyOnPlatformThread(std::move(result), &NoValue), player);
       } else {
         result->Error("INVALID_ARGUMENT", "Volume required");
       }
@@ -293,59 +956,39 @@ void PlayMidifilePlugin::HandleMethodCall(
       result->Error("INVALID_ARGUMENT", "Arguments required");
     }
   } else if (method == "setSpeed") {
-    // Windows MIDI API does not support speed control
-    result->Success();
-  } else if (method == "getCurrentInfo") {
-    // Set time format to milliseconds first
-    mciSendString(L"set midi time format milliseconds", nullptr, 0, midi_window_);
-    
-    // Get current position
-    wchar_t buffer[256];
-    MCIERROR error = mciSendString(L"status midi position", buffer, sizeof(buffer)/sizeof(wchar_t), midi_window_);
-    if (error == 0) {
-      current_position_ms_ = _wtoi(buffer);
-    } else {
-      // If failed to get position, keep the current stored value
-    }
-    
-    // Also get duration to make sure it's correct
-    wchar_t duration_buffer[256];
-    error = mciSendString(L"status midi length", duration_buffer, sizeof(duration_buffer)/sizeof(wchar_t), midi_window_);
-    if (error == 0) {
-      duration_ms_ = _wtoi(duration_buffer);
-    }
-    
-    // Check if playback is still active
-    wchar_t mode_buffer[256];
-    error = mciSendString(L"status midi mode", mode_buffer, sizeof(mode_buffer)/sizeof(wchar_t), midi_window_);
-    if (error == 0) {
-      std::wstring mode(mode_buffer);
-      if (mode == L"stopped" && current_state_ == "playing") {
-        // Playback has completed
-        current_state_ = "stopped";
-        current_position_ms_ = 0; // Reset position for next playback
-      } else if (mode == L"playing") {
-        current_state_ = "playing";
-      } else if (mode == L"paused") {
-        current_state_ = "paused";
+    const auto* args = std::get_if<flutter::EncodableMap>(method_call.arguments());
+    if (args) {
+      auto it = args->find(flutter::EncodableValue("speed"));
+      if (it != args->end()) {
+        double speed = std::get<double>(it->second);
+        engine_->SetSpeed(speed, ReplyOnPlatformThread(std::move(result), &NoValue), player);
+      } else {
+        result->Error("INVALID_ARGUMENT", "Speed required");
       }
+    } else {
+      result->Error("INVALID_ARGUMENT", "Arguments required");
     }
-    
-    flutter::EncodableMap info;
-    info[flutter::EncodableValue("currentPositionMs")] = flutter::EncodableValue(static_cast<int>(current_position_ms_));
-    info[flutter::EncodableValue("durationMs")] = flutter::EncodableValue(static_cast<int>(duration_ms_));
-    double progress = duration_ms_ > 0 ? static_cast<double>(current_position_ms_) / duration_ms_ : 0.0;
-    // Ensure progress is within valid range
-    progress = (progress < 0.0) ? 0.0 : ((progress > 1.0) ? 1.0 : progress);
-    info[flutter::EncodableValue("progress")] = flutter::EncodableValue(progress);
-    result->Success(flutter::EncodableValue(info));
+  } else if (method == "getCurrentInfo") {
+    // Read straight from the engine's snapshot: no command round trip.
+    result->Success(
+        flutter::EncodableValue(InfoMap(engine_->Snapshot(player))));
+  } else if (method == "getStats") {
+    // Lock-free counters, read without a round trip like getCurrentInfo.
+    result->Success(StatsValue(engine_->Stats()));
+  } else if (method == "resetStats") {
+    engine_->ResetStats();
+    result->Success();
+  } else if (method == "createPlayer") {
+    engine_->CreatePlayer(
+        ReplyOnPlatformThread(std::move(result), &PlayerValue));
+  } else if (method == "disposePlayer") {
+    engine_->DisposePlayer(player,
+                           ReplyOnPlatformThread(std::move(result), &NoValue));
   } else {
     result->NotImplemented();
   }
 }
 
-
-
 }  // namespace playmidifile
 
 void PlayMidifilePluginCApiRegisterWithRegistrar(
@@ -353,4 +996,4 @@ void PlayMidifilePluginCApiRegisterWithRegistrar(
   playmidifile::PlayMidifilePlugin::RegisterWithRegistrar(
       flutter::PluginRegistrarManager::GetInstance()
           ->GetRegistrar<flutter::PluginRegistrarWindows>(registrar));
-} 
\ No newline at end of file
+}
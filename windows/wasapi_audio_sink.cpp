@@ -0,0 +1,163 @@
+#include "wasapi_audio_sink.h"
+
+#include <avrt.h>
+#include <mmdeviceapi.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <utility>
+
+#pragma comment(lib, "avrt.lib")
+
+namespace playmidifile {
+
+namespace {
+
+using Microsoft::WRL::ComPtr;
+
+constexpr REFERENCE_TIME kHundredNanosPerSecond = 10000000;
+
+std::string HresultError(const char* what, HRESULT hr) {
+  char code[16];
+  snprintf(code, sizeof(code), "0x%08lX", static_cast<unsigned long>(hr));
+  return std::string(what) + " (error " + code + ")";
+}
+
+}  // namespace
+
+WasapiAudioSink::WasapiAudioSink()
+    : buffer_event_(nullptr), stop_event_(nullptr), buffer_frames_(0) {}
+
+WasapiAudioSink::~WasapiAudioSink() {
+  Close();
+}
+
+bool WasapiAudioSink::Open(AudioFormat* format, std::string* error) {
+  Close();
+  ComPtr<IMMDeviceEnumerator> enumerator;
+  HRESULT hr = CoCreateInstance(__uuidof(MMDeviceEnumerator), nullptr,
+                                CLSCTX_ALL, IID_PPV_ARGS(&enumerator));
+  if (FAILED(hr)) {
+    *error = HresultError("Failed to create audio device enumerator", hr);
+    return false;
+  }
+  ComPtr<IMMDevice> device;
+  hr = enumerator->GetDefaultAudioEndpoint(eRender, eConsole, &device);
+  if (FAILED(hr)) {
+    *error = HresultError("No audio output device", hr);
+    return false;
+  }
+  hr = device->Activate(__uuidof(IAudioClient), CLSCTX_ALL, nullptr,
+                        reinterpret_cast<void**>(client_.GetAddressOf()));
+  if (FAILED(hr)) {
+    *error = HresultError("Failed to open audio output device", hr);
+    return false;
+  }
+
+  REFERENCE_TIME device_period = 0;
+  client_->GetDevicePeriod(&device_period, nullptr);
+  size_t device_period_frames = static_cast<size_t>(
+      device_period * format->sample_rate / kHundredNanosPerSecond);
+  format->period_frames =
+      std::max(format->period_frames, device_period_frames);
+
+  // Stereo float at our rate; the audio engine converts to the mix format.
+  WAVEFORMATEX wave_format = {};
+  wave_format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+  wave_format.nChannels = 2;
+  wave_format.nSamplesPerSec = format->sample_rate;
+  wave_format.wBitsPerSample = 32;
+  wave_format.nBlockAlign = 8;
+  wave_format.nAvgBytesPerSec = format->sample_rate * 8;
+  // One period of endpoint buffer: the AudioOutput's ring, not WASAPI,
+  // decides how far ahead audio is rendered.
+  REFERENCE_TIME duration = static_cast<REFERENCE_TIME>(
+      format->period_frames * kHundredNanosPerSecond / format->sample_rate);
+  hr = client_->Initialize(
+      AUDCLNT_SHAREMODE_SHARED,
+      AUDCLNT_STREAMFLAGS_EVENTCALLBACK | AUDCLNT_STREAMFLAGS_AUTOCONVERTPCM |
+          AUDCLNT_STREAMFLAGS_SRC_DEFAULT_QUALITY,
+      duration, 0, &wave_format, nullptr);
+  if (FAILED(hr)) {
+    client_.Reset();
+    *error = HresultError("Failed to initialize audio output", hr);
+    return false;
+  }
+  client_->GetBufferSize(&buffer_frames_);
+  hr = client_->GetService(IID_PPV_ARGS(&render_client_));
+  if (FAILED(hr)) {
+    client_.Reset();
+    *error = HresultError("Failed to get audio render client", hr);
+    return false;
+  }
+  buffer_event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+  stop_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+  client_->SetEventHandle(buffer_event_);
+  return true;
+}
+
+void WasapiAudioSink::Start(PullCallback pull) {
+  pull_ = std::move(pull);
+  ResetEvent(stop_event_);
+  thread_ = std::thread(&WasapiAudioSink::Run, this);
+}
+
+void WasapiAudioSink::Close() {
+  if (thread_.joinable()) {
+    SetEvent(stop_event_);
+    thread_.join();
+  }
+  render_client_.Reset();
+  client_.Reset();
+  if (buffer_event_) {
+    CloseHandle(buffer_event_);
+    buffer_event_ = nullptr;
+  }
+  if (stop_event_) {
+    CloseHandle(stop_event_);
+    stop_event_ = nullptr;
+  }
+  pull_ = nullptr;
+}
+
+void WasapiAudioSink::Run() {
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  DWORD task_index = 0;
+  HANDLE task = AvSetMmThreadCharacteristicsW(L"Pro Audio", &task_index);
+  // Fill the whole buffer first so the stream starts without a gap.
+  if (FillBuffer() && SUCCEEDED(client_->Start())) {
+    HANDLE events[] = {stop_event_, buffer_event_};
+    for (;;) {
+      DWORD result = WaitForMultipleObjects(2, events, FALSE, INFINITE);
+      // A device that was unplugged or reconfigured stays silent until the
+      // output is reopened.
+      if (result != WAIT_OBJECT_0 + 1 || !FillBuffer()) {
+        break;
+      }
+    }
+    client_->Stop();
+  }
+  if (task) {
+    AvRevertMmThreadCharacteristics(task);
+  }
+  CoUninitialize();
+}
+
+bool WasapiAudioSink::FillBuffer() {
+  UINT32 padding = 0;
+  if (FAILED(client_->GetCurrentPadding(&padding))) {
+    return false;
+  }
+  UINT32 frames = buffer_frames_ - padding;
+  if (frames == 0) {
+    return true;
+  }
+  BYTE* data = nullptr;
+  if (FAILED(render_client_->GetBuffer(frames, &data))) {
+    return false;
+  }
+  pull_(reinterpret_cast<float*>(data), frames);
+  return SUCCEEDED(render_client_->ReleaseBuffer(frames, 0));
+}
+
+}  // namespace playmidifile
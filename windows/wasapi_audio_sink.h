@@ -0,0 +1,58 @@
+#ifndef FLUTTER_PLUGIN_WASAPI_AUDIO_SINK_H_
+#define FLUTTER_PLUGIN_WASAPI_AUDIO_SINK_H_
+
+#ifndef NOMINMAX
+#define NOMINMAX  // Prevent Windows min/max macros from conflicting with std::min/std::max
+#endif
+#include <windows.h>
+#include <audioclient.h>
+#include <wrl/client.h>
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "midi_engine/audio_sink.h"
+
+namespace playmidifile {
+
+// Plays an AudioOutput on the default Windows audio endpoint through WASAPI
+// in shared, event-driven mode. The device thread is registered with MMCSS
+// as "Pro Audio" and pulls whatever the endpoint buffer has room for each
+// time the audio engine signals.
+//
+// Shared mode runs at the audio engine's period (normally 10 ms); a smaller
+// requested period is rounded up to it.
+class WasapiAudioSink : public AudioSink {
+ public:
+  WasapiAudioSink();
+  ~WasapiAudioSink() override;
+
+  // Disallow copy and assign.
+  WasapiAudioSink(const WasapiAudioSink&) = delete;
+  WasapiAudioSink& operator=(const WasapiAudioSink&) = delete;
+
+  // AudioSink:
+  bool Open(AudioFormat* format, std::string* error) override;
+  void Start(PullCallback pull) override;
+  void Close() override;
+
+ private:
+  void Run();
+  // Fills the free part of the endpoint buffer. Returns false if the
+  // device went away.
+  bool FillBuffer();
+
+  Microsoft::WRL::ComPtr<IAudioClient> client_;
+  Microsoft::WRL::ComPtr<IAudioRenderClient> render_client_;
+  // Signalled by the audio engine when it wants data.
+  HANDLE buffer_event_;
+  HANDLE stop_event_;
+  UINT32 buffer_frames_;
+  PullCallback pull_;
+  std::thread thread_;
+};
+
+}  // namespace playmidifile
+
+#endif  // FLUTTER_PLUGIN_WASAPI_AUDIO_SINK_H_
@@ -0,0 +1,72 @@
+#include "win_midi_output.h"
+
+#include <thread>
+
+#pragma comment(lib, "winmm.lib")
+
+namespace playmidifile {
+
+WinMidiOutput::WinMidiOutput() : handle_(nullptr) {}
+
+WinMidiOutput::~WinMidiOutput() {
+  Close();
+}
+
+bool WinMidiOutput::Open(std::string* error) {
+  MMRESULT result = midiOutOpen(&handle_, MIDI_MAPPER, 0, 0, CALLBACK_NULL);
+  if (result != MMSYSERR_NOERROR) {
+    handle_ = nullptr;
+    *error = "Failed to open MIDI output (error " + std::to_string(result) + ")";
+    return false;
+  }
+  // The engine sleeps until the next event; raise the system timer
+  // resolution so those sleeps wake within a millisecond.
+  timeBeginPeriod(1);
+  return true;
+}
+
+void WinMidiOutput::Close() {
+  if (handle_) {
+    midiOutReset(handle_);
+    midiOutClose(handle_);
+    timeEndPeriod(1);
+    handle_ = nullptr;
+  }
+}
+
+void WinMidiOutput::SendChannelMessage(uint8_t status, uint8_t data1, uint8_t data2) {
+  if (handle_) {
+    midiOutShortMsg(handle_, static_cast<DWORD>(status) |
+                                 (static_cast<DWORD>(data1) << 8) |
+                                 (static_cast<DWORD>(data2) << 16));
+  }
+}
+
+void WinMidiOutput::SendSysEx(const uint8_t* data, size_t size) {
+  if (!handle_ || size == 0) {
+    return;
+  }
+  sysex_buffer_.assign(data, data + size);
+  MIDIHDR header = {};
+  header.lpData = reinterpret_cast<LPSTR>(sysex_buffer_.data());
+  header.dwBufferLength = static_cast<DWORD>(sysex_buffer_.size());
+  if (midiOutPrepareHeader(handle_, &header, sizeof(header)) != MMSYSERR_NOERROR) {
+    return;
+  }
+  if (midiOutLongMsg(handle_, &header, sizeof(header)) == MMSYSERR_NOERROR) {
+    // System exclusive messages are rare and short; wait for the driver.
+    while ((header.dwFlags & MHDR_DONE) == 0) {
+      std::this_thread::yield();
+    }
+  }
+  midiOutUnprepareHeader(handle_, &header, sizeof(header));
+}
+
+void WinMidiOutput::SetVolume(double volume) {
+  if (handle_) {
+    DWORD level = static_cast<DWORD>(volume * 0xFFFF);
+    midiOutSetVolume(handle_, level | (level << 16));
+  }
+}
+
+}  // namespace playmidifile
@@ -0,0 +1,46 @@
+#ifndef FLUTTER_PLUGIN_WIN_MIDI_OUTPUT_H_
+#define FLUTTER_PLUGIN_WIN_MIDI_OUTPUT_H_
+
+#ifndef NOMINMAX
+#define NOMINMAX  // Prevent Windows min/max macros from conflicting with std::min/std::max
+#endif
+#include <windows.h>
+#include <mmsystem.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "midi_engine/midi_output.h"
+
+namespace playmidifile {
+
+// Sends sequencer output to the Windows MIDI mapper (normally the Microsoft
+// GS Wavetable Synth) through the winmm midiOut API.
+class WinMidiOutput : public MidiOutput {
+ public:
+  WinMidiOutput();
+  ~WinMidiOutput() override;
+
+  // Disallow copy and assign.
+  WinMidiOutput(const WinMidiOutput&) = delete;
+  WinMidiOutput& operator=(const WinMidiOutput&) = delete;
+
+  // Opens the MIDI mapper. On failure returns false and fills |error|.
+  bool Open(std::string* error);
+  void Close();
+
+  void SendChannelMessage(uint8_t status, uint8_t data1,
+                          uint8_t data2) override;
+  void SendSysEx(const uint8_t* data, size_t size) override;
+  void SetVolume(double volume) override;
+
+ private:
+  HMIDIOUT handle_;
+  // midiOutLongMsg needs a writable buffer.
+  std::vector<uint8_t> sysex_buffer_;
+};
+
+}  // namespace playmidifile
+
+#endif  // FLUTTER_PLUGIN_WIN_MIDI_OUTPUT_H_